@@ -0,0 +1,26 @@
+#define DOCTEST_CONFIG_IMPLEMENT
+#include "doctest/doctest.h"
+
+#include "hadron/Heap.hpp"
+#include "hadron/PagePool.hpp"
+
+#include "spdlog/spdlog.h"
+
+// Runs the tests that need Heap compressed pointers. These must be enabled before the PagePool maps any memory, so
+// can't be from within the unittests process.
+int main(int argc, char* argv[]) {
+    spdlog::set_level(spdlog::level::debug);
+    if (!hadron::PagePool::instance().reserve(hadron::Heap::kMaximumCompressedReservation, hadron::PagePool::kNone)) {
+        SPDLOG_ERROR("Failed to reserve {} bytes for the heap.", hadron::Heap::kMaximumCompressedReservation);
+        return -1;
+    }
+    if (!hadron::Heap::enableCompressedPointers()) {
+        SPDLOG_ERROR("Failed to enable compressed pointers.");
+        return -1;
+    }
+
+    doctest::Context context;
+    context.applyCommandLine(argc, argv);
+    int res = context.run();
+    return res;
+}
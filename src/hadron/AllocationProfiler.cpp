@@ -0,0 +1,110 @@
+#include "hadron/AllocationProfiler.hpp"
+
+#include "hadron/Keywords.hpp"
+#include "hadron/LayoutTable.hpp"
+#include "hadron/library/Kernel.hpp"
+#include "hadron/library/Schema.hpp"
+#include "hadron/library/Symbol.hpp"
+#include "hadron/SymbolTable.hpp"
+#include "hadron/ThreadContext.hpp"
+
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+
+namespace {
+hadron::Hash symbolHash(hadron::Slot slot) { return slot.isHash() ? slot.getHash() : hadron::kNilHash; }
+} // namespace
+
+namespace hadron {
+
+AllocationProfiler::AllocationProfiler():
+        m_sampleInterval(kDefaultSampleInterval),
+        m_bytesUntilSample(0),
+        m_numberOfSamples(0) {
+    resetCountdown();
+}
+
+void AllocationProfiler::setSampleInterval(size_t sampleInterval) {
+    m_sampleInterval = sampleInterval;
+    resetCountdown();
+}
+
+void AllocationProfiler::sample(ThreadContext* context, library::Schema* object) {
+    assert(m_sampleInterval > 0);
+    resolveSamples();
+    resetCountdown();
+
+    // Collect the methods on the Frame chain from the innermost Frame outwards. Frames and methods are read without
+    // going through Symbol, so a partially initialized Frame records nil names instead of asserting.
+    Stack stack;
+    auto frame = reinterpret_cast<schema::FramePrivateSchema*>(context->framePointer);
+    while (frame != nullptr && frame->schema.classIndex() == schema::FramePrivateSchema::kClassIndex &&
+            stack.size() < kMaximumStackDepth * 2) {
+        if (frame->method.isPointer() && frame->method.getPointer()->classIndex() == schema::MethodSchema::kClassIndex) {
+            auto method = library::Method::wrapUnsafe(frame->method);
+            auto ownerClass = method.ownerClass();
+            // Pushed in reverse order, as the whole stack is reversed below.
+            stack.emplace_back(symbolHash(method.instance()->name));
+            stack.emplace_back(ownerClass.isNil() ? kNilHash : symbolHash(ownerClass.instance()->name));
+        }
+        frame = frame->caller.isPointer() ? reinterpret_cast<schema::FramePrivateSchema*>(frame->caller.getPointer()) :
+                nullptr;
+    }
+    std::reverse(stack.begin(), stack.end());
+
+    m_pendingSamples.emplace_back(std::make_pair(object, std::move(stack)));
+}
+
+void AllocationProfiler::resolveSamples() {
+    for (auto& [object, stack] : m_pendingSamples) {
+        stack.emplace_back(LayoutTable::instance().className(object->classIndex()));
+        m_stacks[stack] += m_sampleInterval;
+        ++m_numberOfSamples;
+    }
+    m_pendingSamples.clear();
+}
+
+void AllocationProfiler::writeFoldedStacks(ThreadContext* context, std::ostream& output) {
+    resolveSamples();
+
+    auto name = [context](Hash hash) {
+        if (context->symbolTable && context->symbolTable->isDefined(hash)) {
+            return std::string(library::Symbol(context, Slot::makeHash(hash)).view(context));
+        }
+        return fmt::format("{:#x}", hash);
+    };
+
+    for (const auto& [stack, bytes] : m_stacks) {
+        std::string line;
+        for (size_t i = 0; i + 1 < stack.size(); i += 2) {
+            line += fmt::format("{}:{};", name(stack[i]), name(stack[i + 1]));
+        }
+        line += name(stack.back());
+        output << fmt::format("{} {}\n", line, bytes);
+    }
+}
+
+void AllocationProfiler::clear() {
+    m_pendingSamples.clear();
+    m_stacks.clear();
+    m_numberOfSamples = 0;
+}
+
+void AllocationProfiler::resetCountdown() {
+    if (m_sampleInterval == 0) {
+        m_bytesUntilSample = std::numeric_limits<size_t>::max();
+        return;
+    }
+
+    // Exponentially distributed gaps make each allocated byte equally likely to be sampled, whatever the allocation
+    // pattern, while keeping the average gap at the sample interval.
+    m_distribution = std::exponential_distribution<double>(1.0 / static_cast<double>(m_sampleInterval));
+    m_bytesUntilSample = std::max(static_cast<size_t>(std::llround(m_distribution(m_randomEngine))),
+            static_cast<size_t>(1));
+}
+
+} // namespace hadron
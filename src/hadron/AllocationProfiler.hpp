@@ -0,0 +1,80 @@
+#ifndef SRC_HADRON_ALLOCATION_PROFILER_HPP_
+#define SRC_HADRON_ALLOCATION_PROFILER_HPP_
+
+#include "hadron/Hash.hpp"
+
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace hadron {
+
+namespace library {
+struct Schema;
+}
+
+struct ThreadContext;
+
+// Samples Heap allocations to find out which methods allocate what. The Heap counts allocated bytes on its slow paths,
+// and about once every sampleInterval() bytes records the class of the allocated object along with the methods on the
+// Frame chain at the time of the allocation. The gaps between samples are drawn from an exponential distribution, so
+// regular allocation patterns can't alias with the sampling.
+class AllocationProfiler {
+public:
+    AllocationProfiler();
+    ~AllocationProfiler() = default;
+
+    // Average number of bytes allocated per sample. Zero disables sampling.
+    void setSampleInterval(size_t sampleInterval);
+    size_t sampleInterval() const { return m_sampleInterval; }
+
+    // Counts |sizeInBytes| of allocation, and returns true if the allocation should be sampled with sample().
+    bool countAllocation(size_t sizeInBytes) {
+        if (m_bytesUntilSample > sizeInBytes) {
+            m_bytesUntilSample -= sizeInBytes;
+            return false;
+        }
+        return m_sampleInterval > 0;
+    }
+
+    // Samples |object|, attributing it to the methods in the Frame chain starting at the ThreadContext framePointer.
+    // The object header may not be written yet, so the sample stays pending until the next resolveSamples() call.
+    void sample(ThreadContext* context, library::Schema* object);
+    // Reads the class names of the pending samples. Must be called before a sampled object could be moved or freed.
+    void resolveSamples();
+
+    // Writes the samples in the folded stack format used by flame graph tools, one line per distinct stack. Each line
+    // is the owning class and name of each method from the outermost Frame inwards, then the class of the allocated
+    // object, separated by semicolons, followed by the estimated number of bytes allocated there.
+    void writeFoldedStacks(ThreadContext* context, std::ostream& output);
+    size_t numberOfSamples() const { return m_numberOfSamples; }
+    void clear();
+
+    static constexpr size_t kDefaultSampleInterval = 512 * 1024;
+    // Frame chains deeper than this are truncated to the innermost Frames.
+    static constexpr size_t kMaximumStackDepth = 64;
+
+private:
+    void resetCountdown();
+
+    size_t m_sampleInterval;
+    size_t m_bytesUntilSample;
+    std::minstd_rand m_randomEngine;
+    std::exponential_distribution<double> m_distribution;
+
+    // A stack is the owning class name and method name of each Frame from the outermost inwards, followed by the
+    // class name of the allocated object, all as symbol hashes. Names are only looked up when writing the stacks out.
+    using Stack = std::vector<Hash>;
+    // Samples taken but not yet resolved, as the object and its stack without the allocated class name.
+    std::vector<std::pair<library::Schema*, Stack>> m_pendingSamples;
+    // Estimated bytes allocated per stack.
+    std::map<Stack, size_t> m_stacks;
+    size_t m_numberOfSamples;
+};
+
+} // namespace hadron
+
+#endif // SRC_HADRON_ALLOCATION_PROFILER_HPP_
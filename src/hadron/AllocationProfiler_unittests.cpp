@@ -0,0 +1,72 @@
+#include "hadron/AllocationProfiler.hpp"
+
+#include "hadron/ErrorReporter.hpp"
+#include "hadron/Heap.hpp"
+#include "hadron/library/Array.hpp"
+#include "hadron/library/Kernel.hpp"
+#include "hadron/Runtime.hpp"
+#include "hadron/ThreadContext.hpp"
+
+#include "doctest/doctest.h"
+#include "fmt/format.h"
+
+#include <sstream>
+
+namespace hadron {
+
+class AllocationProfilerTestFixture {
+public:
+    AllocationProfilerTestFixture():
+        m_errorReporter(std::make_shared<ErrorReporter>()),
+        m_runtime(std::make_unique<Runtime>(m_errorReporter)) {}
+    virtual ~AllocationProfilerTestFixture() = default;
+protected:
+    ThreadContext* context() { return m_runtime->context(); }
+private:
+    std::shared_ptr<ErrorReporter> m_errorReporter;
+    std::unique_ptr<Runtime> m_runtime;
+};
+
+TEST_CASE_FIXTURE(AllocationProfilerTestFixture, "AllocationProfiler") {
+    SUBCASE("disabled") {
+        AllocationProfiler profiler;
+        CHECK_EQ(profiler.sampleInterval(), AllocationProfiler::kDefaultSampleInterval);
+        profiler.setSampleInterval(0);
+        CHECK_FALSE(profiler.countAllocation(Heap::kLargeObjectSize));
+        CHECK_FALSE(profiler.countAllocation(Heap::kLargeObjectSize));
+    }
+
+    SUBCASE("folded stacks") {
+        auto& profiler = context()->heap->allocationProfiler();
+        profiler.setSampleInterval(1);
+
+        // Build a single Frame running a method. The names aren't in the symbol table so are written out as hashes.
+        auto ownerClass = library::Class::alloc(context());
+        ownerClass.initToNil();
+        ownerClass.instance()->name = Slot::makeHash(0x1234);
+        auto method = library::Method::alloc(context());
+        method.initToNil();
+        method.instance()->name = Slot::makeHash(0x5678);
+        method.setOwnerClass(context(), ownerClass);
+        auto frame = library::Frame::alloc(context());
+        frame.initToNil();
+        frame.setMethod(context(), method);
+        context()->framePointer = reinterpret_cast<int8_t*>(frame.instance());
+        profiler.clear();
+
+        // With an interval of one byte every allocation outside of an allocation buffer is sampled.
+        library::Array::arrayAlloc(context(), Heap::kLargeObjectSize / kSlotSize);
+        std::ostringstream output;
+        profiler.writeFoldedStacks(context(), output);
+        CHECK_EQ(profiler.numberOfSamples(), 1);
+        CHECK_EQ(output.str(), fmt::format("0x1234:0x5678;{:#x} 1\n", library::Array::nameHash()));
+
+        context()->framePointer = nullptr;
+        profiler.clear();
+        std::ostringstream empty;
+        profiler.writeFoldedStacks(context(), empty);
+        CHECK(empty.str().empty());
+    }
+}
+
+} // namespace hadron
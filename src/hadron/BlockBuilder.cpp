@@ -49,6 +49,9 @@ std::unique_ptr<Frame> BlockBuilder::buildMethod(ThreadContext* context, const l
 
 std::unique_ptr<Frame> BlockBuilder::buildFrame(ThreadContext* context, const library::Method method,
     const ast::BlockAST* blockAST, hir::BlockLiteralHIR* outerBlockHIR) {
+    // The Frame holds references to heap objects the Heap can't see, which a collection could move or free.
+    assert(context->heap->isCollectionDeferred());
+
     // Build outer frame, root scope, and entry block.
     auto frame = std::make_unique<Frame>(context, outerBlockHIR, method);
     auto scope = frame->rootScope.get();
@@ -0,0 +1,248 @@
+#include "hadron/ClassHierarchyAnalysis.hpp"
+
+#include "hadron/Block.hpp"
+#include "hadron/ClassLibrary.hpp"
+#include "hadron/DispatchTable.hpp"
+#include "hadron/Frame.hpp"
+#include "hadron/hir/BlockLiteralHIR.hpp"
+#include "hadron/hir/ConstantHIR.hpp"
+#include "hadron/hir/DirectCallHIR.hpp"
+#include "hadron/hir/MessageHIR.hpp"
+#include "hadron/hir/ReadFromFrameHIR.hpp"
+#include "hadron/Scope.hpp"
+#include "hadron/SymbolTable.hpp"
+#include "hadron/ThreadContext.hpp"
+
+#include "fmt/format.h"
+#include "spdlog/spdlog.h"
+
+#include <cassert>
+#include <memory>
+#include <string_view>
+
+namespace hadron {
+
+namespace {
+const std::vector<library::Method> kNoMethods;
+
+void appendUnique(std::vector<library::Method>& methods, library::Method method) {
+    for (const auto& existing : methods) {
+        if (existing.slot() == method.slot()) { return; }
+    }
+    methods.emplace_back(method);
+}
+} // namespace
+
+void ClassHierarchyAnalysis::build(ThreadContext* context, library::ClassArray classArray) {
+    clear();
+    for (int32_t i = 0; i < classArray.size(); ++i) {
+        m_classNames.emplace(classArray.typedAt(i).name(context));
+    }
+    for (int32_t i = 0; i < classArray.size(); ++i) {
+        auto classDef = classArray.typedAt(i);
+        auto superclass = classDef.superclass(context);
+        if (superclass.isNil() || m_classNames.count(superclass) == 0) { m_rootClasses.emplace_back(classDef); }
+        auto methods = classDef.methods();
+        for (int32_t j = 0; j < methods.size(); ++j) {
+            addImplementor(context, methods.typedAt(j));
+        }
+    }
+}
+
+int32_t ClassHierarchyAnalysis::devirtualize(ThreadContext* context, const DispatchTable* dispatchTable,
+        Frame* frame) {
+    int32_t count = 0;
+    devirtualizeFrame(context, dispatchTable, frame->method, frame, count);
+    return count;
+}
+
+std::vector<library::Method> ClassHierarchyAnalysis::updateClass(ThreadContext* context, library::Class classDef) {
+    std::vector<library::Method> invalidated;
+    m_subclassTargets.clear();
+
+    auto name = classDef.name(context);
+    if (m_classNames.count(name) == 0) {
+        m_classNames.emplace(name);
+        auto superclass = classDef.superclass(context);
+        if (superclass.isNil() || m_classNames.count(superclass) == 0) {
+            // A second root means a receiver of unknown class may no longer inherit from the first root, which sends
+            // to receivers of unknown class relied on.
+            m_rootClasses.emplace_back(classDef);
+            for (auto& dependents : m_dependents) {
+                for (auto method : dependents.second) { appendUnique(invalidated, method); }
+            }
+            m_dependents.clear();
+        }
+    }
+
+    auto methods = classDef.methods();
+    for (int32_t i = 0; i < methods.size(); ++i) {
+        auto method = methods.typedAt(i);
+        addImplementor(context, method);
+        auto dependents = m_dependents.find(method.name(context));
+        if (dependents == m_dependents.end()) { continue; }
+        for (auto dependent : dependents->second) { appendUnique(invalidated, dependent); }
+        m_dependents.erase(dependents);
+    }
+
+    return invalidated;
+}
+
+const std::vector<library::Method>& ClassHierarchyAnalysis::implementors(library::Symbol selector) const {
+    auto iter = m_implementors.find(selector);
+    return iter != m_implementors.end() ? iter->second : kNoMethods;
+}
+
+const std::vector<library::Method>& ClassHierarchyAnalysis::dependents(library::Symbol selector) const {
+    auto iter = m_dependents.find(selector);
+    return iter != m_dependents.end() ? iter->second : kNoMethods;
+}
+
+void ClassHierarchyAnalysis::clear() {
+    m_implementors.clear();
+    m_dependents.clear();
+    m_classNames.clear();
+    m_rootClasses.clear();
+    m_subclassTargets.clear();
+}
+
+void ClassHierarchyAnalysis::devirtualizeScope(ThreadContext* context, const DispatchTable* dispatchTable,
+        library::Method dependent, Scope* scope, int32_t& count) {
+    for (auto& block : scope->blocks) {
+        auto frame = block->frame();
+        for (auto& statement : block->statements()) {
+            if (statement->opcode != hir::Opcode::kMessage) { continue; }
+            auto message = static_cast<const hir::MessageHIR*>(statement.get());
+            auto target = resolve(context, dispatchTable, frame, message);
+            if (target.isNil()) { continue; }
+
+            SPDLOG_INFO("Devirtualized send of {} in {}", message->selector.view(context), dependent.name(context)
+                    .view(context));
+            auto directCall = std::make_unique<hir::DirectCallHIR>(*message, target);
+            for (auto read : directCall->reads) {
+                auto provider = frame->values[read];
+                assert(provider);
+                provider->consumers.erase(statement.get());
+                provider->consumers.emplace(directCall.get());
+            }
+            if (directCall->id != hir::kInvalidID) { frame->values[directCall->id] = directCall.get(); }
+            addDependent(message->selector, dependent);
+            statement = std::move(directCall);
+            ++count;
+        }
+    }
+
+    for (auto& subScope : scope->subScopes) {
+        devirtualizeScope(context, dispatchTable, dependent, subScope.get(), count);
+    }
+}
+
+void ClassHierarchyAnalysis::devirtualizeFrame(ThreadContext* context, const DispatchTable* dispatchTable,
+        library::Method dependent, Frame* frame, int32_t& count) {
+    devirtualizeScope(context, dispatchTable, dependent, frame->rootScope.get(), count);
+    for (auto innerBlock : frame->innerBlocks) {
+        devirtualizeFrame(context, dispatchTable, dependent, innerBlock->frame.get(), count);
+    }
+}
+
+library::Method ClassHierarchyAnalysis::resolve(ThreadContext* context, const DispatchTable* dispatchTable,
+        const Frame* frame, const hir::MessageHIR* message) {
+    if (message->arguments.empty()) { return library::Method(); }
+    auto receiver = frame->values[message->arguments[0]];
+    if (!receiver) { return library::Method(); }
+
+    switch (receiver->opcode) {
+    case hir::Opcode::kConstant: {
+        auto constant = static_cast<const hir::ConstantHIR*>(receiver)->constant;
+        if (!constant.isPointer()) { break; }
+        auto classIndex = constant.getPointer()->classIndex();
+        library::Class classDef;
+        if (classIndex == schema::ClassSchema::kClassIndex) {
+            // Class names are constants, and a Class responds to the methods of its metaclass.
+            auto name = library::Class(constant).name(context).view(context);
+            classDef = context->classLibrary->findClassNamed(library::Symbol::fromView(context,
+                    name.substr(0, 5) == "Meta_" ? std::string("Class") : fmt::format("Meta_{}", name)));
+        } else {
+            classDef = context->classLibrary->findClassForIndex(classIndex);
+        }
+        if (classDef.isNil()) { return library::Method(); }
+        return resolveAll(context, dispatchTable, { classDef }, message->selector);
+    }
+
+    case hir::Opcode::kReadFromFrame: {
+        auto readFromFrame = static_cast<const hir::ReadFromFrameHIR*>(receiver);
+        if (readFromFrame->valueName == context->symbolTable->thisSymbol()) {
+            return resolveSubclasses(context, dispatchTable, frame->method.ownerClass(), message->selector);
+        }
+    } break;
+
+    case hir::Opcode::kRouteToSuperclass:
+        return library::Method();
+
+    default:
+        break;
+    }
+
+    auto flags = static_cast<int32_t>(receiver->typeFlags);
+    if (flags == TypeFlags::kNoFlags || (flags & TypeFlags::kObjectFlag)) {
+        // The receiver could be of any class, so only a single implementor inherited by every class will do.
+        const auto& methods = implementors(message->selector);
+        if (m_rootClasses.size() != 1 || methods.size() != 1) { return library::Method(); }
+        if (methods.front().ownerClass().slot() != m_rootClasses.front().slot()) { return library::Method(); }
+        return methods.front();
+    }
+
+    // Raw pointers only ever appear in the internals of the runtime, and have no class.
+    if (flags & TypeFlags::kRawPointerFlag) { return library::Method(); }
+    std::vector<library::Class> classes;
+    auto addClass = [context, &classes](std::string_view name) {
+        classes.emplace_back(context->classLibrary->findClassNamed(library::Symbol::fromView(context, name)));
+        return !classes.back().isNil();
+    };
+    if ((flags & TypeFlags::kNilFlag) && !addClass("Nil")) { return library::Method(); }
+    if ((flags & TypeFlags::kIntegerFlag) && !addClass("Integer")) { return library::Method(); }
+    if ((flags & TypeFlags::kFloatFlag) && !addClass("Float")) { return library::Method(); }
+    if ((flags & TypeFlags::kBooleanFlag) && !(addClass("True") && addClass("False"))) { return library::Method(); }
+    if ((flags & TypeFlags::kCharFlag) && !addClass("Char")) { return library::Method(); }
+    if ((flags & TypeFlags::kSymbolFlag) && !addClass("Symbol")) { return library::Method(); }
+    return resolveAll(context, dispatchTable, classes, message->selector);
+}
+
+library::Method ClassHierarchyAnalysis::resolveAll(ThreadContext* context, const DispatchTable* dispatchTable,
+        const std::vector<library::Class>& classes, library::Symbol selector) const {
+    library::Method target;
+    for (const auto& classDef : classes) {
+        auto method = dispatchTable->lookup(context, classDef, selector);
+        if (method.isNil() || (!target.isNil() && method.slot() != target.slot())) { return library::Method(); }
+        target = method;
+    }
+    return target;
+}
+
+library::Method ClassHierarchyAnalysis::resolveSubclasses(ThreadContext* context,
+        const DispatchTable* dispatchTable, library::Class classDef, library::Symbol selector) {
+    auto& targets = m_subclassTargets[classDef.name(context)];
+    auto iter = targets.find(selector);
+    if (iter != targets.end()) { return iter->second; }
+
+    auto target = dispatchTable->lookup(context, classDef, selector);
+    auto subclasses = classDef.subclasses();
+    for (int32_t i = 0; i < subclasses.size() && !target.isNil(); ++i) {
+        auto method = resolveSubclasses(context, dispatchTable, subclasses.typedAt(i), selector);
+        if (method.slot() != target.slot()) { target = library::Method(); }
+    }
+
+    // The recursion may have rehashed the map, so look the targets up again.
+    m_subclassTargets[classDef.name(context)].emplace(std::make_pair(selector, target));
+    return target;
+}
+
+void ClassHierarchyAnalysis::addImplementor(ThreadContext* context, library::Method method) {
+    appendUnique(m_implementors[method.name(context)], method);
+}
+
+void ClassHierarchyAnalysis::addDependent(library::Symbol selector, library::Method method) {
+    appendUnique(m_dependents[selector], method);
+}
+
+} // namespace hadron
@@ -0,0 +1,87 @@
+#ifndef SRC_HADRON_CLASS_HIERARCHY_ANALYSIS_HPP_
+#define SRC_HADRON_CLASS_HIERARCHY_ANALYSIS_HPP_
+
+#include "hadron/library/Array.hpp"
+#include "hadron/library/Kernel.hpp"
+#include "hadron/library/Symbol.hpp"
+#include "hadron/Slot.hpp"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace hadron {
+
+class DispatchTable;
+struct Frame;
+struct Scope;
+struct ThreadContext;
+
+namespace hir {
+struct MessageHIR;
+} // namespace hir
+
+// Class hierarchy analysis, run over the Frames of the class library before they are materialized. Records the set of
+// Methods implementing each selector, and uses those and the DispatchTable to replace message sends that can only
+// invoke one Method with DirectCallHIR. A send is devirtualized if the classes its receiver can belong to all resolve
+// the selector to the same Method. The receiver classes are known exactly for constants, are the class of the method
+// and all of its subclasses for sends to 'this', and are the classes of the immediate types for receivers known to
+// never be objects. Any other receiver can be of any class, so only sends of selectors implemented once, in the root
+// of the class hierarchy, are devirtualized. Each devirtualized send makes the Method containing it depend on the
+// selector, and ClassLibrary recompiles dependent Methods when a class changes its implementors of the selector.
+class ClassHierarchyAnalysis {
+public:
+    ClassHierarchyAnalysis() = default;
+    ~ClassHierarchyAnalysis() = default;
+
+    // Records the implementors of every selector in |classArray|, replacing any previous analysis.
+    void build(ThreadContext* context, library::ClassArray classArray);
+
+    // Replaces the message sends in |frame| and its inner frames that can only invoke a single Method, according to
+    // |dispatchTable|. Returns the number of sends replaced.
+    int32_t devirtualize(ThreadContext* context, const DispatchTable* dispatchTable, Frame* frame);
+
+    // Records the methods of |classDef|, which is new or has new methods, as implementors. Returns the Methods that
+    // devirtualized sends of any selector |classDef| implements, which must be recompiled, and forgets their
+    // dependencies.
+    std::vector<library::Method> updateClass(ThreadContext* context, library::Class classDef);
+
+    // Returns the Methods implementing |selector|, in any class.
+    const std::vector<library::Method>& implementors(library::Symbol selector) const;
+    // Returns the Methods that depend on |selector| having its current implementors.
+    const std::vector<library::Method>& dependents(library::Symbol selector) const;
+
+    // Empties the analysis.
+    void clear();
+
+private:
+    void devirtualizeScope(ThreadContext* context, const DispatchTable* dispatchTable, library::Method dependent,
+            Scope* scope, int32_t& count);
+    void devirtualizeFrame(ThreadContext* context, const DispatchTable* dispatchTable, library::Method dependent,
+            Frame* frame, int32_t& count);
+    // Returns the only Method |message| can invoke, or nil if there could be more than one.
+    library::Method resolve(ThreadContext* context, const DispatchTable* dispatchTable, const Frame* frame,
+            const hir::MessageHIR* message);
+    // Returns the Method all of |classes| resolve |selector| to, or nil if they differ or any doesn't understand it.
+    library::Method resolveAll(ThreadContext* context, const DispatchTable* dispatchTable,
+            const std::vector<library::Class>& classes, library::Symbol selector) const;
+    // Returns the Method |selector| resolves to for |classDef| and every one of its subclasses, or nil.
+    library::Method resolveSubclasses(ThreadContext* context, const DispatchTable* dispatchTable,
+            library::Class classDef, library::Symbol selector);
+
+    void addImplementor(ThreadContext* context, library::Method method);
+    void addDependent(library::Symbol selector, library::Method method);
+
+    std::unordered_map<library::Symbol, std::vector<library::Method>> m_implementors;
+    std::unordered_map<library::Symbol, std::vector<library::Method>> m_dependents;
+    std::unordered_set<library::Symbol> m_classNames;
+    // Classes whose superclass isn't in the class library. The class library normally has only one, Object.
+    std::vector<library::Class> m_rootClasses;
+    // Memoizes resolveSubclasses() by class name, then selector, as sends to 'this' are common and the subclasses of a
+    // class near the root are many.
+    std::unordered_map<library::Symbol, std::unordered_map<library::Symbol, library::Method>> m_subclassTargets;
+};
+
+} // namespace hadron
+
+#endif // SRC_HADRON_CLASS_HIERARCHY_ANALYSIS_HPP_
@@ -0,0 +1,158 @@
+#include "hadron/ClassHierarchyAnalysis.hpp"
+
+#include "hadron/Block.hpp"
+#include "hadron/ClassLibrary.hpp"
+#include "hadron/DispatchTable.hpp"
+#include "hadron/ErrorReporter.hpp"
+#include "hadron/Frame.hpp"
+#include "hadron/hir/ConstantHIR.hpp"
+#include "hadron/hir/DirectCallHIR.hpp"
+#include "hadron/hir/MessageHIR.hpp"
+#include "hadron/hir/ReadFromFrameHIR.hpp"
+#include "hadron/library/Array.hpp"
+#include "hadron/library/Kernel.hpp"
+#include "hadron/library/KernelFixtures_unittests.hpp"
+#include "hadron/library/Symbol.hpp"
+#include "hadron/Runtime.hpp"
+#include "hadron/Scope.hpp"
+#include "hadron/SymbolTable.hpp"
+#include "hadron/ThreadContext.hpp"
+
+#include "doctest/doctest.h"
+
+#include <iterator>
+#include <memory>
+#include <string_view>
+
+namespace hadron {
+
+using fixtures::addClass;
+using fixtures::addMethod;
+
+namespace {
+// Appends a send of |selector| to |receiver| to |block|, returning its value.
+hir::ID send(ThreadContext* context, Block* block, hir::ID receiver, std::string_view selector) {
+    auto message = std::make_unique<hir::MessageHIR>();
+    message->selector = library::Symbol::fromView(context, selector);
+    message->addArgument(receiver);
+    return block->append(std::move(message));
+}
+
+const hir::HIR* statementAt(Block* block, size_t index) {
+    return std::next(block->statements().begin(), index)->get();
+}
+} // namespace
+
+TEST_CASE("ClassHierarchyAnalysis") {
+    Runtime runtime(std::make_shared<ErrorReporter>());
+    auto context = runtime.context();
+
+    auto classArray = library::ClassArray::typedArrayAlloc(context, 1);
+    auto object = addClass(context, classArray, "Object", library::Class());
+    auto objectA = addMethod(context, object, "a");
+    auto objectE = addMethod(context, object, "e");
+    auto collection = addClass(context, classArray, "Collection", object);
+    auto collectionC = addMethod(context, collection, "c");
+    auto collectionM = addMethod(context, collection, "m");
+    auto array = addClass(context, classArray, "Array", collection);
+    auto arrayA = addMethod(context, array, "a");
+    auto string = addClass(context, classArray, "String", object);
+    addMethod(context, string, "d");
+    addClass(context, classArray, "Integer", object);
+    REQUIRE(context->classLibrary->restoreLibrary(context, classArray, library::Method(), library::Array()));
+
+    auto a = library::Symbol::fromView(context, "a");
+    auto c = library::Symbol::fromView(context, "c");
+    auto e = library::Symbol::fromView(context, "e");
+
+    DispatchTable table;
+    REQUIRE(table.build(context, classArray));
+    ClassHierarchyAnalysis analysis;
+    analysis.build(context, classArray);
+
+    REQUIRE_EQ(analysis.implementors(a).size(), 2);
+    CHECK_EQ(analysis.implementors(a)[0].slot(), objectA.slot());
+    CHECK_EQ(analysis.implementors(a)[1].slot(), arrayA.slot());
+    REQUIRE_EQ(analysis.implementors(c).size(), 1);
+    CHECK_EQ(analysis.implementors(c)[0].slot(), collectionC.slot());
+    CHECK(analysis.implementors(library::Symbol::fromView(context, "missing")).empty());
+
+    // A method of Collection, sending to an Integer constant, to 'this', and to the result of another send.
+    Frame frame(context, nullptr, collectionM);
+    frame.rootScope->blocks.emplace_back(std::make_unique<Block>(frame.rootScope.get(), frame.numberOfBlocks));
+    ++frame.numberOfBlocks;
+    auto block = frame.rootScope->blocks.front().get();
+    auto integer = block->append(std::make_unique<hir::ConstantHIR>(Slot::makeInt32(1)));
+    send(context, block, integer, "a");
+    auto self = block->append(std::make_unique<hir::ReadFromFrameHIR>(0, hir::kInvalidID,
+            context->symbolTable->thisSymbol()));
+    send(context, block, self, "c");
+    auto result = send(context, block, self, "a");
+    send(context, block, result, "d");
+    send(context, block, result, "e");
+
+    CHECK_EQ(analysis.devirtualize(context, &table, &frame), 3);
+
+    // Integer inherits 'a' from Object.
+    REQUIRE_EQ(statementAt(block, 1)->opcode, hir::Opcode::kDirectCall);
+    CHECK_EQ(static_cast<const hir::DirectCallHIR*>(statementAt(block, 1))->method.slot(), objectA.slot());
+    // Collection and its subclass Array both inherit 'c' from Collection.
+    REQUIRE_EQ(statementAt(block, 3)->opcode, hir::Opcode::kDirectCall);
+    CHECK_EQ(static_cast<const hir::DirectCallHIR*>(statementAt(block, 3))->method.slot(), collectionC.slot());
+    // Array overrides 'a', so 'this' could invoke either.
+    CHECK_EQ(statementAt(block, 4)->opcode, hir::Opcode::kMessage);
+    // A receiver of unknown class can only be devirtualized for selectors only the root class implements.
+    CHECK_EQ(statementAt(block, 5)->opcode, hir::Opcode::kMessage);
+    REQUIRE_EQ(statementAt(block, 6)->opcode, hir::Opcode::kDirectCall);
+    CHECK_EQ(static_cast<const hir::DirectCallHIR*>(statementAt(block, 6))->method.slot(), objectE.slot());
+
+    // The replacements take over the values and consumers of the sends they replace.
+    CHECK_EQ(frame.values[result], statementAt(block, 4));
+    CHECK_EQ(frame.values[statementAt(block, 3)->id], statementAt(block, 3));
+    CHECK_EQ(frame.values[self]->consumers.count(const_cast<hir::HIR*>(statementAt(block, 3))), 1);
+    CHECK_EQ(frame.values[self]->consumers.size(), 2);
+
+    REQUIRE_EQ(analysis.dependents(c).size(), 1);
+    CHECK_EQ(analysis.dependents(c)[0].slot(), collectionM.slot());
+    CHECK_EQ(analysis.dependents(a).size(), 1);
+    CHECK(analysis.dependents(library::Symbol::fromView(context, "d")).empty());
+
+    SUBCASE("new implementor invalidates dependents") {
+        addMethod(context, array, "c");
+        auto invalidated = analysis.updateClass(context, array);
+        REQUIRE_EQ(invalidated.size(), 1);
+        CHECK_EQ(invalidated[0].slot(), collectionM.slot());
+        CHECK_EQ(analysis.implementors(c).size(), 2);
+        // Array also implements 'a', so the dependency on that goes too, but the dependent is only recompiled once.
+        CHECK(analysis.dependents(c).empty());
+        CHECK(analysis.dependents(a).empty());
+        CHECK_EQ(analysis.dependents(e).size(), 1);
+
+        // Recompiling with the new implementor in the table leaves the send to 'this' a message.
+        REQUIRE(table.updateClass(context, array));
+        auto message = std::make_unique<hir::MessageHIR>();
+        message->selector = c;
+        message->addArgument(self);
+        block->append(std::move(message));
+        CHECK_EQ(analysis.devirtualize(context, &table, &frame), 0);
+    }
+
+    SUBCASE("unrelated class") {
+        addMethod(context, string, "f");
+        CHECK(analysis.updateClass(context, string).empty());
+        CHECK_EQ(analysis.dependents(c).size(), 1);
+    }
+
+    SUBCASE("new root invalidates everything") {
+        auto root = library::Class::alloc(context);
+        root.initToNil();
+        root.setName(library::Symbol::fromView(context, "ProtoObject"));
+        auto invalidated = analysis.updateClass(context, root);
+        REQUIRE_EQ(invalidated.size(), 1);
+        CHECK_EQ(invalidated[0].slot(), collectionM.slot());
+        CHECK(analysis.dependents(a).empty());
+        CHECK(analysis.dependents(e).empty());
+    }
+}
+
+} // namespace hadron
@@ -5,6 +5,8 @@
 #include "hadron/ASTBuilder.hpp"
 #include "hadron/Block.hpp"
 #include "hadron/BlockBuilder.hpp"
+#include "hadron/ClassHierarchyAnalysis.hpp"
+#include "hadron/DispatchTable.hpp"
 #include "hadron/Emitter.hpp"
 #include "hadron/ErrorReporter.hpp"
 #include "hadron/Frame.hpp"
@@ -12,11 +14,13 @@
 #include "hadron/Heap.hpp"
 #include "hadron/internal/FileSystem.hpp"
 #include "hadron/Keywords.hpp"
+#include "hadron/LayoutTable.hpp"
 #include "hadron/Lexer.hpp"
 #include "hadron/LifetimeAnalyzer.hpp"
 #include "hadron/LighteningJIT.hpp"
 #include "hadron/LinearFrame.hpp"
 #include "hadron/Materializer.hpp"
+#include "hadron/MethodCache.hpp"
 #include "hadron/Parser.hpp"
 #include "hadron/RegisterAllocator.hpp"
 #include "hadron/Resolver.hpp"
@@ -27,24 +31,126 @@
 
 #include "spdlog/spdlog.h"
 
+#include <algorithm>
 #include <cassert>
+#include <string>
+#include <vector>
 
 namespace hadron {
 
 ClassLibrary::ClassLibrary(std::shared_ptr<ErrorReporter> errorReporter):
         m_errorReporter(errorReporter),
-        m_numberOfClassVariables(0) {}
+        m_numberOfClassVariables(0),
+        m_methodCache(std::make_unique<MethodCache>()),
+        m_dispatchTable(std::make_unique<DispatchTable>()),
+        m_classHierarchy(std::make_unique<ClassHierarchyAnalysis>()) {}
+
+ClassLibrary::~ClassLibrary() = default;
 
 void ClassLibrary::addClassDirectory(const std::string& path) {
     m_libraryPaths.emplace(fs::absolute(path));
 }
 
 bool ClassLibrary::compileLibrary(ThreadContext* context) {
-    if (!resetLibrary(context)) { return false; }
-    if (!scanFiles(context)) { return false; }
-    if (!finalizeHeirarchy(context)) { return false; }
-    if (!materializeFrames(context)) { return false; }
-    return cleanUp();
+    // The compiler holds many references to heap objects that are not visible to the Heap, so collection must wait
+    // until compilation is complete. The class library lives as long as the process, so is allocated in the permanent
+    // space.
+    context->heap->deferCollection();
+    context->heap->beginPermanentAllocation();
+    bool success = resetLibrary(context) && scanFiles(context) && finalizeHeirarchy(context) &&
+            m_dispatchTable->build(context, m_classArray) && devirtualizeFrames(context) &&
+            materializeFrames(context) && cleanUp();
+    if (success) { addToRootSet(context); }
+    context->heap->endPermanentAllocation();
+    context->heap->allowCollection();
+    return success;
+}
+
+bool ClassLibrary::restoreLibrary(ThreadContext* context, library::ClassArray classArray,
+        library::Method interpreterContext, library::Array classVariables) {
+    removeFromRootSet(context);
+    m_methodCache->flush();
+    m_classMap.clear();
+    m_classesByIndex.clear();
+    m_rootClasses.clear();
+    m_methodASTs.clear();
+    m_methodFrames.clear();
+    // Added classes are numbered in the order of the class array, the same as when the library was compiled.
+    LayoutTable::instance().removeAddedLayouts();
+    m_classArray = classArray;
+    // The restored methods keep whatever direct calls they were compiled with, but without their ASTs they can't be
+    // recompiled, so nothing depends on the implementors recorded here.
+    m_classHierarchy->build(context, m_classArray);
+    for (int32_t i = 0; i < m_classArray.size(); ++i) {
+        auto classDef = m_classArray.typedAt(i);
+        addClass(classDef.name(context), classDef);
+        if (classDef.superclass(context).isNil()) { m_rootClasses.emplace_back(classDef); }
+    }
+    m_interpreterContext = interpreterContext;
+    m_classVariables = classVariables;
+    m_numberOfClassVariables = classVariables.size();
+    numberClasses();
+    updateLayouts(context);
+    addToRootSet(context);
+    return m_dispatchTable->build(context, m_classArray);
+}
+
+bool ClassLibrary::updateDispatch(ThreadContext* context, library::Class classDef) {
+    m_methodCache->flush();
+    // Adding the class to its superclass and updating the dispatch table allocate while holding |classDef| and the
+    // superclass, which a collection could move.
+    context->heap->deferCollection();
+    if (!classDef.isNumbered()) {
+        auto name = classDef.name(context);
+        if (findClassNamed(name).isNil()) { addClass(name, classDef); }
+        auto superclassName = classDef.superclass(context);
+        if (superclassName.isNil()) {
+            m_rootClasses.emplace_back(classDef);
+        } else {
+            auto superclass = findClassNamed(superclassName);
+            if (!superclass.isNil()) {
+                superclass.setSubclasses(context, superclass.subclasses().typedAdd(context, classDef));
+            }
+        }
+        // Renumbering is a single walk over the hierarchy, with no lookups, and only needed when classes are added.
+        numberClasses();
+        updateLayouts(context);
+    }
+    if (!m_dispatchTable->updateClass(context, classDef)) {
+        context->heap->allowCollection();
+        return false;
+    }
+
+    bool success = true;
+    for (auto method : m_classHierarchy->updateClass(context, classDef)) {
+        success = recompileMethod(context, method) && success;
+    }
+    context->heap->allowCollection();
+    return success;
+}
+
+Hash ClassLibrary::sourceHash() const {
+    // Directory iteration order is unspecified, so sort the paths for a stable hash.
+    std::vector<fs::path> paths;
+    for (const auto& classLibPath : m_libraryPaths) {
+        for (auto& entry : fs::recursive_directory_iterator(classLibPath)) {
+            const auto& path = fs::absolute(entry.path());
+            if (!fs::is_regular_file(path) || path.extension() != ".sc")
+                continue;
+            paths.emplace_back(path);
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    std::string digest;
+    for (const auto& path : paths) {
+        SourceFile sourceFile(path.string());
+        if (!sourceFile.read(m_errorReporter)) { return 0; }
+        Hash fileHash = hash(sourceFile.codeView());
+        digest.append(path.string());
+        digest.append(reinterpret_cast<const char*>(&fileHash), sizeof(fileHash));
+    }
+    return hash(digest);
 }
 
 library::Class ClassLibrary::findClassNamed(library::Symbol name) const {
@@ -55,7 +161,14 @@ library::Class ClassLibrary::findClassNamed(library::Symbol name) const {
 }
 
 bool ClassLibrary::resetLibrary(ThreadContext* context) {
+    removeFromRootSet(context);
+    m_methodCache->flush();
+    m_dispatchTable->clear();
+    m_classHierarchy->clear();
     m_classMap.clear();
+    m_classesByIndex.clear();
+    m_rootClasses.clear();
+    LayoutTable::instance().removeAddedLayouts();
     m_classArray = library::ClassArray::typedArrayAlloc(context, 1);
     m_methodASTs.clear();
     m_methodFrames.clear();
@@ -126,11 +239,11 @@ bool ClassLibrary::scanFiles(ThreadContext* context) {
                     method.initToNil();
 
                     library::Class methodClassDef = methodNode->isClassMethod ? metaClassDef : classDef;
-                    method.setOwnerClass(methodClassDef);
+                    method.setOwnerClass(context, methodClassDef);
 
                     library::MethodArray methodArray = methodClassDef.methods();
                     methodArray = methodArray.typedAdd(context, method);
-                    methodClassDef.setMethods(methodArray);
+                    methodClassDef.setMethods(context, methodArray);
 
                     library::Symbol methodName = library::Symbol::fromView(context,
                             lexer->tokens()[methodNode->tokenIndex].range);
@@ -155,7 +268,7 @@ bool ClassLibrary::scanFiles(ThreadContext* context) {
                         if (!ast) { return false; }
 
                         // Attach argument names from AST to the method definition.
-                        method.setArgNames(ast->argumentNames);
+                        method.setArgNames(context, ast->argumentNames);
 
                         auto methodIter = m_methodASTs.find(methodClassDef.name(context));
                         assert(methodIter != m_methodASTs.end());
@@ -207,7 +320,7 @@ bool ClassLibrary::scanClass(ThreadContext* context, library::Class classDef, li
         library::Class superclass = findOrInitClass(context, superclassName);
         library::ClassArray subclasses = superclass.subclasses();
         subclasses = subclasses.typedAdd(context, classDef);
-        superclass.setSubclasses(subclasses);
+        superclass.setSubclasses(context, subclasses);
     }
 
     // Set up the parent object for the Meta class, which always has a parent.
@@ -215,14 +328,18 @@ bool ClassLibrary::scanClass(ThreadContext* context, library::Class classDef, li
     library::Class metaSuperclass = findOrInitClass(context, metaSuperclassName);
     library::ClassArray metaSubclasses = metaSuperclass.subclasses();
     metaSubclasses = metaSubclasses.typedAdd(context, metaClassDef);
-    metaSuperclass.setSubclasses(metaSubclasses);
+    metaSuperclass.setSubclasses(context, metaSubclasses);
 
     // Extract class and instance variables and constants.
     const parse::VarListNode* varList = classNode->variables.get();
     while (varList) {
         auto varHash = lexer->tokens()[varList->tokenIndex].hash;
-        auto nameArray = library::SymbolArray();
-        auto valueArray = library::Array();
+        int32_t numberOfDefinitions = 0;
+        for (const parse::Node* node = varList->definitions.get(); node; node = node->next.get()) {
+            ++numberOfDefinitions;
+        }
+        auto nameArray = library::SymbolArray().reserve(context, numberOfDefinitions);
+        auto valueArray = library::Array().reserve(context, numberOfDefinitions);
 
         const parse::VarDefNode* varDef = varList->definitions.get();
         while (varDef) {
@@ -245,15 +362,15 @@ bool ClassLibrary::scanClass(ThreadContext* context, library::Class classDef, li
 
         // Each line gets its own varList parse node, so append to any existing arrays to preserve previous values.
         if (varHash == kVarHash) {
-            classDef.setInstVarNames(classDef.instVarNames().addAll(context, nameArray));
-            classDef.setIprototype(classDef.iprototype().addAll(context, valueArray));
+            classDef.setInstVarNames(context, classDef.instVarNames().addAll(context, nameArray));
+            classDef.setIprototype(context, classDef.iprototype().addAll(context, valueArray));
         } else if (varHash == kClassVarHash) {
-            classDef.setClassVarNames(classDef.classVarNames().addAll(context, nameArray));
-            classDef.setCprototype(classDef.cprototype().addAll(context, valueArray));
+            classDef.setClassVarNames(context, classDef.classVarNames().addAll(context, nameArray));
+            classDef.setCprototype(context, classDef.cprototype().addAll(context, valueArray));
             m_numberOfClassVariables += nameArray.size();
         } else if (varHash == kConstHash) {
-            classDef.setConstNames(classDef.constNames().addAll(context, nameArray));
-            classDef.setConstValues(classDef.constValues().addAll(context, valueArray));
+            classDef.setConstNames(context, classDef.constNames().addAll(context, nameArray));
+            classDef.setConstValues(context, classDef.constValues().addAll(context, valueArray));
         } else {
             // Internal error with VarListNode pointing at a token that isn't 'var', 'classvar', or 'const'.
             assert(false);
@@ -276,10 +393,10 @@ library::Class ClassLibrary::findOrInitClass(ThreadContext* context, library::Sy
 
     classDef.setName(className);
 
-    m_classMap.emplace(std::make_pair(className, classDef));
+    addClass(className, classDef);
 
     if (m_classArray.size()) {
-        classDef.setNextclass(m_classArray.typedAt(m_classArray.size() - 1));
+        classDef.setNextclass(context, m_classArray.typedAt(m_classArray.size() - 1));
     }
     m_classArray = m_classArray.typedAdd(context, classDef);
 
@@ -299,12 +416,14 @@ bool ClassLibrary::finalizeHeirarchy(ThreadContext* context) {
 
     // We start at the root of the class heirarchy with Object.
     auto objectClassDef = objectIter->second;
-    bool success = composeSubclassesFrom(context, objectClassDef);
-
-    // We've converted all the ASTs to Frames, so we can free up the RAM.
-    m_methodASTs.clear();
+    if (!composeSubclassesFrom(context, objectClassDef)) { return false; }
+    m_rootClasses.emplace_back(objectClassDef);
+    numberClasses();
+    updateLayouts(context);
 
-    return success;
+    // The ASTs are kept after building the Frames, for recompiling methods with sends devirtualized by class
+    // hierarchy analysis when the class library changes.
+    return true;
 }
 
 bool ClassLibrary::composeSubclassesFrom(ThreadContext* context, library::Class classDef) {
@@ -350,12 +469,12 @@ bool ClassLibrary::composeSubclassesFrom(ThreadContext* context, library::Class
     for (int32_t i = 0; i < classDef.subclasses().size(); ++i) {
         auto subclass = classDef.subclasses().typedAt(i);
 
-        subclass.setInstVarNames(
+        subclass.setInstVarNames(context,
                 classDef.instVarNames()
                     .copy(context, classDef.instVarNames().size() + subclass.instVarNames().size())
                     .addAll(context, subclass.instVarNames()));
 
-        subclass.setIprototype(
+        subclass.setIprototype(context,
                 classDef.iprototype()
                     .copy(context, classDef.iprototype().size() + subclass.iprototype().size())
                     .addAll(context, subclass.iprototype()));
@@ -366,6 +485,39 @@ bool ClassLibrary::composeSubclassesFrom(ThreadContext* context, library::Class
     return true;
 }
 
+void ClassLibrary::numberClasses() {
+    int32_t preorderIndex = 0;
+    for (auto classDef : m_rootClasses) {
+        preorderIndex = numberSubclassesFrom(classDef, preorderIndex);
+    }
+}
+
+int32_t ClassLibrary::numberSubclassesFrom(library::Class classDef, int32_t preorderIndex) {
+    classDef.setPreorderIndex(preorderIndex);
+    ++preorderIndex;
+    auto subclasses = classDef.subclasses();
+    for (int32_t i = 0; i < subclasses.size(); ++i) {
+        preorderIndex = numberSubclassesFrom(subclasses.typedAt(i), preorderIndex);
+    }
+    classDef.setMaxSubclassIndex(preorderIndex - 1);
+    return preorderIndex;
+}
+
+bool ClassLibrary::devirtualizeFrames(ThreadContext* context) {
+    m_classHierarchy->build(context, m_classArray);
+
+    int32_t numberOfDirectCalls = 0;
+    for (auto& methodMap : m_methodFrames) {
+        for (auto& methodFrame : *methodMap.second) {
+            numberOfDirectCalls += m_classHierarchy->devirtualize(context, m_dispatchTable.get(),
+                    methodFrame.second.get());
+        }
+    }
+
+    SPDLOG_INFO("Class hierarchy analysis replaced {} message sends with direct calls.", numberOfDirectCalls);
+    return true;
+}
+
 bool ClassLibrary::materializeFrames(ThreadContext* context) {
     for (auto& methodMap : m_methodFrames) {
         auto className = methodMap.first;
@@ -384,14 +536,97 @@ bool ClassLibrary::materializeFrames(ThreadContext* context) {
             SPDLOG_INFO("materializing frame for {}:{}", className.view(context), methodName.view(context));
 
             auto bytecode = Materializer::materialize(context, frameIter->second.get());
-            method.setCode(bytecode);
+            method.setCode(context, bytecode);
+            method.setConstants(context, frameIter->second->constants);
         }
     }
 
     return true;
 }
 
+bool ClassLibrary::recompileMethod(ThreadContext* context, library::Method method) {
+    auto className = method.ownerClass().name(context);
+    auto methodName = method.name(context);
+    auto classASTs = m_methodASTs.find(className);
+    if (classASTs == m_methodASTs.end() || classASTs->second->find(methodName) == classASTs->second->end()) {
+        SPDLOG_ERROR("No AST to recompile method {}:{}", className.view(context), methodName.view(context));
+        return false;
+    }
+
+    SPDLOG_INFO("Recompiling {}:{}", className.view(context), methodName.view(context));
+
+    // Same as compileLibrary(), the Frame holds references the Heap can't see.
+    context->heap->deferCollection();
+    context->heap->beginPermanentAllocation();
+    BlockBuilder blockBuilder(m_errorReporter);
+    auto frame = blockBuilder.buildMethod(context, method, classASTs->second->at(methodName).get());
+    bool success = frame != nullptr;
+    if (success && context->runInternalDiagnostics) { success = Validator::validateFrame(frame.get()); }
+    if (success) {
+        m_classHierarchy->devirtualize(context, m_dispatchTable.get(), frame.get());
+        method.setCode(context, Materializer::materialize(context, frame.get()));
+        method.setConstants(context, frame->constants);
+    }
+    context->heap->endPermanentAllocation();
+    context->heap->allowCollection();
+    return success;
+}
+
+void ClassLibrary::addToRootSet(ThreadContext* context) {
+    // Everything else in the class library is reachable from the class array and class variables.
+    if (!m_classArray.isNil()) { context->heap->addToRootSet(m_classArray.slot()); }
+    if (!m_classVariables.isNil()) { context->heap->addToRootSet(m_classVariables.slot()); }
+}
+
+void ClassLibrary::removeFromRootSet(ThreadContext* context) {
+    if (!m_classArray.isNil()) { context->heap->removeFromRootSet(m_classArray.slot()); }
+    if (!m_classVariables.isNil()) { context->heap->removeFromRootSet(m_classVariables.slot()); }
+}
+
+void ClassLibrary::addClass(library::Symbol name, library::Class classDef) {
+    m_classMap.emplace(std::make_pair(name, classDef));
+    auto& layoutTable = LayoutTable::instance();
+    auto classIndex = layoutTable.classIndexOf(name.hash());
+    if (classIndex == LayoutTable::kNoClassIndex) {
+        // Until updateLayouts() runs the class has no instance variables, so its instances can't exist yet.
+        classIndex = layoutTable.addLayout(library::SchemaLayout{name.hash(), 0, library::SchemaLayout::kNotIndexed,
+                ~0ull});
+    }
+    if (classIndex >= m_classesByIndex.size()) { m_classesByIndex.resize(classIndex + 1); }
+    m_classesByIndex[classIndex] = classDef;
+}
+
+void ClassLibrary::updateLayouts(ThreadContext* context) {
+    for (auto classDef : m_rootClasses) {
+        updateLayoutsFrom(context, classDef, library::SchemaLayout::kNotIndexed);
+    }
+}
+
+void ClassLibrary::updateLayoutsFrom(ThreadContext* context, library::Class classDef,
+        library::SchemaLayout::Indexed indexed) {
+    auto& layoutTable = LayoutTable::instance();
+    auto name = classDef.name(context).hash();
+    auto classIndex = layoutTable.classIndexOf(name);
+    if (classIndex == LayoutTable::kNoClassIndex) { assert(false); return; }
+    if (classIndex < layoutTable.numberOfBuiltInLayouts()) {
+        // The layouts schemac generated describe the C++ schemas, so are left as they are.
+        indexed = layoutTable.layout(classIndex)->indexed;
+    } else {
+        // The instance variables of classes defined in the language can hold anything.
+        layoutTable.setLayout(classIndex, library::SchemaLayout{name,
+                static_cast<uint32_t>(classDef.instVarNames().size()), indexed, ~0ull});
+    }
+
+    auto subclasses = classDef.subclasses();
+    for (int32_t i = 0; i < subclasses.size(); ++i) {
+        updateLayoutsFrom(context, subclasses.typedAt(i), indexed);
+    }
+}
+
 bool ClassLibrary::cleanUp() {
+    // The Frames hold references to heap objects not tracked by the Heap, and are no longer needed after
+    // materialization.
+    m_methodFrames.clear();
     return true;
 }
 
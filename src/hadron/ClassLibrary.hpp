@@ -5,18 +5,23 @@
 #include "hadron/Slot.hpp"
 #include "hadron/library/Array.hpp"
 #include "hadron/library/Kernel.hpp"
+#include "hadron/library/Schema.hpp"
 #include "hadron/library/Symbol.hpp"
 
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 namespace hadron {
 
+class ClassHierarchyAnalysis;
+class DispatchTable;
 class ErrorReporter;
 struct Frame;
 class Lexer;
+class MethodCache;
 class Parser;
 class SourceFile;
 struct ThreadContext;
@@ -34,7 +39,7 @@ class ClassLibrary {
 public:
     ClassLibrary() = delete;
     explicit ClassLibrary(std::shared_ptr<ErrorReporter> errorReporter);
-    ~ClassLibrary() = default;
+    ~ClassLibrary();
 
     // Adds a directory to the list of directories to scan for library classes.
     void addClassDirectory(const std::string& path);
@@ -43,12 +48,39 @@ public:
     // found within.
     bool compileLibrary(ThreadContext* context);
 
+    // Restores a previously compiled class library, such as one loaded from a HeapImage, in place of compileLibrary().
+    bool restoreLibrary(ThreadContext* context, library::ClassArray classArray, library::Method interpreterContext,
+            library::Array classVariables);
+
+    // Returns a hash of the paths and contents of every class file in the class directories, for detecting changes to
+    // the class library source. Returns 0 if any file can't be read.
+    Hash sourceHash() const;
+
     library::Class findClassNamed(library::Symbol name) const;
+    // Returns the Class for the class index in an object header, or nil if there is no such class.
+    library::Class findClassForIndex(uint32_t classIndex) const {
+        return classIndex < m_classesByIndex.size() ? m_classesByIndex[classIndex] : library::Class();
+    }
 
     library::Method interpreterContext() const { return m_interpreterContext; }
 
+    library::ClassArray classArray() const { return m_classArray; }
+
     library::Array classVariables() const { return m_classVariables; }
 
+    // The method lookup caches for message sends, flushed whenever the class library is compiled or restored.
+    MethodCache* methodCache() const { return m_methodCache.get(); }
+
+    // Maps every class and selector to the Method a send invokes, rebuilt whenever the class library is compiled or
+    // restored.
+    const DispatchTable* dispatchTable() const { return m_dispatchTable.get(); }
+
+    // Updates method dispatch for |classDef| and its subclasses, after methods were added to or removed from
+    // |classDef|, or after |classDef| was added to the class library. Recompiles any methods with sends devirtualized
+    // on the assumption that |classDef| didn't implement one of its selectors. A new class joins the subclasses of its
+    // superclass, and the classes are renumbered.
+    bool updateDispatch(ThreadContext* context, library::Class classDef);
+
 private:
     // Call to delete any existing class libary compilation structures and start fresh.
     bool resetLibrary(ThreadContext* context);
@@ -65,21 +97,47 @@ private:
     bool finalizeHeirarchy(ThreadContext* context);
     bool composeSubclassesFrom(ThreadContext* context, library::Class classDef);
 
+    // Numbers every class in preorder, walking down from each of |m_rootClasses|, for Class::isSubclassOf().
+    void numberClasses();
+    // Numbers |classDef| with |preorderIndex| and its subclasses after it. Returns the next free number.
+    int32_t numberSubclassesFrom(library::Class classDef, int32_t preorderIndex);
+
+    // Replace message sends with direct calls wherever class hierarchy analysis finds only one possible target.
+    bool devirtualizeFrames(ThreadContext* context);
+
     // Finish compilation from Frame down to executable bytecode.
     bool materializeFrames(ThreadContext* context);
 
+    // Rebuild the Frame for |method| from its AST and materialize it again.
+    bool recompileMethod(ThreadContext* context, library::Method method);
+
     // Clean up any temporary data structures
     bool cleanUp();
 
+    // Keeps the finished class library alive, by adding the class array and class variables to the Heap root set.
+    void addToRootSet(ThreadContext* context);
+    void removeFromRootSet(ThreadContext* context);
+    // Adds |classDef| to |m_classMap| and |m_classesByIndex|. Classes schemac didn't process get the next free class
+    // index, with a layout filled in by updateLayouts() once their instance variables are known.
+    void addClass(library::Symbol name, library::Class classDef);
+    // Sets the layouts of the classes schemac didn't process, walking down from each of |m_rootClasses| so each class
+    // inherits the indexing of its superclass.
+    void updateLayouts(ThreadContext* context);
+    void updateLayoutsFrom(ThreadContext* context, library::Class classDef, library::SchemaLayout::Indexed indexed);
+
     std::shared_ptr<ErrorReporter> m_errorReporter;
     // We keep the normalized paths in a set to prevent duplicate additions of the same path.
     std::unordered_set<std::string> m_libraryPaths;
 
     // A map maintained for quick(er) access to Class objects via Hash.
     std::unordered_map<library::Symbol, library::Class> m_classMap;
+    // The same Class objects by class index.
+    std::vector<library::Class> m_classesByIndex;
 
     // The official array of Class objects, maintained as part of the root set.
     library::ClassArray m_classArray;
+    // The classes without a superclass, from which every other class is reachable through the subclasses.
+    std::vector<library::Class> m_rootClasses;
 
     // We keep a reference to the Interpreter:functionCompileContext method, as that is the "fake method" that
     // all Interpreter code compiles as.
@@ -89,6 +147,12 @@ private:
     library::Array m_classVariables;
     int32_t m_numberOfClassVariables;
 
+    // Holds Methods of the class library, which aren't visible to the Heap, but the class library is only ever replaced
+    // by compiling or restoring a new one, which flush the caches.
+    std::unique_ptr<MethodCache> m_methodCache;
+    std::unique_ptr<DispatchTable> m_dispatchTable;
+    std::unique_ptr<ClassHierarchyAnalysis> m_classHierarchy;
+
     // Outer map is class name to pointer to inner map. Inner map is method name to AST.
     using MethodAST = std::unordered_map<library::Symbol, std::unique_ptr<ast::BlockAST>>;
     std::unordered_map<library::Symbol, std::unique_ptr<MethodAST>> m_methodASTs;
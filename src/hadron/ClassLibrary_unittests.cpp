@@ -0,0 +1,134 @@
+#include "hadron/ClassLibrary.hpp"
+
+#include "hadron/ErrorReporter.hpp"
+#include "hadron/LayoutTable.hpp"
+#include "hadron/library/Array.hpp"
+#include "hadron/library/Kernel.hpp"
+#include "hadron/library/KernelFixtures_unittests.hpp"
+#include "hadron/library/Symbol.hpp"
+#include "hadron/Runtime.hpp"
+#include "hadron/ThreadContext.hpp"
+
+#include "doctest/doctest.h"
+
+#include <memory>
+
+namespace hadron {
+
+using fixtures::addClass;
+using fixtures::makeClass;
+
+TEST_CASE("ClassLibrary class numbering") {
+    Runtime runtime(std::make_shared<ErrorReporter>());
+    auto context = runtime.context();
+
+    auto classArray = library::ClassArray::typedArrayAlloc(context, 1);
+    auto object = addClass(context, classArray, "Object", library::Class());
+    auto collection = addClass(context, classArray, "Collection", object);
+    auto array = addClass(context, classArray, "Array", collection);
+    auto set = addClass(context, classArray, "Set", collection);
+    auto string = addClass(context, classArray, "String", object);
+    REQUIRE(context->classLibrary->restoreLibrary(context, classArray, library::Method(), library::Array()));
+
+    CHECK_EQ(object.preorderIndex(), 0);
+    CHECK_EQ(object.maxSubclassIndex(), 4);
+    CHECK_EQ(collection.preorderIndex(), 1);
+    CHECK_EQ(collection.maxSubclassIndex(), 3);
+    CHECK_EQ(array.preorderIndex(), array.maxSubclassIndex());
+
+    CHECK(array.isSubclassOf(object));
+    CHECK(array.isSubclassOf(collection));
+    CHECK(array.isSubclassOf(array));
+    CHECK(set.isSubclassOf(collection));
+    CHECK(string.isSubclassOf(object));
+    CHECK_FALSE(string.isSubclassOf(collection));
+    CHECK_FALSE(collection.isSubclassOf(array));
+    CHECK_FALSE(object.isSubclassOf(string));
+    CHECK_FALSE(array.isSubclassOf(set));
+
+    SUBCASE("new class") {
+        auto list = makeClass(context, "List", collection);
+        classArray = classArray.typedAdd(context, list);
+        REQUIRE(context->classLibrary->updateDispatch(context, list));
+
+        REQUIRE(list.isNumbered());
+        CHECK(list.isSubclassOf(collection));
+        CHECK(list.isSubclassOf(object));
+        CHECK_FALSE(list.isSubclassOf(array));
+        CHECK_FALSE(string.isSubclassOf(collection));
+        CHECK_FALSE(string.isSubclassOf(list));
+        CHECK_EQ(object.maxSubclassIndex(), 5);
+    }
+
+    SUBCASE("new root class") {
+        auto protoObject = makeClass(context, "ProtoObject", library::Class());
+        classArray = classArray.typedAdd(context, protoObject);
+        REQUIRE(context->classLibrary->updateDispatch(context, protoObject));
+
+        REQUIRE(protoObject.isNumbered());
+        CHECK(protoObject.isSubclassOf(protoObject));
+        CHECK_FALSE(protoObject.isSubclassOf(object));
+        CHECK_FALSE(object.isSubclassOf(protoObject));
+        CHECK_FALSE(array.isSubclassOf(protoObject));
+        CHECK(array.isSubclassOf(collection));
+    }
+}
+
+TEST_CASE("ClassLibrary class indices") {
+    Runtime runtime(std::make_shared<ErrorReporter>());
+    auto context = runtime.context();
+    const auto& layoutTable = LayoutTable::instance();
+
+    auto classArray = library::ClassArray::typedArrayAlloc(context, 1);
+    auto object = addClass(context, classArray, "Object", library::Class());
+    auto array = addClass(context, classArray, "Array", object);
+    // Classes schemac didn't process, with instance variables of their own.
+    auto widget = addClass(context, classArray, "TestWidget", object);
+    widget.setInstVarNames(context, library::SymbolArray().add(context, library::Symbol::fromView(context, "a"))
+            .add(context, library::Symbol::fromView(context, "b")));
+    auto stack = addClass(context, classArray, "TestStack", array);
+    stack.setInstVarNames(context, library::SymbolArray().add(context, library::Symbol::fromView(context, "top")));
+    REQUIRE(context->classLibrary->restoreLibrary(context, classArray, library::Method(), library::Array()));
+
+    // Every class has an index mapping back to it.
+    for (int32_t i = 0; i < classArray.size(); ++i) {
+        auto classDef = classArray.typedAt(i);
+        auto classIndex = layoutTable.classIndexOf(classDef.name(context).hash());
+        REQUIRE_NE(classIndex, LayoutTable::kNoClassIndex);
+        CHECK_EQ(context->classLibrary->findClassForIndex(classIndex).slot(), classDef.slot());
+    }
+
+    auto widgetIndex = layoutTable.classIndexOf(widget.name(context).hash());
+    CHECK_GE(widgetIndex, layoutTable.numberOfBuiltInLayouts());
+    REQUIRE(layoutTable.layout(widgetIndex));
+    CHECK_EQ(layoutTable.layout(widgetIndex)->fixedSlots, 2);
+    CHECK_EQ(layoutTable.layout(widgetIndex)->indexed, library::SchemaLayout::kNotIndexed);
+
+    // Subclasses of indexed classes are indexed the same way.
+    auto stackIndex = layoutTable.classIndexOf(stack.name(context).hash());
+    REQUIRE(layoutTable.layout(stackIndex));
+    CHECK_EQ(layoutTable.layout(stackIndex)->fixedSlots, 1);
+    CHECK_EQ(layoutTable.layout(stackIndex)->indexed, library::SchemaLayout::kIndexedSlots);
+
+    SUBCASE("new class") {
+        auto gadget = makeClass(context, "TestGadget", widget);
+        gadget.setInstVarNames(context, widget.instVarNames());
+        classArray = classArray.typedAdd(context, gadget);
+        REQUIRE(context->classLibrary->updateDispatch(context, gadget));
+
+        auto gadgetIndex = layoutTable.classIndexOf(gadget.name(context).hash());
+        REQUIRE_NE(gadgetIndex, LayoutTable::kNoClassIndex);
+        CHECK_EQ(context->classLibrary->findClassForIndex(gadgetIndex).slot(), gadget.slot());
+        REQUIRE(layoutTable.layout(gadgetIndex));
+        CHECK_EQ(layoutTable.layout(gadgetIndex)->fixedSlots, 2);
+    }
+
+    SUBCASE("restoring again") {
+        // Indices are assigned in the order of the class array, so restoring the same classes gives the same indices.
+        REQUIRE(context->classLibrary->restoreLibrary(context, classArray, library::Method(), library::Array()));
+        CHECK_EQ(layoutTable.classIndexOf(widget.name(context).hash()), widgetIndex);
+        CHECK_EQ(layoutTable.classIndexOf(stack.name(context).hash()), stackIndex);
+    }
+}
+
+} // namespace hadron
@@ -0,0 +1,7 @@
+#include "hadron/CompressedSlot.hpp"
+
+namespace hadron {
+
+uintptr_t CompressedSlot::s_base = 0;
+
+} // namespace hadron
@@ -0,0 +1,63 @@
+#ifndef SRC_HADRON_COMPRESSED_SLOT_HPP_
+#define SRC_HADRON_COMPRESSED_SLOT_HPP_
+
+#include "hadron/Slot.hpp"
+
+#include <cassert>
+#include <cstdint>
+
+namespace hadron {
+
+namespace library {
+struct Schema;
+}
+
+// A reference to a heap object, or nil, in 32 bits instead of the 64 of a Slot. Holds the offset of the object from a
+// base address just below the PagePool reservation, with zero for nil, so it can only refer to objects inside the
+// reservation. Only usable once Heap::enableCompressedPointers() has set the base, see there for the details.
+class CompressedSlot {
+public:
+    CompressedSlot() = delete;
+    ~CompressedSlot() = default;
+
+    // |value| must be nil or a pointer to an object inside the reservation.
+    static inline CompressedSlot compress(Slot value) {
+        if (value.isNil()) { return CompressedSlot(0); }
+        assert(isEnabled());
+        assert(value.isPointer());
+        uintptr_t offset = reinterpret_cast<uintptr_t>(value.getPointer()) - s_base;
+        assert(offset > 0 && offset <= kMaximumOffset);
+        return CompressedSlot(static_cast<uint32_t>(offset));
+    }
+
+    inline Slot decompress() const {
+        if (m_offset == 0) { return Slot::makeNil(); }
+        return Slot::makePointer(reinterpret_cast<library::Schema*>(s_base + m_offset));
+    }
+
+    inline bool isNil() const { return m_offset == 0; }
+    inline bool operator==(const CompressedSlot& c) const { return m_offset == c.m_offset; }
+    inline bool operator!=(const CompressedSlot& c) const { return m_offset != c.m_offset; }
+    inline uint32_t offset() const { return m_offset; }
+
+    static bool isEnabled() { return s_base != 0; }
+    static uintptr_t base() { return s_base; }
+    // Called by the Heap when enabling compressed pointers, before any object is allocated.
+    static void setBase(uintptr_t base) { s_base = base; }
+
+    static constexpr uintptr_t kMaximumOffset = 0xffffffff;
+
+private:
+    explicit CompressedSlot(uint32_t offset): m_offset(offset) {}
+
+    uint32_t m_offset;
+
+    // Zero until compressed pointers are enabled. Shared by every Heap, as they share the PagePool reservation.
+    static uintptr_t s_base;
+};
+
+static_assert(sizeof(CompressedSlot) == 4);
+
+} // namespace hadron
+
+#endif // SRC_HADRON_COMPRESSED_SLOT_HPP_
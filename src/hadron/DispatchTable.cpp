@@ -0,0 +1,244 @@
+#include "hadron/DispatchTable.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+
+namespace hadron {
+
+bool DispatchTable::build(ThreadContext* context, library::ClassArray classArray) {
+    clear();
+    for (int32_t i = 0; i < classArray.size(); ++i) {
+        addClass(context, classArray.typedAt(i));
+    }
+    for (int32_t classId = 0; classId < static_cast<int32_t>(m_classes.size()); ++classId) {
+        linkClass(context, classId);
+    }
+
+    // Building rows in hierarchy order means each superclass row is in the table before its subclasses need it. It
+    // also gives the selectors of the root classes, which every class understands, the lowest IDs, so the rows all
+    // start with a dense run of entries.
+    std::vector<int32_t> order;
+    order.reserve(m_classes.size());
+    for (int32_t classId = 0; classId < static_cast<int32_t>(m_classes.size()); ++classId) {
+        if (m_superclassIds[classId] == kNoId) { appendPreorder(classId, order); }
+    }
+    if (order.size() != m_classes.size()) {
+        SPDLOG_ERROR("Dispatch table found a cycle in the superclasses of the class library.");
+        return false;
+    }
+
+    for (auto classId : order) {
+        placeRow(classId, computeRow(context, classId), kNoId);
+    }
+
+    SPDLOG_INFO("Dispatch table built for {} classes and {} selectors, {} entries in {} slots.", m_classes.size(),
+            m_selectorIds.size(), m_numberOfEntries, m_table.size());
+    return true;
+}
+
+bool DispatchTable::updateClass(ThreadContext* context, library::Class classDef) {
+    auto classId = addClass(context, classDef);
+    linkClass(context, classId);
+
+    std::vector<int32_t> affected;
+    appendPreorder(classId, affected);
+    std::vector<int32_t> oldOffsets;
+    oldOffsets.reserve(affected.size());
+    for (auto affectedId : affected) {
+        oldOffsets.emplace_back(m_rowOffsets[affectedId]);
+        removeRow(affectedId);
+    }
+    for (size_t i = 0; i < affected.size(); ++i) {
+        placeRow(affected[i], computeRow(context, affected[i]), oldOffsets[i]);
+    }
+    return true;
+}
+
+void DispatchTable::clear() {
+    m_table.clear();
+    m_usedOffsets.clear();
+    m_firstFree = 0;
+    m_numberOfEntries = 0;
+    m_classes.clear();
+    m_rowOffsets.clear();
+    m_superclassIds.clear();
+    m_subclassIds.clear();
+    m_classIds.clear();
+    m_selectorIds.clear();
+}
+
+library::Method DispatchTable::lookup(ThreadContext* context, library::Class classDef, library::Symbol selector) const {
+    auto id = classId(classDef.name(context));
+    if (id == kNoId) { return library::Method(); }
+    return lookup(id, selectorId(selector));
+}
+
+int32_t DispatchTable::classId(library::Symbol className) const {
+    if (className.isNil()) { return kNoId; }
+    auto iter = m_classIds.find(className);
+    return iter != m_classIds.end() ? iter->second : kNoId;
+}
+
+int32_t DispatchTable::selectorId(library::Symbol selector) const {
+    if (selector.isNil()) { return kNoId; }
+    auto iter = m_selectorIds.find(selector);
+    return iter != m_selectorIds.end() ? iter->second : kNoId;
+}
+
+int32_t DispatchTable::addClass(ThreadContext* context, library::Class classDef) {
+    auto name = classDef.name(context);
+    auto iter = m_classIds.find(name);
+    if (iter != m_classIds.end()) {
+        m_classes[iter->second] = classDef;
+        return iter->second;
+    }
+
+    auto classId = static_cast<int32_t>(m_classes.size());
+    m_classIds.emplace(std::make_pair(name, classId));
+    m_classes.emplace_back(classDef);
+    m_rowOffsets.emplace_back(kNoId);
+    m_superclassIds.emplace_back(kNoId);
+    m_subclassIds.emplace_back();
+    return classId;
+}
+
+void DispatchTable::linkClass(ThreadContext* context, int32_t classId) {
+    auto superclassId = this->classId(m_classes[classId].superclass(context));
+    if (superclassId == classId) { superclassId = kNoId; }
+
+    auto oldSuperclassId = m_superclassIds[classId];
+    if (oldSuperclassId != kNoId && oldSuperclassId != superclassId) {
+        auto& siblings = m_subclassIds[oldSuperclassId];
+        siblings.erase(std::remove(siblings.begin(), siblings.end(), classId), siblings.end());
+    }
+
+    m_superclassIds[classId] = superclassId;
+    if (superclassId != kNoId) {
+        auto& siblings = m_subclassIds[superclassId];
+        if (std::find(siblings.begin(), siblings.end(), classId) == siblings.end()) { siblings.emplace_back(classId); }
+    }
+}
+
+void DispatchTable::appendPreorder(int32_t classId, std::vector<int32_t>& order) const {
+    order.emplace_back(classId);
+    for (auto subclassId : m_subclassIds[classId]) {
+        appendPreorder(subclassId, order);
+    }
+}
+
+DispatchTable::Row DispatchTable::computeRow(ThreadContext* context, int32_t classId) {
+    auto superclassId = m_superclassIds[classId];
+    auto inherited = superclassId != kNoId ? readRow(superclassId) : Row();
+
+    auto methods = m_classes[classId].methods();
+    Row own;
+    own.reserve(methods.size());
+    for (int32_t i = 0; i < methods.size(); ++i) {
+        auto method = methods.typedAt(i);
+        auto selector = method.name(context);
+        auto iter = m_selectorIds.find(selector);
+        if (iter == m_selectorIds.end()) {
+            iter = m_selectorIds.emplace(std::make_pair(selector, static_cast<int32_t>(m_selectorIds.size()))).first;
+        }
+        own.emplace_back(Entry{iter->second, method});
+    }
+    std::stable_sort(own.begin(), own.end(), [](const Entry& a, const Entry& b) {
+        return a.selectorId < b.selectorId;
+    });
+
+    // Merge the two sorted rows. Methods of the class override inherited ones, and where the class defines a selector
+    // more than once, as a class extension can, the last definition wins.
+    Row row;
+    row.reserve(inherited.size() + own.size());
+    size_t i = 0;
+    size_t j = 0;
+    while (i < inherited.size() || j < own.size()) {
+        if (j < own.size() && (i == inherited.size() || own[j].selectorId <= inherited[i].selectorId)) {
+            while (j + 1 < own.size() && own[j + 1].selectorId == own[j].selectorId) { ++j; }
+            if (i < inherited.size() && inherited[i].selectorId == own[j].selectorId) { ++i; }
+            row.emplace_back(own[j]);
+            ++j;
+        } else {
+            row.emplace_back(inherited[i]);
+            ++i;
+        }
+    }
+    return row;
+}
+
+DispatchTable::Row DispatchTable::readRow(int32_t classId) const {
+    Row row;
+    auto offset = m_rowOffsets[classId];
+    if (offset == kNoId) { return row; }
+    for (int32_t selectorId = 0; selectorId < static_cast<int32_t>(m_selectorIds.size()); ++selectorId) {
+        size_t index = static_cast<size_t>(offset) + static_cast<size_t>(selectorId);
+        if (index >= m_table.size()) { break; }
+        if (m_table[index].selectorId == selectorId) { row.emplace_back(m_table[index]); }
+    }
+    return row;
+}
+
+void DispatchTable::placeRow(int32_t classId, const Row& row, int32_t preferredOffset) {
+    int32_t offset = kNoId;
+    if (preferredOffset != kNoId && fits(row, preferredOffset)) {
+        offset = preferredOffset;
+    } else {
+        // First fit, starting from the first offset that puts the first entry of the row in a free slot.
+        int32_t firstSelectorId = row.empty() ? 0 : row.front().selectorId;
+        int32_t start = std::max(0, static_cast<int32_t>(m_firstFree) - firstSelectorId);
+        for (int32_t probe = 0; probe < kMaximumProbes; ++probe) {
+            if (fits(row, start + probe)) {
+                offset = start + probe;
+                break;
+            }
+        }
+        if (offset == kNoId) {
+            // Past the end of the table every slot is free, so only the offset itself can conflict.
+            offset = std::max(start, static_cast<int32_t>(m_table.size()) - firstSelectorId);
+            while (static_cast<size_t>(offset) < m_usedOffsets.size() && m_usedOffsets[offset]) { ++offset; }
+        }
+    }
+
+    if (static_cast<size_t>(offset) >= m_usedOffsets.size()) { m_usedOffsets.resize(offset + 1, false); }
+    m_usedOffsets[offset] = true;
+    m_rowOffsets[classId] = offset;
+
+    if (!row.empty()) {
+        size_t end = static_cast<size_t>(offset) + static_cast<size_t>(row.back().selectorId) + 1;
+        if (end > m_table.size()) { m_table.resize(end, Entry{kNoId, library::Method()}); }
+    }
+    for (const auto& entry : row) {
+        m_table[offset + entry.selectorId] = entry;
+    }
+    m_numberOfEntries += row.size();
+    while (m_firstFree < m_table.size() && m_table[m_firstFree].selectorId != kNoId) { ++m_firstFree; }
+}
+
+bool DispatchTable::fits(const Row& row, int32_t offset) const {
+    if (static_cast<size_t>(offset) < m_usedOffsets.size() && m_usedOffsets[offset]) { return false; }
+    for (const auto& entry : row) {
+        size_t index = static_cast<size_t>(offset) + static_cast<size_t>(entry.selectorId);
+        if (index >= m_table.size()) { return true; }
+        if (m_table[index].selectorId != kNoId) { return false; }
+    }
+    return true;
+}
+
+void DispatchTable::removeRow(int32_t classId) {
+    auto offset = m_rowOffsets[classId];
+    if (offset == kNoId) { return; }
+    for (int32_t selectorId = 0; selectorId < static_cast<int32_t>(m_selectorIds.size()); ++selectorId) {
+        size_t index = static_cast<size_t>(offset) + static_cast<size_t>(selectorId);
+        if (index >= m_table.size()) { break; }
+        if (m_table[index].selectorId == selectorId) {
+            m_table[index] = Entry{kNoId, library::Method()};
+            --m_numberOfEntries;
+            m_firstFree = std::min(m_firstFree, index);
+        }
+    }
+    m_usedOffsets[offset] = false;
+    m_rowOffsets[classId] = kNoId;
+}
+
+} // namespace hadron
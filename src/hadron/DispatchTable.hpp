@@ -0,0 +1,114 @@
+#ifndef SRC_HADRON_DISPATCH_TABLE_HPP_
+#define SRC_HADRON_DISPATCH_TABLE_HPP_
+
+#include "hadron/library/Array.hpp"
+#include "hadron/library/Kernel.hpp"
+#include "hadron/library/Symbol.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace hadron {
+
+struct ThreadContext;
+
+// Maps every (class, selector) pair to the Method, defined in the class or inherited, that a message send invokes.
+// Classes and selectors each get a dense integer ID. Conceptually the table is a matrix with a row for each class and
+// a column for each selector, holding the Method for each selector the class understands. Most of that matrix is
+// empty, so it is compressed with row displacement: each row is stored at its own offset into one shared array, placed
+// so that its entries only land in slots no other row uses. Each entry records its selector ID, so a lookup is one
+// index and one compare. Rows must have distinct offsets, otherwise an entry could be mistaken for one of a different
+// row with the same selector. The ClassLibrary builds the table after compiling the class library, and updates the
+// rows of a class and its subclasses when their methods change.
+class DispatchTable {
+public:
+    DispatchTable() = default;
+    ~DispatchTable() = default;
+
+    // Builds the table from scratch for every class in |classArray|. Classes whose superclass isn't in |classArray|
+    // are roots of the hierarchy.
+    bool build(ThreadContext* context, library::ClassArray classArray);
+
+    // Rebuilds the rows of |classDef| and all of its subclasses, after methods were added to or removed from them.
+    // Adds |classDef| to the table if it is new. Rows that still fit stay at the same offset.
+    bool updateClass(ThreadContext* context, library::Class classDef);
+
+    // Empties the table, including all class and selector IDs.
+    void clear();
+
+    // Returns the Method invoked by sending the selector with |selectorId| to an instance of the class with |classId|,
+    // or nil if the class doesn't understand it. |selectorId| may be kNoId.
+    library::Method lookup(int32_t classId, int32_t selectorId) const {
+        assert(classId >= 0 && static_cast<size_t>(classId) < m_rowOffsets.size());
+        if (selectorId < 0 || m_rowOffsets[classId] < 0) { return library::Method(); }
+        size_t index = static_cast<size_t>(m_rowOffsets[classId]) + static_cast<size_t>(selectorId);
+        if (index >= m_table.size() || m_table[index].selectorId != selectorId) { return library::Method(); }
+        return m_table[index].method;
+    }
+    // Returns the Method for |selector| sent to an instance of |classDef|, or nil if it isn't understood or in the table.
+    library::Method lookup(ThreadContext* context, library::Class classDef, library::Symbol selector) const;
+
+    // Return the dense ID of the class or selector, or kNoId if it isn't in the table.
+    int32_t classId(library::Symbol className) const;
+    int32_t selectorId(library::Symbol selector) const;
+    static constexpr int32_t kNoId = -1;
+
+    size_t numberOfClasses() const { return m_classes.size(); }
+    size_t numberOfSelectors() const { return m_selectorIds.size(); }
+    // Total number of slots in the compressed table, used or not.
+    size_t size() const { return m_table.size(); }
+    // Number of slots holding an entry.
+    size_t numberOfEntries() const { return m_numberOfEntries; }
+
+    // How many offsets placement tries before giving up on filling gaps and appending the row at the end of the table.
+    // Rows share most of their selectors with their superclass, so rarely fit in the gaps left by other rows, and an
+    // unbounded search would make building the table quadratic in its size.
+    static constexpr int32_t kMaximumProbes = 256;
+
+private:
+    struct Entry {
+        int32_t selectorId;
+        library::Method method;
+    };
+    using Row = std::vector<Entry>;
+
+    // Returns the ID for |classDef|, adding it if needed. Doesn't compute its row.
+    int32_t addClass(ThreadContext* context, library::Class classDef);
+    // Looks up the superclass of |classId| and adds it to the subclasses of that superclass.
+    void linkClass(ThreadContext* context, int32_t classId);
+    // Appends |classId| and all of its subclasses to |order|, superclasses before subclasses.
+    void appendPreorder(int32_t classId, std::vector<int32_t>& order) const;
+    // Computes the row of |classId| from the row of its superclass and its own methods, assigning IDs to any new
+    // selectors. The superclass row must already be in the table.
+    Row computeRow(ThreadContext* context, int32_t classId);
+    // Reads the row of |classId| back out of the table.
+    Row readRow(int32_t classId) const;
+    // Finds an offset for |row|, trying |preferredOffset| first, and stores the row there as the row of |classId|.
+    void placeRow(int32_t classId, const Row& row, int32_t preferredOffset);
+    bool fits(const Row& row, int32_t offset) const;
+    // Clears the entries of |classId| from the table and frees its offset.
+    void removeRow(int32_t classId);
+
+    std::vector<Entry> m_table;
+    // True for each offset in use by a row.
+    std::vector<bool> m_usedOffsets;
+    // Every slot below this index is in use, so placement starts its search here.
+    size_t m_firstFree = 0;
+    size_t m_numberOfEntries = 0;
+
+    // Indexed by class ID.
+    std::vector<library::Class> m_classes;
+    std::vector<int32_t> m_rowOffsets;
+    std::vector<int32_t> m_superclassIds;
+    std::vector<std::vector<int32_t>> m_subclassIds;
+
+    std::unordered_map<library::Symbol, int32_t> m_classIds;
+    std::unordered_map<library::Symbol, int32_t> m_selectorIds;
+};
+
+} // namespace hadron
+
+#endif // SRC_HADRON_DISPATCH_TABLE_HPP_
@@ -0,0 +1,173 @@
+#include "hadron/DispatchTable.hpp"
+
+#include "hadron/ClassLibrary.hpp"
+#include "hadron/ErrorReporter.hpp"
+#include "hadron/library/Array.hpp"
+#include "hadron/library/Kernel.hpp"
+#include "hadron/library/KernelFixtures_unittests.hpp"
+#include "hadron/library/Symbol.hpp"
+#include "hadron/Runtime.hpp"
+#include "hadron/ThreadContext.hpp"
+
+#include "doctest/doctest.h"
+
+#include "fmt/format.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace hadron {
+
+using fixtures::addClass;
+using fixtures::addMethod;
+
+namespace {
+// Finds the method the slow way, for checking the table against.
+library::Method walkHierarchy(ThreadContext* context, library::ClassArray classArray, library::Class classDef,
+        library::Symbol selector) {
+    while (!classDef.isNil()) {
+        auto methods = classDef.methods();
+        library::Method found;
+        for (int32_t i = 0; i < methods.size(); ++i) {
+            if (methods.typedAt(i).name(context) == selector) { found = methods.typedAt(i); }
+        }
+        if (!found.isNil()) { return found; }
+        auto superclassName = classDef.superclass(context);
+        classDef = library::Class();
+        for (int32_t i = 0; i < classArray.size(); ++i) {
+            if (classArray.typedAt(i).name(context) == superclassName) { classDef = classArray.typedAt(i); }
+        }
+    }
+    return library::Method();
+}
+} // namespace
+
+TEST_CASE("DispatchTable") {
+    Runtime runtime(std::make_shared<ErrorReporter>());
+    auto context = runtime.context();
+
+    auto classArray = library::ClassArray::typedArrayAlloc(context, 1);
+    auto object = addClass(context, classArray, "Object", library::Class());
+    auto objectA = addMethod(context, object, "a");
+    auto objectB = addMethod(context, object, "b");
+    auto collection = addClass(context, classArray, "Collection", object);
+    auto collectionB = addMethod(context, collection, "b");
+    auto collectionC = addMethod(context, collection, "c");
+    auto array = addClass(context, classArray, "Array", collection);
+    auto arrayA = addMethod(context, array, "a");
+    auto string = addClass(context, classArray, "String", object);
+    auto stringD = addMethod(context, string, "d");
+
+    auto a = library::Symbol::fromView(context, "a");
+    auto b = library::Symbol::fromView(context, "b");
+    auto c = library::Symbol::fromView(context, "c");
+    auto d = library::Symbol::fromView(context, "d");
+
+    SUBCASE("inherited lookup") {
+        DispatchTable table;
+        REQUIRE(table.build(context, classArray));
+        CHECK_EQ(table.numberOfClasses(), 4);
+        CHECK_EQ(table.numberOfSelectors(), 4);
+        CHECK_EQ(table.numberOfEntries(), 2 + 3 + 3 + 3);
+
+        CHECK_EQ(table.lookup(context, array, a).slot(), arrayA.slot());
+        CHECK_EQ(table.lookup(context, array, b).slot(), collectionB.slot());
+        CHECK_EQ(table.lookup(context, array, c).slot(), collectionC.slot());
+        CHECK_EQ(table.lookup(context, collection, a).slot(), objectA.slot());
+        CHECK_EQ(table.lookup(context, object, b).slot(), objectB.slot());
+        CHECK_EQ(table.lookup(context, string, d).slot(), stringD.slot());
+
+        // Rows share the table, but never answer for selectors of other rows.
+        CHECK(table.lookup(context, object, c).isNil());
+        CHECK(table.lookup(context, array, d).isNil());
+        CHECK(table.lookup(context, string, c).isNil());
+        CHECK(table.lookup(context, array, library::Symbol::fromView(context, "missing")).isNil());
+        CHECK_EQ(table.classId(library::Symbol::fromView(context, "Missing")), DispatchTable::kNoId);
+        CHECK_EQ(table.lookup(table.classId(array.name(context)), DispatchTable::kNoId).slot(), Slot::makeNil());
+    }
+
+    SUBCASE("many classes") {
+        // Siblings that each add their own selectors leave gaps for the rows placed after them to fill.
+        for (int32_t i = 0; i < 64; ++i) {
+            auto sibling = addClass(context, classArray, fmt::format("Sibling{}", i), i % 2 ? collection : object);
+            for (int32_t j = 0; j <= i % 5; ++j) {
+                addMethod(context, sibling, fmt::format("sibling{}_{}", i, j));
+            }
+            if (i % 3 == 0) { addMethod(context, sibling, "b"); }
+        }
+        DispatchTable table;
+        REQUIRE(table.build(context, classArray));
+        CHECK_LT(table.size(), table.numberOfClasses() * table.numberOfSelectors());
+
+        std::vector<library::Symbol> selectors{a, b, c, d};
+        for (int32_t i = 0; i < 64; ++i) {
+            for (int32_t j = 0; j < 5; ++j) {
+                selectors.emplace_back(library::Symbol::fromView(context, fmt::format("sibling{}_{}", i, j)));
+            }
+        }
+        for (int32_t i = 0; i < classArray.size(); ++i) {
+            auto classDef = classArray.typedAt(i);
+            for (auto selector : selectors) {
+                CHECK_EQ(table.lookup(context, classDef, selector).slot(),
+                        walkHierarchy(context, classArray, classDef, selector).slot());
+            }
+        }
+    }
+
+    SUBCASE("update") {
+        DispatchTable table;
+        REQUIRE(table.build(context, classArray));
+
+        // New methods are inherited by subclasses.
+        auto collectionE = addMethod(context, collection, "e");
+        auto e = library::Symbol::fromView(context, "e");
+        REQUIRE(table.updateClass(context, collection));
+        CHECK_EQ(table.lookup(context, collection, e).slot(), collectionE.slot());
+        CHECK_EQ(table.lookup(context, array, e).slot(), collectionE.slot());
+        CHECK(table.lookup(context, object, e).isNil());
+        CHECK(table.lookup(context, string, e).isNil());
+        CHECK_EQ(table.lookup(context, array, a).slot(), arrayA.slot());
+        CHECK_EQ(table.numberOfEntries(), 2 + 4 + 4 + 3);
+
+        // New classes join the hierarchy under their superclass.
+        auto set = addClass(context, classArray, "Set", collection);
+        auto setC = addMethod(context, set, "c");
+        REQUIRE(table.updateClass(context, set));
+        CHECK_EQ(table.numberOfClasses(), 5);
+        CHECK_EQ(table.lookup(context, set, c).slot(), setC.slot());
+        CHECK_EQ(table.lookup(context, set, e).slot(), collectionE.slot());
+        CHECK_EQ(table.lookup(context, set, a).slot(), objectA.slot());
+        CHECK_EQ(table.lookup(context, array, c).slot(), collectionC.slot());
+
+        // Updating the root updates every row.
+        auto objectF = addMethod(context, object, "f");
+        REQUIRE(table.updateClass(context, object));
+        for (int32_t i = 0; i < classArray.size(); ++i) {
+            CHECK_EQ(table.lookup(context, classArray.typedAt(i), library::Symbol::fromView(context, "f")).slot(),
+                    objectF.slot());
+        }
+        CHECK_EQ(table.lookup(context, string, d).slot(), stringD.slot());
+    }
+
+    SUBCASE("superclass cycle") {
+        auto first = addClass(context, classArray, "First", library::Class());
+        auto second = addClass(context, classArray, "Second", first);
+        first.setSuperclass(second.name(context));
+        DispatchTable table;
+        CHECK_FALSE(table.build(context, classArray));
+    }
+
+    SUBCASE("class library") {
+        REQUIRE(context->classLibrary->restoreLibrary(context, classArray, objectA, library::Array()));
+        auto table = context->classLibrary->dispatchTable();
+        REQUIRE(table);
+        CHECK_EQ(table->lookup(context, array, b).slot(), collectionB.slot());
+
+        addMethod(context, array, "c");
+        REQUIRE(context->classLibrary->updateDispatch(context, array));
+        CHECK_EQ(table->lookup(context, array, c).slot(), array.methods().typedAt(1).slot());
+    }
+}
+
+} // namespace hadron
@@ -51,6 +51,8 @@ struct Frame {
     // selectors.
     std::vector<hir::BlockLiteralHIR*> innerBlocks;
     library::FunctionDefArray selectors;
+    // Heap objects the compiled code refers to, set by the Materializer and saved in the method->constants field.
+    library::Array constants;
 
     std::unique_ptr<Scope> rootScope;
 
@@ -0,0 +1,23 @@
+#include "hadron/HandleScope.hpp"
+
+namespace hadron {
+
+HandleArena::HandleArena(): m_blocksInUse(0), m_top(nullptr), m_limit(nullptr), m_scopeDepth(0) {}
+
+size_t HandleArena::numberOfHandles() const {
+    if (m_blocksInUse == 0) { return 0; }
+    auto lastBlock = reinterpret_cast<const Slot*>(m_blocks[m_blocksInUse - 1].get());
+    return ((m_blocksInUse - 1) * kBlockSize) + static_cast<size_t>(m_top - lastBlock);
+}
+
+void HandleArena::addBlock() {
+    if (m_blocksInUse == m_blocks.size()) {
+        static_assert(sizeof(Slot) == sizeof(uint64_t));
+        m_blocks.emplace_back(std::make_unique<uint64_t[]>(kBlockSize));
+    }
+    m_top = reinterpret_cast<Slot*>(m_blocks[m_blocksInUse].get());
+    m_limit = m_top + kBlockSize;
+    ++m_blocksInUse;
+}
+
+} // namespace hadron
@@ -0,0 +1,130 @@
+#ifndef SRC_HADRON_HANDLE_SCOPE_HPP_
+#define SRC_HADRON_HANDLE_SCOPE_HPP_
+
+#include "hadron/Heap.hpp"
+#include "hadron/Slot.hpp"
+#include "hadron/ThreadContext.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace hadron {
+
+// Storage for Handles, owned by the Heap. Handles are allocated by bumping a pointer through fixed size blocks of
+// Slots, and freed all at once when the HandleScope that allocated them closes, so rooting an object costs a store and
+// an increment. Every Slot in use is a root for collection, and the collectors update the Slots of any object they
+// move.
+class HandleArena {
+public:
+    HandleArena();
+    ~HandleArena() = default;
+
+    // Returns the location of a new Handle holding |value|. There must be an open HandleScope.
+    Slot* create(Slot value) {
+        assert(m_scopeDepth > 0);
+        if (m_top == m_limit) { addBlock(); }
+        *m_top = value;
+        return m_top++;
+    }
+
+    // Calls |function| with the start and number of Slots of each contiguous run of Handles in use.
+    template<typename Function> void forEachRun(Function function) {
+        for (size_t i = 0; i < m_blocksInUse; ++i) {
+            Slot* start = reinterpret_cast<Slot*>(m_blocks[i].get());
+            Slot* end = (i == m_blocksInUse - 1) ? m_top : start + kBlockSize;
+            if (end > start) {
+                function(start, static_cast<size_t>(end - start));
+            }
+        }
+    }
+
+    // Number of Handles in use across every open HandleScope.
+    size_t numberOfHandles() const;
+    int32_t scopeDepth() const { return m_scopeDepth; }
+
+    // Number of Slots in each block.
+    static constexpr size_t kBlockSize = 1024;
+
+private:
+    friend class HandleScope;
+
+    // Moves |m_top| to the start of the next block, reusing blocks from earlier scopes when possible.
+    void addBlock();
+
+    // Blocks are kept once allocated, so they can be reused by later scopes without allocation. Slots have no default
+    // constructor, so the blocks are raw words.
+    std::vector<std::unique_ptr<uint64_t[]>> m_blocks;
+    // The number of blocks with Handles in use, the last of which contains |m_top|.
+    size_t m_blocksInUse;
+    Slot* m_top;
+    Slot* m_limit;
+    int32_t m_scopeDepth;
+};
+
+// Every Handle created while a HandleScope is open is released when it closes. Scopes must be strictly nested, so they
+// are only for use as local variables on the C++ stack.
+class HandleScope {
+public:
+    HandleScope() = delete;
+    explicit HandleScope(ThreadContext* context):
+        m_arena(context->heap->handles()),
+        m_blocksInUse(m_arena->m_blocksInUse),
+        m_top(m_arena->m_top),
+        m_limit(m_arena->m_limit) {
+        ++m_arena->m_scopeDepth;
+    }
+    HandleScope(const HandleScope&) = delete;
+    HandleScope& operator=(const HandleScope&) = delete;
+    ~HandleScope() {
+        assert(m_arena->m_scopeDepth > 0);
+        --m_arena->m_scopeDepth;
+        m_arena->m_blocksInUse = m_blocksInUse;
+        m_arena->m_top = m_top;
+        m_arena->m_limit = m_limit;
+    }
+
+private:
+    HandleArena* m_arena;
+    size_t m_blocksInUse;
+    Slot* m_top;
+    Slot* m_limit;
+};
+
+// A rooted reference to a heap object, for C++ code that holds on to objects across allocations or collections. |T| is
+// one of the library:: wrappers. The wrappers hold a raw pointer, which goes stale if the object moves, so code should
+// hold the Handle and call get() again after anything that may collect, rather than keeping the wrapper.
+template<typename T>
+class Handle {
+public:
+    Handle(): m_location(nullptr) {}
+    Handle(ThreadContext* context, T object): m_location(context->heap->handles()->create(object.slot())) {}
+    Handle(const Handle& handle) = default;
+    Handle& operator=(const Handle& handle) = default;
+    ~Handle() = default;
+
+    // Returns a wrapper for the object at its current address.
+    T get() const {
+        if (m_location == nullptr || m_location->isNil()) { return T(); }
+        return T::wrapUnsafe(*m_location);
+    }
+    T operator*() const { return get(); }
+
+    // Replaces the referenced object with |object|.
+    void set(T object) {
+        assert(m_location);
+        *m_location = object.slot();
+    }
+
+    bool isNil() const { return m_location == nullptr || m_location->isNil(); }
+    Slot* location() const { return m_location; }
+
+private:
+    Slot* m_location;
+};
+
+} // namespace hadron
+
+#endif // SRC_HADRON_HANDLE_SCOPE_HPP_
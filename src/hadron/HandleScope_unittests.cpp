@@ -0,0 +1,74 @@
+#include "hadron/HandleScope.hpp"
+
+#include "hadron/ErrorReporter.hpp"
+#include "hadron/Heap.hpp"
+#include "hadron/library/Array.hpp"
+#include "hadron/Runtime.hpp"
+#include "hadron/ThreadContext.hpp"
+
+#include "doctest/doctest.h"
+
+#include <memory>
+#include <vector>
+
+namespace hadron {
+
+TEST_CASE("HandleScope") {
+    auto errorReporter = std::make_shared<ErrorReporter>();
+    Runtime runtime(errorReporter);
+    auto context = runtime.context();
+    auto heap = context->heap;
+    auto handles = heap->handles();
+
+    SUBCASE("nesting") {
+        CHECK_EQ(handles->numberOfHandles(), 0);
+        {
+            HandleScope outer(context);
+            Handle<library::Array> first(context, library::Array::newClear(context, 1));
+            {
+                HandleScope inner(context);
+                // Enough Handles to span several blocks.
+                for (size_t i = 0; i < (3 * HandleArena::kBlockSize) + 1; ++i) {
+                    Handle<library::Array> handle(context, library::Array());
+                    CHECK(handle.isNil());
+                }
+                CHECK_EQ(handles->numberOfHandles(), (3 * HandleArena::kBlockSize) + 2);
+                CHECK_EQ(handles->scopeDepth(), 2);
+            }
+            CHECK_EQ(handles->numberOfHandles(), 1);
+            Handle<library::Array> second(context, first.get());
+            CHECK_EQ(handles->numberOfHandles(), 2);
+            CHECK_EQ(second.get().instance(), first.get().instance());
+        }
+        CHECK_EQ(handles->numberOfHandles(), 0);
+        CHECK_EQ(handles->scopeDepth(), 0);
+    }
+
+    SUBCASE("roots") {
+        HandleScope scope(context);
+        auto array = library::Array::newClear(context, 2);
+        array.put(0, Slot::makeInt32(23));
+        Handle<library::Array> handle(context, array);
+
+        // Objects referred to only by Handles survive, and the Handles follow them when they move.
+        heap->collectYoungGeneration();
+        CHECK_NE(handle.get().instance(), array.instance());
+        CHECK_EQ(handle.get().at(0), Slot::makeInt32(23));
+        for (int32_t i = 1; i < Heap::kPromotionAge; ++i) {
+            heap->collectYoungGeneration();
+        }
+        CHECK_EQ(heap->lastCollection().objectsPromoted, 1);
+        heap->collectGarbage();
+        CHECK_EQ(handle.get().at(0), Slot::makeInt32(23));
+
+        // Objects are reclaimed once no Handle refers to them.
+        heap->collectGarbage();
+        size_t objectsBefore = heap->lastCollection().objectsReclaimed;
+        CHECK_EQ(objectsBefore, 0);
+        handle.set(library::Array());
+        heap->collectGarbage();
+        CHECK_EQ(heap->lastCollection().objectsReclaimed, 1);
+    }
+}
+
+} // namespace hadron
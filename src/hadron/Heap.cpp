@@ -1,24 +1,396 @@
 #include "hadron/Heap.hpp"
 
+#include "hadron/ClassLibrary.hpp"
+#include "hadron/CompressedSlot.hpp"
+#include "hadron/HandleScope.hpp"
+#include "hadron/LayoutTable.hpp"
+#include "hadron/library/Schema.hpp"
+#include "hadron/PagePool.hpp"
+#include "hadron/ThreadContext.hpp"
+#include "hadron/WorkStealingDeque.hpp"
+
 #include "spdlog/spdlog.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstring>
+#include <limits>
+#include <sys/resource.h>
+#include <thread>
+
+namespace {
+
+// A collector that moves an object writes a tagged pointer to the copy over the whole Schema header of the original.
+// Object sizes are limited to library::Schema::kMaximumSizeInBytes, which keeps the tag bits of a valid header clear,
+// so headers can't be mistaken for forwarding pointers.
+hadron::library::Schema* forwardedTo(const hadron::library::Schema* object) {
+    uint64_t bits;
+    std::memcpy(&bits, object, sizeof(bits));
+    if ((bits & hadron::Slot::kTagMask) != hadron::Slot::kPointerTag) { return nullptr; }
+    return reinterpret_cast<hadron::library::Schema*>(bits & (~hadron::Slot::kTagMask));
+}
+
+void setForwardingPointer(hadron::library::Schema* object, hadron::library::Schema* copy) {
+    uint64_t bits = hadron::Slot::makePointer(copy).asBits();
+    std::memcpy(object, &bits, sizeof(bits));
+}
+
+} // namespace
 
 namespace hadron {
 
-Heap::Heap(): m_stackPageOffset(0) {}
+// Young, mature and stack Pages are recycled through the PagePool.
+static_assert(Heap::kPageSize == PagePool::kChunkSize);
+// The base sits one Slot below the reservation, so that no object in it compresses to the zero of nil.
+static_assert(Heap::kMaximumCompressedReservation % PagePool::kHugePageSize == 0);
+static_assert(Heap::kMaximumCompressedReservation + kSlotSize <= CompressedSlot::kMaximumOffset);
+
+Heap::Heap(): Heap(defaultSizeClasses()) {}
+
+Heap::Heap(std::vector<size_t> sizeClasses):
+    m_sizeClasses(std::move(sizeClasses)),
+    m_permanentAllocations(0),
+    m_handles(std::make_unique<HandleArena>()),
+    m_stackPageOffset(0),
+    m_stackCacheLowWatermark(kStackCacheLowWatermark),
+    m_stackCacheHighWatermark(kStackCacheHighWatermark),
+    m_youngCollections(0),
+    m_fullCollections(0),
+    m_totalPauseTime(0),
+    m_maximumPauseTime(0),
+    m_compactions(0),
+    m_threadContext(nullptr),
+    m_collectionDeferrals(0),
+    m_helperThreads(0),
+    m_isMarking(false),
+    m_markingNeedsRescan(false),
+    m_markStepBudget(0),
+    m_bytesAllocatedSinceMarkStep(0),
+    m_markSteps(0),
+    m_markStepTime(0),
+    m_bytesAllocatedSinceCollection(0),
+    m_bytesPromotedSinceCollection(0),
+    m_bytesLiveAfterCollection(0),
+    m_compactionThreshold(0.0),
+    m_rememberedSetComplete(true),
+    m_storeBuffer(std::make_unique<Page>(kStoreBufferSize, kStoreBufferSize)) {
+    assert(m_sizeClasses.size() && m_sizeClasses.size() <= std::numeric_limits<uint8_t>::max());
+    assert(m_sizeClasses.back() == kLargeObjectSize);
+    m_sizeClassLookup.resize((kLargeObjectSize / kSizeClassAlignment) + 1);
+    SizeClass sizeClass = 0;
+    for (size_t i = 0; i < m_sizeClassLookup.size(); ++i) {
+        while (m_sizeClasses[sizeClass] < i * kSizeClassAlignment) {
+            ++sizeClass;
+            assert(m_sizeClasses[sizeClass] % kSizeClassAlignment == 0);
+            assert(m_sizeClasses[sizeClass] > m_sizeClasses[sizeClass - 1]);
+        }
+        m_sizeClassLookup[i] = static_cast<uint8_t>(sizeClass);
+    }
+    m_sizeClassUsage.resize(m_sizeClasses.size());
+    m_pauseHistogram.fill(0);
+    m_youngPages.resize(m_sizeClasses.size());
+    m_maturePages.resize(m_sizeClasses.size());
+    m_permanentPages.resize(m_sizeClasses.size());
+    m_executablePages.resize(m_sizeClasses.size());
+    m_allocationRuns.resize(ThreadContext::kNumberOfAllocationBuffers);
+
+    m_pageMap.resize(1 << kPageMapBits);
+    if (!m_storeBuffer->map()) {
+        SPDLOG_CRITICAL("Failed to map write barrier store buffer.");
+        assert(false);
+    }
+    // The write barrier relies on the buffer being aligned to its size to detect when it is full.
+    assert((reinterpret_cast<uintptr_t>(m_storeBuffer->startAddress()) & (kStoreBufferSize - 1)) == 0);
+}
+
+Heap::~Heap() {
+    // Leave any attached ThreadContext with no pointers into memory about to be released.
+    if (m_threadContext) {
+        m_threadContext->storeBuffer = nullptr;
+        m_threadContext->storeBufferTop = nullptr;
+        m_threadContext->storeBufferOverflow = nullptr;
+        for (auto& buffer : m_threadContext->allocationBuffers) {
+            buffer = ThreadContext::AllocationBuffer();
+        }
+        m_threadContext = nullptr;
+    }
+
+    m_rootSet.clear();
+    assert(m_handles->scopeDepth() == 0);
+    m_handles.reset();
+    m_rememberedSet.clear();
+    m_grayStack.clear();
+    m_markingGrayStack.clear();
+
+    // Return every Page, in a fixed order, to the PagePool or the operating system.
+    for (auto sizedPages : { &m_youngPages, &m_maturePages, &m_permanentPages, &m_executablePages }) {
+        for (auto& pages : sizedPages->pages) {
+            pages.clear();
+        }
+    }
+    m_largeObjectPages.clear();
+    m_stackSegments.clear();
+    m_stackPageCache.clear();
+    m_storeBuffer.reset();
+    m_pageMap.clear();
+}
+
+// static
+std::vector<size_t> Heap::defaultSizeClasses() {
+    std::vector<size_t> sizeClasses;
+    for (size_t size = kSizeClassAlignment; size <= kSmallObjectSize; size += kSizeClassAlignment) {
+        sizeClasses.emplace_back(size);
+    }
+    while (sizeClasses.back() < kLargeObjectSize) {
+        size_t size = sizeClasses.back() + (sizeClasses.back() / 8);
+        size = (size + kSizeClassAlignment - 1) & ~(kSizeClassAlignment - 1);
+        sizeClasses.emplace_back(std::min(size, kLargeObjectSize));
+    }
+    return sizeClasses;
+}
+
+std::vector<Heap::SizeClassUsage> Heap::sizeClassUsage() {
+    retireAllocationBuffers();
+    auto usage = m_sizeClassUsage;
+    for (size_t i = 0; i < usage.size(); ++i) {
+        usage[i].objectSize = m_sizeClasses[i];
+    }
+
+    forEachCollectablePage([this, &usage](Page* page) {
+        auto& classUsage = usage[getSizeClass(page->objectSize())];
+        ++classUsage.pages;
+        classUsage.objects += page->allocatedObjects();
+        classUsage.bytesAllocated += page->allocatedObjects() * page->objectSize();
+        for (size_t offset = 0; offset < page->totalSize(); offset += page->objectSize()) {
+            auto address = page->startAddress() + offset;
+            if (page->isAllocated(address)) {
+                classUsage.bytesUsed += reinterpret_cast<library::Schema*>(address)->_sizeInBytes;
+            }
+        }
+    });
+
+    return usage;
+}
+
+HeapStats Heap::stats() {
+    HeapStats stats;
+    stats.sizeClasses = sizeClassUsage();
+
+    forEachCollectablePage([&stats](Page* page) {
+        auto& space = page->space() == Page::kMatureSpace ? stats.matureSpace :
+                (page->space() == Page::kPermanentSpace ? stats.permanentSpace :
+                (page->space() == Page::kExecutableSpace ? stats.executableSpace : stats.youngSpace));
+        ++space.pages;
+        space.bytesMapped += page->totalSize();
+        space.bytesAllocated += page->allocatedObjects() * page->objectSize();
+        for (size_t offset = 0; offset < page->totalSize(); offset += page->objectSize()) {
+            auto address = page->startAddress() + offset;
+            if (page->isAllocated(address)) {
+                auto& classUsage = stats.classes[LayoutTable::instance().className(
+                        reinterpret_cast<library::Schema*>(address)->classIndex())];
+                ++classUsage.objects;
+                classUsage.bytes += page->objectSize();
+            }
+        }
+    });
+    for (auto& page : m_largeObjectPages) {
+        ++stats.largeObjectSpace.pages;
+        stats.largeObjectSpace.bytesMapped += page->totalSize();
+        stats.largeObjectSpace.bytesAllocated += page->objectSize();
+        auto& classUsage = stats.classes[LayoutTable::instance().className(
+                reinterpret_cast<library::Schema*>(page->startAddress())->classIndex())];
+        ++classUsage.objects;
+        classUsage.bytes += page->objectSize();
+    }
+    stats.stackSpace.pages = m_stackSegments.size() + m_stackPageCache.size();
+    stats.stackSpace.bytesMapped = stats.stackSpace.pages * kPageSize;
+    if (m_stackSegments.size()) {
+        stats.stackSpace.bytesAllocated = ((m_stackSegments.size() - 1) * kPageSize) +
+                (m_stackPageOffset ? m_stackPageOffset : kPageSize);
+    }
 
-Heap::~Heap() { /* WRITEME */ }
+    stats.youngCollections = m_youngCollections;
+    stats.fullCollections = m_fullCollections;
+    stats.compactions = m_compactions;
+    stats.pauseHistogram = m_pauseHistogram;
+    stats.totalPauseTime = m_totalPauseTime;
+    stats.maximumPauseTime = m_maximumPauseTime;
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if (__APPLE__)
+        stats.peakResidentBytes = static_cast<size_t>(usage.ru_maxrss);
+#else
+        // Linux reports in kilobytes.
+        stats.peakResidentBytes = static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+    }
+
+    return stats;
+}
+
+void Heap::setThreadContext(ThreadContext* context) {
+    if (m_threadContext) {
+        retireAllocationBuffers();
+        drainStoreBuffer();
+        m_threadContext->storeBuffer = nullptr;
+        m_threadContext->storeBufferTop = nullptr;
+        m_threadContext->storeBufferOverflow = nullptr;
+    }
+
+    m_threadContext = context;
+
+    if (m_threadContext) {
+        auto storeBuffer = reinterpret_cast<library::Schema**>(m_storeBuffer->startAddress());
+        m_threadContext->storeBuffer = storeBuffer;
+        m_threadContext->storeBufferTop = storeBuffer;
+        m_threadContext->storeBufferOverflow = nullptr;
+        for (auto& buffer : m_threadContext->allocationBuffers) {
+            buffer = ThreadContext::AllocationBuffer();
+        }
+    }
+}
 
 void* Heap::allocateNew(size_t sizeInBytes) {
-    return allocateSized(sizeInBytes, m_youngPages, false);
+    if (m_threadContext == nullptr) {
+        return allocateSized(sizeInBytes, m_youngPages, false);
+    }
+    if (sizeInBytes > ThreadContext::kMaximumBufferedSize) {
+        auto address = allocateSized(sizeInBytes, m_youngPages, false);
+        if (address && m_allocationProfiler.countAllocation(sizeInBytes)) {
+            m_allocationProfiler.sample(m_threadContext, reinterpret_cast<library::Schema*>(address));
+        }
+        return address;
+    }
+
+    auto& buffer = m_threadContext->allocationBuffers[ThreadContext::allocationBufferIndex(sizeInBytes)];
+    if (buffer.remaining == 0 && !refillAllocationBuffer(sizeInBytes)) {
+        return nullptr;
+    }
+    assert(buffer.remaining > 0);
+    --buffer.remaining;
+    auto address = buffer.top;
+    buffer.top += buffer.objectSize;
+    return address;
+}
+
+bool Heap::refillAllocationBuffer(size_t sizeInBytes) {
+    assert(m_threadContext);
+    assert(sizeInBytes <= ThreadContext::kMaximumBufferedSize);
+    auto index = ThreadContext::allocationBufferIndex(sizeInBytes);
+    retireAllocationBuffer(index);
+
+    // Every size served by the buffer falls in the same size class as the largest.
+    auto sizeClass = getSizeClass((index + 1) * ThreadContext::kAllocationBufferGranularity);
+    size_t objectSize = getSize(sizeClass);
+    if (shouldCollect()) {
+        collect();
+    }
+
+    // Reserve from the end of a partially full young Page if possible, otherwise from a new Page.
+    size_t maxObjects = std::max(kAllocationBufferSize / objectSize, static_cast<size_t>(1));
+    size_t count = 0;
+    void* start = nullptr;
+    auto& pages = m_youngPages.pages[sizeClass];
+    for (size_t i = m_youngPages.currentPages[sizeClass]; i < pages.size() && start == nullptr; ++i) {
+        start = pages[i]->reserve(maxObjects, count);
+    }
+    if (start == nullptr) {
+        auto page = addPage(sizeClass, m_youngPages, Page::kYoungSpace);
+        if (page == nullptr) {
+            return false;
+        }
+        start = page->reserve(maxObjects, count);
+        assert(start);
+    }
+    m_bytesAllocatedSinceCollection += count * objectSize;
+    m_bytesAllocatedSinceMarkStep += count * objectSize;
+
+    auto& buffer = m_threadContext->allocationBuffers[index];
+    buffer.top = reinterpret_cast<uint8_t*>(start);
+    buffer.remaining = static_cast<intptr_t>(count);
+    buffer.objectSize = objectSize;
+    m_allocationRuns[index].start = buffer.top;
+    m_allocationRuns[index].count = count;
+
+    // The profiler counts whole runs, so it sees the bytes of each allocation buffer without touching the inline
+    // allocation path. A refill is always for an allocation about to be made, so the first object in the run is the
+    // one sampled.
+    if (m_allocationProfiler.countAllocation(count * objectSize)) {
+        m_allocationProfiler.sample(m_threadContext, reinterpret_cast<library::Schema*>(start));
+    }
+    return true;
+}
+
+void* Heap::allocate(size_t sizeInBytes, uint32_t classIndex, AllocationSpace space) {
+    if (space == kAllocateDefault) {
+        if (m_permanentAllocations > 0) {
+            space = kAllocatePermanent;
+        } else if (isPretenured(classIndex)) {
+            space = kAllocateMature;
+        }
+    }
+
+    switch (space) {
+    case kAllocateMature:
+        return allocateMature(sizeInBytes);
+    case kAllocatePermanent:
+        return allocatePermanent(sizeInBytes);
+    case kAllocateDefault:
+        break;
+    }
+
+    // Objects from the allocation buffers are counted for pretenuring when their buffer is retired.
+    if (m_threadContext == nullptr || sizeInBytes > ThreadContext::kMaximumBufferedSize) {
+        allocationSite(classIndex).bytesAllocated += getMaximumSize(sizeInBytes);
+    }
+    return allocateNew(sizeInBytes);
+}
+
+void* Heap::allocateMature(size_t sizeInBytes) {
+    return allocateOld(sizeInBytes, m_maturePages, Page::kMatureSpace);
+}
+
+void* Heap::allocatePermanent(size_t sizeInBytes) {
+    return allocateOld(sizeInBytes, m_permanentPages, Page::kPermanentSpace);
+}
+
+void* Heap::allocateOld(size_t sizeInBytes, SizedPages& sizedPages, Page::Space space) {
+    if (sizeInBytes > kLargeObjectSize) {
+        return allocateLarge(sizeInBytes, false);
+    }
+
+    auto sizeClass = getSizeClass(sizeInBytes);
+    ++m_sizeClassUsage[sizeClass].totalAllocations;
+    m_sizeClassUsage[sizeClass].totalBytesRequested += sizeInBytes;
+
+    // Counts towards the next full collection, the same as a promotion.
+    m_bytesPromotedSinceCollection += getSize(sizeClass);
+    if (shouldCollectGarbage()) {
+        collect();
+    }
+
+    auto address = allocateFromPages(sizeClass, sizedPages, space);
+    if (address == nullptr) {
+        return nullptr;
+    }
+
+    // As with large objects, the new object may be initialized with young pointers and no write barrier. While
+    // collection is deferred the remembered set is rebuilt afterwards anyway.
+    if (!isCollectionDeferred()) {
+        m_rememberedSet.emplace(reinterpret_cast<library::Schema*>(address));
+    }
+    if (m_isMarking) {
+        regray(findPageContaining(address), reinterpret_cast<library::Schema*>(address));
+    }
+    return address;
 }
 
 void* Heap::allocateJIT(size_t sizeInBytes, size_t& allocatedSize) {
     auto address = allocateSized(sizeInBytes, m_executablePages, true);
     if (address) {
-        auto sizeClass = getSizeClass(sizeInBytes);
-        allocatedSize = getSize(sizeClass);
+        allocatedSize = getMaximumSize(sizeInBytes);
     } else {
         allocatedSize = 0;
     }
@@ -27,17 +399,29 @@ void* Heap::allocateJIT(size_t sizeInBytes, size_t& allocatedSize) {
 
 void* Heap::allocateStackSegment() {
     if (m_stackPageOffset == 0) {
-        m_stackSegments.emplace_back(std::make_unique<Page>(kLargeObjectSize, kPageSize, false));
-        if (!m_stackSegments.back()->map()) {
-            SPDLOG_CRITICAL("Failed to map new stack segment.");
-            assert(false);
-            return nullptr;
+        std::unique_ptr<Page> page;
+        if (m_stackPageCache.size()) {
+            // The most recently cached Page is the most likely to still be resident.
+            page = std::move(m_stackPageCache.back());
+            m_stackPageCache.pop_back();
+            ++m_stackCounters.pagesReused;
+            m_stackCounters.pagesCached = m_stackPageCache.size();
+        } else {
+            page = std::make_unique<Page>(kLargeObjectSize, kPageSize, false);
+            page->setSpace(Page::kStackSpace);
+            if (!page->map(kPageSize)) {
+                SPDLOG_CRITICAL("Failed to map new stack segment.");
+                assert(false);
+                return nullptr;
+            }
+            ++m_stackCounters.pagesMapped;
         }
+        registerPage(page.get());
+        m_stackSegments.emplace_back(std::move(page));
     }
 
     auto address = m_stackSegments.back()->startAddress();
     assert(address);
-    m_pageEnds[reinterpret_cast<uintptr_t>(address) + kPageSize] = m_stackSegments.back().get();
     address += m_stackPageOffset;
 
     m_stackPageOffset = (m_stackPageOffset + kLargeObjectSize) % kPageSize;
@@ -45,18 +429,52 @@ void* Heap::allocateStackSegment() {
 }
 
 void Heap::freeTopStackSegment() {
-    // TODO: consider some page recycling or other hysterisis here to prevent stack boundary oscillation from spamming
-    // map/unmap syscalls.
+    assert(m_stackSegments.size());
     if (m_stackPageOffset == 0) {
-        assert(m_stackSegments.size());
-        m_stackSegments.pop_back();
+        // The last Page is full, so the top segment is the last one in it.
         m_stackPageOffset = kPageSize - kLargeObjectSize;
-    } else {
-        assert(m_stackPageOffset >= kLargeObjectSize);
-        m_stackPageOffset -= kLargeObjectSize;
+        return;
+    }
+
+    assert(m_stackPageOffset >= kLargeObjectSize);
+    m_stackPageOffset -= kLargeObjectSize;
+    if (m_stackPageOffset == 0) {
+        // The last Page is now empty, and the Page before it (if any) is full.
+        unregisterPage(m_stackSegments.back().get());
+        cacheStackPage(std::move(m_stackSegments.back()));
+        m_stackSegments.pop_back();
     }
 }
 
+void Heap::setStackCacheWatermarks(size_t lowWatermark, size_t highWatermark) {
+    assert(lowWatermark <= highWatermark);
+    m_stackCacheLowWatermark = lowWatermark;
+    m_stackCacheHighWatermark = highWatermark;
+    if (m_stackPageCache.size() > m_stackCacheHighWatermark) {
+        size_t excess = m_stackPageCache.size() - m_stackCacheHighWatermark;
+        m_stackPageCache.erase(m_stackPageCache.begin(), m_stackPageCache.begin() + excess);
+        m_stackCounters.pagesUnmapped += excess;
+    }
+    m_stackCounters.pagesCached = m_stackPageCache.size();
+}
+
+void Heap::cacheStackPage(std::unique_ptr<Page> page) {
+    m_stackPageCache.emplace_back(std::move(page));
+
+    // Pages past the high watermark are unmapped, oldest first.
+    if (m_stackPageCache.size() > m_stackCacheHighWatermark) {
+        m_stackPageCache.erase(m_stackPageCache.begin());
+        ++m_stackCounters.pagesUnmapped;
+    }
+    // The Page that falls past the low watermark keeps its mapping but not its memory.
+    if (m_stackPageCache.size() > m_stackCacheLowWatermark) {
+        if (m_stackPageCache[m_stackPageCache.size() - m_stackCacheLowWatermark - 1]->discard()) {
+            ++m_stackCounters.pagesDiscarded;
+        }
+    }
+    m_stackCounters.pagesCached = m_stackPageCache.size();
+}
+
 void Heap::addToRootSet(Slot object) {
     m_rootSet.emplace(object.getPointer());
 }
@@ -65,6 +483,168 @@ void Heap::removeFromRootSet(Slot object) {
     m_rootSet.erase(object.getPointer());
 }
 
+void Heap::allowCollection() {
+    assert(m_collectionDeferrals > 0);
+    --m_collectionDeferrals;
+    if (m_collectionDeferrals == 0) {
+        m_rememberedSetComplete = false;
+        m_markingNeedsRescan = m_markingNeedsRescan || m_isMarking;
+    }
+}
+
+void Heap::collectGarbage() {
+    if (m_isMarking) {
+        finishIncrementalMarking();
+        return;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    retireAllocationBuffers();
+    drainStoreBuffer();
+    mark();
+    m_markSteps = 0;
+    m_markStepTime = std::chrono::microseconds(0);
+    finishCollection(startTime);
+}
+
+void Heap::startIncrementalMarking() {
+    assert(!m_isMarking);
+    assert(m_grayStack.empty());
+    retireAllocationBuffers();
+    drainStoreBuffer();
+    m_isMarking = true;
+    m_markingNeedsRescan = false;
+    m_bytesAllocatedSinceMarkStep = 0;
+    m_markSteps = 0;
+    m_markStepTime = std::chrono::microseconds(0);
+
+    // Shade the roots without scanning, the mark steps do the scanning.
+    auto startTime = std::chrono::steady_clock::now();
+    shadeRoots();
+    m_markStepTime += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - startTime);
+    SPDLOG_INFO("Heap started incremental marking with {} gray objects.", m_grayStack.size());
+}
+
+bool Heap::markStep(std::chrono::microseconds budget) {
+    assert(m_isMarking);
+    auto startTime = std::chrono::steady_clock::now();
+    auto deadline = startTime + budget;
+    ++m_markSteps;
+
+    // Objects stored into since the last step are shaded gray again if black.
+    drainStoreBuffer();
+
+    // Reading the clock costs more than blackening most objects, so only check the deadline periodically.
+    constexpr size_t kObjectsPerDeadlineCheck = 64;
+    size_t objectsBlackened = 0;
+    while (m_grayStack.size()) {
+        auto object = m_grayStack.back();
+        m_grayStack.pop_back();
+        blacken(object);
+        if ((++objectsBlackened % kObjectsPerDeadlineCheck) == 0 && std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+    }
+
+    m_markStepTime += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - startTime);
+    return m_grayStack.empty();
+}
+
+void Heap::finishIncrementalMarking() {
+    assert(m_isMarking);
+    auto startTime = std::chrono::steady_clock::now();
+    retireAllocationBuffers();
+    drainStoreBuffer();
+    // From here the world is stopped, so shade() can mark young objects too.
+    m_isMarking = false;
+
+    if (m_markingNeedsRescan) {
+        // Stores escaped the barrier, so any black object may now refer to white objects.
+        forEachCollectablePage([this](Page* page) {
+            for (size_t offset = 0; offset < page->totalSize(); offset += page->objectSize()) {
+                auto object = reinterpret_cast<library::Schema*>(page->startAddress() + offset);
+                if (page->isAllocated(object) && page->color(object) == Page::Color::kBlack) {
+                    regray(page, object);
+                }
+            }
+        });
+        for (auto& page : m_largeObjectPages) {
+            auto object = reinterpret_cast<library::Schema*>(page->startAddress());
+            if (page->color(object) == Page::Color::kBlack) {
+                regray(page.get(), object);
+            }
+        }
+        m_markingNeedsRescan = false;
+    } else {
+        // The mark steps skipped pointers to young objects, and the remembered set holds every mature object that may
+        // have them.
+        for (auto object : m_rememberedSet) {
+            Page* page = findPageContaining(object);
+            assert(page);
+            if (page->color(object) == Page::Color::kBlack) {
+                regray(page, object);
+            }
+        }
+    }
+
+    mark();
+    finishCollection(startTime);
+}
+
+void Heap::writeBarrier(library::Schema* object) {
+    if (m_collectionDeferrals > 0) { return; }
+    recordWrite(object);
+}
+
+void Heap::finishCollection(std::chrono::steady_clock::time_point startTime) {
+    // Remove remembered objects that are about to be freed.
+    for (auto iter = m_rememberedSet.begin(); iter != m_rememberedSet.end();) {
+        Page* page = findPageContaining(*iter);
+        assert(page);
+        if (page->color(*iter) == Page::Color::kWhite) {
+            iter = m_rememberedSet.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+
+    sweep();
+    if (shouldCompact()) {
+        compactMatureSpace();
+    }
+    m_lastCollection.pauseTime = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - startTime);
+    m_lastCollection.markSteps = m_markSteps;
+    m_lastCollection.markStepTime = m_markStepTime;
+    m_bytesAllocatedSinceCollection = 0;
+    m_bytesPromotedSinceCollection = 0;
+    m_bytesLiveAfterCollection = m_lastCollection.bytesLive;
+    m_allocationSites.clear();
+    m_pretenuredClasses.clear();
+    recordPause();
+
+    SPDLOG_INFO("Heap collection {} reclaimed {} bytes in {} objects, {} bytes live, paused {} us after {} mark steps "
+            "taking {} us.", m_lastCollection.collectionNumber, m_lastCollection.bytesReclaimed,
+            m_lastCollection.objectsReclaimed, m_lastCollection.bytesLive, m_lastCollection.pauseTime.count(),
+            m_markSteps, m_markStepTime.count());
+}
+
+void Heap::recordPause() {
+    if (m_lastCollection.isYoungCollection) {
+        ++m_youngCollections;
+    } else {
+        ++m_fullCollections;
+    }
+
+    auto pause = static_cast<uint64_t>(m_lastCollection.pauseTime.count());
+    size_t bucket = pause ? static_cast<size_t>(64 - __builtin_clzll(pause)) : 0;
+    ++m_pauseHistogram[std::min(bucket, kPauseHistogramBuckets - 1)];
+    m_totalPauseTime += m_lastCollection.pauseTime;
+    m_maximumPauseTime = std::max(m_maximumPauseTime, m_lastCollection.pauseTime);
+}
+
 size_t Heap::getAllocationSize(void* address) {
     Page* page = findPageContaining(address);
     if (!page) { assert(false); return 0; }
@@ -72,91 +652,986 @@ size_t Heap::getAllocationSize(void* address) {
 }
 
 size_t Heap::getMaximumSize(size_t sizeInBytes) {
+    if (sizeInBytes > kLargeObjectSize) {
+        return (sizeInBytes + kLargeObjectGranularity - 1) & ~(kLargeObjectGranularity - 1);
+    }
     return getSize(getSizeClass(sizeInBytes));
 }
 
-Heap::SizeClass Heap::getSizeClass(size_t sizeInBytes) {
-    if (sizeInBytes <= kSmallObjectSize) {
-        return SizeClass::kSmall;
-    } else if (sizeInBytes <= kMediumObjectSize) {
-        return SizeClass::kMedium;
-    } else if (sizeInBytes <= kLargeObjectSize) {
-        return SizeClass::kLarge;
+void* Heap::allocateSized(size_t sizeInBytes, SizedPages& sizedPages, bool isExecutable) {
+    if (sizeInBytes > kLargeObjectSize) {
+        return allocateLarge(sizeInBytes, isExecutable);
     }
-    return SizeClass::kOversize;
-}
 
-size_t Heap::getSize(SizeClass sizeClass) {
-    switch(sizeClass) {
-    case kSmall:
-        return kSmallObjectSize;
-    case kMedium:
-        return kMediumObjectSize;
-    case kLarge:
-        return kLargeObjectSize;
-    default:
-        return 0;
+    auto sizeClass = getSizeClass(sizeInBytes);
+    ++m_sizeClassUsage[sizeClass].totalAllocations;
+    m_sizeClassUsage[sizeClass].totalBytesRequested += sizeInBytes;
+
+    if (isExecutable) {
+        return allocateFromPages(sizeClass, sizedPages, Page::kExecutableSpace);
     }
+
+    m_bytesAllocatedSinceCollection += getSize(sizeClass);
+    m_bytesAllocatedSinceMarkStep += getSize(sizeClass);
+    if (shouldCollect()) {
+        collect();
+    }
+
+    return allocateFromPages(sizeClass, sizedPages, Page::kYoungSpace);
 }
 
-void* Heap::allocateSized(size_t sizeInBytes, SizedPages& sizedPages, bool isExecutable) {
-    auto sizeClass = getSizeClass(sizeInBytes);
-    if (sizeClass == kOversize) {
-        assert(false);
-        sizedPages[kOversize].emplace_back(std::make_unique<Page>(sizeInBytes, sizeInBytes, isExecutable));
-        if (!sizedPages[kOversize].back()->map()) {
-            SPDLOG_ERROR("Mapping failed for oversize object of {} bytes", sizeInBytes);
-            return nullptr;
-        }
-        // We leave oversize pages out of page address map, and search the oversized pages separately.
-        return sizedPages[kOversize].back()->allocate();
+void* Heap::allocateLarge(size_t sizeInBytes, bool isExecutable) {
+    // Large objects are allocated directly in to an old space, so count towards the next full collection.
+    size_t largeSize = getMaximumSize(sizeInBytes);
+    m_bytesPromotedSinceCollection += largeSize;
+    m_bytesAllocatedSinceMarkStep += largeSize;
+    if (shouldCollect() || shouldCollectGarbage()) {
+        collect();
     }
 
-    // Find existing capacity in already mapped pages.
-    for (auto& page : sizedPages[sizeClass]) {
-        if (page->capacity()) {
-            return page->allocate();
+    auto page = std::make_unique<Page>(largeSize, largeSize, isExecutable);
+    page->setSpace(Page::kLargeObjectSpace);
+    if (!page->map(kPageSize)) {
+        SPDLOG_ERROR("Mapping failed for large object of {} bytes", sizeInBytes);
+        return nullptr;
+    }
+    registerPage(page.get());
+    auto address = page->allocate();
+    assert(address);
+
+    // The C++ side initializes new objects without a write barrier, so remember new large objects until the next young
+    // collection checks them for young pointers.
+    m_rememberedSet.emplace(reinterpret_cast<library::Schema*>(address));
+    // Objects already marked black may come to refer to the new object, so it must be scanned before marking finishes.
+    if (m_isMarking) {
+        regray(page.get(), reinterpret_cast<library::Schema*>(address));
+    }
+
+    m_largeObjectPages.emplace_back(std::move(page));
+    return address;
+}
+
+void* Heap::allocateFromPages(SizeClass sizeClass, SizedPages& sizedPages, Page::Space space) {
+    // Find existing capacity in already mapped pages, starting with the current Page.
+    auto& pages = sizedPages.pages[sizeClass];
+    auto& currentPage = sizedPages.currentPages[sizeClass];
+    for (; currentPage < pages.size(); ++currentPage) {
+        if (pages[currentPage]->capacity()) {
+            return pages[currentPage]->allocate();
         }
     }
 
-    // HERE is where we would initiate a collection
-    mark();
-    sweep();
+    Page* page = addPage(sizeClass, sizedPages, space);
+    if (page == nullptr) {
+        return nullptr;
+    }
+    return page->allocate();
+}
 
-    sizedPages[sizeClass].emplace_back(std::make_unique<Page>(getSize(sizeClass), kPageSize, isExecutable));
-    if (!sizedPages[sizeClass].back()->map()) {
+Page* Heap::addPage(SizeClass sizeClass, SizedPages& sizedPages, Page::Space space) {
+    auto& pages = sizedPages.pages[sizeClass];
+    pages.emplace_back(std::make_unique<Page>(getSize(sizeClass), kPageSize, space == Page::kExecutableSpace));
+    Page* page = pages.back().get();
+    page->setSpace(space);
+    if (!page->map(kPageSize)) {
         assert(false);
         return nullptr;
     }
+    registerPage(page);
+    return page;
+}
 
-    auto address = sizedPages[sizeClass].back()->startAddress();
-    assert(address);
-    m_pageEnds[reinterpret_cast<uintptr_t>(address) + kPageSize] = sizedPages[sizeClass].back().get();
+void Heap::retireAllocationBuffers() {
+    if (m_threadContext == nullptr) { return; }
+    // Every sampled object has an initialized header by now, and may be moved or freed after this.
+    m_allocationProfiler.resolveSamples();
+    for (size_t i = 0; i < m_allocationRuns.size(); ++i) {
+        retireAllocationBuffer(i);
+    }
+}
+
+void Heap::retireAllocationBuffer(size_t index) {
+    auto& run = m_allocationRuns[index];
+    auto& buffer = m_threadContext->allocationBuffers[index];
+    if (run.start != nullptr) {
+        assert(buffer.remaining >= 0 && static_cast<size_t>(buffer.remaining) <= run.count);
+        Page* page = findPageContaining(run.start);
+        assert(page);
+
+        // Account for the objects allocated from the buffer.
+        size_t used = run.count - static_cast<size_t>(buffer.remaining);
+        auto& usage = m_sizeClassUsage[getSizeClass(page->objectSize())];
+        usage.totalAllocations += used;
+        for (size_t i = 0; i < used; ++i) {
+            auto object = reinterpret_cast<library::Schema*>(run.start + (i * page->objectSize()));
+            usage.totalBytesRequested += object->_sizeInBytes;
+            allocationSite(object->classIndex()).bytesAllocated += page->objectSize();
+        }
+
+        if (buffer.remaining > 0) {
+            page->release(buffer.top, static_cast<size_t>(buffer.remaining));
+            size_t unusedBytes = static_cast<size_t>(buffer.remaining) * page->objectSize();
+            m_bytesAllocatedSinceCollection -= std::min(unusedBytes, m_bytesAllocatedSinceCollection);
+        }
+    }
+
+    run.start = nullptr;
+    run.count = 0;
+    buffer.top = nullptr;
+    buffer.remaining = 0;
+    buffer.objectSize = 0;
+}
+
+bool Heap::shouldCollect() const {
+    if (m_threadContext == nullptr || m_collectionDeferrals > 0) { return false; }
+    return m_bytesAllocatedSinceCollection >= kYoungGenerationSize ||
+            (m_isMarking && m_bytesAllocatedSinceMarkStep >= kMarkStepInterval);
+}
+
+bool Heap::shouldCollectGarbage() const {
+    if (m_threadContext == nullptr || m_collectionDeferrals > 0) { return false; }
+    // Let the old spaces grow in proportion to the live set, to amortize the cost of each full collection over the
+    // promotions and large allocations that triggered it.
+    return m_bytesPromotedSinceCollection >= std::max(kMinimumCollectionThreshold, m_bytesLiveAfterCollection);
+}
+
+void Heap::collect() {
+    if (m_bytesAllocatedSinceCollection >= kYoungGenerationSize) {
+        collectYoungGeneration();
+    }
+
+    if (m_isMarking) {
+        if (m_bytesAllocatedSinceMarkStep >= kMarkStepInterval) {
+            m_bytesAllocatedSinceMarkStep = 0;
+            if (markStep(m_markStepBudget)) {
+                finishIncrementalMarking();
+            }
+        }
+    } else if (shouldCollectGarbage()) {
+        if (m_markStepBudget.count() > 0) {
+            startIncrementalMarking();
+        } else {
+            collectGarbage();
+        }
+    }
+}
 
-    return sizedPages[sizeClass].back()->allocate();
+template<typename Function>
+void Heap::forEachCollectablePage(Function function) {
+    for (auto sizedPages : { &m_youngPages, &m_maturePages, &m_permanentPages, &m_executablePages }) {
+        for (auto& pages : sizedPages->pages) {
+            for (auto& page : pages) {
+                function(page.get());
+            }
+        }
+    }
 }
 
 void Heap::mark() {
-    // TODO once we add the Stack should be enough to build a decent root set
+    // The gray stack may already hold objects from incremental marking.
+    shadeRoots();
+
+    if (m_helperThreads > 0) {
+        markParallel();
+        return;
+    }
+
+    while (m_grayStack.size()) {
+        auto object = m_grayStack.back();
+        m_grayStack.pop_back();
+        blacken(object);
+    }
+}
+
+template<typename Function>
+void Heap::runOnHelperThreads(Function function) {
+    std::vector<std::thread> helpers;
+    helpers.reserve(m_helperThreads);
+    for (size_t i = 1; i <= m_helperThreads; ++i) {
+        helpers.emplace_back(function, i);
+    }
+    function(0);
+    for (auto& helper : helpers) {
+        helper.join();
+    }
+}
+
+void Heap::markParallel() {
+    assert(!m_isMarking);
+    size_t numberOfThreads = m_helperThreads + 1;
+    std::vector<std::unique_ptr<WorkStealingDeque<library::Schema*>>> deques;
+    for (size_t i = 0; i < numberOfThreads; ++i) {
+        deques.emplace_back(std::make_unique<WorkStealingDeque<library::Schema*>>());
+    }
+    // Deal out the gray objects before the helper threads start.
+    for (size_t i = 0; i < m_grayStack.size(); ++i) {
+        deques[i % numberOfThreads]->push(m_grayStack[i]);
+    }
+    m_grayStack.clear();
+
+    std::atomic<size_t> idleThreads(0);
+    runOnHelperThreads([this, &deques, &idleThreads, numberOfThreads](size_t index) {
+        auto& deque = *deques[index];
+        auto push = [&deque](library::Schema* object) { deque.push(object); };
+        library::Schema* object = nullptr;
+        while (true) {
+            while (deque.pop(object)) {
+                blacken(object, push);
+            }
+
+            // Out of local work, so try to steal from the other threads, starting with the next one.
+            bool stole = false;
+            for (size_t i = 1; i < numberOfThreads && !stole; ++i) {
+                stole = deques[(index + i) % numberOfThreads]->steal(object);
+            }
+            if (stole) {
+                blacken(object, push);
+                continue;
+            }
+
+            // Only a busy thread can shade more objects, so marking is done once every thread is idle.
+            idleThreads.fetch_add(1, std::memory_order_acq_rel);
+            bool foundWork = false;
+            while (!foundWork) {
+                if (idleThreads.load(std::memory_order_acquire) == numberOfThreads) { return; }
+                for (size_t i = 0; i < numberOfThreads && !foundWork; ++i) {
+                    foundWork = !deques[i]->empty();
+                }
+                if (!foundWork) {
+                    std::this_thread::yield();
+                }
+            }
+            idleThreads.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    });
+}
+
+void Heap::shadeRoots() {
+    for (auto root : m_rootSet) {
+        shade(root);
+    }
+
+    // Every Slot in the in-use portion of the stack segments is a potential root. Stack segments are allocated
+    // kLargeObjectSize at a time from the end of the last Page, so all but the last Page are completely in use.
+    for (size_t i = 0; i < m_stackSegments.size(); ++i) {
+        size_t usedSize = kPageSize;
+        if (i == m_stackSegments.size() - 1 && m_stackPageOffset > 0) {
+            usedSize = m_stackPageOffset;
+        }
+        scanSlots(reinterpret_cast<const Slot*>(m_stackSegments[i]->startAddress()), usedSize / kSlotSize);
+    }
+    m_handles->forEachRun([this](Slot* slots, size_t numberOfSlots) { scanSlots(slots, numberOfSlots); });
+
+    if (m_threadContext) {
+        shade(reinterpret_cast<library::Schema*>(m_threadContext->thisProcess));
+        shade(reinterpret_cast<library::Schema*>(m_threadContext->thisThread));
+        if (m_threadContext->classLibrary) {
+            shade(reinterpret_cast<library::Schema*>(m_threadContext->classLibrary->classArray().instance()));
+            shade(reinterpret_cast<library::Schema*>(m_threadContext->classLibrary->classVariables().instance()));
+        }
+    }
 }
 
 void Heap::sweep() {
-    // TODO once we have mark() going
+    ++m_lastCollection.collectionNumber;
+    m_lastCollection.objectsReclaimed = 0;
+    m_lastCollection.bytesReclaimed = 0;
+    m_lastCollection.bytesLive = 0;
+    m_lastCollection.isYoungCollection = false;
+    m_lastCollection.objectsPromoted = 0;
+    m_lastCollection.bytesPromoted = 0;
+    m_lastCollection.objectsCompacted = 0;
+    m_lastCollection.pagesReleased = 0;
+
+    std::vector<Page*> pages;
+    forEachCollectablePage([&pages](Page* page) { pages.emplace_back(page); });
+
+    // Sweeping only touches the Page being swept, so the Pages are shared out between the threads one at a time.
+    struct SweepTotals {
+        size_t objectsReclaimed = 0;
+        size_t bytesReclaimed = 0;
+        size_t bytesLive = 0;
+    };
+    std::vector<SweepTotals> threadTotals(m_helperThreads + 1);
+    std::atomic<size_t> nextPage(0);
+    runOnHelperThreads([&pages, &threadTotals, &nextPage](size_t index) {
+        SweepTotals totals;
+        for (size_t i = nextPage.fetch_add(1, std::memory_order_relaxed); i < pages.size();
+                i = nextPage.fetch_add(1, std::memory_order_relaxed)) {
+            Page* page = pages[i];
+            size_t freedObjects = page->sweep();
+            totals.objectsReclaimed += freedObjects;
+            totals.bytesReclaimed += freedObjects * page->objectSize();
+            totals.bytesLive += page->allocatedObjects() * page->objectSize();
+        }
+        threadTotals[index] = totals;
+    });
+    for (const auto& totals : threadTotals) {
+        m_lastCollection.objectsReclaimed += totals.objectsReclaimed;
+        m_lastCollection.bytesReclaimed += totals.bytesReclaimed;
+        m_lastCollection.bytesLive += totals.bytesLive;
+    }
+
+    m_youngPages.resetCurrentPages();
+    m_maturePages.resetCurrentPages();
+    m_permanentPages.resetCurrentPages();
+    m_executablePages.resetCurrentPages();
+
+    // Return the memory of dead large objects to the operating system right away.
+    for (auto& page : m_largeObjectPages) {
+        size_t freedObjects = page->sweep();
+        if (freedObjects) {
+            m_lastCollection.objectsReclaimed += freedObjects;
+            m_lastCollection.bytesReclaimed += page->objectSize();
+            unregisterPage(page.get());
+            page.reset();
+        } else {
+            m_lastCollection.bytesLive += page->objectSize();
+        }
+    }
+    m_largeObjectPages.erase(std::remove(m_largeObjectPages.begin(), m_largeObjectPages.end(), nullptr),
+            m_largeObjectPages.end());
+}
+
+void Heap::collectYoungGeneration() {
+    auto startTime = std::chrono::steady_clock::now();
+    ++m_lastCollection.collectionNumber;
+    m_lastCollection.isYoungCollection = true;
+    m_lastCollection.objectsPromoted = 0;
+    m_lastCollection.bytesPromoted = 0;
+
+    retireAllocationBuffers();
+    drainStoreBuffer();
+
+    // The current young Pages become the from-space, and Pages allocated in to m_youngPages during collection form the
+    // to-space.
+    SizedPages fromSpace;
+    std::swap(fromSpace, m_youngPages);
+    m_youngPages.resize(m_sizeClasses.size());
+    size_t fromSpaceObjects = 0;
+    size_t fromSpaceBytes = 0;
+    for (auto& pages : fromSpace.pages) {
+        for (auto& page : pages) {
+            fromSpaceObjects += page->allocatedObjects();
+            fromSpaceBytes += page->allocatedObjects() * page->objectSize();
+        }
+    }
+
+    // The C++ side refers to root set objects and the class library arrays directly, so they must not move. Coloring
+    // them black in their Pages keeps evacuate() from copying them, and they are retained in place. As roots they are
+    // always scanned, even if mature.
+    auto pin = [this](library::Schema* object) {
+        if (object == nullptr) { return; }
+        Page* page = findPageContaining(object);
+        if (page == nullptr || !page->isAllocated(object)) { return; }
+        if (page->space() == Page::kYoungSpace) {
+            if (page->color(object) == Page::Color::kBlack) { return; }
+            page->mark(object, Page::Color::kBlack);
+        }
+        m_grayStack.emplace_back(object);
+    };
+    // Set aside the gray objects of any incremental marking in progress.
+    assert(m_markingGrayStack.empty());
+    std::swap(m_markingGrayStack, m_grayStack);
+    for (auto root : m_rootSet) {
+        pin(root);
+    }
+    if (m_threadContext && m_threadContext->classLibrary) {
+        pin(reinterpret_cast<library::Schema*>(m_threadContext->classLibrary->classArray().instance()));
+        pin(reinterpret_cast<library::Schema*>(m_threadContext->classLibrary->classVariables().instance()));
+    }
+
+    for (size_t i = 0; i < m_stackSegments.size(); ++i) {
+        size_t usedSize = kPageSize;
+        if (i == m_stackSegments.size() - 1 && m_stackPageOffset > 0) {
+            usedSize = m_stackPageOffset;
+        }
+        scavengeSlots(reinterpret_cast<Slot*>(m_stackSegments[i]->startAddress()), usedSize / kSlotSize);
+    }
+    m_handles->forEachRun([this](Slot* slots, size_t numberOfSlots) { scavengeSlots(slots, numberOfSlots); });
+
+    if (m_threadContext) {
+        m_threadContext->thisProcess = reinterpret_cast<schema::ProcessSchema*>(
+                evacuate(reinterpret_cast<library::Schema*>(m_threadContext->thisProcess)));
+        m_threadContext->thisThread = reinterpret_cast<schema::ThreadSchema*>(
+                evacuate(reinterpret_cast<library::Schema*>(m_threadContext->thisThread)));
+    }
+
+    // Scanning the remembered set rebuilds it, as objects that no longer refer to young objects are dropped.
+    if (m_rememberedSetComplete) {
+        for (auto object : m_rememberedSet) {
+            m_grayStack.emplace_back(object);
+        }
+    } else {
+        for (auto sizedPages : { &m_maturePages, &m_permanentPages }) {
+            for (auto& pages : sizedPages->pages) {
+                for (auto& page : pages) {
+                    for (size_t offset = 0; offset < page->totalSize(); offset += page->objectSize()) {
+                        auto address = page->startAddress() + offset;
+                        if (page->isAllocated(address)) {
+                            m_grayStack.emplace_back(reinterpret_cast<library::Schema*>(address));
+                        }
+                    }
+                }
+            }
+        }
+        for (auto& page : m_largeObjectPages) {
+            m_grayStack.emplace_back(reinterpret_cast<library::Schema*>(page->startAddress()));
+        }
+        m_rememberedSetComplete = true;
+    }
+    m_rememberedSet.clear();
+
+    // Cheney scan, the gray stack is processed as a queue with evacuate() appending copied objects to the end, until
+    // the scan index catches up with the end of the queue.
+    for (size_t i = 0; i < m_grayStack.size(); ++i) {
+        scavengeObject(m_grayStack[i]);
+    }
+    m_grayStack.clear();
+    std::swap(m_markingGrayStack, m_grayStack);
+
+    // Every object left in the from-space has either been copied or is garbage, except for the pinned objects. Keep
+    // the Pages with pinned objects, and release the rest.
+    size_t retainedObjects = 0;
+    size_t retainedBytes = 0;
+    for (size_t sizeClass = 0; sizeClass < fromSpace.pages.size(); ++sizeClass) {
+        for (auto& page : fromSpace.pages[sizeClass]) {
+            page->sweep();
+            if (page->allocatedObjects()) {
+                retainedObjects += page->allocatedObjects();
+                retainedBytes += page->allocatedObjects() * page->objectSize();
+                m_youngPages.pages[sizeClass].emplace_back(std::move(page));
+            } else {
+                unregisterPage(page.get());
+            }
+        }
+    }
+    m_youngPages.resetCurrentPages();
+
+    size_t copiedObjects = 0;
+    size_t copiedBytes = 0;
+    for (auto& pages : m_youngPages.pages) {
+        for (auto& page : pages) {
+            if (page->space() == Page::kSurvivorSpace) {
+                page->setSpace(Page::kYoungSpace);
+                copiedObjects += page->allocatedObjects();
+                copiedBytes += page->allocatedObjects() * page->objectSize();
+            }
+        }
+    }
+
+    // Promoted objects are counted as live, copied to the mature space.
+    m_lastCollection.bytesLive = retainedBytes + copiedBytes + m_lastCollection.bytesPromoted;
+    m_lastCollection.bytesReclaimed = fromSpaceBytes - m_lastCollection.bytesLive;
+    m_lastCollection.objectsReclaimed = fromSpaceObjects - retainedObjects - copiedObjects -
+            m_lastCollection.objectsPromoted;
+    m_bytesAllocatedSinceCollection = 0;
+    m_bytesPromotedSinceCollection += m_lastCollection.bytesPromoted;
+    updatePretenuring();
+    m_lastCollection.pauseTime = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - startTime);
+    recordPause();
+
+    SPDLOG_INFO("Young collection {} reclaimed {} bytes in {} objects, {} bytes live, {} bytes promoted, paused {} us.",
+            m_lastCollection.collectionNumber, m_lastCollection.bytesReclaimed, m_lastCollection.objectsReclaimed,
+            m_lastCollection.bytesLive, m_lastCollection.bytesPromoted, m_lastCollection.pauseTime.count());
+}
+
+void Heap::compactMatureSpace() {
+    assert(!m_isMarking);
+    auto startTime = std::chrono::steady_clock::now();
+    retireAllocationBuffers();
+    drainStoreBuffer();
+
+    // Outside of marking every object is white, so as in the young collector objects that must stay in place are pinned
+    // by coloring them black.
+    std::vector<library::Schema*> pinned;
+    auto pin = [this, &pinned](library::Schema* object) {
+        if (object == nullptr) { return; }
+        Page* page = findPageContaining(object);
+        if (page == nullptr || page->space() != Page::kMatureSpace || !page->isAllocated(object)) { return; }
+        if (page->color(object) == Page::Color::kBlack) { return; }
+        page->mark(object, Page::Color::kBlack);
+        pinned.emplace_back(object);
+    };
+    for (auto root : m_rootSet) {
+        pin(root);
+    }
+    if (m_threadContext && m_threadContext->classLibrary) {
+        // The ClassLibrary maps class names to the Class objects directly.
+        auto classArray = m_threadContext->classLibrary->classArray();
+        pin(reinterpret_cast<library::Schema*>(classArray.instance()));
+        for (int32_t i = 0; i < classArray.size(); ++i) {
+            pin(reinterpret_cast<library::Schema*>(classArray.typedAt(i).instance()));
+        }
+        pin(reinterpret_cast<library::Schema*>(m_threadContext->classLibrary->classVariables().instance()));
+        pin(reinterpret_cast<library::Schema*>(m_threadContext->classLibrary->interpreterContext().instance()));
+    }
+
+    // All Pages in a size class are interchangeable, so rather than sliding objects towards one end of the space the
+    // live objects of each size class are packed into as few Pages as can hold them. Filling the fullest Pages first
+    // from the emptiest moves the fewest objects.
+    std::vector<library::Schema*> movedObjects;
+    for (size_t sizeClass = 0; sizeClass < m_maturePages.pages.size(); ++sizeClass) {
+        auto& pages = m_maturePages.pages[sizeClass];
+        size_t liveObjects = 0;
+        for (const auto& page : pages) {
+            liveObjects += page->allocatedObjects();
+        }
+        size_t objectsPerPage = kPageSize / getSize(sizeClass);
+        size_t neededPages = (liveObjects + objectsPerPage - 1) / objectsPerPage;
+        if (neededPages >= pages.size()) { continue; }
+
+        std::stable_sort(pages.begin(), pages.end(), [](const auto& a, const auto& b) {
+            return a->allocatedObjects() > b->allocatedObjects();
+        });
+        size_t destination = 0;
+        for (size_t source = neededPages; source < pages.size() && destination < neededPages; ++source) {
+            Page* page = pages[source].get();
+            for (size_t offset = 0; offset < page->totalSize() && destination < neededPages;
+                    offset += page->objectSize()) {
+                auto object = reinterpret_cast<library::Schema*>(page->startAddress() + offset);
+                if (!page->isAllocated(object) || page->color(object) == Page::Color::kBlack) { continue; }
+
+                // Pinned objects left in the source Pages can leave the destination Pages short of room.
+                void* copy = nullptr;
+                while (destination < neededPages && (copy = pages[destination]->allocate()) == nullptr) {
+                    ++destination;
+                }
+                if (copy == nullptr) { break; }
+
+                std::memcpy(copy, object, object->_sizeInBytes);
+                pages[destination]->setCollectionCount(copy, page->collectionCount(object));
+                // As in evacuate(), the old object keeps a pointer to its copy in place of its header.
+                setForwardingPointer(object, reinterpret_cast<library::Schema*>(copy));
+                movedObjects.emplace_back(object);
+            }
+        }
+    }
+
+    if (movedObjects.size()) {
+        // Rewrite every pointer to a moved object, skipping the moved objects themselves.
+        auto updateObject = [this](library::Schema* object) {
+            if (forwardedTo(object)) { return; }
+            forEachSlotRun(object, [this](Slot* slots, size_t numberOfSlots) { updateSlots(slots, numberOfSlots); });
+            forEachCompressedRun(object, [this](CompressedSlot* slots, size_t numberOfSlots) {
+                updateCompressedSlots(slots, numberOfSlots);
+            });
+        };
+        forEachCollectablePage([&updateObject](Page* page) {
+            for (size_t offset = 0; offset < page->totalSize(); offset += page->objectSize()) {
+                auto address = page->startAddress() + offset;
+                if (page->isAllocated(address)) {
+                    updateObject(reinterpret_cast<library::Schema*>(address));
+                }
+            }
+        });
+        for (auto& page : m_largeObjectPages) {
+            updateObject(reinterpret_cast<library::Schema*>(page->startAddress()));
+        }
+        for (size_t i = 0; i < m_stackSegments.size(); ++i) {
+            size_t usedSize = kPageSize;
+            if (i == m_stackSegments.size() - 1 && m_stackPageOffset > 0) {
+                usedSize = m_stackPageOffset;
+            }
+            updateSlots(reinterpret_cast<Slot*>(m_stackSegments[i]->startAddress()), usedSize / kSlotSize);
+        }
+        m_handles->forEachRun([this](Slot* slots, size_t numberOfSlots) { updateSlots(slots, numberOfSlots); });
+        if (m_threadContext) {
+            m_threadContext->thisProcess = reinterpret_cast<schema::ProcessSchema*>(
+                    forwardingAddress(reinterpret_cast<library::Schema*>(m_threadContext->thisProcess)));
+            m_threadContext->thisThread = reinterpret_cast<schema::ThreadSchema*>(
+                    forwardingAddress(reinterpret_cast<library::Schema*>(m_threadContext->thisThread)));
+        }
+        std::unordered_set<library::Schema*> rememberedSet;
+        for (auto object : m_rememberedSet) {
+            rememberedSet.emplace(forwardingAddress(object));
+        }
+        std::swap(rememberedSet, m_rememberedSet);
+
+        for (auto object : movedObjects) {
+            findPageContaining(object)->release(object, 1);
+        }
+    }
+
+    for (auto object : pinned) {
+        findPageContaining(object)->mark(object, Page::Color::kWhite);
+    }
+
+    // Release every empty mature Page, including any the sweep left empty.
+    size_t pagesReleased = 0;
+    for (auto& pages : m_maturePages.pages) {
+        for (auto& page : pages) {
+            if (page->allocatedObjects() == 0) {
+                unregisterPage(page.get());
+                page.reset();
+                ++pagesReleased;
+            }
+        }
+        pages.erase(std::remove(pages.begin(), pages.end(), nullptr), pages.end());
+    }
+    m_maturePages.resetCurrentPages();
+
+    ++m_compactions;
+    m_lastCollection.objectsCompacted = movedObjects.size();
+    m_lastCollection.pagesReleased = pagesReleased;
+    SPDLOG_INFO("Heap compaction moved {} mature objects and released {} Pages in {} us.", movedObjects.size(),
+            pagesReleased, std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - startTime).count());
+}
+
+bool Heap::shouldCompact() {
+    if (m_compactionThreshold <= 0.0 || m_collectionDeferrals > 0) { return false; }
+    HeapStats::SpaceUsage usage;
+    for (const auto& pages : m_maturePages.pages) {
+        for (const auto& page : pages) {
+            ++usage.pages;
+            usage.bytesMapped += page->totalSize();
+            usage.bytesAllocated += page->allocatedObjects() * page->objectSize();
+        }
+    }
+    return usage.fragmentation() >= m_compactionThreshold;
+}
+
+library::Schema* Heap::forwardingAddress(library::Schema* object) {
+    if (object == nullptr) { return nullptr; }
+    // Stack segments can contain stale Slots, so only follow forwarding pointers of valid mature objects.
+    Page* page = findPageContaining(object);
+    if (page == nullptr || page->space() != Page::kMatureSpace || !page->isAllocated(object)) { return object; }
+    auto copy = forwardedTo(object);
+    return copy ? copy : object;
+}
+
+void Heap::updateSlots(Slot* slots, size_t numberOfSlots) {
+    for (size_t i = 0; i < numberOfSlots; ++i) {
+        if (!slots[i].isPointer()) { continue; }
+
+        auto object = slots[i].getPointer();
+        auto newObject = forwardingAddress(object);
+        if (newObject != object) {
+            slots[i] = Slot::makePointer(newObject);
+        }
+    }
+}
+
+void Heap::updateCompressedSlots(CompressedSlot* slots, size_t numberOfSlots) {
+    for (size_t i = 0; i < numberOfSlots; ++i) {
+        if (slots[i].isNil()) { continue; }
+
+        auto object = slots[i].decompress().getPointer();
+        auto newObject = forwardingAddress(object);
+        if (newObject != object) {
+            slots[i] = CompressedSlot::compress(Slot::makePointer(newObject));
+        }
+    }
+}
+
+void Heap::updatePretenuring() {
+    for (uint32_t classIndex = 0; classIndex < m_allocationSites.size(); ++classIndex) {
+        const auto& site = m_allocationSites[classIndex];
+        if (site.bytesAllocated >= kPretenureSampleBytes &&
+                site.bytesPromoted * 100 >= site.bytesAllocated * kPretenureSurvivalPercent &&
+                m_pretenuredClasses.emplace(classIndex).second) {
+            SPDLOG_INFO("Heap pretenuring class {:016x} after {} of {} bytes allocated were promoted.",
+                    LayoutTable::instance().className(classIndex), site.bytesPromoted, site.bytesAllocated);
+        }
+    }
+}
+
+void Heap::drainStoreBuffer() {
+    if (m_threadContext == nullptr || m_threadContext->storeBuffer == nullptr) { return; }
+
+    if (m_threadContext->storeBufferOverflow) {
+        // Entries were lost when the buffer wrapped, so the remembered set must be rebuilt from the mature space.
+        m_rememberedSetComplete = false;
+        m_markingNeedsRescan = m_markingNeedsRescan || m_isMarking;
+        m_threadContext->storeBufferOverflow = nullptr;
+    }
+
+    for (auto entry = m_threadContext->storeBuffer; entry < m_threadContext->storeBufferTop; ++entry) {
+        // Compiled code may record tagged pointers, so strip any tag.
+        recordWrite(reinterpret_cast<library::Schema*>(reinterpret_cast<uintptr_t>(*entry) & (~Slot::kTagMask)));
+    }
+
+    m_threadContext->storeBufferTop = m_threadContext->storeBuffer;
+}
+
+void Heap::recordWrite(library::Schema* object) {
+    Page* page = findPageContaining(object);
+    if (page == nullptr || !page->isAllocated(object)) { return; }
+
+    if (page->space() == Page::kMatureSpace || page->space() == Page::kPermanentSpace ||
+            page->space() == Page::kLargeObjectSpace) {
+        m_rememberedSet.emplace(object);
+    }
+    // Incremental update barrier, a black object that was stored into must be scanned again.
+    if (m_isMarking && page->space() != Page::kYoungSpace && page->color(object) == Page::Color::kBlack) {
+        regray(page, object);
+    }
+}
+
+void Heap::regray(Page* page, library::Schema* object) {
+    page->mark(object, Page::Color::kGray);
+    m_grayStack.emplace_back(object);
+}
+
+library::Schema* Heap::evacuate(library::Schema* object) {
+    if (object == nullptr) { return nullptr; }
+
+    // Stack segments can contain stale Slots, so only move valid young objects.
+    Page* page = findPageContaining(object);
+    if (page == nullptr || page->space() != Page::kYoungSpace || !page->isAllocated(object)) { return object; }
+
+    // Copied objects have a pointer to their copy written over their header.
+    auto forwarded = forwardedTo(object);
+    if (forwarded) { return forwarded; }
+
+    // Pinned objects stay in place.
+    if (page->color(object) == Page::Color::kBlack) { return object; }
+
+    // Copy to a Page with the same object size, to preserve the capacity of arrays.
+    auto sizeClass = getSizeClass(page->objectSize());
+    auto collectionCount = page->collectionCount(object);
+    library::Schema* copy = nullptr;
+    if (collectionCount >= kPromotionAge) {
+        copy = reinterpret_cast<library::Schema*>(allocateFromPages(sizeClass, m_maturePages, Page::kMatureSpace));
+        m_lastCollection.bytesPromoted += page->objectSize();
+        ++m_lastCollection.objectsPromoted;
+        allocationSite(object->classIndex()).bytesPromoted += page->objectSize();
+        // Objects already marked black may refer to the promoted object, so it must start gray.
+        if (m_isMarking && copy) {
+            findPageContaining(copy)->mark(copy, Page::Color::kGray);
+            m_markingGrayStack.emplace_back(copy);
+        }
+    } else {
+        copy = reinterpret_cast<library::Schema*>(allocateFromPages(sizeClass, m_youngPages, Page::kSurvivorSpace));
+    }
+    if (copy == nullptr) {
+        SPDLOG_CRITICAL("Failed to allocate memory to evacuate young object.");
+        assert(false);
+        return object;
+    }
+
+    std::memcpy(copy, object, object->_sizeInBytes);
+    findPageContaining(copy)->setCollectionCount(copy, static_cast<uint8_t>(std::min(collectionCount + 1, 0x3f)));
+    setForwardingPointer(object, copy);
+    m_grayStack.emplace_back(copy);
+    return copy;
+}
+
+bool Heap::scavengeSlots(Slot* slots, size_t numberOfSlots) {
+    bool hasYoungPointers = false;
+    for (size_t i = 0; i < numberOfSlots; ++i) {
+        if (!slots[i].isPointer()) { continue; }
+
+        auto object = slots[i].getPointer();
+        auto newObject = evacuate(object);
+        if (newObject != object) {
+            slots[i] = Slot::makePointer(newObject);
+        }
+        hasYoungPointers = hasYoungPointers || isYoung(newObject);
+    }
+    return hasYoungPointers;
+}
+
+bool Heap::scavengeCompressedSlots(CompressedSlot* slots, size_t numberOfSlots) {
+    bool hasYoungPointers = false;
+    for (size_t i = 0; i < numberOfSlots; ++i) {
+        if (slots[i].isNil()) { continue; }
+
+        auto object = slots[i].decompress().getPointer();
+        auto newObject = evacuate(object);
+        if (newObject != object) {
+            slots[i] = CompressedSlot::compress(Slot::makePointer(newObject));
+        }
+        hasYoungPointers = hasYoungPointers || isYoung(newObject);
+    }
+    return hasYoungPointers;
+}
+
+void Heap::scavengeObject(library::Schema* object) {
+    bool hasYoungPointers = false;
+    forEachSlotRun(object, [this, &hasYoungPointers](Slot* slots, size_t numberOfSlots) {
+        hasYoungPointers = scavengeSlots(slots, numberOfSlots) || hasYoungPointers;
+    });
+    forEachCompressedRun(object, [this, &hasYoungPointers](CompressedSlot* slots, size_t numberOfSlots) {
+        hasYoungPointers = scavengeCompressedSlots(slots, numberOfSlots) || hasYoungPointers;
+    });
+    if (hasYoungPointers && !isYoung(object)) {
+        m_rememberedSet.emplace(object);
+    }
+}
+
+bool Heap::isYoung(library::Schema* object) {
+    Page* page = findPageContaining(object);
+    return page && (page->space() == Page::kYoungSpace || page->space() == Page::kSurvivorSpace);
+}
+
+bool Heap::hasSlots(const library::Schema* object) {
+    // Raw arrays contain no Slots, so are not scanned. Objects with no layout are scanned conservatively.
+    auto layout = LayoutTable::instance().layout(object->classIndex());
+    return layout == nullptr || layout->fixedSlots > 0 || layout->indexed == library::SchemaLayout::kNotIndexed ||
+            layout->indexed == library::SchemaLayout::kIndexedSlots;
+}
+
+// static
+bool Heap::enableCompressedPointers() {
+    if (CompressedSlot::isEnabled()) { return true; }
+
+    auto& pool = PagePool::instance();
+    auto counters = pool.counters();
+    if (counters.reservedBytes == 0 || counters.reservedBytes > kMaximumCompressedReservation) {
+        SPDLOG_ERROR("Compressed pointers need a PagePool reservation of at most {} bytes, have {} bytes.",
+                kMaximumCompressedReservation, counters.reservedBytes);
+        return false;
+    }
+    // Chunks mapped before confinement are outside the reservation, and may still hold objects.
+    if (counters.chunksMapped > 0) {
+        SPDLOG_ERROR("Compressed pointers must be enabled before the PagePool maps any chunks.");
+        return false;
+    }
+    if (!pool.confineToReservation()) { return false; }
+
+    CompressedSlot::setBase(reinterpret_cast<uintptr_t>(pool.reservationStart()) - kSlotSize);
+    SPDLOG_INFO("Heap compressed pointers enabled over a {} byte reservation.", counters.reservedBytes);
+    return true;
+}
+
+template<typename Function>
+void Heap::forEachSlotRun(library::Schema* object, Function function) {
+    assert(object->_sizeInBytes >= sizeof(library::Schema));
+    auto slots = reinterpret_cast<Slot*>(reinterpret_cast<int8_t*>(object) + sizeof(library::Schema));
+    size_t numberOfSlots = (object->_sizeInBytes - sizeof(library::Schema)) / kSlotSize;
+
+    auto layout = LayoutTable::instance().layout(object->classIndex());
+    if (layout == nullptr) {
+        function(slots, numberOfSlots);
+        return;
+    }
+
+    size_t fixedSlots = std::min(static_cast<size_t>(layout->fixedSlots), numberOfSlots);
+    // Any instance variables past the pointer map are followed by the indexed Slots, if the object has them, and both
+    // are scanned as one run after the mapped instance variables.
+    size_t mappedSlots = std::min(fixedSlots, static_cast<size_t>(64));
+    size_t tailEnd = (layout->indexed == library::SchemaLayout::kIndexedBytes ||
+            layout->indexed == library::SchemaLayout::kIndexedCompressed) ? fixedSlots : numberOfSlots;
+    size_t tailStart = mappedSlots;
+    uint64_t map = mappedSlots == 64 ? layout->pointerMap : layout->pointerMap & ((1ull << mappedSlots) - 1);
+    while (map) {
+        size_t start = static_cast<size_t>(__builtin_ctzll(map));
+        uint64_t rest = ~(map >> start);
+        size_t end = start + (rest ? static_cast<size_t>(__builtin_ctzll(rest)) : 64);
+        // A run reaching the end of the map joins the tail.
+        if (end == mappedSlots) {
+            tailStart = start;
+            break;
+        }
+        function(slots + start, end - start);
+        map &= ~((1ull << end) - 1);
+    }
+    if (tailEnd > tailStart) {
+        function(slots + tailStart, tailEnd - tailStart);
+    }
+}
+
+template<typename Function>
+void Heap::forEachCompressedRun(library::Schema* object, Function function) {
+    auto layout = LayoutTable::instance().layout(object->classIndex());
+    if (layout == nullptr || layout->indexed != library::SchemaLayout::kIndexedCompressed) { return; }
+
+    size_t start = sizeof(library::Schema) + (layout->fixedSlots * kSlotSize);
+    if (object->_sizeInBytes <= start) { return; }
+    function(reinterpret_cast<CompressedSlot*>(reinterpret_cast<int8_t*>(object) + start),
+            (object->_sizeInBytes - start) / sizeof(CompressedSlot));
+}
+
+void Heap::scanSlots(const Slot* slots, size_t numberOfSlots) {
+    for (size_t i = 0; i < numberOfSlots; ++i) {
+        if (slots[i].isPointer()) {
+            shade(slots[i].getPointer());
+        }
+    }
+}
+
+void Heap::shade(library::Schema* object) {
+    if (tryShade(object)) {
+        m_grayStack.emplace_back(object);
+    }
+}
+
+bool Heap::tryShade(library::Schema* object) {
+    if (object == nullptr) { return false; }
+
+    // Stack segments can contain stale Slots, so validate that the pointer points at a live object before coloring.
+    Page* page = findPageContaining(object);
+    if (page == nullptr || !page->isAllocated(object)) { return false; }
+    // Young objects can move before incremental marking finishes, so the mark steps leave them for the final pause.
+    if (m_isMarking && page->space() == Page::kYoungSpace) { return false; }
+
+    return page->shade(object);
+}
+
+template<typename Function>
+void Heap::blacken(library::Schema* object, Function push) {
+    Page* page = findPageContaining(object);
+    assert(page);
+    page->mark(object, Page::Color::kBlack);
+
+    forEachSlotRun(object, [this, &push](Slot* slots, size_t numberOfSlots) {
+        for (size_t i = 0; i < numberOfSlots; ++i) {
+            if (slots[i].isPointer() && tryShade(slots[i].getPointer())) {
+                push(slots[i].getPointer());
+            }
+        }
+    });
+    forEachCompressedRun(object, [this, &push](CompressedSlot* slots, size_t numberOfSlots) {
+        for (size_t i = 0; i < numberOfSlots; ++i) {
+            if (slots[i].isNil()) { continue; }
+            auto gray = slots[i].decompress().getPointer();
+            if (tryShade(gray)) {
+                push(gray);
+            }
+        }
+    });
+}
+
+void Heap::blacken(library::Schema* object) {
+    blacken(object, [this](library::Schema* gray) { m_grayStack.emplace_back(gray); });
 }
 
 Page* Heap::findPageContaining(void* address) {
-    auto addressValue = reinterpret_cast<uintptr_t>(address);
-    auto page = m_pageEnds.upper_bound(addressValue);
-    if (page == m_pageEnds.end()) {
-        return nullptr;
+    auto chunk = reinterpret_cast<uintptr_t>(address) >> kPageShift;
+    if (chunk >= (1ull << (2 * kPageMapBits))) { return nullptr; }
+    const auto& leaf = m_pageMap[chunk >> kPageMapBits];
+    if (!leaf) { return nullptr; }
+    return (*leaf)[chunk & kPageMapMask];
+}
+
+void Heap::registerPage(Page* page) {
+    assert(page->startAddress());
+    assert((reinterpret_cast<uintptr_t>(page->startAddress()) & (kPageSize - 1)) == 0);
+    auto firstChunk = reinterpret_cast<uintptr_t>(page->startAddress()) >> kPageShift;
+    auto lastChunk = (reinterpret_cast<uintptr_t>(page->startAddress()) + page->totalSize() - 1) >> kPageShift;
+    assert(lastChunk < (1ull << (2 * kPageMapBits)));
+    for (auto chunk = firstChunk; chunk <= lastChunk; ++chunk) {
+        auto& leaf = m_pageMap[chunk >> kPageMapBits];
+        if (!leaf) {
+            leaf = std::make_unique<PageMapLeaf>();
+            leaf->fill(nullptr);
+        }
+        assert((*leaf)[chunk & kPageMapMask] == nullptr);
+        (*leaf)[chunk & kPageMapMask] = page;
     }
-    auto startAddress = reinterpret_cast<uintptr_t>(page->second->startAddress());
-    assert(addressValue >= startAddress);
-    if (addressValue - startAddress < page->second->totalSize()) {
-        return page->second;
+}
+
+void Heap::unregisterPage(Page* page) {
+    auto firstChunk = reinterpret_cast<uintptr_t>(page->startAddress()) >> kPageShift;
+    auto lastChunk = (reinterpret_cast<uintptr_t>(page->startAddress()) + page->totalSize() - 1) >> kPageShift;
+    for (auto chunk = firstChunk; chunk <= lastChunk; ++chunk) {
+        auto& leaf = m_pageMap[chunk >> kPageMapBits];
+        assert(leaf && (*leaf)[chunk & kPageMapMask] == page);
+        (*leaf)[chunk & kPageMapMask] = nullptr;
     }
-    // TODO: search oversize
-    return nullptr;
 }
 
 } // namespace hadron
\ No newline at end of file
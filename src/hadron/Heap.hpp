@@ -1,13 +1,16 @@
 #ifndef SRC_COMPILER_INCLUDE_HADRON_HEAP_HPP_
 #define SRC_COMPILER_INCLUDE_HADRON_HEAP_HPP_
 
+#include "hadron/AllocationProfiler.hpp"
 #include "hadron/Hash.hpp"
 #include "hadron/Page.hpp"
 #include "hadron/Slot.hpp"
 
+#include <algorithm>
 #include <array>
+#include <cassert>
+#include <chrono>
 #include <cstddef>
-#include <map>
 #include <memory>
 #include <string_view>
 #include <unordered_map>
@@ -20,17 +23,77 @@ namespace library {
 struct Schema;
 }
 
+class CompressedSlot;
+class HandleArena;
+struct HeapStats;
+struct ThreadContext;
+
 // Manages dynamic memory allocation for Hadron, including garbage collection. Inspired by the design of the v8 garbage
 // collection system, but greatly simplified.
 class Heap {
 public:
+    // Uses the default size classes from defaultSizeClasses().
     Heap();
+    // |sizeClasses| is the object size of each size class in bytes, in ascending order. Each must be a multiple of
+    // kSizeClassAlignment, and the last must be kLargeObjectSize.
+    explicit Heap(std::vector<size_t> sizeClasses);
     ~Heap();
 
+    // Size classes in kSizeClassAlignment steps up to kSmallObjectSize, then growing geometrically by a factor of
+    // (1 + 1/8) up to kLargeObjectSize, which bounds internal fragmentation at 1/8 of the allocation size.
+    static std::vector<size_t> defaultSizeClasses();
+    const std::vector<size_t>& sizeClasses() const { return m_sizeClasses; }
+
+    // The ThreadContext supplies part of the root set for garbage collection, and the Heap will not collect until one
+    // is provided. Also installs the store buffer for the write barrier and empty allocation buffers into |context|.
+    void setThreadContext(ThreadContext* context);
+
     // Default allocation, allocates from the young space (unless extra large). Does not initialize the memory to
-    // a known value.
+    // a known value. Small objects are allocated from the same ThreadContext allocation buffers as compiled code.
     void* allocateNew(size_t sizeInBytes);
 
+    // Replaces the ThreadContext allocation buffer serving objects of |sizeInBytes| with a fresh run of objects, as the
+    // response to the kAllocateMemory interrupt. |sizeInBytes| must be no larger than
+    // ThreadContext::kMaximumBufferedSize. May trigger a collection. Returns false if out of memory.
+    bool refillAllocationBuffer(size_t sizeInBytes);
+
+    // The space to allocate an object in, for callers that know how long the object will live.
+    enum AllocationSpace : uint8_t {
+        // The young space, unless inside a permanent allocation scope, or the class of the object is pretenured.
+        kAllocateDefault,
+        kAllocateMature,
+        kAllocatePermanent
+    };
+    // Allocates an object of the class with |classIndex| in |space|. Does not initialize the memory.
+    void* allocate(size_t sizeInBytes, uint32_t classIndex, AllocationSpace space = kAllocateDefault);
+
+    // Allocates directly in the mature space (or the large object space if extra large), for objects known to be long
+    // lived. Does not initialize the memory. May trigger a full collection.
+    void* allocateMature(size_t sizeInBytes);
+    // Allocates directly in the permanent space (or the large object space if extra large). Permanent objects are
+    // marked and swept by full collections like mature objects, but compaction never moves them, so the C++ side can
+    // keep references to them, as the ClassLibrary does to the classes. May trigger a full collection.
+    void* allocatePermanent(size_t sizeInBytes);
+
+    // Every default allocation between these calls goes to the permanent space, so objects that live as long as the
+    // process, like those created while compiling the class library, are never copied by the young collector. Calls
+    // can nest.
+    void beginPermanentAllocation() { ++m_permanentAllocations; }
+    void endPermanentAllocation() {
+        assert(m_permanentAllocations > 0);
+        --m_permanentAllocations;
+    }
+
+    // Allocation site feedback for pretenuring. Sites are identified by the class of the object allocated. Young
+    // collections count the bytes of each class promoted to the mature space, against the bytes allocated in the young
+    // space. Once at least kPretenureSampleBytes of a class have been allocated, and at least kPretenureSurvivalPercent
+    // of them promoted, the class is pretenured, and default allocations from C++ go straight to the mature space.
+    // Compiled code allocates inline, so is never pretenured. Each full collection forgets the feedback and decisions
+    // so far, so that pretenuring follows changes in program behavior.
+    bool isPretenured(uint32_t classIndex) const {
+        return m_pretenuredClasses.size() && m_pretenuredClasses.count(classIndex);
+    }
+
     // Used for allocating JIT memory. Returns the maximum usable size in |allocatedSize|, which can be useful as the
     // JIT bytecode is typically based on size estimates. NOTE: calling thread will need to be marked for JIT
     // compilation or this method will segfault on macOS aarch64 devices.
@@ -41,15 +104,179 @@ public:
     void* allocateStackSegment();
     void freeTopStackSegment();
 
+    // Stack Pages emptied by freeTopStackSegment() are cached for reuse instead of unmapped, so a call depth that hovers
+    // around a Page boundary costs no system calls. The |lowWatermark| most recently cached Pages stay resident, older
+    // cached Pages give their memory back to the operating system with madvise() but stay mapped, and cached Pages
+    // beyond |highWatermark| are unmapped.
+    void setStackCacheWatermarks(size_t lowWatermark, size_t highWatermark);
+    struct StackCounters {
+        size_t pagesMapped = 0;
+        size_t pagesUnmapped = 0;
+        size_t pagesReused = 0;
+        size_t pagesDiscarded = 0;
+        size_t pagesCached = 0;
+    };
+    const StackCounters& stackCounters() const { return m_stackCounters; }
+
     // Adds to the list of permanent objects that are the point of origin for all scanning jobs.
     void addToRootSet(Slot object);
     void removeFromRootSet(Slot object);
 
-    // TODO: verify size classes experimentally.
+    // Storage for the Handles of every open HandleScope, which are also roots. Unlike root set objects, objects only
+    // referred to by Handles may be moved, with the Handles updated to match.
+    HandleArena* handles() { return m_handles.get(); }
+
+    // Collection is only safe when every live object is reachable from the root set. Much of the C++ side of Hadron,
+    // for example the compiler during class library compilation, holds untracked references to heap objects, so it
+    // must defer collection while running. Calls can nest, collection resumes when every deferCollection() call has
+    // been matched by a call to allowCollection().
+    // C++ code may also store young pointers into mature objects without a write barrier while collection is deferred,
+    // so the remembered set is rebuilt from a scan of the mature space after the final allowCollection() call.
+    void deferCollection() { ++m_collectionDeferrals; }
+    void allowCollection();
+    bool isCollectionDeferred() const { return m_collectionDeferrals > 0; }
+
+    // Performs a full stop-the-world mark and sweep collection, regardless of any deferral. If incremental marking is in
+    // progress this finishes it instead.
+    void collectGarbage();
+
+    // Incremental marking spreads the mark phase of a full collection over bounded steps interleaved with allocation,
+    // leaving only a final re-scan of the roots and the sweep in the pause. Young objects can move during marking, so
+    // the steps only mark mature and large objects, and the final pause marks the young objects. Stores into objects
+    // already marked black are caught by the write barrier, which shades the object gray again for another scan.
+    // A nonzero budget enables incremental marking for full collections triggered by allocation, with each step
+    // limited to roughly |budget|. A zero budget (the default) collects with collectGarbage() instead.
+    void setMarkStepBudget(std::chrono::microseconds budget) { m_markStepBudget = budget; }
+    std::chrono::microseconds markStepBudget() const { return m_markStepBudget; }
+    // Shades the roots and begins incremental marking.
+    void startIncrementalMarking();
+    // Marks gray objects until the gray stack is empty or |budget| is exhausted. Returns true when no gray objects
+    // remain, so marking can be finished with a short pause.
+    bool markStep(std::chrono::microseconds budget);
+    // Completes marking with the world stopped, then sweeps.
+    void finishIncrementalMarking();
+    bool isMarking() const { return m_isMarking; }
+
+    // Stop-the-world marking, in collectGarbage() and the final pause of incremental marking, and the sweep of every
+    // full collection can use |count| helper threads in addition to the collecting thread. Each marking thread keeps
+    // its gray objects in its own work-stealing deque, and steals from the other threads when it runs out. The helper
+    // threads only live for the duration of each phase. Zero (the default) collects on the calling thread only.
+    void setHelperThreads(size_t count) { m_helperThreads = count; }
+    size_t helperThreads() const { return m_helperThreads; }
+
+    // Compaction fights fragmentation of the mature space, where long lived objects that die leave their Pages partly
+    // empty, and the sweep can only return a Page once every object in it is dead. Within each size class it moves the
+    // objects of the emptiest Pages into the free objects of the fullest, rewrites every pointer to a moved object,
+    // and releases the Pages left empty. Objects the C++ side refers to directly, the root set and the class library,
+    // are never moved.
+    // A nonzero threshold compacts after any full collection that leaves at least that fraction of the mature space
+    // unused, see HeapStats::SpaceUsage::fragmentation(). Zero (the default) never compacts automatically.
+    void setCompactionThreshold(double threshold) { m_compactionThreshold = threshold; }
+    double compactionThreshold() const { return m_compactionThreshold; }
+    // Compacts the mature space, regardless of the threshold or any deferral. Must not be called while marking.
+    void compactMatureSpace();
+
+    // Returns true if |object| contains Slots that the collector should scan, false if it holds raw bytes or only
+    // CompressedSlots.
+    static bool hasSlots(const library::Schema* object);
+
+    // Compressed pointers halve the size of object references held in CompressedSlots, like the elements of a
+    // library::CompressedArray, by storing them as 32 bit offsets from a base address. Every object must then be within
+    // 4 GiB of the base, so this confines the PagePool to its reservation, which must already exist and be no larger
+    // than kMaximumCompressedReservation, and sets the base just below it. Executable Pages are still mapped outside
+    // the reservation, so CompressedSlots can't refer to compiled code. Applies to every Heap in the process, and must
+    // be called before creating any. Returns false on failure, leaving compressed pointers disabled.
+    static bool enableCompressedPointers();
+
+    // Write barrier for C++ code, must follow any store of an object pointer into |object| made while collection is
+    // allowed. Compiled code uses the store buffer instead, with the same effect.
+    void writeBarrier(library::Schema* object);
+
+    // Performs a young generation collection, regardless of any deferral. Copies live young objects into new young
+    // Pages, or promotes them to the mature space once they have survived kPromotionAge collections. The work is
+    // proportional to the amount of live young data plus the size of the remembered set.
+    void collectYoungGeneration();
+
+    // Summary of the most recent collection, also logged at the end of every collection.
+    struct CollectionReport {
+        size_t collectionNumber = 0;
+        std::chrono::microseconds pauseTime = std::chrono::microseconds(0);
+        size_t objectsReclaimed = 0;
+        size_t bytesReclaimed = 0;
+        size_t bytesLive = 0;
+        // Young generation collections only account for the young generation, with promoted objects counted as live.
+        bool isYoungCollection = false;
+        size_t objectsPromoted = 0;
+        size_t bytesPromoted = 0;
+        // For incrementally marked full collections, the number and total duration of the mark steps. The pause time
+        // covers only the final pause.
+        size_t markSteps = 0;
+        std::chrono::microseconds markStepTime = std::chrono::microseconds(0);
+        // For full collections followed by compaction, the number of mature objects moved and the number of mature
+        // Pages released.
+        size_t objectsCompacted = 0;
+        size_t pagesReleased = 0;
+    };
+    const CollectionReport& lastCollection() const { return m_lastCollection; }
+
+    // Memory usage for a single size class, across all spaces.
+    struct SizeClassUsage {
+        size_t objectSize = 0;
+        size_t pages = 0;
+        size_t objects = 0;
+        // Allocation size of every object, |objects| * |objectSize|.
+        size_t bytesAllocated = 0;
+        // Sum of the sizes of every object, as recorded in the object Schemas.
+        size_t bytesUsed = 0;
+        // Totals of all allocations requests in this size class over the lifetime of the Heap. Objects allocated from
+        // ThreadContext allocation buffers are counted when the buffer is retired, using the size in their header.
+        size_t totalAllocations = 0;
+        size_t totalBytesRequested = 0;
+
+        // Internal fragmentation, the memory allocated to objects but not used by them.
+        size_t fragmentationBytes() const { return bytesAllocated - bytesUsed; }
+    };
+    // Returns usage for each size class, in the same order as sizeClasses(). Walks every Page, so is not cheap.
+    std::vector<SizeClassUsage> sizeClassUsage();
+
+    // Returns the current HeapStats. Also walks every Page.
+    HeapStats stats();
+    // Number of buckets in the HeapStats pause time histogram.
+    static constexpr size_t kPauseHistogramBuckets = 24;
+
+    // The sampling allocation profiler, fed from the allocation slow paths. See AllocationProfiler.
+    AllocationProfiler& allocationProfiler() { return m_allocationProfiler; }
+
+    static constexpr size_t kSizeClassAlignment = 16;
     static constexpr size_t kSmallObjectSize = 256;
-    static constexpr size_t kMediumObjectSize = 2048;
     static constexpr size_t kLargeObjectSize = 32 * 1024;
     static constexpr size_t kPageSize = 256 * 1024;
+    // Objects larger than kLargeObjectSize get their own Page in the large object space, sized in multiples of this.
+    static constexpr size_t kLargeObjectGranularity = 4096;
+    // Number of bytes allocated in the young generation before allocation will trigger a young generation collection.
+    static constexpr size_t kYoungGenerationSize = 8 * kPageSize;
+    // Minimum number of bytes promoted since the last full collection before a young generation collection will be
+    // followed by a full collection.
+    static constexpr size_t kMinimumCollectionThreshold = 16 * kPageSize;
+    // Young objects are promoted to the mature space when evacuated with a Page collection count at or above this
+    // value, meaning they have survived kPromotionAge - 1 collections.
+    static constexpr uint8_t kPromotionAge = 3;
+    // Size in bytes of the write barrier store buffer, must be a power of two no larger than the operating system page
+    // size, to guarantee alignment.
+    static constexpr size_t kStoreBufferSize = 4096;
+    // Number of bytes of objects reserved by each refill of a ThreadContext allocation buffer.
+    static constexpr size_t kAllocationBufferSize = 4096;
+    // Thresholds for pretenuring a class, see isPretenured().
+    static constexpr size_t kPretenureSampleBytes = 64 * 1024;
+    static constexpr size_t kPretenureSurvivalPercent = 85;
+    // Number of bytes allocated between incremental mark steps.
+    static constexpr size_t kMarkStepInterval = 64 * 1024;
+    // Largest PagePool reservation that compressed pointers can address, the 4 GiB range of a CompressedSlot rounded
+    // down to a whole number of huge pages.
+    static constexpr size_t kMaximumCompressedReservation = (4ull << 30) - (2 * 1024 * 1024);
+    // Default watermarks for the stack Page cache.
+    static constexpr size_t kStackCacheLowWatermark = 1;
+    static constexpr size_t kStackCacheHighWatermark = 4;
 
     // For the given object, returns the allocation size for that object.
     size_t getAllocationSize(void* address);
@@ -58,39 +285,277 @@ public:
     size_t getMaximumSize(size_t sizeInBytes);
 
 private:
-    enum SizeClass {
-        kSmall = 0,
-        kMedium = 1,
-        kLarge = 2,
-        kOversize = 3
+    // Index into m_sizeClasses.
+    using SizeClass = size_t;
+    // Pages of each size class, along with the index of the Page currently allocated from for each size class. Pages
+    // before the current Page are full, as nothing frees objects until the next collection resets the indices.
+    struct SizedPages {
+        std::vector<std::vector<std::unique_ptr<Page>>> pages;
+        std::vector<size_t> currentPages;
+        void resize(size_t numberOfSizeClasses) {
+            pages.resize(numberOfSizeClasses);
+            currentPages.resize(numberOfSizeClasses, 0);
+        }
+        void resetCurrentPages() { std::fill(currentPages.begin(), currentPages.end(), 0); }
     };
-    using SizedPages = std::array<std::vector<std::unique_ptr<Page>>, kOversize>;
 
-    SizeClass getSizeClass(size_t sizeInBytes);
-    size_t getSize(SizeClass sizeClass);
+    // Returns the smallest size class that can hold |sizeInBytes|, which must be no larger than kLargeObjectSize.
+    SizeClass getSizeClass(size_t sizeInBytes) const {
+        assert(sizeInBytes <= kLargeObjectSize);
+        return m_sizeClassLookup[(sizeInBytes + kSizeClassAlignment - 1) / kSizeClassAlignment];
+    }
+    size_t getSize(SizeClass sizeClass) const { return m_sizeClasses[sizeClass]; }
     void* allocateSized(size_t sizeInBytes, SizedPages& sizedPages, bool isExecutable);
+    // Maps a new Page in the large object space for a single object.
+    void* allocateLarge(size_t sizeInBytes, bool isExecutable);
+    // Allocates an object in |sizedPages| for allocateMature() or allocatePermanent().
+    void* allocateOld(size_t sizeInBytes, SizedPages& sizedPages, Page::Space space);
+    // Allocates from |sizedPages|, mapping a new Page in |space| if needed, but never triggers collection.
+    void* allocateFromPages(SizeClass sizeClass, SizedPages& sizedPages, Page::Space space);
+    // Adds an empty stack Page to the stack Page cache, discarding or unmapping older cached Pages as needed.
+    void cacheStackPage(std::unique_ptr<Page> page);
+    // Maps and registers a new Page for |sizeClass| in |sizedPages|, returns nullptr on failure.
+    Page* addPage(SizeClass sizeClass, SizedPages& sizedPages, Page::Space space);
+
+    // Returns the unused objects in the ThreadContext allocation buffers to their Pages, so every allocated young object
+    // has an initialized header. Must be called before walking or collecting the young Pages.
+    void retireAllocationBuffers();
+    void retireAllocationBuffer(size_t index);
+    // Returns true if enough has been allocated since the last collection to justify another young collection, or since
+    // the last mark step to justify another step.
+    bool shouldCollect() const;
+    // Returns true if enough has been promoted or allocated in the large object space since the last full collection to
+    // justify another full collection.
+    bool shouldCollectGarbage() const;
+    // Runs a young generation collection if needed, followed by an incremental mark step if marking, or the start of
+    // a full collection if enough has been promoted since the last.
+    void collect();
+    // Shades the roots and marks until the gray stack is empty.
     void mark();
+    // Marks from the objects on the gray stack with the calling thread and the helper threads, leaving the gray stack
+    // empty.
+    void markParallel();
+    // Calls |function| with the index of the thread, from zero for the calling thread to m_helperThreads, on the calling
+    // thread and each helper thread. Returns once every call has returned.
+    template<typename Function> void runOnHelperThreads(Function function);
+    void shadeRoots();
     void sweep();
-    // Return a pointer to a Page object that contains the provided address.
+    // Finishes a full collection after marking, sweeping and updating the collection statistics.
+    void finishCollection(std::chrono::steady_clock::time_point startTime);
+    // Adds the pause time of m_lastCollection to the pause statistics.
+    void recordPause();
+    // Records a store into |object|, adding it to the remembered set if mature. During incremental marking, also shades
+    // |object| gray again if already black, so it will be re-scanned.
+    void recordWrite(library::Schema* object);
+    // Marks |object| gray, whatever its current color, and pushes it on to the gray stack.
+    void regray(Page* page, library::Schema* object);
+    // Pretenures the classes whose allocation site feedback justifies it, after a young collection.
+    void updatePretenuring();
+
+    // Compaction support.
+    // Returns true if the mature space is fragmented past the compaction threshold.
+    bool shouldCompact();
+    // If |object| was moved by compaction returns its new address, otherwise returns |object|.
+    library::Schema* forwardingAddress(library::Schema* object);
+    // Rewrites the |numberOfSlots| Slots starting at |slots| that point at moved objects to their new addresses.
+    void updateSlots(Slot* slots, size_t numberOfSlots);
+    // As updateSlots(), for CompressedSlots.
+    void updateCompressedSlots(CompressedSlot* slots, size_t numberOfSlots);
+
+    // Young generation collection support.
+    // Adds the objects the store buffer recorded since the last young collection to the remembered set.
+    void drainStoreBuffer();
+    // If |object| is in the young space returns its new address, copying it if not already copied. Otherwise returns
+    // |object|.
+    library::Schema* evacuate(library::Schema* object);
+    // Evacuates all the young objects referred to by |numberOfSlots| Slots starting at |slots|, updating the Slots to
+    // their new addresses. Returns true if any Slot still refers to a young object afterwards.
+    bool scavengeSlots(Slot* slots, size_t numberOfSlots);
+    // As scavengeSlots(), for CompressedSlots.
+    bool scavengeCompressedSlots(CompressedSlot* slots, size_t numberOfSlots);
+    // Scavenges all the Slots in |object|, and adds it to the remembered set if it is mature and still refers to young
+    // objects.
+    void scavengeObject(library::Schema* object);
+    // Returns true if |object| is in the young or survivor space.
+    bool isYoung(library::Schema* object);
+    // Scans |numberOfSlots| Slots starting at |slots|, shading any pointer to a white object gray.
+    void scanSlots(const Slot* slots, size_t numberOfSlots);
+    // Shades |object| gray and pushes it on to the gray stack if it is a valid white object.
+    void shade(library::Schema* object);
+    // Returns true if |object| is a valid white object, after shading it gray. When several threads race to shade the
+    // same object only one gets true back.
+    bool tryShade(library::Schema* object);
+    // Scans the Slots in |object| for pointers, then marks it black.
+    void blacken(library::Schema* object);
+    // Marks |object| black and calls |push| with each object it refers to that this thread shaded gray. Safe to call
+    // from multiple threads during parallel marking.
+    template<typename Function> void blacken(library::Schema* object, Function push);
+    // Calls |function| with the start and number of Slots of each run of Slots in |object| that may hold pointers,
+    // following the layout schemac generated for its class. Raw bytes are skipped, so arrays of them produce no runs.
+    template<typename Function> static void forEachSlotRun(library::Schema* object, Function function);
+    // Calls |function| with the start and number of the CompressedSlots in |object|, if its class layout has them.
+    template<typename Function> static void forEachCompressedRun(library::Schema* object, Function function);
+    // Calls |function| for each size-classed Page that may contain collectable objects.
+    template<typename Function> void forEachCollectablePage(Function function);
+    // Return a pointer to a Page object that contains the provided address, or nullptr if the address is not in a Page.
     Page* findPageContaining(void* address);
+    // Adds or removes |page| from the page map. Pages must be mapped at kPageSize alignment.
+    void registerPage(Page* page);
+    void unregisterPage(Page* page);
+
+    // Object size of each size class.
+    std::vector<size_t> m_sizeClasses;
+    // Maps allocation sizes, divided by kSizeClassAlignment and rounded up, to their size class.
+    std::vector<uint8_t> m_sizeClassLookup;
+    // Only the cumulative fields are maintained here, the rest are computed in sizeClassUsage().
+    std::vector<SizeClassUsage> m_sizeClassUsage;
+
+    // The run of objects reserved for each ThreadContext allocation buffer, for retiring the buffer.
+    struct AllocationRun {
+        uint8_t* start = nullptr;
+        size_t count = 0;
+    };
+    std::vector<AllocationRun> m_allocationRuns;
 
     SizedPages m_youngPages;
     SizedPages m_maturePages;
+    SizedPages m_permanentPages;
+    int32_t m_permanentAllocations;
 
     // Bytecode cannot be relocated and so is exempt from generational garbage collection.
     SizedPages m_executablePages;
 
+    // Objects larger than kLargeObjectSize each get their own Page, and are never copied. Dead large objects have their
+    // Page unmapped during the sweep.
+    std::vector<std::unique_ptr<Page>> m_largeObjectPages;
+
     // Not garbage collected, permanently allocated objects. Root objects are where scanning starts, along with the
     // stack.
     std::unordered_set<library::Schema*> m_rootSet;
+    std::unique_ptr<HandleArena> m_handles;
 
     // Hadron program stack support.
     std::vector<std::unique_ptr<Page>> m_stackSegments;
-    // Offset of first free chunk within last Page of m_stackSegments.
+    // Offset of first free chunk within last Page of m_stackSegments. Zero means the last Page is full.
     size_t m_stackPageOffset;
+    // Empty stack Pages, in the order they were cached, so the most recently used are at the back.
+    std::vector<std::unique_ptr<Page>> m_stackPageCache;
+    size_t m_stackCacheLowWatermark;
+    size_t m_stackCacheHighWatermark;
+    StackCounters m_stackCounters;
+
+    // Collection pause statistics for HeapStats, maintained by recordPause().
+    size_t m_youngCollections;
+    size_t m_fullCollections;
+    std::array<size_t, kPauseHistogramBuckets> m_pauseHistogram;
+    std::chrono::microseconds m_totalPauseTime;
+    std::chrono::microseconds m_maximumPauseTime;
+    size_t m_compactions;
+
+    AllocationProfiler m_allocationProfiler;
+
+    struct AllocationSite {
+        size_t bytesAllocated = 0;
+        size_t bytesPromoted = 0;
+    };
+    AllocationSite& allocationSite(uint32_t classIndex) {
+        if (classIndex >= m_allocationSites.size()) { m_allocationSites.resize(classIndex + 1); }
+        return m_allocationSites[classIndex];
+    }
+    // Indexed by the Schema _classIndex, grown as needed.
+    std::vector<AllocationSite> m_allocationSites;
+    std::unordered_set<uint32_t> m_pretenuredClasses;
+
+    // Maps each kPageSize-aligned chunk of the address space to the Page containing it, for mapping an arbitrary address
+    // back to its owning Page in constant time. As executable Pages can't share a single reservation with the rest of
+    // the heap this is a two-level radix tree over the 48-bit address space, with leaves allocated as needed.
+    static constexpr size_t kPageShift = 18;
+    static_assert(kPageSize == (1 << kPageShift));
+    static constexpr size_t kPageMapBits = (48 - kPageShift) / 2;
+    static constexpr uintptr_t kPageMapMask = (1 << kPageMapBits) - 1;
+    using PageMapLeaf = std::array<Page*, 1 << kPageMapBits>;
+    std::vector<std::unique_ptr<PageMapLeaf>> m_pageMap;
+
+    ThreadContext* m_threadContext;
+    int32_t m_collectionDeferrals;
+    size_t m_helperThreads;
+    // Objects marked gray but not yet scanned, also used as the scan queue for copied objects during young collection.
+    std::vector<library::Schema*> m_grayStack;
+
+    // Incremental marking state. The young collector promotes objects gray while marking, as they may be referred to
+    // by objects already marked black.
+    bool m_isMarking;
+    // Set when stores may have escaped the write barrier during marking, meaning every black object must be scanned
+    // again in the final pause.
+    bool m_markingNeedsRescan;
+    std::chrono::microseconds m_markStepBudget;
+    size_t m_bytesAllocatedSinceMarkStep;
+    size_t m_markSteps;
+    std::chrono::microseconds m_markStepTime;
+    // Holds the incremental marking gray stack during a young collection, which uses m_grayStack as its scan queue.
+    std::vector<library::Schema*> m_markingGrayStack;
+    // Sum of young allocation sizes since the last collection, used for collection scheduling.
+    size_t m_bytesAllocatedSinceCollection;
+    // Sum of promoted and large object sizes since the last full collection, used for collection scheduling.
+    size_t m_bytesPromotedSinceCollection;
+    // Size of the live heap after the last full collection.
+    size_t m_bytesLiveAfterCollection;
+    double m_compactionThreshold;
+    CollectionReport m_lastCollection;
+
+    // Mature objects that may contain pointers to young objects, scanned as roots during young collections.
+    std::unordered_set<library::Schema*> m_rememberedSet;
+    // False if there may be mature objects with young pointers missing from the remembered set, meaning the next
+    // young collection must scan the entire mature space.
+    bool m_rememberedSetComplete;
+    std::unique_ptr<Page> m_storeBuffer;
+};
+
+// A snapshot of Heap usage and collection history, for tuning heap sizing and catching allocation regressions.
+struct HeapStats {
+    // Usage of each size class, in the same order as Heap::sizeClasses().
+    std::vector<Heap::SizeClassUsage> sizeClasses;
+
+    // Allocated objects of a single class, in any space. |bytes| counts allocation sizes.
+    struct ClassUsage {
+        size_t objects = 0;
+        size_t bytes = 0;
+    };
+    // Keyed by class name hash.
+    std::unordered_map<Hash, ClassUsage> classes;
+
+    struct SpaceUsage {
+        size_t pages = 0;
+        size_t bytesMapped = 0;
+        // Allocation size of every object in the space.
+        size_t bytesAllocated = 0;
+
+        // The fraction of the mapped memory not allocated to any object.
+        double fragmentation() const {
+            if (bytesMapped == 0) { return 0.0; }
+            return 1.0 - (static_cast<double>(bytesAllocated) / static_cast<double>(bytesMapped));
+        }
+    };
+    SpaceUsage youngSpace;
+    SpaceUsage matureSpace;
+    SpaceUsage permanentSpace;
+    SpaceUsage executableSpace;
+    SpaceUsage largeObjectSpace;
+    // Includes the cached stack Pages.
+    SpaceUsage stackSpace;
+
+    size_t youngCollections = 0;
+    size_t fullCollections = 0;
+    // Number of times the mature space was compacted.
+    size_t compactions = 0;
+    // Bucket 0 counts pauses under 1 us, and each bucket i after that pauses of at least 2^(i - 1) and under 2^i us.
+    // The last bucket also counts every longer pause.
+    std::array<size_t, Heap::kPauseHistogramBuckets> pauseHistogram = {};
+    std::chrono::microseconds totalPauseTime = std::chrono::microseconds(0);
+    std::chrono::microseconds maximumPauseTime = std::chrono::microseconds(0);
 
-    // Address of first byte past the end of each Page, used for mapping an arbitrary address back to owning object.
-    std::map<uintptr_t, Page*> m_pageEnds;
+    // Peak resident set size of the whole process, in bytes.
+    size_t peakResidentBytes = 0;
 };
 
 } // namespace hadron
@@ -0,0 +1,313 @@
+#include "hadron/HeapImage.hpp"
+
+#include "hadron/ClassLibrary.hpp"
+#include "hadron/Heap.hpp"
+#include "hadron/internal/BuildInfo.hpp"
+#include "hadron/LayoutTable.hpp"
+#include "hadron/library/Array.hpp"
+#include "hadron/library/Kernel.hpp"
+#include "hadron/library/Schema.hpp"
+#include "hadron/library/String.hpp"
+#include "hadron/SymbolTable.hpp"
+#include "hadron/ThreadContext.hpp"
+
+#include "fmt/format.h"
+#include "spdlog/spdlog.h"
+
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// "HDNIMAGE" in little-endian byte order.
+constexpr uint64_t kMagic = 0x4547414d494e4448ull;
+
+struct Header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t slotSize;
+    // Object layouts may change between builds of Hadron, so images are only valid for the build that wrote them.
+    hadron::Hash buildHash;
+    hadron::Hash sourceHash;
+    uint64_t numberOfObjects;
+    // Size of the object records, which follow the header. Each record is the allocation size of the object as a
+    // uint64_t, followed by the object itself padded to a multiple of 8 bytes.
+    uint64_t objectBytes;
+    // The symbol Strings follow the object records, as an array of this many references.
+    uint64_t numberOfSymbols;
+    // References to the class library objects. A reference is an object number plus one, with zero meaning nil.
+    uint64_t classArray;
+    uint64_t interpreterContext;
+    uint64_t classVariables;
+};
+
+hadron::Hash buildHash() {
+    return hadron::hash(fmt::format("{}@{}", hadron::kHadronVersion, hadron::kHadronCommitHash));
+}
+
+size_t paddedSize(size_t sizeInBytes) {
+    return (sizeInBytes + 7) & ~static_cast<size_t>(7);
+}
+
+// Within the image pointer Slots hold references, so |reference| is stored as if it were an address.
+hadron::Slot referenceSlot(uint64_t reference) {
+    return hadron::Slot::makePointer(reinterpret_cast<hadron::library::Schema*>(reference));
+}
+
+uint64_t slotReference(hadron::Slot slot) {
+    return reinterpret_cast<uint64_t>(slot.getPointer());
+}
+
+size_t numberOfSlots(const hadron::library::Schema* object) {
+    return (object->_sizeInBytes - sizeof(hadron::library::Schema)) / hadron::kSlotSize;
+}
+
+hadron::Slot* slotsOf(hadron::library::Schema* object) {
+    return reinterpret_cast<hadron::Slot*>(reinterpret_cast<uint8_t*>(object) + sizeof(hadron::library::Schema));
+}
+
+// Numbers objects in the order they are first referenced.
+class ObjectNumbering {
+public:
+    uint64_t reference(hadron::library::Schema* object) {
+        if (object == nullptr) { return 0; }
+        auto iter = m_numbers.find(object);
+        if (iter != m_numbers.end()) { return iter->second + 1; }
+        m_numbers.emplace(object, m_objects.size());
+        m_objects.emplace_back(object);
+        return m_objects.size();
+    }
+
+    // Objects may be added while iterating by index.
+    const std::vector<hadron::library::Schema*>& objects() const { return m_objects; }
+
+private:
+    std::unordered_map<hadron::library::Schema*, uint64_t> m_numbers;
+    std::vector<hadron::library::Schema*> m_objects;
+};
+
+// Copies the objects out of the image at |data| into the permanent space, fixes up their pointers, and sets |addresses|
+// to the new address of each object. Code is raw bytes that need no fix up, as the heap objects it refers to are in the
+// constants Array of its FunctionDef or Method, which gets fixed up like any other object.
+bool loadObjects(hadron::ThreadContext* context, const Header* header, const uint8_t* data,
+        std::vector<hadron::library::Schema*>& addresses) {
+    const uint8_t* record = data;
+    const uint8_t* end = data + header->objectBytes;
+    addresses.reserve(header->numberOfObjects);
+    for (uint64_t i = 0; i < header->numberOfObjects; ++i) {
+        if (static_cast<size_t>(end - record) < sizeof(uint64_t) + sizeof(hadron::library::Schema)) { return false; }
+        uint64_t allocationSize;
+        std::memcpy(&allocationSize, record, sizeof(uint64_t));
+        auto schema = reinterpret_cast<const hadron::library::Schema*>(record + sizeof(uint64_t));
+        size_t recordSize = sizeof(uint64_t) + paddedSize(schema->_sizeInBytes);
+        if (schema->_sizeInBytes < sizeof(hadron::library::Schema) || schema->_sizeInBytes > allocationSize ||
+                static_cast<size_t>(end - record) < recordSize ||
+                hadron::LayoutTable::instance().layout(schema->classIndex()) == nullptr) {
+            return false;
+        }
+
+        auto address = context->heap->allocatePermanent(allocationSize);
+        if (address == nullptr) { return false; }
+        std::memcpy(address, schema, schema->_sizeInBytes);
+        addresses.emplace_back(reinterpret_cast<hadron::library::Schema*>(address));
+        record += recordSize;
+    }
+
+    for (auto object : addresses) {
+        if (!hadron::Heap::hasSlots(object)) { continue; }
+        auto slots = slotsOf(object);
+        for (size_t i = 0; i < numberOfSlots(object); ++i) {
+            if (!slots[i].isPointer()) { continue; }
+            uint64_t reference = slotReference(slots[i]);
+            if (reference > addresses.size()) { return false; }
+            slots[i] = hadron::Slot::makePointer(addresses[reference - 1]);
+        }
+    }
+
+    return true;
+}
+
+// Returns the object for |reference| as a Slot, or nil if |reference| is nil, out of range, or not of the class with
+// |classIndex|.
+hadron::Slot resolve(const std::vector<hadron::library::Schema*>& addresses, uint64_t reference,
+        uint32_t classIndex) {
+    if (reference == 0 || reference > addresses.size() || addresses[reference - 1]->classIndex() != classIndex) {
+        return hadron::Slot::makeNil();
+    }
+    return hadron::Slot::makePointer(addresses[reference - 1]);
+}
+
+} // namespace
+
+namespace hadron {
+
+// static
+bool HeapImage::write(ThreadContext* context, const std::string& path, Hash sourceHash) {
+    assert(context->heap->isCollectionDeferred());
+
+    Header header;
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.slotSize = kSlotSize;
+    header.buildHash = buildHash();
+    header.sourceHash = sourceHash;
+
+    ObjectNumbering numbering;
+    std::vector<uint64_t> symbols;
+    symbols.reserve(context->symbolTable->symbols().size());
+    for (const auto& [symbolHash, string] : context->symbolTable->symbols()) {
+        symbols.emplace_back(numbering.reference(string.slot().getPointer()));
+    }
+    auto classArray = context->classLibrary->classArray();
+    header.classArray = numbering.reference(reinterpret_cast<library::Schema*>(classArray.instance()));
+    auto interpreterContext = context->classLibrary->interpreterContext();
+    header.interpreterContext = numbering.reference(reinterpret_cast<library::Schema*>(
+            interpreterContext.instance()));
+    auto classVariables = context->classLibrary->classVariables();
+    header.classVariables = numbering.reference(reinterpret_cast<library::Schema*>(classVariables.instance()));
+
+    // Number every object reachable from the roots, breadth first.
+    for (size_t i = 0; i < numbering.objects().size(); ++i) {
+        auto object = numbering.objects()[i];
+        // CompressedSlots are offsets from an address that changes from run to run, so can't be saved.
+        auto layout = LayoutTable::instance().layout(object->classIndex());
+        if (layout && layout->indexed == library::SchemaLayout::kIndexedCompressed) {
+            SPDLOG_ERROR("Heap image can't hold compressed object of class index {}.", object->classIndex());
+            return false;
+        }
+        if (!Heap::hasSlots(object)) { continue; }
+        auto slots = slotsOf(object);
+        for (size_t j = 0; j < numberOfSlots(object); ++j) {
+            if (slots[j].isPointer()) {
+                numbering.reference(slots[j].getPointer());
+            }
+        }
+    }
+
+    header.numberOfObjects = numbering.objects().size();
+    header.objectBytes = 0;
+    for (auto object : numbering.objects()) {
+        header.objectBytes += sizeof(uint64_t) + paddedSize(object->_sizeInBytes);
+    }
+    header.numberOfSymbols = symbols.size();
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        SPDLOG_ERROR("Failed to open heap image file {} for writing.", path);
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+    // Write each object with its pointers replaced by references.
+    std::vector<uint8_t> buffer;
+    for (auto object : numbering.objects()) {
+        uint64_t allocationSize = context->heap->getAllocationSize(object);
+        file.write(reinterpret_cast<const char*>(&allocationSize), sizeof(uint64_t));
+        buffer.assign(paddedSize(object->_sizeInBytes), 0);
+        std::memcpy(buffer.data(), object, object->_sizeInBytes);
+        auto copy = reinterpret_cast<library::Schema*>(buffer.data());
+        if (Heap::hasSlots(copy)) {
+            auto slots = slotsOf(copy);
+            for (size_t i = 0; i < numberOfSlots(copy); ++i) {
+                if (slots[i].isPointer()) {
+                    slots[i] = referenceSlot(numbering.reference(slots[i].getPointer()));
+                }
+            }
+        }
+        file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    }
+    file.write(reinterpret_cast<const char*>(symbols.data()), symbols.size() * sizeof(uint64_t));
+
+    if (!file) {
+        SPDLOG_ERROR("Failed to write heap image file {}.", path);
+        return false;
+    }
+    SPDLOG_INFO("Wrote heap image {} with {} objects, {} bytes.", path, header.numberOfObjects,
+            sizeof(Header) + header.objectBytes + symbols.size() * sizeof(uint64_t));
+    return true;
+}
+
+// static
+bool HeapImage::read(ThreadContext* context, const std::string& path, Hash sourceHash) {
+    auto startTime = std::chrono::steady_clock::now();
+    int fileDescriptor = open(path.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) {
+        SPDLOG_INFO("No heap image at {}.", path);
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(fileDescriptor, &fileStat) != 0 || static_cast<size_t>(fileStat.st_size) < sizeof(Header)) {
+        SPDLOG_WARN("Heap image {} is truncated.", path);
+        close(fileDescriptor);
+        return false;
+    }
+    size_t fileSize = static_cast<size_t>(fileStat.st_size);
+    void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    close(fileDescriptor);
+    if (mapped == MAP_FAILED) {
+        SPDLOG_ERROR("Failed to map heap image {}: {}", path, strerror(errno));
+        return false;
+    }
+
+    auto data = reinterpret_cast<const uint8_t*>(mapped);
+    auto header = reinterpret_cast<const Header*>(data);
+    uint64_t numberOfObjects = header->numberOfObjects;
+    bool success = false;
+    if (header->magic != kMagic || header->version != kVersion || header->slotSize != kSlotSize ||
+            header->buildHash != buildHash()) {
+        SPDLOG_INFO("Heap image {} is from a different build, ignoring.", path);
+    } else if (header->sourceHash != sourceHash) {
+        SPDLOG_INFO("Class library source has changed since heap image {} was written, ignoring.", path);
+    } else if (header->objectBytes > fileSize - sizeof(Header) || header->numberOfSymbols >
+            (fileSize - sizeof(Header) - header->objectBytes) / sizeof(uint64_t)) {
+        SPDLOG_WARN("Heap image {} is truncated.", path);
+    } else {
+        // Nothing loaded is reachable from the roots until the very end.
+        context->heap->deferCollection();
+        std::vector<library::Schema*> addresses;
+        success = loadObjects(context, header, data + sizeof(Header), addresses);
+
+        auto classArray = resolve(addresses, header->classArray, library::Array::classIndex());
+        auto interpreterContext = resolve(addresses, header->interpreterContext, library::Method::classIndex());
+        auto classVariables = resolve(addresses, header->classVariables, library::Array::classIndex());
+        success = success && !classArray.isNil() && !interpreterContext.isNil() && !classVariables.isNil();
+
+        std::vector<library::String> symbols;
+        auto symbolReferences = reinterpret_cast<const uint64_t*>(data + sizeof(Header) + header->objectBytes);
+        for (uint64_t i = 0; success && i < header->numberOfSymbols; ++i) {
+            auto string = resolve(addresses, symbolReferences[i], library::String::classIndex());
+            success = !string.isNil();
+            symbols.emplace_back(library::String(string));
+        }
+
+        if (success) {
+            for (auto string : symbols) {
+                context->symbolTable->addSymbol(context, string);
+            }
+            success = context->classLibrary->restoreLibrary(context, library::ClassArray(classArray),
+                    library::Method(interpreterContext), library::Array(classVariables));
+        } else {
+            SPDLOG_WARN("Heap image {} is corrupt.", path);
+        }
+        context->heap->allowCollection();
+    }
+
+    munmap(mapped, fileSize);
+    if (success) {
+        SPDLOG_INFO("Loaded heap image {} with {} objects in {} us.", path, numberOfObjects,
+                std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                    startTime).count());
+    }
+    return success;
+}
+
+} // namespace hadron
@@ -0,0 +1,36 @@
+#ifndef SRC_HADRON_HEAP_IMAGE_HPP_
+#define SRC_HADRON_HEAP_IMAGE_HPP_
+
+#include "hadron/Hash.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace hadron {
+
+struct ThreadContext;
+
+// A snapshot of the compiled class library, so that later runs can load the class library from a file instead of
+// compiling it again. The image holds every object reachable from the symbol table and the class library, with the
+// object pointers in each object replaced by object numbers, so it can be loaded at any address. Loading maps the file,
+// copies the objects into the permanent space, then fixes up the pointers to their new addresses. Compiled code is
+// copied as is, which is only safe because code reaches heap objects through the constants Array of its FunctionDef or
+// Method, never by address. See LoadLiteralLIR.
+class HeapImage {
+public:
+    // Writes the symbol table and class library of |context| to a new image at |path|, tagged with |sourceHash|.
+    // Collection must be deferred while writing. Returns false on error.
+    static bool write(ThreadContext* context, const std::string& path, Hash sourceHash);
+
+    // Loads the image at |path|, replacing the class library of |context| and adding the image symbols to its symbol
+    // table. Fails without changing either if the image is missing, invalid, from a different build of Hadron, or
+    // tagged with a hash other than |sourceHash|.
+    static bool read(ThreadContext* context, const std::string& path, Hash sourceHash);
+
+    // Change this when the image format changes.
+    static constexpr uint32_t kVersion = 3;
+};
+
+} // namespace hadron
+
+#endif // SRC_HADRON_HEAP_IMAGE_HPP_
@@ -0,0 +1,118 @@
+#include "hadron/HeapImage.hpp"
+
+#include "hadron/ClassLibrary.hpp"
+#include "hadron/ErrorReporter.hpp"
+#include "hadron/Heap.hpp"
+#include "hadron/internal/FileSystem.hpp"
+#include "hadron/library/Array.hpp"
+#include "hadron/library/Kernel.hpp"
+#include "hadron/library/Symbol.hpp"
+#include "hadron/Runtime.hpp"
+#include "hadron/SymbolTable.hpp"
+#include "hadron/ThreadContext.hpp"
+
+#include "doctest/doctest.h"
+
+#include <memory>
+#include <string>
+
+namespace hadron {
+
+namespace {
+constexpr int32_t kCodeSize = 16;
+
+// Builds a small class library in |context|, with one class with one method, and one class variable. The method has
+// code, and an inner block in its constants as the compiled code of a block literal would.
+void buildLibrary(ThreadContext* context) {
+    auto classDef = library::Class::alloc(context);
+    classDef.initToNil();
+    classDef.setName(library::Symbol::fromView(context, "HeapImageTestClass"));
+    auto method = library::Method::alloc(context);
+    method.initToNil();
+    method.setName(library::Symbol::fromView(context, "heapImageTestMethod"));
+    method.setOwnerClass(context, classDef);
+    auto code = library::Int8Array::arrayAlloc(context, kCodeSize);
+    for (int32_t i = 0; i < kCodeSize; ++i) { code = code.add(context, static_cast<int8_t>(i)); }
+    method.setCode(context, code);
+    auto functionDef = library::FunctionDef::alloc(context);
+    functionDef.initToNil();
+    functionDef.setCode(context, code);
+    method.setConstants(context, library::Array::arrayAlloc(context, 1).add(context, functionDef.slot()));
+    classDef.setMethods(context, library::MethodArray::typedArrayAlloc(context, 1).typedAdd(context, method));
+
+    auto classArray = library::ClassArray::typedArrayAlloc(context, 1).typedAdd(context, classDef);
+    auto classVariables = library::Array::arrayAlloc(context, 1).add(context, Slot::makeFloat(2.5));
+    REQUIRE(context->classLibrary->restoreLibrary(context, classArray, method, classVariables));
+}
+} // namespace
+
+TEST_CASE("HeapImage") {
+    auto errorReporter = std::make_shared<ErrorReporter>();
+    auto path = (fs::temp_directory_path() / "HeapImage_unittests.image").string();
+    constexpr Hash kSourceHash = 0x1234;
+
+    {
+        Runtime runtime(errorReporter);
+        auto context = runtime.context();
+        buildLibrary(context);
+        context->heap->deferCollection();
+        REQUIRE(HeapImage::write(context, path, kSourceHash));
+        context->heap->allowCollection();
+    }
+
+    SUBCASE("round trip") {
+        Runtime runtime(errorReporter);
+        auto context = runtime.context();
+        REQUIRE(HeapImage::read(context, path, kSourceHash));
+
+        auto className = library::Symbol::fromView(context, "HeapImageTestClass");
+        auto classDef = context->classLibrary->findClassNamed(className);
+        REQUIRE(!classDef.isNil());
+        CHECK_EQ(classDef.name(context), className);
+        REQUIRE_EQ(classDef.methods().size(), 1);
+        auto method = classDef.methods().typedAt(0);
+        CHECK_EQ(method.name(context).view(context), "heapImageTestMethod");
+        CHECK_EQ(method.ownerClass().slot(), classDef.slot());
+        CHECK_EQ(context->classLibrary->interpreterContext().slot(), method.slot());
+        REQUIRE_EQ(context->classLibrary->classVariables().size(), 1);
+        CHECK_EQ(context->classLibrary->classVariables().at(0), Slot::makeFloat(2.5));
+
+        // Loaded objects are in the permanent space and survive collection.
+        context->heap->collectGarbage();
+        CHECK_EQ(classDef.name(context), className);
+    }
+
+    SUBCASE("code constants") {
+        Runtime runtime(errorReporter);
+        auto context = runtime.context();
+        REQUIRE(HeapImage::read(context, path, kSourceHash));
+        auto method = context->classLibrary->interpreterContext();
+
+        // Code is copied byte for byte.
+        REQUIRE_EQ(method.code().size(), kCodeSize);
+        for (int32_t i = 0; i < kCodeSize; ++i) { CHECK_EQ(method.code().at(i), i); }
+
+        // The objects the code refers to are moved with the rest, and the constants fixed up to their new addresses.
+        REQUIRE_EQ(method.constants().size(), 1);
+        auto constant = method.constants().at(0);
+        REQUIRE(constant.isPointer());
+        CHECK_EQ(constant.getPointer()->classIndex(), library::FunctionDef::classIndex());
+        CHECK_EQ(library::FunctionDef(constant).code().slot(), method.code().slot());
+    }
+
+    SUBCASE("source changed") {
+        Runtime runtime(errorReporter);
+        auto context = runtime.context();
+        CHECK_FALSE(HeapImage::read(context, path, kSourceHash + 1));
+        CHECK(context->classLibrary->classArray().isNil());
+    }
+
+    SUBCASE("missing image") {
+        Runtime runtime(errorReporter);
+        CHECK_FALSE(HeapImage::read(runtime.context(), path + ".missing", kSourceHash));
+    }
+
+    fs::remove(path);
+}
+
+} // namespace hadron
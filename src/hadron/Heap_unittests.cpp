@@ -0,0 +1,514 @@
+#include "hadron/Heap.hpp"
+
+#include "hadron/ErrorReporter.hpp"
+#include "hadron/HandleScope.hpp"
+#include "hadron/Runtime.hpp"
+#include "hadron/ThreadContext.hpp"
+#include "hadron/library/Array.hpp"
+
+#include "doctest/doctest.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace hadron {
+
+class HeapTestFixture {
+public:
+    HeapTestFixture():
+        m_errorReporter(std::make_shared<ErrorReporter>()),
+        m_runtime(std::make_unique<Runtime>(m_errorReporter)) {}
+    virtual ~HeapTestFixture() = default;
+protected:
+    ThreadContext* context() { return m_runtime->context(); }
+private:
+    std::shared_ptr<ErrorReporter> m_errorReporter;
+    std::unique_ptr<Runtime> m_runtime;
+};
+
+TEST_CASE_FIXTURE(HeapTestFixture, "Heap") {
+    SUBCASE("getAllocationSize") {
+        auto heap = context()->heap;
+        // Header plus two slots rounds up to the next size class.
+        auto small = library::Array::arrayAlloc(context(), 2);
+        CHECK_EQ(heap->getAllocationSize(small.instance()), 32);
+        // Header plus 32 slots is 264 bytes, just above kSmallObjectSize, so is allocated in the next geometric class.
+        auto medium = library::Array::arrayAlloc(context(), Heap::kSmallObjectSize / kSlotSize);
+        CHECK_EQ(heap->getAllocationSize(medium.instance()), 288);
+        auto large = library::Array::arrayAlloc(context(), Heap::kLargeObjectSize / kSlotSize);
+        CHECK_EQ(heap->getAllocationSize(large.instance()), Heap::kLargeObjectSize + Heap::kLargeObjectGranularity);
+    }
+
+    SUBCASE("size classes") {
+        auto heap = context()->heap;
+        const auto& sizeClasses = heap->sizeClasses();
+        REQUIRE(sizeClasses.size() > 1);
+        CHECK_EQ(sizeClasses.front(), Heap::kSizeClassAlignment);
+        CHECK_EQ(sizeClasses.back(), Heap::kLargeObjectSize);
+        for (size_t i = 1; i < sizeClasses.size(); ++i) {
+            CHECK_EQ(sizeClasses[i] % Heap::kSizeClassAlignment, 0);
+            CHECK_GT(sizeClasses[i], sizeClasses[i - 1]);
+            // Rounding up to the next size class wastes no more than an eighth of the allocation.
+            if (sizeClasses[i - 1] >= Heap::kSmallObjectSize) {
+                CHECK_LE(sizeClasses[i] - sizeClasses[i - 1], (sizeClasses[i - 1] / 8) + Heap::kSizeClassAlignment);
+            }
+        }
+        for (size_t size = 1; size <= Heap::kLargeObjectSize; size += 7) {
+            auto maximumSize = heap->getMaximumSize(size);
+            CHECK_GE(maximumSize, size);
+            auto sizeClass = std::lower_bound(sizeClasses.begin(), sizeClasses.end(), size);
+            CHECK_EQ(maximumSize, *sizeClass);
+        }
+    }
+
+    SUBCASE("size class usage") {
+        auto heap = context()->heap;
+        auto before = heap->sizeClassUsage();
+        REQUIRE_EQ(before.size(), heap->sizeClasses().size());
+
+        // Header plus four slots is 40 bytes, allocated in the 48 byte class.
+        auto array = library::Array::newClear(context(), 4);
+        auto after = heap->sizeClassUsage();
+        size_t sizeClass = 0;
+        while (heap->sizeClasses()[sizeClass] < 40) { ++sizeClass; }
+        CHECK_EQ(after[sizeClass].objectSize, 48);
+        CHECK_EQ(after[sizeClass].totalAllocations, before[sizeClass].totalAllocations + 1);
+        CHECK_EQ(after[sizeClass].totalBytesRequested, before[sizeClass].totalBytesRequested + 40);
+        CHECK_EQ(after[sizeClass].objects, before[sizeClass].objects + 1);
+        CHECK_EQ(after[sizeClass].bytesAllocated, before[sizeClass].bytesAllocated + 48);
+        CHECK_EQ(after[sizeClass].bytesUsed, before[sizeClass].bytesUsed + 40);
+        CHECK_EQ(after[sizeClass].fragmentationBytes(), before[sizeClass].fragmentationBytes() + 8);
+    }
+
+    SUBCASE("stats") {
+        auto heap = context()->heap;
+        auto before = heap->stats();
+        auto root = library::Array::newClear(context(), 3);
+        heap->addToRootSet(root.slot());
+        root.put(0, library::Array::newClear(context(), 10000).slot());
+        auto after = heap->stats();
+        auto arrayBefore = before.classes[library::Array::nameHash()];
+        auto arrayAfter = after.classes[library::Array::nameHash()];
+        CHECK_EQ(arrayAfter.objects, arrayBefore.objects + 2);
+        CHECK_EQ(arrayAfter.bytes, arrayBefore.bytes + heap->getAllocationSize(root.instance()) +
+                heap->getAllocationSize(library::Array(root.at(0)).instance()));
+        CHECK_EQ(after.largeObjectSpace.pages, before.largeObjectSpace.pages + 1);
+        CHECK_GE(after.youngSpace.pages, 1);
+        CHECK_EQ(after.youngSpace.bytesMapped, after.youngSpace.pages * Heap::kPageSize);
+        CHECK_GT(after.peakResidentBytes, 0);
+
+        // Each collection is counted, with its pause time in the histogram.
+        heap->collectYoungGeneration();
+        heap->collectGarbage();
+        auto collected = heap->stats();
+        CHECK_EQ(collected.youngCollections, after.youngCollections + 1);
+        CHECK_EQ(collected.fullCollections, after.fullCollections + 1);
+        size_t pauses = 0;
+        for (auto count : collected.pauseHistogram) {
+            pauses += count;
+        }
+        CHECK_EQ(pauses, collected.youngCollections + collected.fullCollections);
+        CHECK_GE(collected.totalPauseTime, collected.maximumPauseTime);
+
+        heap->removeFromRootSet(root.slot());
+    }
+
+    SUBCASE("large objects") {
+        auto root = library::Array::newClear(context(), 1);
+        context()->heap->addToRootSet(root.slot());
+        auto large = library::Array::newClear(context(), 10000);
+        root.put(0, large.slot());
+        auto young = library::Array::newClear(context(), 1);
+        large.put(9999, young.slot());
+
+        // Large objects are never moved, but the young objects they refer to are.
+        context()->heap->collectYoungGeneration();
+        CHECK_EQ(library::Array(root.at(0)).instance(), large.instance());
+        auto youngCopy = library::Array(large.at(9999));
+        CHECK_NE(youngCopy.instance(), young.instance());
+        CHECK_EQ(youngCopy.size(), 1);
+
+        context()->heap->collectGarbage();
+        CHECK_EQ(context()->heap->lastCollection().objectsReclaimed, 0);
+        auto largeSize = context()->heap->getAllocationSize(large.instance());
+        auto youngSize = context()->heap->getAllocationSize(youngCopy.instance());
+        root.put(0, Slot::makeNil());
+        context()->heap->collectGarbage();
+        CHECK_EQ(context()->heap->lastCollection().objectsReclaimed, 2);
+        CHECK_EQ(context()->heap->lastCollection().bytesReclaimed, youngSize + largeSize);
+
+        context()->heap->removeFromRootSet(root.slot());
+    }
+
+    SUBCASE("collectGarbage") {
+        context()->heap->collectGarbage();
+        size_t baseline = context()->heap->lastCollection().bytesLive;
+
+        auto root = library::Array::newClear(context(), 2);
+        auto child = library::Array::newClear(context(), 3);
+        root.put(0, child.slot());
+        context()->heap->addToRootSet(root.slot());
+        auto rootSize = context()->heap->getAllocationSize(root.instance());
+        auto childSize = context()->heap->getAllocationSize(child.instance());
+
+        for (int32_t i = 0; i < 10; ++i) {
+            library::Array::newClear(context(), 1);
+        }
+
+        context()->heap->collectGarbage();
+        CHECK_EQ(context()->heap->lastCollection().objectsReclaimed, 10);
+        CHECK_EQ(context()->heap->lastCollection().bytesLive, baseline + rootSize + childSize);
+
+        // Reachable objects should survive, and be reclaimed once unreachable.
+        REQUIRE_EQ(library::Array(root.at(0)).size(), 3);
+        root.put(0, Slot::makeNil());
+        context()->heap->collectGarbage();
+        CHECK_EQ(context()->heap->lastCollection().objectsReclaimed, 1);
+        CHECK_EQ(context()->heap->lastCollection().bytesLive, baseline + rootSize);
+
+        context()->heap->removeFromRootSet(root.slot());
+        context()->heap->collectGarbage();
+        CHECK_EQ(context()->heap->lastCollection().objectsReclaimed, 1);
+        CHECK_EQ(context()->heap->lastCollection().bytesLive, baseline);
+    }
+
+    SUBCASE("collectYoungGeneration") {
+        auto root = library::Array::newClear(context(), 1);
+        auto child = library::Array::newClear(context(), 2);
+        child.put(0, Slot::makeInt32(42));
+        root.put(0, child.slot());
+        context()->heap->addToRootSet(root.slot());
+
+        // Root set objects stay in place, but the child should be copied.
+        context()->heap->collectYoungGeneration();
+        auto copy = library::Array(root.at(0));
+        CHECK_NE(copy.instance(), child.instance());
+        REQUIRE_EQ(copy.size(), 2);
+        CHECK_EQ(copy.at(0), Slot::makeInt32(42));
+        CHECK_EQ(context()->heap->lastCollection().objectsPromoted, 0);
+
+        for (int32_t i = 1; i < Heap::kPromotionAge; ++i) {
+            context()->heap->collectYoungGeneration();
+        }
+        CHECK_EQ(context()->heap->lastCollection().objectsPromoted, 1);
+        auto mature = library::Array(root.at(0));
+        CHECK_EQ(mature.at(0), Slot::makeInt32(42));
+
+        // Storing a young pointer into a mature object requires the write barrier.
+        auto young = library::Array::newClear(context(), 1);
+        young.put(0, Slot::makeInt32(-1));
+        mature.put(1, young.slot());
+        *(context()->storeBufferTop++) = reinterpret_cast<library::Schema*>(mature.instance());
+        context()->heap->collectYoungGeneration();
+        CHECK_EQ(library::Array(root.at(0)).instance(), mature.instance());
+        auto youngCopy = library::Array(mature.at(1));
+        CHECK_NE(youngCopy.instance(), young.instance());
+        CHECK_EQ(youngCopy.at(0), Slot::makeInt32(-1));
+
+        context()->heap->removeFromRootSet(root.slot());
+    }
+
+    SUBCASE("growing young arrays across collections") {
+        auto heap = context()->heap;
+        HandleScope scope(context());
+        constexpr int32_t kNumberOfElements = 1000;
+        Handle<library::Array> handle(context(), library::Array::newClear(context(), kNumberOfElements));
+        for (int32_t i = 0; i < kNumberOfElements; ++i) {
+            auto element = library::Array::newClear(context(), 1);
+            element.put(0, Slot::makeInt32(i));
+            auto array = handle.get();
+            array.put(i, element.slot());
+        }
+
+        // Each round only allocates in copy(), reserve() and addAll(), so every young collection happens during one of
+        // them, moving the young array being copied from.
+        auto youngCollections = heap->stats().youngCollections;
+        for (int32_t round = 0; round < 400; ++round) {
+            auto array = handle.get().copy(context());
+            handle.set(array);
+            array.reserve(context(), array.capacity(context()) + 1);
+            handle.set(array);
+            auto sum = library::Array();
+            sum.addAll(context(), handle.get());
+            handle.set(sum);
+        }
+        CHECK_GE(heap->stats().youngCollections, youngCollections + 2);
+
+        auto array = handle.get();
+        REQUIRE_EQ(array.size(), kNumberOfElements);
+        int32_t mistakes = 0;
+        for (int32_t i = 0; i < kNumberOfElements; ++i) {
+            if (library::Array(array.at(i)).at(0) != Slot::makeInt32(i)) { ++mistakes; }
+        }
+        CHECK_EQ(mistakes, 0);
+    }
+
+    SUBCASE("incremental marking") {
+        auto heap = context()->heap;
+        // Mark steps skip young objects, so use a large object as the root to have it scanned incrementally.
+        auto root = library::Array::newClear(context(), Heap::kLargeObjectSize / kSlotSize);
+        heap->addToRootSet(root.slot());
+        root.put(0, library::Array::newClear(context(), 1).slot());
+        for (int32_t i = 0; i < Heap::kPromotionAge; ++i) {
+            heap->collectYoungGeneration();
+        }
+        auto mature = library::Array(root.at(0));
+        heap->collectGarbage();
+
+        // Mark until the mature object has been scanned, without finishing the collection.
+        heap->startIncrementalMarking();
+        CHECK(heap->isMarking());
+        while (!heap->markStep(std::chrono::microseconds(0))) {}
+
+        // A new object stored only into the already black mature object must survive, which requires the barrier.
+        auto young = library::Array::newClear(context(), 1);
+        young.put(0, Slot::makeInt32(7));
+        mature.put(0, young.slot());
+        heap->writeBarrier(reinterpret_cast<library::Schema*>(mature.instance()));
+
+        heap->finishIncrementalMarking();
+        CHECK(!heap->isMarking());
+        CHECK_GE(heap->lastCollection().markSteps, 1);
+        CHECK_EQ(heap->lastCollection().objectsReclaimed, 0);
+        CHECK_EQ(library::Array(mature.at(0)).at(0), Slot::makeInt32(7));
+
+        // Objects unreachable when marking starts are reclaimed.
+        mature.put(0, Slot::makeNil());
+        heap->startIncrementalMarking();
+        while (!heap->markStep(std::chrono::microseconds(0))) {}
+        heap->finishIncrementalMarking();
+        CHECK_EQ(heap->lastCollection().objectsReclaimed, 1);
+
+        heap->removeFromRootSet(root.slot());
+    }
+
+    SUBCASE("parallel collection") {
+        auto heap = context()->heap;
+        heap->collectGarbage();
+        size_t baseline = heap->lastCollection().bytesLive;
+        heap->setHelperThreads(3);
+
+        // A wide tree of arrays, with garbage allocated in between the live objects.
+        auto root = library::Array::newClear(context(), 64);
+        heap->addToRootSet(root.slot());
+        size_t liveBytes = heap->getAllocationSize(root.instance());
+        size_t garbage = 0;
+        for (int32_t i = 0; i < 64; ++i) {
+            auto branch = library::Array::newClear(context(), 64);
+            root.put(i, branch.slot());
+            liveBytes += heap->getAllocationSize(branch.instance());
+            for (int32_t j = 0; j < 64; ++j) {
+                auto leaf = library::Array::newClear(context(), 1);
+                leaf.put(0, Slot::makeInt32((i * 64) + j));
+                branch.put(j, leaf.slot());
+                liveBytes += heap->getAllocationSize(leaf.instance());
+                library::Array::newClear(context(), 2);
+                ++garbage;
+            }
+        }
+
+        heap->collectGarbage();
+        CHECK_EQ(heap->lastCollection().objectsReclaimed, garbage);
+        CHECK_EQ(heap->lastCollection().bytesLive, baseline + liveBytes);
+        int32_t mistakes = 0;
+        for (int32_t i = 0; i < 64; ++i) {
+            auto branch = library::Array(root.at(i));
+            for (int32_t j = 0; j < 64; ++j) {
+                if (library::Array(branch.at(j)).at(0) != Slot::makeInt32((i * 64) + j)) { ++mistakes; }
+            }
+        }
+        CHECK_EQ(mistakes, 0);
+
+        // Dropping half of the branches frees them along with their leaves.
+        for (int32_t i = 0; i < 64; i += 2) {
+            root.put(i, Slot::makeNil());
+        }
+        heap->collectGarbage();
+        CHECK_EQ(heap->lastCollection().objectsReclaimed, 32 * 65);
+
+        heap->removeFromRootSet(root.slot());
+        heap->setHelperThreads(0);
+    }
+
+    SUBCASE("compaction") {
+        auto heap = context()->heap;
+        // Promote enough small arrays to fill several mature Pages.
+        constexpr int32_t kNumberOfLeaves = 32768;
+        auto root = library::Array::newClear(context(), kNumberOfLeaves);
+        heap->addToRootSet(root.slot());
+        for (int32_t i = 0; i < kNumberOfLeaves; ++i) {
+            auto leaf = library::Array::newClear(context(), 3);
+            leaf.put(0, Slot::makeInt32(i));
+            root.put(i, leaf.slot());
+        }
+        for (int32_t i = 0; i < Heap::kPromotionAge; ++i) {
+            heap->collectYoungGeneration();
+        }
+
+        // Dropping three in four leaves frees objects from every Page, but empties none of them.
+        for (int32_t i = 0; i < kNumberOfLeaves; ++i) {
+            if (i % 4) { root.put(i, Slot::makeNil()); }
+        }
+        heap->collectGarbage();
+        CHECK_EQ(heap->lastCollection().pagesReleased, 0);
+        auto fragmented = heap->stats();
+        CHECK_GT(fragmented.matureSpace.fragmentation(), 0.5);
+
+        // Compaction after the next collection packs the survivors into fewer Pages.
+        heap->setCompactionThreshold(0.5);
+        heap->collectGarbage();
+        CHECK_GT(heap->lastCollection().objectsCompacted, 0);
+        CHECK_GE(heap->lastCollection().pagesReleased, 2);
+        auto compacted = heap->stats();
+        CHECK_EQ(compacted.compactions, fragmented.compactions + 1);
+        CHECK_LT(compacted.matureSpace.pages, fragmented.matureSpace.pages);
+        CHECK_LT(compacted.matureSpace.fragmentation(), fragmented.matureSpace.fragmentation());
+
+        // Every pointer to a moved object was updated.
+        int32_t mistakes = 0;
+        for (int32_t i = 0; i < kNumberOfLeaves; i += 4) {
+            if (library::Array(root.at(i)).at(0) != Slot::makeInt32(i)) { ++mistakes; }
+        }
+        CHECK_EQ(mistakes, 0);
+
+        // Below the threshold nothing moves.
+        heap->collectGarbage();
+        CHECK_EQ(heap->lastCollection().objectsCompacted, 0);
+
+        heap->setCompactionThreshold(0.0);
+        heap->removeFromRootSet(root.slot());
+    }
+
+    SUBCASE("pretenuring") {
+        auto heap = context()->heap;
+        heap->collectGarbage();
+        auto before = heap->stats();
+
+        // Objects allocated in the mature and permanent spaces are never copied by the young collector.
+        auto root = library::Array::alloc(context(), 2, Heap::kAllocateMature);
+        root.initToNil();
+        heap->addToRootSet(root.slot());
+        auto permanent = library::Array::alloc(context(), 1, Heap::kAllocatePermanent);
+        permanent.initToNil();
+        root.put(0, permanent.slot());
+        heap->beginPermanentAllocation();
+        auto scoped = library::Array::newClear(context(), 1);
+        heap->endPermanentAllocation();
+        root.put(1, scoped.slot());
+        heap->collectYoungGeneration();
+        CHECK_EQ(library::Array(root.at(0)).instance(), permanent.instance());
+        CHECK_EQ(library::Array(root.at(1)).instance(), scoped.instance());
+        auto allocated = heap->stats();
+        CHECK_EQ(allocated.permanentSpace.bytesAllocated, before.permanentSpace.bytesAllocated +
+                heap->getAllocationSize(permanent.instance()) + heap->getAllocationSize(scoped.instance()));
+
+        // Unreachable permanent objects are still reclaimed by full collections.
+        root.put(1, Slot::makeNil());
+        heap->collectGarbage();
+        CHECK_EQ(heap->stats().permanentSpace.bytesAllocated, before.permanentSpace.bytesAllocated +
+                heap->getAllocationSize(permanent.instance()));
+
+        // A class whose objects all survive to promotion is pretenured.
+        constexpr int32_t kNumberOfArrays = 4096;
+        auto survivors = library::Array::alloc(context(), kNumberOfArrays, Heap::kAllocateMature);
+        survivors.initToNil();
+        heap->addToRootSet(survivors.slot());
+        for (int32_t i = 0; i < kNumberOfArrays; ++i) {
+            survivors.put(i, library::Array::newClear(context(), 1).slot());
+        }
+        heap->writeBarrier(reinterpret_cast<library::Schema*>(survivors.instance()));
+        CHECK_FALSE(heap->isPretenured(library::Array::classIndex()));
+        for (int32_t i = 0; i < Heap::kPromotionAge; ++i) {
+            heap->collectYoungGeneration();
+        }
+        CHECK(heap->isPretenured(library::Array::classIndex()));
+
+        // New objects of the class are allocated mature, so are not copied.
+        auto pretenured = library::Array::newClear(context(), 1);
+        survivors.put(0, pretenured.slot());
+        heap->collectYoungGeneration();
+        CHECK_EQ(library::Array(survivors.at(0)).instance(), pretenured.instance());
+
+        // Full collections forget the decision.
+        heap->collectGarbage();
+        CHECK_FALSE(heap->isPretenured(library::Array::classIndex()));
+
+        heap->removeFromRootSet(survivors.slot());
+        heap->removeFromRootSet(root.slot());
+    }
+
+    SUBCASE("stack segments") {
+        auto heap = context()->heap;
+        constexpr size_t kSegmentsPerPage = Heap::kPageSize / Heap::kLargeObjectSize;
+        std::vector<void*> segments;
+        for (size_t i = 0; i < kSegmentsPerPage; ++i) {
+            segments.emplace_back(heap->allocateStackSegment());
+        }
+        auto counters = heap->stackCounters();
+        CHECK_EQ(counters.pagesMapped, 1);
+
+        // A stack depth hovering around the Page boundary reuses the cached Page.
+        for (size_t i = 0; i < 100; ++i) {
+            CHECK_NE(heap->allocateStackSegment(), nullptr);
+            heap->freeTopStackSegment();
+        }
+        counters = heap->stackCounters();
+        CHECK_EQ(counters.pagesMapped, 2);
+        CHECK_EQ(counters.pagesUnmapped, 0);
+        CHECK_EQ(counters.pagesReused, 99);
+        CHECK_EQ(counters.pagesDiscarded, 0);
+        CHECK_EQ(counters.pagesCached, 1);
+
+        // Segments freed within a Page are handed out again in stack order.
+        heap->freeTopStackSegment();
+        CHECK_EQ(heap->allocateStackSegment(), segments.back());
+
+        // Freeing several Pages worth of segments caches them up to the high watermark.
+        heap->setStackCacheWatermarks(1, 2);
+        for (size_t i = 0; i < 3 * kSegmentsPerPage; ++i) {
+            heap->allocateStackSegment();
+        }
+        for (size_t i = 0; i < 4 * kSegmentsPerPage; ++i) {
+            heap->freeTopStackSegment();
+        }
+        counters = heap->stackCounters();
+        CHECK_EQ(counters.pagesMapped, 4);
+        CHECK_EQ(counters.pagesUnmapped, 2);
+        CHECK_EQ(counters.pagesDiscarded, 3);
+        CHECK_EQ(counters.pagesCached, 2);
+
+        heap->setStackCacheWatermarks(0, 0);
+        CHECK_EQ(heap->stackCounters().pagesUnmapped, 4);
+        CHECK_EQ(heap->stackCounters().pagesCached, 0);
+    }
+
+    SUBCASE("allocation buffers") {
+        auto heap = context()->heap;
+        heap->collectGarbage();
+        // Allocate from the buffer the way compiled code does, refilling the buffer when empty.
+        auto& buffer = context()->allocationBuffers[ThreadContext::allocationBufferIndex(40)];
+        std::vector<library::Schema*> objects;
+        for (size_t i = 0; i < 2 * Heap::kAllocationBufferSize / 48; ++i) {
+            if (buffer.remaining == 0) {
+                REQUIRE(heap->refillAllocationBuffer(40));
+            }
+            CHECK_EQ(buffer.objectSize, 48);
+            --buffer.remaining;
+            auto object = reinterpret_cast<library::Schema*>(buffer.top);
+            buffer.top += buffer.objectSize;
+            object->_classIndex = library::Array::classIndex();
+            object->_sizeInBytes = 40;
+            objects.emplace_back(object);
+        }
+        CHECK_EQ(heap->getAllocationSize(objects.front()), 48);
+
+        // Collection returns the unused part of the buffer before freeing the unreachable objects.
+        heap->collectGarbage();
+        CHECK_EQ(buffer.remaining, 0);
+        CHECK_EQ(buffer.top, nullptr);
+        CHECK_EQ(heap->lastCollection().objectsReclaimed, objects.size());
+        CHECK_EQ(heap->lastCollection().bytesReclaimed, objects.size() * 48);
+    }
+}
+
+} // namespace hadron
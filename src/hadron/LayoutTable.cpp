@@ -0,0 +1,73 @@
+#include "hadron/LayoutTable.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <cassert>
+
+namespace hadron {
+
+LayoutTable::LayoutTable(const library::SchemaLayout* layouts, size_t numberOfLayouts):
+    m_layouts(layouts, layouts + numberOfLayouts),
+    m_numberOfBuiltInLayouts(numberOfLayouts) {
+    assert(numberOfLayouts < (1ull << library::Schema::kClassIndexBits));
+    rebuildIndices();
+}
+
+// static
+LayoutTable& LayoutTable::instance() {
+    static LayoutTable table(schema::kSchemaLayouts, schema::kNumberOfSchemaLayouts);
+    return table;
+}
+
+uint32_t LayoutTable::addLayout(const library::SchemaLayout& layout) {
+    assert(layout.className != kEmpty);
+    assert(m_layouts.size() + 1 < (1ull << library::Schema::kClassIndexBits));
+    auto classIndex = static_cast<uint32_t>(m_layouts.size());
+    m_layouts.emplace_back(layout);
+    if (m_layouts.size() * 2 > m_indices.size()) {
+        rebuildIndices();
+    } else {
+        addIndex(classIndex);
+    }
+    return classIndex;
+}
+
+void LayoutTable::setLayout(uint32_t classIndex, const library::SchemaLayout& layout) {
+    assert(classIndex >= m_numberOfBuiltInLayouts && classIndex < m_layouts.size());
+    assert(layout.className == m_layouts[classIndex].className);
+    m_layouts[classIndex] = layout;
+}
+
+void LayoutTable::removeAddedLayouts() {
+    if (m_layouts.size() == m_numberOfBuiltInLayouts) { return; }
+    m_layouts.resize(m_numberOfBuiltInLayouts);
+    rebuildIndices();
+}
+
+void LayoutTable::addIndex(uint32_t classIndex) {
+    const auto& layout = m_layouts[classIndex];
+    assert(layout.className != kEmpty);
+    // Compressed storage variants share the name of their class, which maps to the index of the uncompressed one.
+    if (layout.indexed == library::SchemaLayout::kIndexedCompressed) { return; }
+    size_t slot = layout.className & m_mask;
+    while (m_indices[slot].className != kEmpty && m_indices[slot].className != layout.className) {
+        slot = (slot + 1) & m_mask;
+    }
+    if (m_indices[slot].className == layout.className) {
+        SPDLOG_WARN("LayoutTable has more than one layout for class {:016x}, using the first.", layout.className);
+        return;
+    }
+    m_indices[slot] = IndexEntry{layout.className, classIndex};
+}
+
+void LayoutTable::rebuildIndices() {
+    size_t capacity = 16;
+    while (capacity < m_layouts.size() * 2) { capacity *= 2; }
+    m_indices.assign(capacity, IndexEntry{kEmpty, kNoClassIndex});
+    m_mask = capacity - 1;
+    for (size_t i = 0; i < m_layouts.size(); ++i) {
+        addIndex(static_cast<uint32_t>(i));
+    }
+}
+
+} // namespace hadron
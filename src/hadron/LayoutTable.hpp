@@ -0,0 +1,90 @@
+#ifndef SRC_HADRON_LAYOUT_TABLE_HPP_
+#define SRC_HADRON_LAYOUT_TABLE_HPP_
+
+#include "hadron/Hash.hpp"
+#include "hadron/library/Schema.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hadron {
+
+namespace schema {
+// Defined in the SchemaLayouts.cpp file that schemac generates alongside the schema headers, with one entry for each
+// non-primitive class it processed, in order of class index.
+extern const library::SchemaLayout kSchemaLayouts[];
+extern const size_t kNumberOfSchemaLayouts;
+} // namespace schema
+
+// Maps the dense class indices in object headers to the names and instance layouts of their classes, so the collector
+// can find the pointers in an object from its header. Layouts are kept in a single array indexed by class index. The
+// reverse mapping from class names is an open addressed hash table, keyed by the class name hashes themselves, which
+// are already well distributed. The classes schemac processed take the first indices, with the layouts it generated. The
+// ClassLibrary adds the rest of the classes after them, as it creates them, see addLayout().
+class LayoutTable {
+public:
+    LayoutTable() = delete;
+    // The layout of class index i is |layouts[i]|.
+    LayoutTable(const library::SchemaLayout* layouts, size_t numberOfLayouts);
+    ~LayoutTable() = default;
+
+    // The table of layouts for the class library, starting with those schemac generated.
+    static LayoutTable& instance();
+
+    // Appends |layout| for a class without one, returning the new class index.
+    uint32_t addLayout(const library::SchemaLayout& layout);
+    // Replaces the layout of |classIndex|, which must have been added by addLayout(), keeping the class name.
+    void setLayout(uint32_t classIndex, const library::SchemaLayout& layout);
+    // Removes every layout added by addLayout(), leaving those the table was built with.
+    void removeAddedLayouts();
+
+    // Returns the layout for |classIndex|, or nullptr if out of range.
+    const library::SchemaLayout* layout(uint32_t classIndex) const {
+        return classIndex < m_layouts.size() ? &m_layouts[classIndex] : nullptr;
+    }
+
+    // Returns the name hash of the class with |classIndex|, or 0 if out of range.
+    Hash className(uint32_t classIndex) const {
+        return classIndex < m_layouts.size() ? m_layouts[classIndex].className : kEmpty;
+    }
+
+    // Returns the index of the class named |className|, or kNoClassIndex if it has none.
+    uint32_t classIndexOf(Hash className) const {
+        for (size_t slot = className & m_mask; m_indices[slot].className != kEmpty; slot = (slot + 1) & m_mask) {
+            if (m_indices[slot].className == className) { return m_indices[slot].classIndex; }
+        }
+        return kNoClassIndex;
+    }
+
+    size_t size() const { return m_layouts.size(); }
+    // The number of layouts the table was built with, which come before any added layouts.
+    size_t numberOfBuiltInLayouts() const { return m_numberOfBuiltInLayouts; }
+
+    static constexpr uint32_t kNoClassIndex = 0xffffffff;
+
+private:
+    // No class name hashes to zero in practice, so it marks unused entries.
+    static constexpr Hash kEmpty = 0;
+
+    // Adds an entry mapping the name of layout |classIndex| to |classIndex|, unless the name already has one.
+    void addIndex(uint32_t classIndex);
+    // Sizes |m_indices| for the current number of layouts and fills it again.
+    void rebuildIndices();
+
+    std::vector<library::SchemaLayout> m_layouts;
+    size_t m_numberOfBuiltInLayouts;
+
+    struct IndexEntry {
+        Hash className;
+        uint32_t classIndex;
+    };
+    // Always at least twice the number of layouts, rounded up to a power of two, so probe sequences stay short and
+    // always end at an empty entry.
+    std::vector<IndexEntry> m_indices;
+    size_t m_mask;
+};
+
+} // namespace hadron
+
+#endif // SRC_HADRON_LAYOUT_TABLE_HPP_
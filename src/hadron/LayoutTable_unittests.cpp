@@ -0,0 +1,101 @@
+#include "hadron/LayoutTable.hpp"
+
+#include "hadron/library/Schema.hpp"
+#include "hadron/schema/Common/Collections/ArrayedCollectionSchema.hpp"
+#include "hadron/schema/Common/Collections/ArraySchema.hpp"
+#include "hadron/schema/Common/Collections/StringSchema.hpp"
+#include "hadron/schema/Common/Core/ObjectSchema.hpp"
+
+#include "doctest/doctest.h"
+
+#include <vector>
+
+namespace hadron {
+
+TEST_CASE("LayoutTable") {
+    SUBCASE("lookup") {
+        // Class names that collide in the table, to exercise probing.
+        std::vector<library::SchemaLayout> layouts = {
+            { 0x101, 0, library::SchemaLayout::kNotIndexed, 0x0 },
+            { 0x201, 2, library::SchemaLayout::kIndexedSlots, 0x3 },
+            { 0x301, 1, library::SchemaLayout::kIndexedBytes, 0x1 },
+            { 0x302, 70, library::SchemaLayout::kNotIndexed, ~0ull },
+        };
+        LayoutTable table(layouts.data(), layouts.size());
+        CHECK_EQ(table.size(), layouts.size());
+        for (uint32_t i = 0; i < layouts.size(); ++i) {
+            auto layout = table.layout(i);
+            REQUIRE(layout);
+            CHECK_EQ(layout->className, layouts[i].className);
+            CHECK_EQ(layout->fixedSlots, layouts[i].fixedSlots);
+            CHECK_EQ(layout->indexed, layouts[i].indexed);
+            CHECK_EQ(layout->pointerMap, layouts[i].pointerMap);
+            CHECK_EQ(table.className(i), layouts[i].className);
+            CHECK_EQ(table.classIndexOf(layouts[i].className), i);
+        }
+        CHECK_EQ(table.layout(layouts.size()), nullptr);
+        CHECK_EQ(table.className(layouts.size()), 0);
+        CHECK_EQ(table.classIndexOf(0x401), LayoutTable::kNoClassIndex);
+        CHECK_EQ(table.classIndexOf(0x303), LayoutTable::kNoClassIndex);
+    }
+
+    SUBCASE("added layouts") {
+        std::vector<library::SchemaLayout> layouts = {
+            { 0x101, 0, library::SchemaLayout::kNotIndexed, 0x0 },
+            { 0x201, 2, library::SchemaLayout::kIndexedSlots, 0x3 },
+        };
+        LayoutTable table(layouts.data(), layouts.size());
+
+        // Enough layouts to grow the index several times.
+        constexpr uint32_t kNumberOfAdded = 100;
+        for (uint32_t i = 0; i < kNumberOfAdded; ++i) {
+            auto classIndex = table.addLayout({ 0x1000 + i, 0, library::SchemaLayout::kNotIndexed, ~0ull });
+            CHECK_EQ(classIndex, layouts.size() + i);
+        }
+        CHECK_EQ(table.size(), layouts.size() + kNumberOfAdded);
+        CHECK_EQ(table.numberOfBuiltInLayouts(), layouts.size());
+        for (uint32_t i = 0; i < kNumberOfAdded; ++i) {
+            CHECK_EQ(table.classIndexOf(0x1000 + i), layouts.size() + i);
+        }
+        CHECK_EQ(table.classIndexOf(0x201), 1);
+
+        table.setLayout(layouts.size(), { 0x1000, 3, library::SchemaLayout::kIndexedSlots, ~0ull });
+        REQUIRE(table.layout(layouts.size()));
+        CHECK_EQ(table.layout(layouts.size())->fixedSlots, 3);
+        CHECK_EQ(table.layout(layouts.size())->indexed, library::SchemaLayout::kIndexedSlots);
+
+        table.removeAddedLayouts();
+        CHECK_EQ(table.size(), layouts.size());
+        CHECK_EQ(table.classIndexOf(0x1000), LayoutTable::kNoClassIndex);
+        CHECK_EQ(table.classIndexOf(0x101), 0);
+        CHECK_EQ(table.addLayout({ 0x2000, 0, library::SchemaLayout::kNotIndexed, ~0ull }), layouts.size());
+    }
+
+    SUBCASE("class library") {
+        const auto& table = LayoutTable::instance();
+        auto object = table.layout(schema::ObjectSchema::kClassIndex);
+        REQUIRE(object);
+        CHECK_EQ(object->className, schema::ObjectSchema::kNameHash);
+        CHECK_EQ(object->fixedSlots, 0);
+        CHECK_EQ(object->indexed, library::SchemaLayout::kNotIndexed);
+        CHECK_EQ(table.classIndexOf(schema::ObjectSchema::kNameHash), schema::ObjectSchema::kClassIndex);
+
+        auto array = table.layout(schema::ArraySchema::kClassIndex);
+        REQUIRE(array);
+        CHECK_EQ(array->className, schema::ArraySchema::kNameHash);
+        CHECK_EQ(array->indexed, library::SchemaLayout::kIndexedSlots);
+
+        // Raw arrays, including the Symbol hashes in SymbolArray, are never scanned for pointers.
+        auto string = table.layout(schema::StringSchema::kClassIndex);
+        REQUIRE(string);
+        CHECK_EQ(string->indexed, library::SchemaLayout::kIndexedBytes);
+        auto int8Array = table.layout(schema::Int8ArraySchema::kClassIndex);
+        REQUIRE(int8Array);
+        CHECK_EQ(int8Array->indexed, library::SchemaLayout::kIndexedBytes);
+        auto symbolArray = table.layout(schema::SymbolArraySchema::kClassIndex);
+        REQUIRE(symbolArray);
+        CHECK_EQ(symbolArray->indexed, library::SchemaLayout::kIndexedBytes);
+    }
+}
+
+} // namespace hadron
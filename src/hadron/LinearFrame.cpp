@@ -1,5 +1,8 @@
 #include "hadron/LinearFrame.hpp"
 
+#include "hadron/lir/LoadConstantLIR.hpp"
+#include "hadron/lir/LoadLiteralLIR.hpp"
+
 #include <cassert>
 
 namespace hadron {
@@ -38,4 +41,21 @@ lir::VReg LinearFrame::append(hir::ID hirId, std::unique_ptr<lir::LIR> lir) {
     return value;
 }
 
+lir::VReg LinearFrame::loadConstant(hir::ID hirId, Slot constant) {
+    if (!constant.isPointer()) { return append(hirId, std::make_unique<lir::LoadConstantLIR>(constant)); }
+
+    int32_t index = 0;
+    while (index < static_cast<int32_t>(literals.size()) && literals[index] != constant) { ++index; }
+    if (index == static_cast<int32_t>(literals.size())) { literals.emplace_back(constant); }
+    return append(hirId, std::make_unique<lir::LoadLiteralLIR>(index, constant.getType()));
+}
+
+int32_t LinearFrame::addCallSite(library::Symbol selector) {
+    // The selector is a Hash, never a pointer, so loadConstant() won't match it with a constant of the code.
+    auto index = static_cast<int32_t>(literals.size());
+    literals.emplace_back(selector.slot());
+    callSites.emplace_back(index);
+    return index;
+}
+
 } // namespace hadron
\ No newline at end of file
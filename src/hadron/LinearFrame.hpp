@@ -2,6 +2,7 @@
 #define SRC_COMPILER_INCLUDE_HADRON_LINEAR_FRAME_HPP_
 
 #include "hadron/hir/HIR.hpp"
+#include "hadron/library/Symbol.hpp"
 #include "hadron/LifetimeInterval.hpp"
 #include "hadron/lir/LIR.hpp"
 
@@ -37,11 +38,25 @@ struct LinearFrame {
 
     std::unordered_map<hir::ID, lir::VReg> hirToRegMap;
 
+    // Heap objects referred to by the code, in the order of their LoadLiteralLIR indices. The Materializer saves these
+    // as the constants Array of the compiled FunctionDef or Method.
+    std::vector<Slot> literals;
+    // Indices in |literals| reserved for the CallSiteCache of each dynamically dispatched send, in the order they are
+    // lowered. Each holds the selector of its send until the Materializer replaces it with a new CallSiteCache.
+    std::vector<int32_t> callSites;
+
     // Convenience function, returns associated VReg in LIR or kInvalidVReg if no hir value found.
     lir::VReg hirToReg(hir::ID hirId);
 
     // If hirId is valid then we add to the mapping. Returns the assigned VReg or kInvalidVReg if no value assigned.
     lir::VReg append(hir::ID hirId, std::unique_ptr<lir::LIR> lir);
+
+    // Appends a load of |constant|. Immediate values are loaded directly, but pointers can move so are loaded from the
+    // literals instead. Returns the assigned VReg.
+    lir::VReg loadConstant(hir::ID hirId, Slot constant);
+
+    // Reserves a literal for the CallSiteCache of a send of |selector|. Returns the index of the literal.
+    int32_t addCallSite(library::Symbol selector);
 };
 
 } // namespace hadron
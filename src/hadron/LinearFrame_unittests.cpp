@@ -0,0 +1,95 @@
+#include "hadron/LinearFrame.hpp"
+
+#include "hadron/ErrorReporter.hpp"
+#include "hadron/hir/DirectCallHIR.hpp"
+#include "hadron/hir/MessageHIR.hpp"
+#include "hadron/library/Array.hpp"
+#include "hadron/library/Symbol.hpp"
+#include "hadron/lir/LoadConstantLIR.hpp"
+#include "hadron/lir/StoreToPointerLIR.hpp"
+#include "hadron/MethodCache.hpp"
+#include "hadron/Runtime.hpp"
+#include "hadron/ThreadContext.hpp"
+
+#include "doctest/doctest.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace hadron {
+
+namespace {
+
+// Returns the values the lowered code stores in ThreadContext::callSiteIndex, in order.
+std::vector<Slot> storedCallSiteIndices(const LinearFrame& linearFrame) {
+    std::vector<Slot> indices;
+    auto offset = static_cast<int32_t>(offsetof(ThreadContext, callSiteIndex) / kSlotSize);
+    for (const auto& lir : linearFrame.instructions) {
+        if (lir->opcode != lir::kStoreToPointer) { continue; }
+        auto store = static_cast<const lir::StoreToPointerLIR*>(lir.get());
+        if (store->pointer != lir::kContextPointerVReg || store->offset != offset) { continue; }
+        const auto& load = *linearFrame.vRegs[store->toStore];
+        REQUIRE_EQ(load->opcode, lir::kLoadConstant);
+        indices.emplace_back(static_cast<const lir::LoadConstantLIR*>(load.get())->constant);
+    }
+    return indices;
+}
+
+} // namespace
+
+TEST_CASE("LinearFrame call sites") {
+    Runtime runtime(std::make_shared<ErrorReporter>());
+    auto context = runtime.context();
+
+    auto selector = library::Symbol::fromView(context, "callSiteTest");
+    auto literal = library::Array::arrayAlloc(context, 1);
+    LinearFrame linearFrame;
+    linearFrame.loadConstant(hir::kInvalidID, literal.slot());
+
+    hir::MessageHIR first;
+    first.selector = selector;
+    first.lower(&linearFrame);
+    hir::MessageHIR second;
+    second.selector = selector;
+    second.lower(&linearFrame);
+    hir::DirectCallHIR direct(second, library::Method());
+    direct.lower(&linearFrame);
+
+    // Each dynamic send reserves a literal of its own after those the code loads, and stores its index for the
+    // dispatcher. The direct call has no cache.
+    REQUIRE_EQ(linearFrame.literals.size(), 3);
+    REQUIRE_EQ(linearFrame.callSites.size(), 2);
+    CHECK_EQ(linearFrame.callSites[0], 1);
+    CHECK_EQ(linearFrame.callSites[1], 2);
+    auto stored = storedCallSiteIndices(linearFrame);
+    REQUIRE_EQ(stored.size(), 3);
+    CHECK_EQ(stored[0], Slot::makeInt32(1));
+    CHECK_EQ(stored[1], Slot::makeInt32(2));
+    CHECK(stored[2].isNil());
+
+    // A later load of the literal still finds it rather than a reserved call site.
+    linearFrame.loadConstant(hir::kInvalidID, literal.slot());
+    CHECK_EQ(linearFrame.literals.size(), 3);
+
+    // The dispatcher finds each cache through the constants the Materializer builds from the literals.
+    context->heap->deferCollection();
+    auto constants = library::Array::arrayAlloc(context, static_cast<int32_t>(linearFrame.literals.size()));
+    for (auto slot : linearFrame.literals) { constants = constants.add(context, slot); }
+    for (auto index : linearFrame.callSites) {
+        auto site = CallSiteCache::alloc(context, library::Symbol(context, constants.at(index)));
+        constants.put(index, site.array().slot());
+    }
+    context->heap->allowCollection();
+
+    auto firstSite = CallSiteCache::fromConstants(constants, stored[0]);
+    REQUIRE_FALSE(firstSite.isNil());
+    CHECK_EQ(firstSite.selector(), selector.hash());
+    CHECK_EQ(firstSite.state(), CallSiteCache::kEmpty);
+    auto secondSite = CallSiteCache::fromConstants(constants, stored[1]);
+    REQUIRE_FALSE(secondSite.isNil());
+    CHECK_NE(firstSite.array().slot(), secondSite.array().slot());
+    CHECK(CallSiteCache::fromConstants(constants, stored[2]).isNil());
+}
+
+} // namespace hadron
@@ -4,25 +4,35 @@
 #include "hadron/BlockSerializer.hpp"
 #include "hadron/Emitter.hpp"
 #include "hadron/Frame.hpp"
+#include "hadron/Heap.hpp"
 #include "hadron/hir/BlockLiteralHIR.hpp"
 #include "hadron/LifetimeAnalyzer.hpp"
 #include "hadron/LinearFrame.hpp"
+#include "hadron/MethodCache.hpp"
 #include "hadron/RegisterAllocator.hpp"
 #include "hadron/Resolver.hpp"
 #include "hadron/ThreadContext.hpp"
 #include "hadron/VirtualJIT.hpp"
 
+#include <cassert>
+
 namespace hadron {
 
 // static
 library::Int8Array Materializer::materialize(ThreadContext* context, Frame* frame) {
+    assert(context->heap->isCollectionDeferred());
+
     // Compile any inner blocks first.
+    if (frame->innerBlocks.size()) {
+        frame->selectors.reserve(context, frame->selectors.size() + static_cast<int32_t>(frame->innerBlocks.size()));
+    }
     for (const auto innerBlock : frame->innerBlocks) {
         auto functionDef = library::FunctionDef::alloc(context);
         auto innerByteCode = Materializer::materialize(context, innerBlock->frame.get());
-        functionDef.setCode(innerByteCode);
-        functionDef.setSelectors(innerBlock->frame->selectors);
-        functionDef.setPrototypeFrame(innerBlock->frame->prototypeFrame);
+        functionDef.setCode(context, innerByteCode);
+        functionDef.setSelectors(context, innerBlock->frame->selectors);
+        functionDef.setConstants(context, innerBlock->frame->constants);
+        functionDef.setPrototypeFrame(context, innerBlock->frame->prototypeFrame);
 
         // TODO: argNames, varNames?
 
@@ -33,6 +43,17 @@ library::Int8Array Materializer::materialize(ThreadContext* context, Frame* fram
     BlockSerializer serializer;
     auto linearFrame = serializer.serialize(frame);
 
+    // Lowering has collected the heap objects the code loads, which must live where the collector can update them,
+    // and reserved a constant for the inline cache of each send, so the cache lives as long as the code does.
+    if (linearFrame->literals.size()) {
+        frame->constants = library::Array::arrayAlloc(context, static_cast<int32_t>(linearFrame->literals.size()));
+        for (auto literal : linearFrame->literals) { frame->constants = frame->constants.add(context, literal); }
+        for (auto index : linearFrame->callSites) {
+            auto selector = library::Symbol(context, frame->constants.at(index));
+            frame->constants.put(index, CallSiteCache::alloc(context, selector).array().slot());
+        }
+    }
+
     LifetimeAnalyzer lifetimeAnalyzer;
     lifetimeAnalyzer.buildLifetimes(linearFrame.get());
 
@@ -11,7 +11,8 @@ struct Frame;
 // Utility class to take a Frame of HIR code and produce an Int8Array of the finalized bytecode.
 class Materializer {
 public:
-    // May recursively materialize subframes first.
+    // May recursively materialize subframes first. |frame| and the code being built hold references to heap objects
+    // the Heap can't see, so collection must be deferred, see Heap::deferCollection().
     static library::Int8Array materialize(ThreadContext* context, Frame* frame);
 };
 
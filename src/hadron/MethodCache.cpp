@@ -0,0 +1,201 @@
+#include "hadron/MethodCache.hpp"
+
+#include "hadron/ClassLibrary.hpp"
+#include "hadron/DispatchTable.hpp"
+#include "hadron/HandleScope.hpp"
+#include "hadron/Heap.hpp"
+#include "hadron/LayoutTable.hpp"
+#include "hadron/SymbolTable.hpp"
+#include "hadron/ThreadContext.hpp"
+
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <cassert>
+#include <string_view>
+
+namespace hadron {
+
+namespace {
+// Floats are the only values without a tag, and no other class key has all of the tag bits set.
+constexpr uint64_t kFloatKey = Slot::kTagMask;
+} // namespace
+
+// static
+CallSiteCache CallSiteCache::alloc(ThreadContext* context, library::Symbol selector) {
+    HandleScope scope(context);
+    Handle<library::Array> array(context, library::Array::newClear(context, kArraySize));
+    array.get().put(kSelectorIndex, selector.slot());
+    // Allocating the class keys may collect, moving the cache Array, so it is only read back through the Handle.
+    auto classKeys = library::Int8Array::arrayAlloc(context, kMaximumEntries * sizeof(uint64_t));
+    classKeys.resize(context, kMaximumEntries * sizeof(uint64_t));
+    array.get().put(kClassKeysIndex, classKeys.slot());
+    context->heap->writeBarrier(reinterpret_cast<library::Schema*>(array.get().instance()));
+    CallSiteCache site(array.get());
+    site.reset(0);
+    return site;
+}
+
+uint64_t CallSiteCache::classKeyAt(int32_t index) const {
+    assert(index < numberOfEntries());
+    return reinterpret_cast<const uint64_t*>(library::Int8Array(m_array.at(kClassKeysIndex)).start())[index];
+}
+
+void CallSiteCache::reset(int32_t epoch) {
+    setState(kEmpty);
+    m_array.put(kNumberOfEntriesIndex, Slot::makeInt32(0));
+    m_array.put(kEpochIndex, Slot::makeInt32(epoch));
+    for (int32_t i = 0; i < kMaximumEntries; ++i) { m_array.put(kMethodsIndex + i, Slot::makeNil()); }
+}
+
+void CallSiteCache::addEntry(ThreadContext* context, uint64_t classKey, library::Method method) {
+    auto index = numberOfEntries();
+    assert(index < kMaximumEntries);
+    reinterpret_cast<uint64_t*>(library::Int8Array(m_array.at(kClassKeysIndex)).start())[index] = classKey;
+    m_array.put(kMethodsIndex + index, method.slot());
+    context->heap->writeBarrier(reinterpret_cast<library::Schema*>(m_array.instance()));
+    m_array.put(kNumberOfEntriesIndex, Slot::makeInt32(index + 1));
+    setState(index == 0 ? kMonomorphic : kPolymorphic);
+}
+
+MethodCache::MethodCache(): m_epoch(0), m_globalCache(kGlobalCacheSize, GlobalEntry{kEmptyKey, 0, library::Method()}) {}
+
+library::Method MethodCache::lookup(ThreadContext* context, CallSiteCache site, Slot receiver) {
+    assert(!site.array().isNil());
+    if (site.epoch() != m_epoch) { site.reset(m_epoch); }
+
+    auto key = classKey(receiver);
+    for (int32_t i = 0; i < site.numberOfEntries(); ++i) {
+        if (site.classKeyAt(i) == key) {
+            ++m_counters.callSiteHits;
+            return site.methodAt(i);
+        }
+    }
+
+    auto method = lookup(context, library::Symbol(context, Slot::makeHash(site.selector())), receiver);
+    // Sends that aren't understood go to the slow path every time, so there's no point caching them.
+    if (method.isNil() || site.state() == CallSiteCache::kMegamorphic) { return method; }
+
+    if (site.numberOfEntries() == CallSiteCache::kMaximumEntries) {
+        // Too many receiver classes to be worth scanning, from now on this site relies on the global cache.
+        site.reset(m_epoch);
+        site.setState(CallSiteCache::kMegamorphic);
+        return method;
+    }
+
+    site.addEntry(context, key, method);
+    return method;
+}
+
+library::Method MethodCache::lookup(ThreadContext* context, library::Symbol selector, Slot receiver) {
+    auto key = classKey(receiver);
+    auto& entry = m_globalCache[globalIndex(key, selector.hash())];
+    if (entry.classKey == key && entry.selector == selector.hash()) {
+        ++m_counters.globalHits;
+        return entry.method;
+    }
+
+    ++m_counters.misses;
+    auto method = findMethod(context, selector, receiver);
+    if (!method.isNil()) {
+        entry = GlobalEntry{key, selector.hash(), method};
+    }
+    return method;
+}
+
+void MethodCache::flush() {
+    ++m_epoch;
+    std::fill(m_globalCache.begin(), m_globalCache.end(), GlobalEntry{kEmptyKey, 0, library::Method()});
+}
+
+// static
+uint64_t MethodCache::classKey(Slot receiver) {
+    if (receiver.isFloat()) { return kFloatKey; }
+    if (receiver.isPointer()) {
+        auto classIndex = receiver.getPointer()->classIndex();
+        return classIndex == schema::ClassSchema::kClassIndex ? receiver.asBits() : classIndex;
+    }
+    if (receiver.isBool()) { return receiver.asBits(); }
+    // Nil is the pointer tag on its own, which can't be confused with a pointer to an object.
+    return receiver.asBits() & Slot::kTagMask;
+}
+
+size_t MethodCache::globalIndex(uint64_t classKey, Hash selector) const {
+    // Fibonacci hashing of the combined key, taking the top bits of the product.
+    uint64_t combined = (classKey ^ selector) * 0x9e3779b97f4a7c15ull;
+    return static_cast<size_t>(combined >> 52) & (kGlobalCacheSize - 1);
+}
+
+library::Method MethodCache::findMethod(ThreadContext* context, library::Symbol selector, Slot receiver) const {
+    auto classDef = classOf(context, receiver);
+    if (classDef.isNil()) { return library::Method(); }
+
+    auto dispatchTable = context->classLibrary->dispatchTable();
+    auto classId = dispatchTable->classId(classDef.name(context));
+    if (classId != DispatchTable::kNoId) { return dispatchTable->lookup(classId, dispatchTable->selectorId(selector)); }
+
+    // Classes added since the dispatch table was built are looked up the slow way.
+    while (!classDef.isNil()) {
+        auto methods = classDef.methods();
+        for (int32_t i = 0; i < methods.size(); ++i) {
+            auto method = methods.typedAt(i);
+            if (method.name(context) == selector) { return method; }
+        }
+        classDef = context->classLibrary->findClassNamed(classDef.superclass(context));
+    }
+    return library::Method();
+}
+
+library::Class MethodCache::classOf(ThreadContext* context, Slot receiver) const {
+    const auto& classLibrary = context->classLibrary;
+    std::string_view className;
+    switch (receiver.getType()) {
+    case TypeFlags::kFloatFlag:
+        className = "Float";
+        break;
+    case TypeFlags::kIntegerFlag:
+        className = "Integer";
+        break;
+    case TypeFlags::kBooleanFlag:
+        className = receiver.getBool() ? "True" : "False";
+        break;
+    case TypeFlags::kNilFlag:
+        className = "Nil";
+        break;
+    case TypeFlags::kSymbolFlag:
+        className = "Symbol";
+        break;
+    case TypeFlags::kCharFlag:
+        className = "Char";
+        break;
+    case TypeFlags::kRawPointerFlag:
+        className = "RawPointer";
+        break;
+    case TypeFlags::kObjectFlag: {
+        auto classIndex = receiver.getPointer()->classIndex();
+        if (classIndex == schema::ClassSchema::kClassIndex) {
+            // A Class responds to the methods of its metaclass, and a metaclass to those of Class.
+            auto classDef = library::Class(receiver);
+            auto name = classDef.name(context).view(context);
+            if (name.substr(0, 5) == "Meta_") {
+                className = "Class";
+                break;
+            }
+            return classLibrary->findClassNamed(library::Symbol::fromView(context, fmt::format("Meta_{}", name)));
+        }
+
+        auto classDef = classLibrary->findClassForIndex(classIndex);
+        if (!classDef.isNil()) { return classDef; }
+        // Variant indices, such as that of CompressedArray, share the class name of the class they are a variant of.
+        auto nameHash = LayoutTable::instance().className(classIndex);
+        if (!context->symbolTable->isDefined(nameHash)) { return library::Class(); }
+        return classLibrary->findClassNamed(library::Symbol(context, Slot::makeHash(nameHash)));
+    }
+    default:
+        return library::Class();
+    }
+
+    return classLibrary->findClassNamed(library::Symbol::fromView(context, className));
+}
+
+} // namespace hadron
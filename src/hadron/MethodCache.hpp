@@ -0,0 +1,136 @@
+#ifndef SRC_HADRON_METHOD_CACHE_HPP_
+#define SRC_HADRON_METHOD_CACHE_HPP_
+
+#include "hadron/Hash.hpp"
+#include "hadron/Slot.hpp"
+#include "hadron/library/Array.hpp"
+#include "hadron/library/Kernel.hpp"
+#include "hadron/library/Symbol.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hadron {
+
+struct ThreadContext;
+
+// The inline cache of a single message send in compiled code, recording the Method each receiver class seen at the send
+// resolved to. Starts empty, becomes monomorphic with the first class, and polymorphic with up to kMaximumEntries
+// classes. A send site that sees more classes than that becomes megamorphic, and looks up through the global cache in
+// MethodCache instead. The cache is an Array on the Heap, kept in the constants of the compiled FunctionDef or Method
+// that makes the send, so it lives exactly as long as that code does and the collector sees the Methods it holds.
+class CallSiteCache {
+public:
+    enum State : int32_t {
+        kEmpty,
+        kMonomorphic,
+        kPolymorphic,
+        kMegamorphic
+    };
+    static constexpr int32_t kMaximumEntries = 4;
+
+    CallSiteCache() = default;
+    explicit CallSiteCache(library::Array array): m_array(array) {}
+    ~CallSiteCache() = default;
+
+    // Allocates a new, empty cache for a send of |selector|.
+    static CallSiteCache alloc(ThreadContext* context, library::Symbol selector);
+    // Returns the cache of the send that raised kDispatch, from the |constants| of the sending code and the
+    // ThreadContext::callSiteIndex it stored. Returns a nil cache for a send without one.
+    static CallSiteCache fromConstants(library::Array constants, Slot callSiteIndex) {
+        if (!callSiteIndex.isInt32()) { return CallSiteCache(); }
+        return CallSiteCache(library::Array(constants.at(callSiteIndex.getInt32())));
+    }
+
+    bool isNil() const { return m_array.isNil(); }
+
+    Hash selector() const { return m_array.at(kSelectorIndex).getHash(); }
+    State state() const { return static_cast<State>(m_array.at(kStateIndex).getInt32()); }
+    int32_t numberOfEntries() const { return m_array.at(kNumberOfEntriesIndex).getInt32(); }
+    uint64_t classKeyAt(int32_t index) const;
+    library::Method methodAt(int32_t index) const { return library::Method(m_array.at(kMethodsIndex + index)); }
+
+    library::Array array() const { return m_array; }
+
+private:
+    friend class MethodCache;
+
+    // Layout of the Array. The class keys aren't Slots, so are kept in an Int8Array of their own.
+    static constexpr int32_t kSelectorIndex = 0;
+    static constexpr int32_t kStateIndex = 1;
+    static constexpr int32_t kNumberOfEntriesIndex = 2;
+    // The MethodCache epoch the entries were added in, entries from before the last flush are stale.
+    static constexpr int32_t kEpochIndex = 3;
+    static constexpr int32_t kClassKeysIndex = 4;
+    static constexpr int32_t kMethodsIndex = 5;
+    static constexpr int32_t kArraySize = kMethodsIndex + kMaximumEntries;
+
+    int32_t epoch() const { return m_array.at(kEpochIndex).getInt32(); }
+    void reset(int32_t epoch);
+    void setState(State state) { m_array.put(kStateIndex, Slot::makeInt32(state)); }
+    void addEntry(ThreadContext* context, uint64_t classKey, library::Method method);
+
+    library::Array m_array;
+};
+
+class MethodCache {
+public:
+    MethodCache();
+    ~MethodCache() = default;
+
+    // Returns the Method that sending the selector of |site| to |receiver| invokes, or nil if the receiver doesn't
+    // understand the selector, updating |site| and the global cache on a miss.
+    library::Method lookup(ThreadContext* context, CallSiteCache site, Slot receiver);
+    // Returns the Method for sending |selector| to |receiver|, from the global cache or by walking the class hierarchy.
+    library::Method lookup(ThreadContext* context, library::Symbol selector, Slot receiver);
+
+    // Empties the global cache, and every CallSiteCache the next time it is looked up through.
+    void flush();
+
+    // Returns the key identifying the class of |receiver| in the caches. Objects are keyed by the class index in their
+    // header, except for Class objects, which share a class index but each have their own metaclass, so are keyed by
+    // their tagged address. The class library is never moved, so the address is stable. Immediate values are keyed by
+    // their tag, except for Booleans, whose true and false values belong to different classes, and Floats, which have
+    // no tag. None of these keys collide, and none equal kEmptyKey.
+    static uint64_t classKey(Slot receiver);
+    static constexpr uint64_t kEmptyKey = ~0ull;
+
+    struct Counters {
+        // Lookups answered by the entries of the send site.
+        size_t callSiteHits = 0;
+        // Lookups answered by the global cache.
+        size_t globalHits = 0;
+        // Lookups that missed both caches.
+        size_t misses = 0;
+    };
+    const Counters& counters() const { return m_counters; }
+
+    // Number of entries in the global cache, a power of two.
+    static constexpr size_t kGlobalCacheSize = 4096;
+
+private:
+    // Returns the global cache entry for |classKey| and |selector|.
+    size_t globalIndex(uint64_t classKey, Hash selector) const;
+    // Finds the Method named |selector| for |receiver| in the dispatch table, or by walking the class hierarchy.
+    library::Method findMethod(ThreadContext* context, library::Symbol selector, Slot receiver) const;
+    // Returns the Class of |receiver|, or nil if it isn't in the class library.
+    library::Class classOf(ThreadContext* context, Slot receiver) const;
+
+    // Incremented by each flush, so CallSiteCaches can tell their entries are stale without the MethodCache tracking
+    // them all.
+    int32_t m_epoch;
+
+    struct GlobalEntry {
+        uint64_t classKey;
+        Hash selector;
+        library::Method method;
+    };
+    std::vector<GlobalEntry> m_globalCache;
+
+    Counters m_counters;
+};
+
+} // namespace hadron
+
+#endif // SRC_HADRON_METHOD_CACHE_HPP_
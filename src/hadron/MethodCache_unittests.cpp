@@ -0,0 +1,127 @@
+#include "hadron/MethodCache.hpp"
+
+#include "hadron/ClassLibrary.hpp"
+#include "hadron/ErrorReporter.hpp"
+#include "hadron/library/Array.hpp"
+#include "hadron/library/Kernel.hpp"
+#include "hadron/library/KernelFixtures_unittests.hpp"
+#include "hadron/library/Symbol.hpp"
+#include "hadron/Runtime.hpp"
+#include "hadron/ThreadContext.hpp"
+
+#include "doctest/doctest.h"
+
+#include <memory>
+
+namespace hadron {
+
+using fixtures::addClass;
+using fixtures::addMethod;
+
+TEST_CASE("MethodCache") {
+    Runtime runtime(std::make_shared<ErrorReporter>());
+    auto context = runtime.context();
+
+    // Object defines both selectors, Array overrides one, and the immediate classes inherit them.
+    auto classArray = library::ClassArray::typedArrayAlloc(context, 1);
+    auto object = addClass(context, classArray, "Object", library::Class());
+    auto objectTest = addMethod(context, object, "cacheTest");
+    addMethod(context, object, "other");
+    auto array = addClass(context, classArray, "Array", object);
+    auto arrayTest = addMethod(context, array, "cacheTest");
+    for (auto name : { "Integer", "Float", "Char", "Nil", "Symbol", "True", "False" }) {
+        addClass(context, classArray, name, object);
+    }
+    auto classClass = addClass(context, classArray, "Class", object);
+    auto metaArray = addClass(context, classArray, "Meta_Array", classClass);
+    auto metaArrayNew = addMethod(context, metaArray, "cacheTest");
+    REQUIRE(context->classLibrary->restoreLibrary(context, classArray, objectTest, library::Array()));
+
+    auto cache = context->classLibrary->methodCache();
+    REQUIRE(cache);
+    auto selector = library::Symbol::fromView(context, "cacheTest");
+    auto arrayInstance = library::Array::arrayAlloc(context, 1).slot();
+
+    SUBCASE("class keys") {
+        CHECK_EQ(MethodCache::classKey(Slot::makeInt32(1)), MethodCache::classKey(Slot::makeInt32(-7)));
+        CHECK_NE(MethodCache::classKey(Slot::makeInt32(1)), MethodCache::classKey(Slot::makeFloat(1.0)));
+        CHECK_NE(MethodCache::classKey(Slot::makeBool(true)), MethodCache::classKey(Slot::makeBool(false)));
+        CHECK_NE(MethodCache::classKey(Slot::makeNil()), MethodCache::classKey(arrayInstance));
+        CHECK_EQ(MethodCache::classKey(arrayInstance),
+                MethodCache::classKey(library::Array::arrayAlloc(context, 4).slot()));
+        // Each Class object has its own metaclass, so has its own key.
+        CHECK_NE(MethodCache::classKey(array.slot()), MethodCache::classKey(object.slot()));
+        CHECK_NE(MethodCache::classKey(Slot::makeFloat(2.0)), MethodCache::kEmptyKey);
+    }
+
+    SUBCASE("monomorphic to megamorphic") {
+        auto site = CallSiteCache::alloc(context, selector);
+        CHECK_EQ(site.state(), CallSiteCache::kEmpty);
+
+        CHECK_EQ(cache->lookup(context, site, arrayInstance).slot(), arrayTest.slot());
+        CHECK_EQ(site.state(), CallSiteCache::kMonomorphic);
+        CHECK_EQ(cache->lookup(context, site, arrayInstance).slot(), arrayTest.slot());
+        CHECK_EQ(cache->counters().callSiteHits, 1);
+        CHECK_EQ(cache->counters().misses, 1);
+
+        // Inherited methods are found through the superclass.
+        CHECK_EQ(cache->lookup(context, site, Slot::makeInt32(3)).slot(), objectTest.slot());
+        CHECK_EQ(site.state(), CallSiteCache::kPolymorphic);
+        CHECK_EQ(cache->lookup(context, site, Slot::makeFloat(1.5)).slot(), objectTest.slot());
+        CHECK_EQ(cache->lookup(context, site, Slot::makeChar('a')).slot(), objectTest.slot());
+        CHECK_EQ(site.numberOfEntries(), CallSiteCache::kMaximumEntries);
+        CHECK_EQ(cache->lookup(context, site, Slot::makeInt32(4)).slot(), objectTest.slot());
+        CHECK_EQ(cache->counters().callSiteHits, 2);
+
+        // A fifth class makes the site megamorphic, after which lookups go through the global cache.
+        CHECK_EQ(cache->lookup(context, site, Slot::makeNil()).slot(), objectTest.slot());
+        CHECK_EQ(site.state(), CallSiteCache::kMegamorphic);
+        CHECK_EQ(site.numberOfEntries(), 0);
+        auto misses = cache->counters().misses;
+        CHECK_EQ(cache->lookup(context, site, Slot::makeInt32(5)).slot(), objectTest.slot());
+        CHECK_EQ(cache->lookup(context, site, Slot::makeNil()).slot(), objectTest.slot());
+        CHECK_EQ(cache->counters().misses, misses);
+        CHECK_EQ(cache->counters().globalHits, 2);
+        CHECK_EQ(site.state(), CallSiteCache::kMegamorphic);
+    }
+
+    SUBCASE("shared global cache") {
+        auto first = CallSiteCache::alloc(context, selector);
+        auto second = CallSiteCache::alloc(context, selector);
+        CHECK_EQ(cache->lookup(context, first, Slot::makeBool(true)).slot(), objectTest.slot());
+        CHECK_EQ(cache->lookup(context, second, Slot::makeBool(true)).slot(), objectTest.slot());
+        CHECK_EQ(cache->counters().misses, 1);
+        CHECK_EQ(cache->counters().globalHits, 1);
+        CHECK_EQ(second.state(), CallSiteCache::kMonomorphic);
+    }
+
+    SUBCASE("class receivers") {
+        auto site = CallSiteCache::alloc(context, selector);
+        CHECK_EQ(cache->lookup(context, site, array.slot()).slot(), metaArrayNew.slot());
+        // Object has no metaclass here, so doesn't understand the selector.
+        CHECK(cache->lookup(context, site, object.slot()).isNil());
+        CHECK_EQ(site.numberOfEntries(), 1);
+    }
+
+    SUBCASE("not understood") {
+        auto site = CallSiteCache::alloc(context, library::Symbol::fromView(context, "missingSelector"));
+        CHECK(cache->lookup(context, site, arrayInstance).isNil());
+        CHECK(cache->lookup(context, site, arrayInstance).isNil());
+        CHECK_EQ(site.state(), CallSiteCache::kEmpty);
+        CHECK_EQ(cache->counters().misses, 2);
+    }
+
+    SUBCASE("flush") {
+        auto site = CallSiteCache::alloc(context, selector);
+        CHECK_EQ(cache->lookup(context, site, arrayInstance).slot(), arrayTest.slot());
+        cache->flush();
+        // The site empties itself on the next lookup, which misses.
+        CHECK_EQ(cache->lookup(context, site, arrayInstance).slot(), arrayTest.slot());
+        CHECK_EQ(cache->counters().misses, 2);
+        CHECK_EQ(cache->counters().callSiteHits, 0);
+        CHECK_EQ(site.state(), CallSiteCache::kMonomorphic);
+        CHECK_EQ(site.numberOfEntries(), 1);
+    }
+}
+
+} // namespace hadron
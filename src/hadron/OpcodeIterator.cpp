@@ -505,12 +505,13 @@ int8_t OpcodeReadIterator::readByte() {
 }
 
 Word OpcodeReadIterator::readWord() {
-    Word word = 0;
+    // Accumulate unsigned, as shifting a signed value right would smear the high bit of each byte over the next.
+    UWord word = 0;
     for (size_t i = 0; i < sizeof(Word); ++i) {
         word = word >> 8;
-        word = word | (static_cast<Word>(readByte()) << (8 * (sizeof(Word) - 1)));
+        word = word | (static_cast<UWord>(static_cast<uint8_t>(readByte())) << (8 * (sizeof(Word) - 1)));
     }
-    return word;
+    return static_cast<Word>(word);
 }
 
 UWord OpcodeReadIterator::readUWord() {
@@ -523,12 +524,12 @@ UWord OpcodeReadIterator::readUWord() {
 }
 
 int OpcodeReadIterator::readInt() {
-    int integer = 0;
+    unsigned int integer = 0;
     for (size_t i = 0; i < sizeof(int); ++i) {
         integer = integer >> 8;
-        integer = integer | (static_cast<int>(readByte()) << (8 * (sizeof(int) - 1)));
+        integer = integer | (static_cast<unsigned int>(static_cast<uint8_t>(readByte())) << (8 * (sizeof(int) - 1)));
     }
-    return integer;
+    return static_cast<int>(integer);
 }
 
 } // namespace hadron
\ No newline at end of file
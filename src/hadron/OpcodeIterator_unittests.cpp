@@ -23,10 +23,11 @@ TEST_CASE("MoveIterator types") {
     }
 
     SUBCASE("words de/serialization") {
-        std::array<int8_t, 32> buffer;
+        std::array<int8_t, 48> buffer;
         OpcodeWriteIterator wIt(buffer.data(), buffer.size());
         REQUIRE(wIt.addi(0, 1, 512));
         REQUIRE(wIt.addi(2, 3, -768));
+        REQUIRE(wIt.addi(4, 5, 0x80));
         OpcodeReadIterator rIt(buffer.data(), buffer.size());
         JIT::Reg target, a;
         Word b;
@@ -38,6 +39,10 @@ TEST_CASE("MoveIterator types") {
         CHECK_EQ(target, 2);
         CHECK_EQ(a, 3);
         CHECK_EQ(b, -768);
+        REQUIRE(rIt.addi(target, a, b));
+        CHECK_EQ(target, 4);
+        CHECK_EQ(a, 5);
+        CHECK_EQ(b, 0x80);
     }
 
     SUBCASE("uwords de/serialization") {
@@ -58,6 +63,7 @@ TEST_CASE("MoveIterator types") {
         OpcodeWriteIterator wIt(buffer.data(), buffer.size());
         REQUIRE(wIt.ldxi_w(JIT::kStackPointerReg, 19, -16));
         REQUIRE(wIt.ldxi_w(4, JIT::kContextPointerReg, 4));
+        REQUIRE(wIt.ldxi_w(5, 6, 128));
         OpcodeReadIterator rIt(buffer.data(), buffer.size());
         JIT::Reg target, address;
         int offset;
@@ -69,6 +75,11 @@ TEST_CASE("MoveIterator types") {
         CHECK_EQ(target, 4);
         CHECK_EQ(address, JIT::kContextPointerReg);
         CHECK_EQ(offset, 4);
+        // Bytes with their high bit set must not sign extend into the bytes above them.
+        REQUIRE(rIt.ldxi_w(target, address, offset));
+        CHECK_EQ(target, 5);
+        CHECK_EQ(address, 6);
+        CHECK_EQ(offset, 128);
     }
 }
 
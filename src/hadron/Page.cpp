@@ -1,10 +1,15 @@
 #include "hadron/Page.hpp"
 
+#include "hadron/PagePool.hpp"
+
 #include "spdlog/spdlog.h"
 
+#include <algorithm>
+#include <cassert>
 #include <errno.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <unistd.h>
 
 namespace hadron {
 
@@ -13,36 +18,82 @@ Page::Page(size_t objectSize, size_t totalSize, bool isExecutable):
     m_objectSize(objectSize),
     m_totalSize(totalSize),
     m_isExecutable(isExecutable),
-    m_nextFreeObject(0),
-    m_allocatedObjects(0) {
-    m_collectionCounts.resize(totalSize / objectSize, 0);
+    m_isPooled(false),
+    m_space(isExecutable ? kExecutableSpace : kYoungSpace),
+    m_numberOfObjects(totalSize / objectSize),
+    m_bumpIndex(0),
+    m_searchWord(0),
+    m_allocatedObjects(0),
+    m_collectionCounts(std::make_unique<std::atomic<uint8_t>[]>(m_numberOfObjects)) {
+    m_allocationBitmap.resize((m_numberOfObjects + kBitsPerWord - 1) / kBitsPerWord, 0);
 }
 
 Page::~Page() {
     unmap();
 }
 
-bool Page::map() {
+bool Page::map(size_t alignment) {
     if (m_startAddress) {
         SPDLOG_WARN("Duplicate calls to Page::map()");
         return true;
     }
 
+    // Pool chunks are aligned to their size, which satisfies any alignment up to the chunk size.
+    if (!m_isExecutable && m_totalSize == PagePool::kChunkSize && alignment <= PagePool::kChunkSize) {
+        m_startAddress = reinterpret_cast<uint8_t*>(PagePool::instance().acquire());
+        if (m_startAddress == nullptr) {
+            SPDLOG_CRITICAL("Page failed to acquire {} bytes from the PagePool", m_totalSize);
+            return false;
+        }
+        m_isPooled = true;
+        return true;
+    }
+
+    // A confined pool must also supply Pages of other sizes, rounded up to whole chunks, so they stay inside the
+    // reservation.
+    if (!m_isExecutable && alignment <= PagePool::kChunkSize && PagePool::instance().isConfined()) {
+        m_startAddress = reinterpret_cast<uint8_t*>(PagePool::instance().acquireRun(pooledRunSize()));
+        if (m_startAddress == nullptr) {
+            SPDLOG_CRITICAL("Page failed to acquire {} bytes from the PagePool", m_totalSize);
+            return false;
+        }
+        m_isPooled = true;
+        return true;
+    }
+
+    // To align the Page we over-allocate by the alignment, then unmap the unaligned excess on either side.
+    size_t mapSize = m_totalSize + alignment;
     void* address = MAP_FAILED;
     if (!m_isExecutable) {
-        address = mmap(nullptr, m_totalSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        address = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
     } else {
-        address = mmap(nullptr, m_totalSize, PROT_EXEC | PROT_READ | PROT_WRITE, MAP_JIT | MAP_PRIVATE | MAP_ANONYMOUS,
+        address = mmap(nullptr, mapSize, PROT_EXEC | PROT_READ | PROT_WRITE, MAP_JIT | MAP_PRIVATE | MAP_ANONYMOUS,
                 -1, 0);
     }
 
     if (address == MAP_FAILED) {
         int mmapError = errno;
-        SPDLOG_CRITICAL("Page mmap failed for {} bytes, errno: {}, string: {}", m_totalSize, mmapError,
+        SPDLOG_CRITICAL("Page mmap failed for {} bytes, errno: {}, string: {}", mapSize, mmapError,
                 strerror(mmapError));
         return false;
     }
 
+    if (alignment) {
+        assert((alignment & (alignment - 1)) == 0);
+        uintptr_t mapStart = reinterpret_cast<uintptr_t>(address);
+        uintptr_t alignedStart = (mapStart + alignment - 1) & ~(alignment - 1);
+        if (alignedStart > mapStart) {
+            munmap(address, alignedStart - mapStart);
+        }
+        // munmap() requires an address aligned to the operating system page size.
+        uintptr_t osPageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        uintptr_t alignedEnd = (alignedStart + m_totalSize + osPageSize - 1) & ~(osPageSize - 1);
+        if (mapStart + mapSize > alignedEnd) {
+            munmap(reinterpret_cast<void*>(alignedEnd), mapStart + mapSize - alignedEnd);
+        }
+        address = reinterpret_cast<void*>(alignedStart);
+    }
+
     m_startAddress = reinterpret_cast<uint8_t*>(address);
     return true;
 }
@@ -52,6 +103,17 @@ bool Page::unmap() {
         return true;
     }
 
+    if (m_isPooled) {
+        if (m_totalSize == PagePool::kChunkSize) {
+            PagePool::instance().release(m_startAddress);
+        } else {
+            PagePool::instance().releaseRun(m_startAddress, pooledRunSize());
+        }
+        m_startAddress = nullptr;
+        m_isPooled = false;
+        return true;
+    }
+
     if (munmap(m_startAddress, m_totalSize) != 0) {
         int munmapError = errno;
         SPDLOG_ERROR("Page munmap failed for with errno: {}, string: {}", munmapError, strerror(munmapError));
@@ -62,41 +124,211 @@ bool Page::unmap() {
     return true;
 }
 
+bool Page::discard() {
+    if (m_startAddress == nullptr) {
+        return false;
+    }
+
+#if defined(MADV_FREE)
+    // Pages are reclaimed lazily, under memory pressure, and keep their contents until then.
+    int advice = MADV_FREE;
+#else
+    int advice = MADV_DONTNEED;
+#endif
+    if (madvise(m_startAddress, m_totalSize, advice) != 0) {
+        int madviseError = errno;
+        SPDLOG_ERROR("Page madvise failed with errno: {}, string: {}", madviseError, strerror(madviseError));
+        return false;
+    }
+
+    return true;
+}
+
 void* Page::allocate() {
-    if (m_allocatedObjects == m_collectionCounts.size()) {
+    if (m_allocatedObjects == m_numberOfObjects) {
         return nullptr;
     }
-    assert(m_collectionCounts[m_nextFreeObject] == 0);
-    void* address = m_startAddress + (m_nextFreeObject * m_objectSize);
-    m_collectionCounts[m_nextFreeObject] = 1;
-    ++m_allocatedObjects;
-    if (m_allocatedObjects < m_collectionCounts.size()) {
-        for (size_t i = 1; i < m_collectionCounts.size(); ++i) {
-            m_nextFreeObject = (m_nextFreeObject + i) % m_collectionCounts.size();
-            if (m_collectionCounts[m_nextFreeObject] == 0) {
+
+    size_t number = 0;
+    if (m_allocatedObjects == m_bumpIndex) {
+        // No free objects below the bump index, so the next object is the first never-allocated one.
+        number = m_bumpIndex;
+        ++m_bumpIndex;
+    } else {
+        // There's at least one free object below the bump index, find the lowest one in the bitmap. Words before
+        // m_searchWord are known to be full.
+        for (; m_searchWord < m_allocationBitmap.size(); ++m_searchWord) {
+            uint64_t freeBits = ~m_allocationBitmap[m_searchWord];
+            if (freeBits) {
+                number = (m_searchWord * kBitsPerWord) + static_cast<size_t>(__builtin_ctzll(freeBits));
                 break;
             }
         }
-    } else {
-        m_nextFreeObject = m_collectionCounts.size();
+        assert(number < m_bumpIndex);
     }
-    return address;
+
+    assert(m_collectionCounts[number].load(std::memory_order_relaxed) == 0);
+    m_allocationBitmap[number / kBitsPerWord] |= (1ull << (number % kBitsPerWord));
+    m_collectionCounts[number].store(1, std::memory_order_relaxed);
+    ++m_allocatedObjects;
+    return m_startAddress + (number * m_objectSize);
 }
 
 size_t Page::capacity() {
-    assert(m_allocatedObjects <= m_collectionCounts.size());
-    return m_collectionCounts.size() - m_allocatedObjects;
+    assert(m_allocatedObjects <= m_numberOfObjects);
+    return m_numberOfObjects - m_allocatedObjects;
+}
+
+void* Page::reserve(size_t maxObjects, size_t& count) {
+    assert(maxObjects > 0);
+    count = std::min(maxObjects, m_numberOfObjects - m_bumpIndex);
+    if (count == 0) {
+        return nullptr;
+    }
+
+    size_t first = m_bumpIndex;
+    for (size_t number = first; number < first + count; ++number) {
+        assert(m_collectionCounts[number].load(std::memory_order_relaxed) == 0);
+        m_allocationBitmap[number / kBitsPerWord] |= (1ull << (number % kBitsPerWord));
+        m_collectionCounts[number].store(1, std::memory_order_relaxed);
+    }
+    m_bumpIndex += count;
+    m_allocatedObjects += count;
+    return m_startAddress + (first * m_objectSize);
+}
+
+void Page::release(void* address, size_t count) {
+    size_t first = objectNumber(address);
+    assert(first + count <= m_bumpIndex);
+    for (size_t number = first; number < first + count; ++number) {
+        assert(m_collectionCounts[number].load(std::memory_order_relaxed) != 0);
+        m_allocationBitmap[number / kBitsPerWord] &= ~(1ull << (number % kBitsPerWord));
+        m_collectionCounts[number].store(0, std::memory_order_relaxed);
+    }
+    assert(count <= m_allocatedObjects);
+    m_allocatedObjects -= count;
+
+    // If nothing was allocated after the run the bump index can reclaim it, otherwise leave the freed objects for the
+    // bitmap search.
+    if (first + count == m_bumpIndex) {
+        m_bumpIndex = first;
+    } else {
+        m_searchWord = std::min(m_searchWord, first / kBitsPerWord);
+    }
 }
 
 void Page::mark(void* address, Color color) {
+    size_t number = objectNumber(address);
+    uint8_t count = m_collectionCounts[number].load(std::memory_order_relaxed);
+    assert(count != 0);
+    // Replace the old color with a single store, so a concurrent shade() of a non-white object never sees the object
+    // as white.
+    m_collectionCounts[number].store((count & 0x3f) | color, std::memory_order_relaxed);
+}
+
+bool Page::shade(void* address) {
+    size_t number = objectNumber(address);
+    uint8_t count = m_collectionCounts[number].load(std::memory_order_relaxed);
+    assert(count != 0);
+    while ((count & 0xc0) == kWhite) {
+        if (m_collectionCounts[number].compare_exchange_weak(count, count | kGray, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Page::Color Page::color(void* address) const {
+    size_t number = objectNumber(address);
+    uint8_t count = m_collectionCounts[number].load(std::memory_order_relaxed);
+    assert(count != 0);
+    return static_cast<Color>(count & 0xc0);
+}
+
+bool Page::isAllocated(const void* address) const {
+    uintptr_t start = reinterpret_cast<uintptr_t>(m_startAddress);
+    uintptr_t addressInt = reinterpret_cast<uintptr_t>(address);
+    if (addressInt < start || addressInt - start >= m_numberOfObjects * m_objectSize) {
+        return false;
+    }
+    if ((addressInt - start) % m_objectSize != 0) {
+        return false;
+    }
+    size_t number = (addressInt - start) / m_objectSize;
+    return (m_allocationBitmap[number / kBitsPerWord] & (1ull << (number % kBitsPerWord))) != 0;
+}
+
+uint8_t Page::collectionCount(const void* address) const {
+    size_t number = objectNumber(address);
+    uint8_t count = m_collectionCounts[number].load(std::memory_order_relaxed);
+    assert(count != 0);
+    return count & 0x3f;
+}
+
+void Page::setCollectionCount(void* address, uint8_t count) {
+    size_t number = objectNumber(address);
+    uint8_t oldCount = m_collectionCounts[number].load(std::memory_order_relaxed);
+    assert(oldCount != 0);
+    assert(count > 0 && count <= 0x3f);
+    m_collectionCounts[number].store((oldCount & 0xc0) | count, std::memory_order_relaxed);
+}
+
+size_t Page::sweep() {
+    size_t freedObjects = 0;
+    // Visit only the allocated objects, a word of the bitmap at a time.
+    for (size_t word = 0; word < m_allocationBitmap.size(); ++word) {
+        uint64_t allocatedBits = m_allocationBitmap[word];
+        while (allocatedBits) {
+            size_t bit = static_cast<size_t>(__builtin_ctzll(allocatedBits));
+            allocatedBits &= allocatedBits - 1;
+            size_t number = (word * kBitsPerWord) + bit;
+            uint8_t count = m_collectionCounts[number].load(std::memory_order_relaxed);
+            assert(count != 0);
+
+            if ((count & 0xc0) == kWhite) {
+                m_allocationBitmap[word] &= ~(1ull << bit);
+                m_collectionCounts[number].store(0, std::memory_order_relaxed);
+                ++freedObjects;
+                continue;
+            }
+
+            // Survivor, bump the collection count (saturating in the lower 6 bits) and reset color to white.
+            count &= 0x3f;
+            if (count < 0x3f) {
+                ++count;
+            }
+            m_collectionCounts[number].store(count, std::memory_order_relaxed);
+        }
+    }
+
+    assert(freedObjects <= m_allocatedObjects);
+    m_allocatedObjects -= freedObjects;
+
+    // Move the bump index down to just past the highest allocated object, and restart the free object search at the
+    // beginning of the Page.
+    m_bumpIndex = 0;
+    for (size_t word = m_allocationBitmap.size(); word > 0; --word) {
+        if (m_allocationBitmap[word - 1]) {
+            m_bumpIndex = ((word - 1) * kBitsPerWord) + kBitsPerWord -
+                    static_cast<size_t>(__builtin_clzll(m_allocationBitmap[word - 1]));
+            break;
+        }
+    }
+    m_searchWord = 0;
+
+    return freedObjects;
+}
+
+size_t Page::objectNumber(const void* address) const {
     uintptr_t start = reinterpret_cast<uintptr_t>(m_startAddress);
     uintptr_t addressInt = reinterpret_cast<uintptr_t>(address);
     assert(start <= addressInt);
     assert(addressInt - start < m_totalSize);
-    size_t objectNumber = (addressInt - start) / m_objectSize;
-    // Strip out old color if any.
-    m_collectionCounts[objectNumber] &= 0x3f;
-    m_collectionCounts[objectNumber] |= color;
+    return (addressInt - start) / m_objectSize;
+}
+
+size_t Page::pooledRunSize() const {
+    return (m_totalSize + PagePool::kChunkSize - 1) & ~(PagePool::kChunkSize - 1);
 }
 
-} // namespace hadron
\ No newline at end of file
+} // namespace hadron
@@ -1,7 +1,10 @@
 #ifndef SRC_COMPILER_INCLUDE_HADRON_PAGE_HPP_
 #define SRC_COMPILER_INCLUDE_HADRON_PAGE_HPP_
 
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 namespace hadron {
@@ -14,8 +17,15 @@ public:
     Page(size_t objectSize, size_t totalSize, bool isExecutable = false);
     ~Page();
 
-    bool map();
+    // Maps the memory for the Page. If |alignment| is nonzero it must be a power of two, and the start address of the
+    // Page will be a multiple of it. Non-executable Pages of PagePool::kChunkSize take their memory from the PagePool,
+    // as do non-executable Pages of any size when the pool is confined to its reservation, and unmapping them returns
+    // the memory to the pool.
+    bool map(size_t alignment = 0);
     bool unmap();
+    // Lets the operating system reclaim the memory of a mapped Page whose contents are no longer needed, while keeping
+    // the mapping. The contents are undefined after this call, but the Page may be written to again right away.
+    bool discard();
 
     // Returns a pointer to available memory for a new object of size |objectSize|, or nullptr if no additional capacity
     // available.
@@ -23,6 +33,13 @@ public:
     // Returns available room in the page *in number of stored objects*
     size_t capacity();
 
+    // Allocates a contiguous run of up to |maxObjects| never-allocated objects from the end of the Page, for use as an
+    // allocation buffer. Returns the address of the first object and sets |count| to the number of objects in the run,
+    // or returns nullptr if there is no room at the end of the Page.
+    void* reserve(size_t maxObjects, size_t& count);
+    // Frees the |count| objects starting at |address|, which must be the unused tail of a run returned by reserve().
+    void release(void* address, size_t count);
+
 
     // Reserve the 2 most significant bits for coloring objects in the m_collectionCounts field.
     enum Color : uint8_t {
@@ -32,12 +49,51 @@ public:
     };
     // Mark the object contained by address.
     void mark(void* address, Color color);
+    // Marks the object at |address| gray if it is white, atomically, so that when marking threads race to shade the
+    // same object exactly one of them gets true back and takes responsibility for scanning it.
+    bool shade(void* address);
+    // Returns the color of the object at |address|, which must be an allocated object in this Page.
+    Color color(void* address) const;
+
+    // Returns true if |address| is the start of an allocated object within this Page.
+    bool isAllocated(const void* address) const;
+
+    // Returns the number of collections the object at |address| has survived, plus one.
+    uint8_t collectionCount(const void* address) const;
+    // Sets the collection count for the object at |address|, for objects copied between Pages.
+    void setCollectionCount(void* address, uint8_t count);
+
+    // Frees every allocated object still colored white, and resets the survivors to white while incrementing their
+    // collection counts. Returns the number of objects freed. Touches only this Page, so different Pages can be swept
+    // concurrently.
+    size_t sweep();
+
+    // The Heap space this Page belongs to, maintained by the Heap.
+    enum Space : uint8_t {
+        kYoungSpace,
+        // Young Pages allocated during a young generation collection, to receive objects evacuated from kYoungSpace.
+        kSurvivorSpace,
+        kMatureSpace,
+        // Mature objects that are never moved, such as the class library.
+        kPermanentSpace,
+        kExecutableSpace,
+        kLargeObjectSpace,
+        kStackSpace
+    };
+    Space space() const { return m_space; }
+    void setSpace(Space space) { m_space = space; }
 
     uint8_t* startAddress() const { return m_startAddress; }
     size_t totalSize() const { return m_totalSize; }
     size_t objectSize() const { return m_objectSize; }
+    size_t allocatedObjects() const { return m_allocatedObjects; }
 
 private:
+    // Returns the index of the object containing |address|.
+    size_t objectNumber(const void* address) const;
+    // Size of the PagePool run backing a Page of other than PagePool::kChunkSize.
+    size_t pooledRunSize() const;
+
     // Mmaped start of the address of this page.
     uint8_t* m_startAddress;
     // Individual size of an object stored in this page, in bytes.
@@ -46,13 +102,23 @@ private:
     size_t m_totalSize;
     // If true the Page needs to be marked for JIT bytecode on mapping.
     bool m_isExecutable;
-    // Index of next free object in Page.
-    size_t m_nextFreeObject;
+    // If true the Page memory is a PagePool chunk.
+    bool m_isPooled;
+    Space m_space;
+    size_t m_numberOfObjects;
+    // Every object at or above this index is free, so allocation can bump the index until there are no free objects
+    // below it.
+    size_t m_bumpIndex;
+    // Index of the first word in m_allocationBitmap that may have a free object, all words before it are full.
+    size_t m_searchWord;
     // Number of allocated objects in Page.
     size_t m_allocatedObjects;
+    // One bit per object, set if the object is allocated.
+    static constexpr size_t kBitsPerWord = 64;
+    std::vector<uint64_t> m_allocationBitmap;
     // Maintains an entry per-object of the collection iterations each object has survived + 1, meaning that if a count
-    // is zero that slot is unallocated.
-    std::vector<uint8_t> m_collectionCounts;
+    // is zero that slot is unallocated. Atomic for parallel marking, otherwise accessed with relaxed ordering.
+    std::unique_ptr<std::atomic<uint8_t>[]> m_collectionCounts;
 };
 
 }
@@ -0,0 +1,251 @@
+#include "hadron/PagePool.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <cassert>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+
+namespace {
+
+// Maps |size| bytes aligned to |alignment| by over-allocating, then unmapping the unaligned excess on either side.
+uint8_t* mapAligned(size_t size, size_t alignment, int flags) {
+    size_t mapSize = size + alignment;
+    void* address = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    if (address == MAP_FAILED) {
+        int mmapError = errno;
+        SPDLOG_ERROR("PagePool mmap failed for {} bytes, errno: {}, string: {}", mapSize, mmapError,
+                strerror(mmapError));
+        return nullptr;
+    }
+
+    uintptr_t mapStart = reinterpret_cast<uintptr_t>(address);
+    uintptr_t alignedStart = (mapStart + alignment - 1) & ~(alignment - 1);
+    if (alignedStart > mapStart) {
+        munmap(address, alignedStart - mapStart);
+    }
+    if (mapStart + mapSize > alignedStart + size) {
+        munmap(reinterpret_cast<void*>(alignedStart + size), mapStart + mapSize - (alignedStart + size));
+    }
+    return reinterpret_cast<uint8_t*>(alignedStart);
+}
+
+} // namespace
+
+namespace hadron {
+
+PagePool::PagePool():
+    m_reservationStart(nullptr),
+    m_reservationEnd(nullptr),
+    m_reservationTop(nullptr),
+    m_isConfined(false),
+    m_residentChunks(kDefaultResidentChunks) {}
+
+PagePool::~PagePool() {
+    // Chunks still in use are leaked, as they may belong to a Heap that outlives the pool.
+    for (auto chunk : m_freeChunks) {
+        if (!isReserved(chunk)) {
+            munmap(chunk, kChunkSize);
+        }
+    }
+    if (m_reservationStart) {
+        munmap(m_reservationStart, m_reservationEnd - m_reservationStart);
+    }
+}
+
+// static
+PagePool& PagePool::instance() {
+    static PagePool pool;
+    return pool;
+}
+
+bool PagePool::reserve(size_t sizeInBytes, HugePages hugePages) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_reservationStart) {
+        SPDLOG_ERROR("PagePool already has a reservation.");
+        return false;
+    }
+
+    size_t size = (sizeInBytes + kHugePageSize - 1) & ~(kHugePageSize - 1);
+    // Reserve without committing swap, memory is committed as each chunk is first touched.
+    int flags = MAP_NORESERVE;
+#if defined(MAP_HUGETLB)
+    if (hugePages == kExplicit) {
+        flags |= MAP_HUGETLB;
+    }
+#else
+    if (hugePages == kExplicit) {
+        SPDLOG_ERROR("PagePool explicit huge pages are not supported on this platform.");
+        return false;
+    }
+#endif
+    // Aligning the reservation to the huge page size lets every huge page in it be backed by a single TLB entry.
+    auto start = mapAligned(size, kHugePageSize, flags);
+    if (start == nullptr) {
+        return false;
+    }
+
+#if defined(MADV_HUGEPAGE)
+    if (hugePages == kTransparent && madvise(start, size, MADV_HUGEPAGE) != 0) {
+        int madviseError = errno;
+        SPDLOG_WARN("PagePool madvise for transparent huge pages failed with errno: {}, string: {}", madviseError,
+                strerror(madviseError));
+    }
+#endif
+
+    m_reservationStart = start;
+    m_reservationEnd = start + size;
+    m_reservationTop = start;
+    m_counters.reservedBytes = size;
+    return true;
+}
+
+void* PagePool::acquire() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_freeChunks.size()) {
+        // The most recently released chunk is the most likely to still be resident.
+        auto chunk = m_freeChunks.back();
+        m_freeChunks.pop_back();
+        ++m_counters.chunksReused;
+        m_counters.freeChunks = m_freeChunks.size();
+        return chunk;
+    }
+
+    if (m_reservationTop < m_reservationEnd) {
+        auto chunk = m_reservationTop;
+        m_reservationTop += kChunkSize;
+        ++m_counters.chunksCarved;
+        return chunk;
+    }
+
+    if (m_isConfined) {
+        SPDLOG_ERROR("PagePool reservation of {} bytes exhausted.", m_counters.reservedBytes);
+        return nullptr;
+    }
+
+    auto chunk = mapAligned(kChunkSize, kChunkSize, 0);
+    if (chunk) {
+        ++m_counters.chunksMapped;
+    }
+    return chunk;
+}
+
+void PagePool::release(void* address) {
+    auto chunk = reinterpret_cast<uint8_t*>(address);
+    assert((reinterpret_cast<uintptr_t>(chunk) & (kChunkSize - 1)) == 0);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    releaseLocked(chunk);
+}
+
+void* PagePool::acquireRun(size_t sizeInBytes) {
+    assert(sizeInBytes > 0 && (sizeInBytes & (kChunkSize - 1)) == 0);
+    size_t numberOfChunks = sizeInBytes / kChunkSize;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto run = takeFreeRun(numberOfChunks);
+    if (run) {
+        m_counters.chunksReused += numberOfChunks;
+        m_counters.freeChunks = m_freeChunks.size();
+        return run;
+    }
+
+    if (static_cast<size_t>(m_reservationEnd - m_reservationTop) >= sizeInBytes) {
+        run = m_reservationTop;
+        m_reservationTop += sizeInBytes;
+        m_counters.chunksCarved += numberOfChunks;
+        return run;
+    }
+
+    if (m_isConfined) {
+        SPDLOG_ERROR("PagePool reservation of {} bytes has no room for a run of {} bytes.", m_counters.reservedBytes,
+                sizeInBytes);
+        return nullptr;
+    }
+
+    run = mapAligned(sizeInBytes, kChunkSize, 0);
+    if (run) {
+        m_counters.chunksMapped += numberOfChunks;
+    }
+    return run;
+}
+
+void PagePool::releaseRun(void* address, size_t sizeInBytes) {
+    assert((sizeInBytes & (kChunkSize - 1)) == 0);
+    auto run = reinterpret_cast<uint8_t*>(address);
+    assert((reinterpret_cast<uintptr_t>(run) & (kChunkSize - 1)) == 0);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t offset = 0; offset < sizeInBytes; offset += kChunkSize) {
+        releaseLocked(run + offset);
+    }
+}
+
+bool PagePool::confineToReservation() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_reservationStart == nullptr) {
+        SPDLOG_ERROR("PagePool has no reservation to confine to.");
+        return false;
+    }
+    m_isConfined = true;
+    return true;
+}
+
+uint8_t* PagePool::takeFreeRun(size_t numberOfChunks) {
+    if (m_freeChunks.size() < numberOfChunks) { return nullptr; }
+
+    // Free chunks are kept in release order, so look for the run in a copy sorted by address.
+    std::vector<uint8_t*> sorted(m_freeChunks);
+    std::sort(sorted.begin(), sorted.end());
+    size_t runStart = 0;
+    for (size_t i = 1; i <= sorted.size(); ++i) {
+        if (i - runStart == numberOfChunks) {
+            uint8_t* start = sorted[runStart];
+            uint8_t* end = start + (numberOfChunks * kChunkSize);
+            m_freeChunks.erase(std::remove_if(m_freeChunks.begin(), m_freeChunks.end(), [start, end](uint8_t* chunk) {
+                return chunk >= start && chunk < end;
+            }), m_freeChunks.end());
+            return start;
+        }
+        if (i < sorted.size() && sorted[i] != sorted[i - 1] + kChunkSize) {
+            runStart = i;
+        }
+    }
+    return nullptr;
+}
+
+void PagePool::releaseLocked(uint8_t* chunk) {
+    if (m_freeChunks.size() >= m_residentChunks) {
+        if (!isReserved(chunk)) {
+            munmap(chunk, kChunkSize);
+            ++m_counters.chunksUnmapped;
+            return;
+        }
+
+#if defined(MADV_FREE)
+        int advice = MADV_FREE;
+#else
+        int advice = MADV_DONTNEED;
+#endif
+        // Chunks released earlier are now the least likely to be reused soon, so give up the memory of the oldest
+        // resident one and keep this one resident in its place.
+        auto discarded = m_residentChunks ? m_freeChunks[m_freeChunks.size() - m_residentChunks] : chunk;
+        if (madvise(discarded, kChunkSize, advice) == 0) {
+            ++m_counters.chunksDiscarded;
+        }
+    }
+
+    m_freeChunks.emplace_back(chunk);
+    m_counters.freeChunks = m_freeChunks.size();
+}
+
+void PagePool::setResidentChunks(size_t count) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_residentChunks = count;
+}
+
+PagePool::Counters PagePool::counters() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_counters;
+}
+
+} // namespace hadron
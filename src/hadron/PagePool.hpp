@@ -0,0 +1,102 @@
+#ifndef SRC_HADRON_PAGE_POOL_HPP_
+#define SRC_HADRON_PAGE_POOL_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace hadron {
+
+// Supplies the memory for Pages in fixed size, aligned chunks, and recycles the chunks of unmapped Pages instead of
+// returning them to the operating system, so that Pages come and go without system calls. Optionally carves the chunks
+// out of a single virtual address range reserved up front, which can be backed by huge pages to reduce TLB pressure.
+// Chunks are mapped individually once any reservation runs out. Shared by every Heap in the process, and thread safe.
+class PagePool {
+public:
+    PagePool();
+    ~PagePool();
+
+    // The process-wide pool, used by Page::map().
+    static PagePool& instance();
+
+    enum HugePages {
+        // Normal operating system pages.
+        kNone,
+        // Transparent huge pages, requested with madvise(MADV_HUGEPAGE). The kernel may ignore the request.
+        kTransparent,
+        // Explicit huge pages with MAP_HUGETLB. Fails unless the system has enough huge pages set aside.
+        kExplicit
+    };
+    // Reserves |sizeInBytes| of address space, rounded up to a multiple of kHugePageSize, to carve chunks out of. The
+    // memory is only committed as it is used. Can only be called once, returns false on failure or if called again.
+    bool reserve(size_t sizeInBytes, HugePages hugePages);
+
+    // Returns the address of a chunk of kChunkSize bytes aligned to kChunkSize, or nullptr if out of memory. The
+    // contents of recycled chunks are undefined.
+    void* acquire();
+    // Returns the chunk at |address| to the pool.
+    void release(void* address);
+
+    // Returns the address of |sizeInBytes|, a multiple of kChunkSize, of contiguous memory aligned to kChunkSize, for
+    // Pages of other sizes. Takes a run of free chunks if there is one, then carves the run from the reservation,
+    // or returns nullptr if out of memory.
+    void* acquireRun(size_t sizeInBytes);
+    // Returns the run of |sizeInBytes| at |address| to the pool, as individual chunks.
+    void releaseRun(void* address, size_t sizeInBytes);
+
+    // Confines the pool to its reservation, so that every chunk and run it hands out is inside the reservation, and
+    // acquire() and acquireRun() return nullptr once it runs out instead of mapping memory elsewhere. Page::map() also
+    // takes non-executable Pages of every size from a confined pool. Heap compressed pointers rely on this to
+    // bound the addresses of every object. Returns false if the pool has no reservation.
+    bool confineToReservation();
+    bool isConfined() const { return m_isConfined; }
+    const uint8_t* reservationStart() const { return m_reservationStart; }
+
+    // The pool keeps the memory of this many of the most recently released chunks resident, and lets the operating
+    // system reclaim the memory of the rest with madvise(). Individually mapped chunks are unmapped instead, once the
+    // pool holds this many free chunks.
+    void setResidentChunks(size_t count);
+
+    struct Counters {
+        size_t reservedBytes = 0;
+        // Chunks carved out of the reservation so far.
+        size_t chunksCarved = 0;
+        size_t chunksMapped = 0;
+        size_t chunksUnmapped = 0;
+        size_t chunksReused = 0;
+        size_t chunksDiscarded = 0;
+        size_t freeChunks = 0;
+    };
+    Counters counters();
+
+    static constexpr size_t kChunkSize = 256 * 1024;
+    static constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+    static constexpr size_t kDefaultResidentChunks = 64;
+
+private:
+    bool isReserved(const uint8_t* address) const {
+        return address >= m_reservationStart && address < m_reservationEnd;
+    }
+    // Removes a run of |numberOfChunks| contiguous chunks from the free chunks and returns its start, or returns nullptr
+    // if there is no such run. Requires |m_mutex|.
+    uint8_t* takeFreeRun(size_t numberOfChunks);
+    // Adds |chunk| to the free chunks, discarding or unmapping memory past the resident chunks. Requires |m_mutex|.
+    void releaseLocked(uint8_t* chunk);
+
+    std::mutex m_mutex;
+    uint8_t* m_reservationStart;
+    uint8_t* m_reservationEnd;
+    // Start of the part of the reservation not yet carved into chunks.
+    uint8_t* m_reservationTop;
+    // Set once at startup, before any Heap exists, so read without locking.
+    bool m_isConfined;
+    // Released chunks, with the most recently released at the back.
+    std::vector<uint8_t*> m_freeChunks;
+    size_t m_residentChunks;
+    Counters m_counters;
+};
+
+} // namespace hadron
+
+#endif // SRC_HADRON_PAGE_POOL_HPP_
@@ -0,0 +1,148 @@
+#include "hadron/PagePool.hpp"
+
+#include "hadron/Heap.hpp"
+#include "hadron/Page.hpp"
+
+#include "doctest/doctest.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace hadron {
+
+namespace {
+bool isAligned(void* address) {
+    return (reinterpret_cast<uintptr_t>(address) & (PagePool::kChunkSize - 1)) == 0;
+}
+} // namespace
+
+TEST_CASE("PagePool") {
+    SUBCASE("recycle") {
+        PagePool pool;
+        auto chunk = pool.acquire();
+        REQUIRE(chunk);
+        CHECK(isAligned(chunk));
+        std::memset(chunk, 0xff, PagePool::kChunkSize);
+        CHECK_EQ(pool.counters().chunksMapped, 1);
+
+        // Released chunks are reused, most recent first, without mapping any more memory.
+        auto second = pool.acquire();
+        pool.release(chunk);
+        pool.release(second);
+        CHECK_EQ(pool.counters().freeChunks, 2);
+        CHECK_EQ(pool.acquire(), second);
+        CHECK_EQ(pool.acquire(), chunk);
+        CHECK_EQ(pool.counters().chunksMapped, 2);
+        CHECK_EQ(pool.counters().chunksReused, 2);
+        pool.release(chunk);
+        pool.release(second);
+    }
+
+    SUBCASE("resident chunks") {
+        PagePool pool;
+        pool.setResidentChunks(1);
+        auto first = pool.acquire();
+        auto second = pool.acquire();
+        pool.release(first);
+        // Individually mapped chunks beyond the resident chunks are unmapped.
+        pool.release(second);
+        auto counters = pool.counters();
+        CHECK_EQ(counters.freeChunks, 1);
+        CHECK_EQ(counters.chunksUnmapped, 1);
+        CHECK_EQ(pool.acquire(), first);
+        pool.release(first);
+    }
+
+    SUBCASE("reservation") {
+        PagePool pool;
+        REQUIRE(pool.reserve(3 * PagePool::kChunkSize, PagePool::kTransparent));
+        CHECK_EQ(pool.counters().reservedBytes, PagePool::kHugePageSize);
+        CHECK_FALSE(pool.reserve(PagePool::kChunkSize, PagePool::kNone));
+
+        // Chunks are carved out of the reservation in address order until it runs out.
+        size_t chunksPerReservation = PagePool::kHugePageSize / PagePool::kChunkSize;
+        std::vector<uint8_t*> chunks;
+        for (size_t i = 0; i < chunksPerReservation; ++i) {
+            chunks.emplace_back(reinterpret_cast<uint8_t*>(pool.acquire()));
+            REQUIRE(chunks.back());
+            CHECK(isAligned(chunks.back()));
+            if (i > 0) {
+                CHECK_EQ(chunks[i], chunks[i - 1] + PagePool::kChunkSize);
+            }
+        }
+        CHECK(isAligned(chunks.front()));
+        CHECK_EQ(pool.counters().chunksCarved, chunksPerReservation);
+        CHECK_EQ(pool.counters().chunksMapped, 0);
+
+        // Then are mapped individually.
+        chunks.emplace_back(reinterpret_cast<uint8_t*>(pool.acquire()));
+        REQUIRE(chunks.back());
+        CHECK_EQ(pool.counters().chunksMapped, 1);
+
+        // Reserved chunks beyond the resident chunks are kept, but their memory discarded.
+        pool.setResidentChunks(1);
+        for (auto chunk : chunks) {
+            pool.release(chunk);
+        }
+        auto counters = pool.counters();
+        CHECK_EQ(counters.freeChunks, chunksPerReservation);
+        CHECK_EQ(counters.chunksUnmapped, 1);
+        CHECK_EQ(counters.chunksDiscarded, chunksPerReservation - 1);
+    }
+
+    SUBCASE("runs") {
+        PagePool pool;
+        REQUIRE(pool.reserve(PagePool::kHugePageSize, PagePool::kNone));
+        auto run = reinterpret_cast<uint8_t*>(pool.acquireRun(3 * PagePool::kChunkSize));
+        REQUIRE(run);
+        CHECK(isAligned(run));
+        CHECK_EQ(pool.counters().chunksCarved, 3);
+        std::memset(run, 0xff, 3 * PagePool::kChunkSize);
+
+        // Released runs become individual chunks, and a contiguous run of free chunks can be taken again.
+        pool.releaseRun(run, 3 * PagePool::kChunkSize);
+        CHECK_EQ(pool.counters().freeChunks, 3);
+        CHECK_EQ(pool.acquireRun(2 * PagePool::kChunkSize), run);
+        CHECK_EQ(pool.counters().freeChunks, 1);
+        CHECK_EQ(pool.acquire(), run + (2 * PagePool::kChunkSize));
+        CHECK_EQ(pool.counters().chunksCarved, 3);
+    }
+
+    SUBCASE("confined") {
+        PagePool pool;
+        CHECK_FALSE(pool.confineToReservation());
+        REQUIRE(pool.reserve(PagePool::kHugePageSize, PagePool::kNone));
+        REQUIRE(pool.confineToReservation());
+        CHECK(pool.isConfined());
+
+        // A confined pool runs out with the reservation, instead of mapping chunks elsewhere.
+        size_t chunksPerReservation = PagePool::kHugePageSize / PagePool::kChunkSize;
+        CHECK_FALSE(pool.acquireRun((chunksPerReservation + 1) * PagePool::kChunkSize));
+        for (size_t i = 0; i < chunksPerReservation; ++i) {
+            auto chunk = reinterpret_cast<uint8_t*>(pool.acquire());
+            REQUIRE(chunk);
+            CHECK(chunk >= pool.reservationStart());
+            CHECK(chunk < pool.reservationStart() + PagePool::kHugePageSize);
+        }
+        CHECK_FALSE(pool.acquire());
+        CHECK_EQ(pool.counters().chunksMapped, 0);
+    }
+
+    SUBCASE("Heap pages") {
+        PagePool::Counters before;
+        {
+            Heap heap;
+            REQUIRE(heap.allocateNew(64));
+            REQUIRE(heap.allocateNew(1024));
+            REQUIRE(heap.allocateStackSegment());
+            // The Pages may have been recycled from the pool, so count from after they were taken.
+            before = PagePool::instance().counters();
+        }
+        // Destroying the Heap returns its young and stack Pages to the pool.
+        auto after = PagePool::instance().counters();
+        CHECK_GE(after.freeChunks + after.chunksUnmapped, before.freeChunks + before.chunksUnmapped + 3);
+    }
+}
+
+} // namespace hadron
@@ -0,0 +1,112 @@
+#include "hadron/Page.hpp"
+
+#include "doctest/doctest.h"
+
+namespace hadron {
+
+TEST_CASE("Page") {
+    SUBCASE("allocate") {
+        Page page(256, 256 * 130);
+        REQUIRE(page.map());
+        REQUIRE_EQ(page.capacity(), 130);
+
+        // Fresh Pages allocate in address order.
+        for (size_t i = 0; i < 130; ++i) {
+            auto address = page.allocate();
+            CHECK_EQ(address, page.startAddress() + (i * 256));
+            CHECK(page.isAllocated(address));
+        }
+        CHECK_EQ(page.capacity(), 0);
+        CHECK_EQ(page.allocate(), nullptr);
+    }
+
+    SUBCASE("sweep") {
+        Page page(256, 256 * 130);
+        REQUIRE(page.map());
+        for (size_t i = 0; i < 130; ++i) {
+            page.allocate();
+        }
+
+        // Keep every object except 3, 70, and 129.
+        for (size_t i = 0; i < 130; ++i) {
+            if (i != 3 && i != 70 && i != 129) {
+                page.mark(page.startAddress() + (i * 256), Page::Color::kBlack);
+            }
+        }
+        CHECK_EQ(page.sweep(), 3);
+        CHECK_EQ(page.capacity(), 3);
+        CHECK(!page.isAllocated(page.startAddress() + (3 * 256)));
+        CHECK(page.isAllocated(page.startAddress() + (4 * 256)));
+        CHECK_EQ(page.collectionCount(page.startAddress()), 2);
+
+        // Freed objects are reused lowest address first.
+        CHECK_EQ(page.allocate(), page.startAddress() + (3 * 256));
+        CHECK_EQ(page.allocate(), page.startAddress() + (70 * 256));
+        CHECK_EQ(page.allocate(), page.startAddress() + (129 * 256));
+        CHECK_EQ(page.allocate(), nullptr);
+
+        // Unmarked objects are all freed.
+        CHECK_EQ(page.sweep(), 130);
+        CHECK_EQ(page.capacity(), 130);
+        CHECK_EQ(page.allocate(), page.startAddress());
+    }
+
+    SUBCASE("reserve") {
+        Page page(256, 256 * 130);
+        REQUIRE(page.map());
+        page.allocate();
+
+        // Runs are reserved from the end of the Page, and may be cut short by the end of the Page.
+        size_t count = 0;
+        CHECK_EQ(page.reserve(100, count), page.startAddress() + 256);
+        CHECK_EQ(count, 100);
+        CHECK(page.isAllocated(page.startAddress() + (100 * 256)));
+        CHECK_EQ(page.reserve(100, count), page.startAddress() + (101 * 256));
+        CHECK_EQ(count, 29);
+        CHECK_EQ(page.reserve(100, count), nullptr);
+        CHECK_EQ(page.capacity(), 0);
+
+        // Releasing the tail of the last run returns it to the end of the Page.
+        page.release(page.startAddress() + (110 * 256), 20);
+        CHECK_EQ(page.capacity(), 20);
+        CHECK(!page.isAllocated(page.startAddress() + (110 * 256)));
+        CHECK_EQ(page.reserve(5, count), page.startAddress() + (110 * 256));
+        CHECK_EQ(count, 5);
+
+        // Releasing an earlier run leaves the objects for allocate() to find.
+        page.release(page.startAddress() + (50 * 256), 51);
+        CHECK_EQ(page.allocate(), page.startAddress() + (50 * 256));
+        CHECK_EQ(page.reserve(100, count), page.startAddress() + (115 * 256));
+        CHECK_EQ(count, 15);
+    }
+
+    SUBCASE("discard") {
+        Page page(256, 256 * 130);
+        CHECK_FALSE(page.discard());
+        REQUIRE(page.map());
+        page.startAddress()[0] = 1;
+        CHECK(page.discard());
+        // The Page stays mapped and writable.
+        page.startAddress()[0] = 2;
+        CHECK_EQ(page.startAddress()[0], 2);
+    }
+
+    SUBCASE("shade") {
+        Page page(256, 256 * 130);
+        REQUIRE(page.map());
+        auto address = page.allocate();
+        page.setCollectionCount(address, 2);
+
+        // Only white objects can be shaded, and shading preserves the collection count.
+        CHECK(page.shade(address));
+        CHECK_EQ(page.color(address), Page::Color::kGray);
+        CHECK_EQ(page.collectionCount(address), 2);
+        CHECK_FALSE(page.shade(address));
+        page.mark(address, Page::Color::kBlack);
+        CHECK_FALSE(page.shade(address));
+        CHECK_EQ(page.color(address), Page::Color::kBlack);
+        CHECK_EQ(page.collectionCount(address), 2);
+    }
+}
+
+} // namespace hadron
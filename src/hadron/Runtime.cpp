@@ -5,7 +5,9 @@
 #include "hadron/ClassLibrary.hpp"
 #include "hadron/ErrorReporter.hpp"
 #include "hadron/Frame.hpp"
+#include "hadron/Hash.hpp"
 #include "hadron/Heap.hpp"
+#include "hadron/HeapImage.hpp"
 #include "hadron/Lexer.hpp"
 #include "hadron/library/Kernel.hpp"
 #include "hadron/library/Thread.hpp"
@@ -32,14 +34,39 @@ Runtime::Runtime(std::shared_ptr<ErrorReporter> errorReporter):
     m_threadContext->heap = m_heap;
     m_threadContext->symbolTable = std::make_unique<SymbolTable>();
     m_threadContext->classLibrary = std::make_unique<ClassLibrary>(m_errorReporter);
+    m_heap->setThreadContext(m_threadContext.get());
 }
 
-Runtime::~Runtime() {}
+Runtime::~Runtime() {
+    m_heap->setThreadContext(nullptr);
+}
 
 bool Runtime::initInterpreter() {
     if (!buildThreadContext()) return false;
     if (!buildTrampolines()) return false;
+    if (!loadClassLibrary()) return false;
+    return true;
+}
+
+bool Runtime::loadClassLibrary() {
+    if (m_heapImagePath.empty()) {
+        return compileClassLibrary();
+    }
+
+    m_threadContext->classLibrary->addClassDirectory(findSCClassLibrary());
+    Hash sourceHash = m_threadContext->classLibrary->sourceHash();
+    if (sourceHash && HeapImage::read(m_threadContext.get(), m_heapImagePath, sourceHash)) {
+        return true;
+    }
+
     if (!compileClassLibrary()) return false;
+
+    // A missing image only costs the next run a compilation, so failing to write one is not an error.
+    if (sourceHash) {
+        m_heap->deferCollection();
+        HeapImage::write(m_threadContext.get(), m_heapImagePath, sourceHash);
+        m_heap->allowCollection();
+    }
     return true;
 }
 
@@ -77,10 +104,15 @@ bool Runtime::buildTrampolines() {
     jit.ldxi_w(JIT::kStackPointerReg, JIT::kContextPointerReg, offsetof(ThreadContext, stackPointer));
     // Remove tag from stack pointer.
     jit.andi(JIT::kStackPointerReg, JIT::kStackPointerReg, ~Slot::kTagMask);
+    // Restore the Hadron frame pointer.
+    jit.ldxi_w(JIT::kFramePointerReg, JIT::kContextPointerReg, offsetof(ThreadContext, framePointer));
     // Jump into the calling code.
     jit.jmpr(JIT::Reg(0));
 
     m_exitTrampoline = jit.addressToFunctionPointer(jit.address());
+    // Save the Hadron frame pointer, so C++ code called from machine code (such as the allocation profiler) can walk
+    // the Frame chain.
+    jit.stxi_w(offsetof(ThreadContext, framePointer), JIT::kContextPointerReg, JIT::kFramePointerReg);
     // Restore the C stack pointer.
     jit.ldxi_w(jit.getCStackPointerRegister(), JIT::kContextPointerReg, offsetof(ThreadContext, cStackPointer));
     jit.leaveABI(align);
@@ -2,6 +2,8 @@
 #define SRC_HADRON_RUNTIME_HPP_
 
 #include <memory>
+#include <string>
+#include <utility>
 
 namespace hadron {
 
@@ -23,16 +25,22 @@ public:
     // Compile (or re-compile) class library.
     bool compileClassLibrary();
 
+    // If set before initInterpreter(), the class library is loaded from the HeapImage at |path| when the image matches
+    // the class library source, and otherwise is compiled and then written out to |path| for the next run.
+    void setHeapImagePath(std::string path) { m_heapImagePath = std::move(path); }
+
     ThreadContext* context() { return m_threadContext.get(); }
 
 private:
     bool buildThreadContext();
     bool buildTrampolines();
+    bool loadClassLibrary();
     void enterMachineCode(const uint8_t* machineCode);
 
     std::shared_ptr<ErrorReporter> m_errorReporter;
     std::shared_ptr<Heap> m_heap;
     std::unique_ptr<ThreadContext> m_threadContext;
+    std::string m_heapImagePath;
 
     // Saves registers, initializes thread context and stack pointer registers, and jumps into the machine code pointer.
     void (*m_entryTrampoline)(ThreadContext* context, const uint8_t* machineCode);
@@ -1,5 +1,8 @@
 #include "hadron/SymbolTable.hpp"
 
+#include "hadron/Heap.hpp"
+#include "hadron/ThreadContext.hpp"
+
 namespace hadron {
 
 void SymbolTable::preloadSymbols(ThreadContext* context) {
@@ -24,7 +27,10 @@ Hash SymbolTable::addSymbol(ThreadContext* context, std::string_view v) {
     Hash h = hash(v);
     auto mapIter = m_symbolMap.find(h);
     if (mapIter == m_symbolMap.end()) {
-        m_symbolMap.emplace(std::make_pair(h, library::String::fromView(context, v)));
+        // Symbols are never freed, so the Strings backing them are permanent members of the root set.
+        auto string = library::String::fromView(context, v);
+        context->heap->addToRootSet(string.slot());
+        m_symbolMap.emplace(std::make_pair(h, string));
     } else {
         // TODO: when this assert fails we have a hash collision and will need to design accordingly.
         assert(mapIter->second.compare(v));
@@ -32,6 +38,18 @@ Hash SymbolTable::addSymbol(ThreadContext* context, std::string_view v) {
     return h;
 }
 
+Hash SymbolTable::addSymbol(ThreadContext* context, library::String string) {
+    Hash h = hash(string.view());
+    auto mapIter = m_symbolMap.find(h);
+    if (mapIter == m_symbolMap.end()) {
+        context->heap->addToRootSet(string.slot());
+        m_symbolMap.emplace(std::make_pair(h, string));
+    } else {
+        assert(mapIter->second.compare(string));
+    }
+    return h;
+}
+
 library::String SymbolTable::getString(library::Symbol s) {
     auto mapIter = m_symbolMap.find(s.hash());
     if (mapIter == m_symbolMap.end()) {
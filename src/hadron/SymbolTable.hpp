@@ -18,6 +18,11 @@ public:
     void preloadSymbols(ThreadContext* context);
 
     Hash addSymbol(ThreadContext* context, std::string_view v);
+    // Adds the existing |string| as a symbol if not already defined, for restoring symbols from a HeapImage.
+    Hash addSymbol(ThreadContext* context, library::String string);
+
+    // All of the Strings backing symbols, keyed by symbol hash.
+    const std::unordered_map<Hash, library::String>& symbols() const { return m_symbolMap; }
 
     // Returns true if the hash exists in the symbolMap.
     bool isDefined(Hash h) const { return m_symbolMap.find(h) != m_symbolMap.end(); }
@@ -7,6 +7,9 @@
 #include <cstdint>
 
 namespace hadron {
+namespace library {
+struct Schema;
+}
 namespace schema {
 struct ProcessSchema;
 struct ThreadSchema;
@@ -35,10 +38,40 @@ struct ThreadContext {
         kAllocateMemory
     };
     InterruptCode interruptCode = InterruptCode::kNormalReturn;
+    // Compiled code stores the index of the CallSiteCache of a send in the constants of the sending FunctionDef or
+    // Method here before raising kDispatch, as an Integer, or nil for a send without a cache.
+    Slot callSiteIndex = Slot::makeNil();
 
     // The stack pointer as preserved on entry into machine code.
     void* cStackPointer = nullptr;
 
+    // Sequential store buffer for the generational write barrier, installed by the Heap. Compiled code appends the
+    // address of each object it stores into at |storeBufferTop|, and the Heap drains the buffer at the next young
+    // generation collection. The buffer is aligned to its size so a full buffer can be detected with a mask. When full
+    // the barrier sets |storeBufferOverflow| to a non-null value and starts over at the beginning of the buffer.
+    library::Schema** storeBuffer = nullptr;
+    library::Schema** storeBufferTop = nullptr;
+    library::Schema** storeBufferOverflow = nullptr;
+
+    // Thread-local allocation buffers, installed by the Heap, so compiled code can allocate small objects without
+    // leaving machine code. Buffer |n| serves allocations of up to (n + 1) * kAllocationBufferGranularity bytes, so
+    // compiled code picks its buffer by a fixed offset. Allocation takes the object at |top|, advances |top| by
+    // |objectSize| and decrements |remaining|. Once |remaining| reaches zero compiled code stores the requested size in
+    // |allocationSize| and raises the kAllocateMemory interrupt, to refill the buffer from the Heap.
+    struct AllocationBuffer {
+        uint8_t* top = nullptr;
+        intptr_t remaining = 0;
+        size_t objectSize = 0;
+    };
+    static constexpr size_t kAllocationBufferGranularity = 16;
+    static constexpr size_t kNumberOfAllocationBuffers = 16;
+    static constexpr size_t kMaximumBufferedSize = kAllocationBufferGranularity * kNumberOfAllocationBuffers;
+    static constexpr size_t allocationBufferIndex(size_t sizeInBytes) {
+        return sizeInBytes ? (sizeInBytes - 1) / kAllocationBufferGranularity : 0;
+    }
+    AllocationBuffer allocationBuffers[kNumberOfAllocationBuffers];
+    size_t allocationSize = 0;
+
     std::shared_ptr<Heap> heap;
     std::unique_ptr<SymbolTable> symbolTable;
     std::unique_ptr<ClassLibrary> classLibrary;
@@ -46,8 +79,8 @@ struct ThreadContext {
     // Objects accessible from the language. To break the cyclical dependency between library objects and ThreadContext,
     // but still keep strongly typed references here, we maintain forward-decleared instance pointers, and then just
     // always wrap them in their corresponding library objects when using them from the C++ side.
-    schema::ProcessSchema* thisProcess;
-    schema::ThreadSchema* thisThread;
+    schema::ProcessSchema* thisProcess = nullptr;
+    schema::ThreadSchema* thisThread = nullptr;
 
     // If true, Hadron will run internal diagnostics during every compilation step.
     bool runInternalDiagnostics = true;
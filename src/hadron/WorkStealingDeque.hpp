@@ -0,0 +1,117 @@
+#ifndef SRC_HADRON_WORK_STEALING_DEQUE_HPP_
+#define SRC_HADRON_WORK_STEALING_DEQUE_HPP_
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace hadron {
+
+// Chase-Lev work-stealing deque, with the memory orderings from Lê et al., "Correct and Efficient Work-Stealing for
+// Weak Memory Models". The owning thread pushes and pops at the bottom end without contention, other threads steal
+// from the top end. |T| must be trivially copyable, as items are copied in and out of atomics.
+template<typename T>
+class WorkStealingDeque {
+public:
+    static_assert(std::is_trivially_copyable<T>::value);
+
+    // |capacity| must be a power of two. The deque grows as needed.
+    explicit WorkStealingDeque(size_t capacity = 1024): m_top(0), m_bottom(0) {
+        assert(capacity && (capacity & (capacity - 1)) == 0);
+        m_arrays.emplace_back(std::make_unique<Array>(capacity));
+        m_array.store(m_arrays.back().get(), std::memory_order_relaxed);
+    }
+    ~WorkStealingDeque() = default;
+
+    // Owner thread only.
+    void push(T item) {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        int64_t top = m_top.load(std::memory_order_acquire);
+        Array* array = m_array.load(std::memory_order_relaxed);
+        if (bottom - top > static_cast<int64_t>(array->mask)) {
+            array = grow(array, top, bottom);
+        }
+        array->put(bottom, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    // Owner thread only. Returns false if the deque is empty.
+    bool pop(T& item) {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        Array* array = m_array.load(std::memory_order_relaxed);
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = m_top.load(std::memory_order_relaxed);
+
+        if (top > bottom) {
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        item = array->get(bottom);
+        if (top == bottom) {
+            // Last item, race any thieves for it.
+            bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                    std::memory_order_relaxed);
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // Any thread. Returns false if the deque is empty or another thread took the top item first.
+    bool steal(T& item) {
+        int64_t top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = m_bottom.load(std::memory_order_acquire);
+        if (top >= bottom) {
+            return false;
+        }
+
+        Array* array = m_array.load(std::memory_order_acquire);
+        item = array->get(top);
+        return m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    // Any thread, but only exact when no other thread is modifying the deque.
+    bool empty() const {
+        return m_top.load(std::memory_order_acquire) >= m_bottom.load(std::memory_order_acquire);
+    }
+
+private:
+    struct Array {
+        explicit Array(size_t capacity): mask(capacity - 1), items(std::make_unique<std::atomic<T>[]>(capacity)) {}
+        T get(int64_t index) const { return items[index & mask].load(std::memory_order_relaxed); }
+        void put(int64_t index, T item) { items[index & mask].store(item, std::memory_order_relaxed); }
+
+        size_t mask;
+        std::unique_ptr<std::atomic<T>[]> items;
+    };
+
+    // Copies the items into an Array of twice the capacity. Thieves may still be reading the old Array, so it is kept
+    // until the deque is destroyed.
+    Array* grow(Array* array, int64_t top, int64_t bottom) {
+        m_arrays.emplace_back(std::make_unique<Array>((array->mask + 1) * 2));
+        Array* newArray = m_arrays.back().get();
+        for (int64_t i = top; i < bottom; ++i) {
+            newArray->put(i, array->get(i));
+        }
+        m_array.store(newArray, std::memory_order_release);
+        return newArray;
+    }
+
+    std::atomic<int64_t> m_top;
+    std::atomic<int64_t> m_bottom;
+    std::atomic<Array*> m_array;
+    // Owned by the owner thread, the last element is the current Array.
+    std::vector<std::unique_ptr<Array>> m_arrays;
+};
+
+} // namespace hadron
+
+#endif // SRC_HADRON_WORK_STEALING_DEQUE_HPP_
@@ -0,0 +1,86 @@
+#include "hadron/WorkStealingDeque.hpp"
+
+#include "doctest/doctest.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace hadron {
+
+TEST_CASE("WorkStealingDeque") {
+    SUBCASE("push and pop") {
+        WorkStealingDeque<int> deque(4);
+        CHECK(deque.empty());
+        int item = 0;
+        CHECK_FALSE(deque.pop(item));
+        CHECK_FALSE(deque.steal(item));
+
+        // Pushing past the initial capacity grows the deque.
+        for (int i = 0; i < 10; ++i) {
+            deque.push(i);
+        }
+        CHECK_FALSE(deque.empty());
+
+        // The owner pops from the bottom, thieves steal from the top.
+        REQUIRE(deque.pop(item));
+        CHECK_EQ(item, 9);
+        REQUIRE(deque.steal(item));
+        CHECK_EQ(item, 0);
+        REQUIRE(deque.steal(item));
+        CHECK_EQ(item, 1);
+        for (int i = 8; i > 1; --i) {
+            REQUIRE(deque.pop(item));
+            CHECK_EQ(item, i);
+        }
+        CHECK(deque.empty());
+        CHECK_FALSE(deque.pop(item));
+    }
+
+    SUBCASE("concurrent steal") {
+        constexpr int kNumberOfItems = 100000;
+        constexpr size_t kNumberOfThieves = 3;
+        WorkStealingDeque<int> deque(16);
+        std::vector<std::atomic<int>> taken(kNumberOfItems);
+        std::atomic<bool> done(false);
+
+        std::vector<std::thread> thieves;
+        for (size_t i = 0; i < kNumberOfThieves; ++i) {
+            thieves.emplace_back([&deque, &taken, &done]() {
+                int item = 0;
+                while (!done.load()) {
+                    if (deque.steal(item)) {
+                        taken[item].fetch_add(1);
+                    }
+                }
+            });
+        }
+
+        // The owner interleaves pushes and pops while the thieves steal.
+        int item = 0;
+        for (int i = 0; i < kNumberOfItems; ++i) {
+            deque.push(i);
+            if ((i % 3) == 0 && deque.pop(item)) {
+                taken[item].fetch_add(1);
+            }
+        }
+        while (deque.pop(item)) {
+            taken[item].fetch_add(1);
+        }
+        done.store(true);
+        for (auto& thief : thieves) {
+            thief.join();
+        }
+
+        // Every item is taken exactly once.
+        int mistakes = 0;
+        for (int i = 0; i < kNumberOfItems; ++i) {
+            if (taken[i].load() != 1) {
+                ++mistakes;
+            }
+        }
+        CHECK_EQ(mistakes, 0);
+    }
+}
+
+} // namespace hadron
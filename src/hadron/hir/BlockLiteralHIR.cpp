@@ -4,10 +4,9 @@
 #include "hadron/Frame.hpp"
 #include "hadron/LinearFrame.hpp"
 #include "hadron/library/Function.hpp"
+#include "hadron/lir/AllocateLIR.hpp"
 #include "hadron/lir/AssignLIR.hpp"
-#include "hadron/lir/InterruptLIR.hpp"
 #include "hadron/lir/LoadConstantLIR.hpp"
-#include "hadron/lir/LoadFromPointerLIR.hpp"
 #include "hadron/lir/StoreToPointerLIR.hpp"
 #include "hadron/Scope.hpp"
 
@@ -32,10 +31,10 @@ void BlockLiteralHIR::lower(LinearFrame* linearFrame) const {
     // Function object. The Materializer should have already compiled the FunctionDef and provided it to the block.
     assert(!functionDef.isNil());
 
-    // Interrupt to allocate memory for the Function object.
-    linearFrame->append(kInvalidID, std::make_unique<lir::InterruptLIR>(ThreadContext::InterruptCode::kAllocateMemory));
-    // TODO: actual useful stack frame offset
-    auto functionVReg = linearFrame->append(id, std::make_unique<lir::LoadFromPointerLIR>(lir::kStackPointerVReg, 0));
+    // Allocate the Function object from the thread-local allocation buffer, which needs a scratch register.
+    auto scratchVReg = linearFrame->append(kInvalidID, std::make_unique<lir::LoadConstantLIR>(Slot::makeNil()));
+    auto functionVReg = linearFrame->append(id, std::make_unique<lir::AllocateLIR>(scratchVReg,
+            sizeof(schema::FunctionSchema), schema::FunctionSchema::kClassIndex));
 
     // Set the Function context to the current context pointer. Make a copy of the current context register.
     auto contextVReg = linearFrame->append(kInvalidID, std::make_unique<lir::AssignLIR>(lir::kContextPointerVReg));
@@ -44,7 +43,7 @@ void BlockLiteralHIR::lower(LinearFrame* linearFrame) const {
             offsetof(schema::FunctionSchema, context)));
 
     // Load the functiondef/method into a register.
-    auto functionDefVReg = linearFrame->append(kInvalidID, std::make_unique<lir::LoadConstantLIR>(functionDef.slot()));
+    auto functionDefVReg = linearFrame->loadConstant(kInvalidID, functionDef.slot());
     linearFrame->append(kInvalidID, std::make_unique<lir::StoreToPointerLIR>(functionVReg, functionDefVReg,
             offsetof(schema::FunctionSchema, def)));
 }
@@ -1,7 +1,6 @@
 #include "hadron/hir/ConstantHIR.hpp"
 
 #include "hadron/LinearFrame.hpp"
-#include "hadron/lir/LoadConstantLIR.hpp"
 
 namespace hadron {
 namespace hir {
@@ -18,7 +17,7 @@ bool ConstantHIR::replaceInput(ID /* original */, ID /* replacement */) {
 }
 
 void ConstantHIR::lower(LinearFrame* linearFrame) const {
-    linearFrame->append(id, std::make_unique<lir::LoadConstantLIR>(constant));
+    linearFrame->loadConstant(id, constant);
 }
 
 } // namespace hir
@@ -0,0 +1,25 @@
+#include "hadron/hir/DirectCallHIR.hpp"
+
+namespace hadron {
+namespace hir {
+
+DirectCallHIR::DirectCallHIR(const MessageHIR& message, library::Method target):
+    MessageHIR(kDirectCall),
+    method(target) {
+    id = message.id;
+    typeFlags = message.typeFlags;
+    reads = message.reads;
+    consumers = message.consumers;
+    owningBlock = message.owningBlock;
+    selector = message.selector;
+    arguments = message.arguments;
+    keywordArguments = message.keywordArguments;
+}
+
+void DirectCallHIR::lower(LinearFrame* linearFrame) const {
+    // The dispatcher calls a Method found in place of the selector without looking it up.
+    lowerDispatch(linearFrame, method.slot(), -1);
+}
+
+} // namespace hir
+} // namespace hadron
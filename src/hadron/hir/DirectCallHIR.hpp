@@ -0,0 +1,25 @@
+#ifndef SRC_HADRON_HIR_DIRECT_CALL_HIR_HPP_
+#define SRC_HADRON_HIR_DIRECT_CALL_HIR_HPP_
+
+#include "hadron/hir/MessageHIR.hpp"
+#include "hadron/library/Kernel.hpp"
+
+namespace hadron {
+namespace hir {
+
+// A message send that class hierarchy analysis proved can only ever invoke |method|, so skips method lookup. Made by
+// ClassHierarchyAnalysis in place of the MessageHIR it replaces, taking over its value and arguments.
+struct DirectCallHIR : public MessageHIR {
+    DirectCallHIR() = delete;
+    DirectCallHIR(const MessageHIR& message, library::Method target);
+    virtual ~DirectCallHIR() = default;
+
+    library::Method method;
+
+    void lower(LinearFrame* linearFrame) const override;
+};
+
+} // namespace hir
+} // namespace hadron
+
+#endif // SRC_HADRON_HIR_DIRECT_CALL_HIR_HPP_
@@ -26,6 +26,7 @@ enum Opcode {
     kBranch,
     kBranchIfTrue,
     kConstant,
+    kDirectCall,
     kLoadOuterFrame,
     kMessage,
     kMethodReturn,
@@ -5,12 +5,17 @@
 #include "hadron/lir/LoadConstantLIR.hpp"
 #include "hadron/lir/LoadFromPointerLIR.hpp"
 #include "hadron/lir/StoreToPointerLIR.hpp"
+#include "hadron/ThreadContext.hpp"
+
+#include <cstddef>
 
 namespace hadron {
 namespace hir {
 
 MessageHIR::MessageHIR(): HIR(kMessage, TypeFlags::kAllFlags) {}
 
+MessageHIR::MessageHIR(Opcode op): HIR(op, TypeFlags::kAllFlags) {}
+
 void MessageHIR::addArgument(ID id) {
     reads.emplace(id);
     arguments.emplace_back(id);
@@ -45,8 +50,12 @@ bool MessageHIR::replaceInput(ID original, ID replacement) {
 }
 
 void MessageHIR::lower(LinearFrame* linearFrame) const {
-    auto selectorVReg = linearFrame->append(hir::kInvalidID, std::make_unique<lir::LoadConstantLIR>(selector.slot()));
-    linearFrame->append(hir::kInvalidID, std::make_unique<lir::StoreToPointerLIR>(lir::kStackPointerVReg, selectorVReg,
+    lowerDispatch(linearFrame, selector.slot(), linearFrame->addCallSite(selector));
+}
+
+void MessageHIR::lowerDispatch(LinearFrame* linearFrame, Slot target, int32_t callSiteIndex) const {
+    auto targetVReg = linearFrame->loadConstant(hir::kInvalidID, target);
+    linearFrame->append(hir::kInvalidID, std::make_unique<lir::StoreToPointerLIR>(lir::kStackPointerVReg, targetVReg,
             0)); // TODO - Stack Structure?
 
     auto numberOfArgsVReg = linearFrame->append(hir::kInvalidID, std::make_unique<lir::LoadConstantLIR>(
@@ -74,6 +83,11 @@ void MessageHIR::lower(LinearFrame* linearFrame) const {
         ++index;
     }
 
+    auto callSiteVReg = linearFrame->append(hir::kInvalidID, std::make_unique<lir::LoadConstantLIR>(
+            callSiteIndex >= 0 ? Slot::makeInt32(callSiteIndex) : Slot::makeNil()));
+    linearFrame->append(hir::kInvalidID, std::make_unique<lir::StoreToPointerLIR>(lir::kContextPointerVReg,
+            callSiteVReg, static_cast<int32_t>(offsetof(ThreadContext, callSiteIndex) / kSlotSize)));
+
     linearFrame->append(hir::kInvalidID, std::make_unique<lir::InterruptLIR>(ThreadContext::InterruptCode::kDispatch));
 
     // Load return value.
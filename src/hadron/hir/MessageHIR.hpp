@@ -26,6 +26,14 @@ struct MessageHIR : public HIR {
     ID proposeValue(ID proposedId) override;
     bool replaceInput(ID original, ID replacement) override;
     void lower(LinearFrame* linearFrame) const override;
+
+protected:
+    explicit MessageHIR(Opcode op);
+
+    // Stores |target| and the arguments on the stack for the dispatcher and raises the kDispatch interrupt. |target| is
+    // the selector for a dynamic send, or the Method to call for a direct call. |callSiteIndex| is the index of the
+    // CallSiteCache of a dynamic send in the literals, or -1 for a send without one.
+    void lowerDispatch(LinearFrame* linearFrame, Slot target, int32_t callSiteIndex) const;
 };
 
 } // namespace hir
@@ -2,6 +2,7 @@
 
 #include "hadron/LinearFrame.hpp"
 #include "hadron/lir/StoreToPointerLIR.hpp"
+#include "hadron/lir/WriteBarrierLIR.hpp"
 
 namespace hadron {
 namespace hir {
@@ -34,6 +35,7 @@ void WriteToClassHIR::lower(LinearFrame* linearFrame) const {
     auto classVarVReg = linearFrame->hirToReg(classVariableArray);
     auto toWriteVReg = linearFrame->hirToReg(toWrite);
     linearFrame->append(kInvalidID, std::make_unique<lir::StoreToPointerLIR>(classVarVReg, toWriteVReg, arrayIndex));
+    linearFrame->append(kInvalidID, std::make_unique<lir::WriteBarrierLIR>(classVarVReg));
 }
 
 } // namespace hir
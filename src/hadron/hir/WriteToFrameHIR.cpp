@@ -2,6 +2,7 @@
 
 #include "hadron/LinearFrame.hpp"
 #include "hadron/lir/StoreToPointerLIR.hpp"
+#include "hadron/lir/WriteBarrierLIR.hpp"
 
 namespace hadron {
 namespace hir {
@@ -48,6 +49,8 @@ void WriteToFrameHIR::lower(LinearFrame* linearFrame) const {
 
     auto frameIdVReg = linearFrame->hirToReg(frameId);
     linearFrame->append(kInvalidID, std::make_unique<lir::StoreToPointerLIR>(frameIdVReg, toWriteVReg, frameIndex));
+    // Outer frames can outlive the stack, so writes into them need a write barrier.
+    linearFrame->append(kInvalidID, std::make_unique<lir::WriteBarrierLIR>(frameIdVReg));
 }
 
 } // namespace hir
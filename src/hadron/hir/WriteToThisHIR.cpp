@@ -2,6 +2,7 @@
 
 #include "hadron/LinearFrame.hpp"
 #include "hadron/lir/StoreToPointerLIR.hpp"
+#include "hadron/lir/WriteBarrierLIR.hpp"
 
 namespace hadron {
 namespace hir {
@@ -38,6 +39,7 @@ void WriteToThisHIR::lower(LinearFrame* linearFrame) const {
     auto thisVReg = linearFrame->hirToReg(thisId);
     auto toStoreVReg = linearFrame->hirToReg(toWrite);
     linearFrame->append(kInvalidID, std::make_unique<lir::StoreToPointerLIR>(thisVReg, toStoreVReg, index));
+    linearFrame->append(kInvalidID, std::make_unique<lir::WriteBarrierLIR>(thisVReg));
 }
 
 } // namespace hir
@@ -1,11 +1,14 @@
 #ifndef SRC_HADRON_LIBRARY_ARRAY_HPP_
 #define SRC_HADRON_LIBRARY_ARRAY_HPP_
 
+#include "hadron/CompressedSlot.hpp"
 #include "hadron/Slot.hpp"
 
 #include "hadron/library/ArrayedCollection.hpp"
 #include "hadron/schema/Common/Collections/ArraySchema.hpp"
 
+#include <cstring>
+
 namespace hadron {
 namespace library {
 
@@ -53,6 +56,67 @@ public:
     }
 };
 
+} // namespace library
+
+namespace schema {
+// The compressed storage variant of Array, with CompressedSlot elements. Instances are of class Array, but have a class
+// index of their own, whose layout tells the collector to decompress the elements.
+struct CompressedArraySchema {
+    static constexpr Hash kNameHash = ArraySchema::kNameHash;
+    static constexpr Hash kMetaNameHash = ArraySchema::kMetaNameHash;
+    static constexpr uint32_t kClassIndex = ArraySchema::kCompressedClassIndex;
+
+    library::Schema schema;
+};
+} // namespace schema
+
+namespace library {
+
+// An array of objects of type T, or nil, in half the memory of a TypedArray, for large collections of objects that C++
+// code traverses. Requires Heap::enableCompressedPointers(). The elements are CompressedSlots, which at() and put()
+// decompress and compress, so they can't hold numbers or other immediate values, or compiled code. Compiled code
+// expects the elements of an Array to be Slots, so these must not be reachable from the language.
+template<typename T>
+class CompressedArray : public ArrayedCollection<CompressedArray<T>, schema::CompressedArraySchema, CompressedSlot> {
+public:
+    CompressedArray(): ArrayedCollection<CompressedArray<T>, schema::CompressedArraySchema, CompressedSlot>() {}
+    explicit CompressedArray(schema::CompressedArraySchema* instance):
+        ArrayedCollection<CompressedArray<T>, schema::CompressedArraySchema, CompressedSlot>(instance) {}
+    explicit CompressedArray(Slot instance):
+        ArrayedCollection<CompressedArray<T>, schema::CompressedArraySchema, CompressedSlot>(instance) {}
+    ~CompressedArray() {}
+
+    // Makes a new array of size |indexedSize| with each element set to nil.
+    static CompressedArray<T> newClear(ThreadContext* context, int32_t indexedSize) {
+        auto array = CompressedArray<T>::arrayAlloc(context, indexedSize);
+        array.resize(context, indexedSize);
+        std::memset(array.start(), 0, indexedSize * sizeof(CompressedSlot));
+        return array;
+    }
+
+    Slot at(int32_t index) const {
+        return ArrayedCollection<CompressedArray<T>, schema::CompressedArraySchema, CompressedSlot>::at(index)
+                .decompress();
+    }
+    T typedAt(int32_t index) const { return T(at(index)); }
+
+    // Has no write barrier, as with Array::put().
+    void put(int32_t index, Slot value) {
+        ArrayedCollection<CompressedArray<T>, schema::CompressedArraySchema, CompressedSlot>::put(index,
+                CompressedSlot::compress(value));
+    }
+    void typedPut(int32_t index, T element) { put(index, element.slot()); }
+
+    CompressedArray<T>& typedAdd(ThreadContext* context, T element) {
+        this->add(context, CompressedSlot::compress(element.slot()));
+        return *this;
+    }
+
+    Slot typedIndexOf(T item) const {
+        return this->indexOf(CompressedSlot::compress(item.slot()));
+    }
+};
+
 } // namespace library
 } // namespace hadron
 
@@ -1,6 +1,8 @@
 #ifndef SRC_HADRON_LIBRARY_ARRAYED_COLLECTION_HPP_
 #define SRC_HADRON_LIBRARY_ARRAYED_COLLECTION_HPP_
 
+#include "hadron/CompressedSlot.hpp"
+#include "hadron/HandleScope.hpp"
 #include "hadron/Hash.hpp"
 #include "hadron/Heap.hpp"
 #include "hadron/ThreadContext.hpp"
@@ -9,6 +11,10 @@
 #include "hadron/library/Symbol.hpp"
 #include "hadron/schema/Common/Collections/ArrayedCollectionSchema.hpp"
 
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+
 namespace hadron {
 namespace library {
 
@@ -20,9 +26,11 @@ public:
     explicit ArrayedCollection(Slot instance): SequenceableCollection<T, S>(instance) {}
     ~ArrayedCollection() {}
 
-    static T arrayAlloc(ThreadContext* context, int32_t maxSize) {
-        S* instance = arrayAllocRaw(context, maxSize);
-        instance->schema._className = S::kNameHash;
+    // Allocates an empty array with room for |maxSize| elements. See Heap::AllocationSpace for the choice of |space|.
+    static T arrayAlloc(ThreadContext* context, int32_t maxSize,
+            Heap::AllocationSpace space = Heap::kAllocateDefault) {
+        S* instance = arrayAllocRaw(context, maxSize, space);
+        instance->schema._classIndex = S::kClassIndex;
         instance->schema._sizeInBytes = sizeof(S);
         return T(instance);
     }
@@ -33,8 +41,12 @@ public:
         if (maxSize > 0) {
             const T& t = static_cast<const T&>(*this);
             if (t.m_instance) {
+                // The allocation may collect, moving this array, so copy from wherever it ends up.
+                HandleScope scope(context);
+                Handle<T> source(context, t);
                 S* instance = arrayAllocRaw(context, maxSize);
-                std::memcpy(instance, t.m_instance, t.m_instance->schema._sizeInBytes);
+                auto sourceInstance = source.get().m_instance;
+                std::memcpy(instance, sourceInstance, sourceInstance->schema._sizeInBytes);
                 return T(instance);
             } else {
                 // Copying an empty array but requesting a nonzero maxSize so we just create a new array with that size.
@@ -59,6 +71,8 @@ public:
         return *(start() + index);
     }
 
+    // Has no write barrier, so storing an object pointer with collection allowed must be followed by a call to
+    // Heap::writeBarrier().
     void put(int32_t index, E value) {
         assert(index < size());
         *(start() + index) = value;
@@ -66,18 +80,33 @@ public:
 
     T& add(ThreadContext* context, E element) {
         int32_t oldSize = size();
-        resize(context, oldSize + 1);
-        *(start() + oldSize) = element;
+        if constexpr (kHoldsPointers) {
+            // Growing may collect, moving the object |element| refers to, so keep it where the collector updates it.
+            HandleScope scope(context);
+            Slot* rooted = context->heap->handles()->create(toSlot(element));
+            resize(context, oldSize + 1);
+            *(start() + oldSize) = fromSlot(*rooted);
+            this->writeBarrier(context);
+        } else {
+            resize(context, oldSize + 1);
+            *(start() + oldSize) = element;
+        }
         return static_cast<T&>(*this);
     }
 
     T& addAll(ThreadContext* context, const ArrayedCollection<T, S, E>& coll) {
         T& t = static_cast<T&>(*this);
-        if (coll.size()) {
+        int32_t collSize = coll.size();
+        if (collSize) {
             int32_t oldSize = size();
-            resize(context, oldSize + coll.size());
+            // Growing may collect, moving |coll|, so copy from wherever it ends up. If |coll| is this array the
+            // elements are copied from the old allocation, which the Handle keeps alive.
+            HandleScope scope(context);
+            Handle<T> source(context, static_cast<const T&>(coll));
+            resize(context, oldSize + collSize);
             std::memcpy(reinterpret_cast<int8_t*>(t.m_instance) + sizeof(S) + (oldSize * sizeof(E)),
-                coll.start(), coll.size() * sizeof(E));
+                source.get().start(), collSize * sizeof(E));
+            if constexpr (kHoldsPointers) { this->writeBarrier(context); }
         }
         return t;
     }
@@ -97,24 +126,29 @@ public:
         return (allocSize - sizeof(S)) / sizeof(E);
     }
 
-    // newSize is in number of elements. If adding elements they are uninitialized.
-    void resize(ThreadContext* context, int32_t newSize) {
+    // Makes room for at least |maxSize| elements without changing the size, so adding up to that many elements never
+    // reallocates. Allocates an empty array if this is nil. Returns this, so adds can follow.
+    T& reserve(ThreadContext* context, int32_t maxSize) {
         T& t = static_cast<T&>(*this);
-        if (newSize > capacity(context)) {
-            S* newArray = arrayAllocRaw(context, newSize);
-            if (t.m_instance) {
-                assert(t.m_instance->schema._className == S::kNameHash);
-                std::memcpy(newArray, t.m_instance, t.m_instance->schema._sizeInBytes);
-            } else {
-                newArray->schema._className = S::kNameHash;
-            }
+        if (t.m_instance == nullptr || !fits(context, maxSize)) { reallocate(context, maxSize); }
+        return t;
+    }
 
-            t.m_instance = newArray;
+    // newSize is in number of elements. If adding elements they are uninitialized. Growing past the capacity
+    // reallocates with room for half again as many elements as the array had, so a run of add() or addAll() calls
+    // copies each element a constant number of times on average.
+    void resize(ThreadContext* context, int32_t newSize) {
+        T& t = static_cast<T&>(*this);
+        if (t.m_instance == nullptr) {
+            if (newSize == 0) { return; }
+            reallocate(context, newSize);
+        } else if (!fits(context, newSize)) {
+            int64_t oldSize = size();
+            auto grownSize = std::min(oldSize + (oldSize / 2), kMaximumElements);
+            reallocate(context, static_cast<int32_t>(std::max(static_cast<int64_t>(newSize), grownSize)));
         }
 
-        if (t.m_instance) {
-            t.m_instance->schema._sizeInBytes = sizeof(S) + (newSize * sizeof(E));
-        }
+        t.m_instance->schema._sizeInBytes = static_cast<uint32_t>(sizeof(S) + (newSize * sizeof(E)));
     }
 
     // Returns an int32_t with the index of item, or nil if item not found.
@@ -128,9 +162,57 @@ public:
     }
 
 protected:
-    static S* arrayAllocRaw(ThreadContext* context, int32_t numberOfElements) {
-        int32_t size = sizeof(S) + (numberOfElements * sizeof(E));
-        return reinterpret_cast<S*>(context->heap->allocateNew(size));
+    // True if the elements can refer to other objects, so storing them needs a write barrier.
+    static constexpr bool kHoldsPointers = std::is_same<E, Slot>::value || std::is_same<E, CompressedSlot>::value;
+    static constexpr int64_t kMaximumElements = (Schema::kMaximumSizeInBytes - sizeof(S)) / sizeof(E);
+
+    // Returns true if the allocation of this non-nil array can hold |numberOfElements|. The allocation is at least the
+    // size the Heap reserves for the current size, which needs no Page lookup, so only arrays about to outgrow that ask
+    // the Heap for their actual allocation size.
+    bool fits(ThreadContext* context, int32_t numberOfElements) const {
+        const T& t = static_cast<const T&>(*this);
+        size_t sizeInBytes = sizeof(S) + (numberOfElements * sizeof(E));
+        if (sizeInBytes <= context->heap->getMaximumSize(t.m_instance->schema._sizeInBytes)) { return true; }
+        return numberOfElements <= capacity(context);
+    }
+
+    // Moves the elements to a new allocation with room for |maxSize| elements, which must be at least the size.
+    void reallocate(ThreadContext* context, int32_t maxSize) {
+        T& t = static_cast<T&>(*this);
+        assert(maxSize >= size());
+        if (t.m_instance == nullptr) {
+            S* newArray = arrayAllocRaw(context, maxSize);
+            newArray->schema._classIndex = S::kClassIndex;
+            newArray->schema._sizeInBytes = sizeof(S);
+            t.m_instance = newArray;
+            return;
+        }
+
+        // The allocation may collect, moving this array, so copy from wherever it ends up.
+        HandleScope scope(context);
+        Handle<T> oldArray(context, t);
+        S* newArray = arrayAllocRaw(context, maxSize);
+        auto oldInstance = oldArray.get().m_instance;
+        assert(oldInstance->schema.classIndex() == S::kClassIndex);
+        std::memcpy(newArray, oldInstance, oldInstance->schema._sizeInBytes);
+        t.m_instance = newArray;
+    }
+
+    // Conversions between elements and the Slots Handles hold, for element types that refer to objects.
+    static Slot toSlot(E element) {
+        if constexpr (std::is_same<E, CompressedSlot>::value) { return element.decompress(); }
+        else { return element; }
+    }
+    static E fromSlot(Slot slot) {
+        if constexpr (std::is_same<E, CompressedSlot>::value) { return CompressedSlot::compress(slot); }
+        else { return slot; }
+    }
+
+    static S* arrayAllocRaw(ThreadContext* context, int32_t numberOfElements,
+            Heap::AllocationSpace space = Heap::kAllocateDefault) {
+        size_t size = sizeof(S) + (numberOfElements * sizeof(E));
+        assert(size <= Schema::kMaximumSizeInBytes);
+        return reinterpret_cast<S*>(context->heap->allocate(size, S::kClassIndex, space));
     }
 };
 
@@ -155,8 +237,8 @@ public:
         size_t size = sizeof(schema::Int8ArraySchema) + byteSize;
         schema::Int8ArraySchema* instance = reinterpret_cast<schema::Int8ArraySchema*>(
             context->heap->allocateJIT(size, maxSize));
-        instance->schema._className = schema::Int8ArraySchema::kNameHash;
-        instance->schema._sizeInBytes = size;
+        instance->schema._classIndex = schema::Int8ArraySchema::kClassIndex;
+        instance->schema._sizeInBytes = static_cast<uint32_t>(size);
         return Int8Array(instance);
     }
 };
@@ -32,6 +32,45 @@ TEST_CASE_FIXTURE(ArrayedCollectionTestFixture, "SymbolArray") {
         CHECK_EQ(array.at(1), library::Symbol::fromView(context(), "b"));
         CHECK_EQ(array.at(0), library::Symbol::fromView(context(), "a"));
     }
+
+    SUBCASE("amortized growth") {
+        auto symbol = library::Symbol::fromView(context(), "a");
+        library::SymbolArray array;
+        auto instance = array.instance();
+        int32_t reallocations = 0;
+        for (int32_t i = 0; i < 10000; ++i) {
+            array.add(context(), symbol);
+            if (array.instance() != instance) {
+                instance = array.instance();
+                ++reallocations;
+            }
+        }
+        CHECK_EQ(array.size(), 10000);
+        CHECK_EQ(array.at(9999), symbol);
+        // Growing by half again each time, plus a reallocation for each small size class.
+        CHECK_LT(reallocations, 40);
+        CHECK_GE(array.capacity(context()), array.size());
+    }
+
+    SUBCASE("reserve") {
+        library::SymbolArray array;
+        array.reserve(context(), 1000);
+        REQUIRE_FALSE(array.isNil());
+        CHECK_EQ(array.size(), 0);
+        CHECK_GE(array.capacity(context()), 1000);
+
+        auto instance = array.instance();
+        for (int32_t i = 0; i < 1000; ++i) {
+            array.add(context(), library::Symbol::fromView(context(), "b"));
+        }
+        CHECK_EQ(array.instance(), instance);
+        CHECK_EQ(array.size(), 1000);
+
+        // Reserving less than the capacity does nothing.
+        array.reserve(context(), 10);
+        CHECK_EQ(array.instance(), instance);
+        CHECK_EQ(array.size(), 1000);
+    }
 }
 
 } // namespace hadron
\ No newline at end of file
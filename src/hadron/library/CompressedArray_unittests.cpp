@@ -0,0 +1,140 @@
+#include "hadron/library/Array.hpp"
+
+#include "hadron/CompressedSlot.hpp"
+#include "hadron/ErrorReporter.hpp"
+#include "hadron/HandleScope.hpp"
+#include "hadron/Heap.hpp"
+#include "hadron/Runtime.hpp"
+#include "hadron/ThreadContext.hpp"
+
+#include "doctest/doctest.h"
+
+#include <memory>
+#include <vector>
+
+// These tests need compressed pointers, so are built into compressed_unittests, which enables them before creating
+// any Heap.
+namespace hadron {
+
+namespace {
+
+using Elements = library::CompressedArray<library::Array>;
+
+// Fills |array| with new single element Arrays, each holding its index.
+void fill(ThreadContext* context, Elements array) {
+    for (int32_t i = 0; i < array.size(); ++i) {
+        auto element = library::Array::newClear(context, 1);
+        element.put(0, Slot::makeInt32(i));
+        array.typedPut(i, element);
+    }
+}
+
+// Returns the number of elements of |array| that don't hold the Array made for their index, checking only indices
+// that are a multiple of |stride|. The others must be nil.
+int32_t countMistakes(Elements array, int32_t stride) {
+    int32_t mistakes = 0;
+    for (int32_t i = 0; i < array.size(); ++i) {
+        if (i % stride) {
+            if (!array.at(i).isNil()) { ++mistakes; }
+        } else if (array.at(i).isNil() || array.typedAt(i).at(0) != Slot::makeInt32(i)) {
+            ++mistakes;
+        }
+    }
+    return mistakes;
+}
+
+// Returns the addresses of the elements of |array|.
+std::vector<library::Schema*> addresses(Elements array) {
+    std::vector<library::Schema*> result;
+    for (int32_t i = 0; i < array.size(); ++i) {
+        result.emplace_back(array.at(i).isNil() ? nullptr : array.at(i).getPointer());
+    }
+    return result;
+}
+
+} // namespace
+
+class CompressedArrayTestFixture {
+public:
+    CompressedArrayTestFixture():
+        m_errorReporter(std::make_shared<ErrorReporter>()),
+        m_runtime(std::make_unique<Runtime>(m_errorReporter)) {}
+    virtual ~CompressedArrayTestFixture() = default;
+protected:
+    ThreadContext* context() { return m_runtime->context(); }
+private:
+    std::shared_ptr<ErrorReporter> m_errorReporter;
+    std::unique_ptr<Runtime> m_runtime;
+};
+
+TEST_CASE_FIXTURE(CompressedArrayTestFixture, "CompressedArray collection") {
+    REQUIRE(CompressedSlot::isEnabled());
+    auto heap = context()->heap;
+
+    SUBCASE("young collection") {
+        // The array is young too, so is copied along with its elements.
+        HandleScope scope(context());
+        heap->deferCollection();
+        auto array = Elements::newClear(context(), 1024);
+        fill(context(), array);
+        Handle<Elements> rooted(context(), array);
+        heap->allowCollection();
+
+        auto youngCollections = heap->stats().youngCollections;
+        auto original = addresses(rooted.get());
+        heap->collectYoungGeneration();
+        CHECK_EQ(heap->stats().youngCollections, youngCollections + 1);
+        CHECK_NE(rooted.get().instance(), array.instance());
+        CHECK_EQ(countMistakes(rooted.get(), 1), 0);
+        auto copied = addresses(rooted.get());
+        int32_t moved = 0;
+        for (size_t i = 0; i < original.size(); ++i) {
+            if (copied[i] != original[i]) { ++moved; }
+        }
+        CHECK_EQ(moved, rooted.get().size());
+
+        // Through promotion to the mature space.
+        for (int32_t i = 0; i < Heap::kPromotionAge; ++i) {
+            heap->collectYoungGeneration();
+            CHECK_EQ(countMistakes(rooted.get(), 1), 0);
+        }
+    }
+
+    SUBCASE("full collection and compaction") {
+        // Enough single element Arrays to fill several mature Pages, as in the Heap compaction test.
+        constexpr int32_t kNumberOfElements = 32768;
+        auto array = Elements::newClear(context(), kNumberOfElements);
+        heap->addToRootSet(array.slot());
+        fill(context(), array);
+        for (int32_t i = 0; i < Heap::kPromotionAge; ++i) {
+            heap->collectYoungGeneration();
+        }
+        CHECK_EQ(countMistakes(array, 1), 0);
+
+        // Marking reaches the elements only through the array, and frees the dropped ones.
+        for (int32_t i = 0; i < kNumberOfElements; ++i) {
+            if (i % 4) { array.put(i, Slot::makeNil()); }
+        }
+        heap->collectGarbage();
+        CHECK_EQ(countMistakes(array, 4), 0);
+        CHECK_GT(heap->stats().matureSpace.fragmentation(), 0.5);
+
+        // Compaction moves elements and updates the array to their new addresses.
+        auto original = addresses(array);
+        heap->setCompactionThreshold(0.5);
+        heap->collectGarbage();
+        CHECK_GT(heap->lastCollection().objectsCompacted, 0);
+        CHECK_EQ(countMistakes(array, 4), 0);
+        auto compacted = addresses(array);
+        int32_t moved = 0;
+        for (size_t i = 0; i < original.size(); ++i) {
+            if (compacted[i] != original[i]) { ++moved; }
+        }
+        CHECK_GT(moved, 0);
+
+        heap->setCompactionThreshold(0.0);
+        heap->removeFromRootSet(array.slot());
+    }
+}
+
+} // namespace hadron
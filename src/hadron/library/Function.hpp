@@ -15,10 +15,16 @@ class Function : public Object<Function, schema::FunctionSchema> {
     ~Function() {}
 
     FunctionDef def() const { return FunctionDef(m_instance->def); }
-    void setDef(FunctionDef functionDef) { m_instance->def = functionDef.slot(); }
+    void setDef(ThreadContext* context, FunctionDef functionDef) {
+        m_instance->def = functionDef.slot();
+        writeBarrier(context);
+    }
 
     Frame context() const { return Frame(m_instance->context); }
-    void setContext(Frame frame) { m_instance->context = frame.slot(); }
+    void setContext(ThreadContext* context, Frame frame) {
+        m_instance->context = frame.slot();
+        writeBarrier(context);
+    }
 };
 
 } // namespace library
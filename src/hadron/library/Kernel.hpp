@@ -15,6 +15,7 @@ namespace schema {
 struct FramePrivateSchema {
     static constexpr Hash kNameHash = FrameSchema::kNameHash;
     static constexpr Hash kMetaNameHash = FrameSchema::kMetaNameHash;
+    static constexpr uint32_t kClassIndex = FrameSchema::kClassIndex;
 
     library::Schema schema;
 
@@ -47,34 +48,61 @@ public:
     void setName(Symbol name) { m_instance->name = name.slot(); }
 
     Class nextclass() const { return Class(m_instance->nextclass); }
-    void setNextclass(Class nextClass) { m_instance->nextclass = nextClass.slot(); }
+    void setNextclass(ThreadContext* context, Class nextClass) {
+        m_instance->nextclass = nextClass.slot();
+        writeBarrier(context);
+    }
 
     Symbol superclass(ThreadContext* context) const { return Symbol(context, m_instance->superclass); }
     void setSuperclass(Symbol name) { m_instance->superclass = name.slot(); }
 
     ClassArray subclasses() const { return ClassArray(m_instance->subclasses); }
-    void setSubclasses(ClassArray a) { m_instance->subclasses = a.slot(); }
+    void setSubclasses(ThreadContext* context, ClassArray a) {
+        m_instance->subclasses = a.slot();
+        writeBarrier(context);
+    }
 
     MethodArray methods() const { return MethodArray(m_instance->methods); }
-    void setMethods(MethodArray a) { m_instance->methods = a.slot(); }
+    void setMethods(ThreadContext* context, MethodArray a) {
+        m_instance->methods = a.slot();
+        writeBarrier(context);
+    }
 
     SymbolArray instVarNames() const { return SymbolArray(m_instance->instVarNames); }
-    void setInstVarNames(SymbolArray a) { m_instance->instVarNames = a.slot(); }
+    void setInstVarNames(ThreadContext* context, SymbolArray a) {
+        m_instance->instVarNames = a.slot();
+        writeBarrier(context);
+    }
 
     SymbolArray classVarNames() const { return SymbolArray(m_instance->classVarNames); }
-    void setClassVarNames(SymbolArray a) { m_instance->classVarNames = a.slot(); }
+    void setClassVarNames(ThreadContext* context, SymbolArray a) {
+        m_instance->classVarNames = a.slot();
+        writeBarrier(context);
+    }
 
     Array iprototype() const { return Array(m_instance->iprototype); }
-    void setIprototype(Array a) { m_instance->iprototype = a.slot(); }
+    void setIprototype(ThreadContext* context, Array a) {
+        m_instance->iprototype = a.slot();
+        writeBarrier(context);
+    }
 
     Array cprototype() const { return Array(m_instance->cprototype); }
-    void setCprototype(Array a) { m_instance->cprototype = a.slot(); }
+    void setCprototype(ThreadContext* context, Array a) {
+        m_instance->cprototype = a.slot();
+        writeBarrier(context);
+    }
 
     SymbolArray constNames() const { return SymbolArray(m_instance->constNames); }
-    void setConstNames(SymbolArray a) { m_instance->constNames = a.slot(); }
+    void setConstNames(ThreadContext* context, SymbolArray a) {
+        m_instance->constNames = a.slot();
+        writeBarrier(context);
+    }
 
     Array constValues() const { return Array(m_instance->constValues); }
-    void setConstValues(Array a) { m_instance->constValues = a.slot(); }
+    void setConstValues(ThreadContext* context, Array a) {
+        m_instance->constValues = a.slot();
+        writeBarrier(context);
+    }
 
     Symbol filenameSymbol(ThreadContext* context) const { return Symbol(context, m_instance->filenameSymbol); }
     void setFilenameSymbol(Symbol filename) { m_instance->filenameSymbol = filename.slot(); }
@@ -84,6 +112,22 @@ public:
 
     int32_t classVarIndex() const { return m_instance->classVarIndex.getInt32(); }
     void setClassVarIndex(int32_t index) { m_instance->classVarIndex = Slot::makeInt32(index); }
+
+    // The ClassLibrary numbers classes in preorder over the class hierarchy, so a class and all of its subclasses
+    // number the interval [preorderIndex(), maxSubclassIndex()]. Stored in the classIndex and maxSubclassIndex members
+    // SuperCollider reserves for this, not to be confused with the class index in the object header. The numbers are
+    // never negative, so their tagged Slots compare in the same order, which IsSubclassOfLIR relies on.
+    bool isNumbered() const { return m_instance->classIndex.isInt32(); }
+    int32_t preorderIndex() const { return m_instance->classIndex.getInt32(); }
+    void setPreorderIndex(int32_t index) { m_instance->classIndex = Slot::makeInt32(index); }
+    int32_t maxSubclassIndex() const { return m_instance->maxSubclassIndex.getInt32(); }
+    void setMaxSubclassIndex(int32_t index) { m_instance->maxSubclassIndex = Slot::makeInt32(index); }
+
+    // Returns true if this class is |classDef| or inherits from it. Both classes must be numbered.
+    bool isSubclassOf(Class classDef) const {
+        auto index = preorderIndex();
+        return classDef.preorderIndex() <= index && index <= classDef.maxSubclassIndex();
+    }
 };
 
 class Process : public Object<Process, schema::ProcessSchema> {
@@ -102,48 +146,63 @@ public:
     ~FunctionDefBase() {}
 
     Int8Array code() const {
-        T& t = static_cast<T&>(*this);
+        const T& t = static_cast<const T&>(*this);
         return Int8Array(t.m_instance->code);
     }
-    void setCode(Int8Array c) {
+    void setCode(ThreadContext* context, Int8Array c) {
         T& t = static_cast<T&>(*this);
         t.m_instance->code = c.slot();
+        this->writeBarrier(context);
     }
 
     FunctionDefArray selectors() const {
         T& t = static_cast<T&>(*this);
         return FunctionDefArray(t.m_instance->selectors);
     }
-    void setSelectors(FunctionDefArray a) {
+    void setSelectors(ThreadContext* context, FunctionDefArray a) {
         T& t = static_cast<T&>(*this);
         t.m_instance->selectors = a.slot();
+        this->writeBarrier(context);
+    }
+
+    Array constants() const {
+        const T& t = static_cast<const T&>(*this);
+        return Array(t.m_instance->constants);
+    }
+    void setConstants(ThreadContext* context, Array a) {
+        T& t = static_cast<T&>(*this);
+        t.m_instance->constants = a.slot();
+        this->writeBarrier(context);
     }
 
     Array prototypeFrame() const {
         const T& t = static_cast<const T&>(*this);
         return Array(t.m_instance->prototypeFrame);
     }
-    void setPrototypeFrame(Array a) {
+    void setPrototypeFrame(ThreadContext* context, Array a) {
         T& t = static_cast<T&>(*this);
         t.m_instance->prototypeFrame = a.slot();
+        this->writeBarrier(context);
     }
 
     SymbolArray argNames() const {
         const T& t = static_cast<const T&>(*this);
         return SymbolArray(t.m_instance->argNames);
     }
-    void setArgNames(SymbolArray a) {
+    void setArgNames(ThreadContext* context, SymbolArray a) {
         T& t = static_cast<T&>(*this);
         t.m_instance->argNames = a.slot();
+        this->writeBarrier(context);
     }
 
     SymbolArray varNames() const {
         T& t = static_cast<T&>(*this);
         return SymbolArray(t.m_instance->varNames);
     }
-    void setVarNames(SymbolArray a) {
-        T&t = static_cast<T&>(*this);
+    void setVarNames(ThreadContext* context, SymbolArray a) {
+        T& t = static_cast<T&>(*this);
         t.m_instance->varNames = a.slot();
+        this->writeBarrier(context);
     }
 };
 
@@ -167,7 +226,10 @@ public:
     ~Method() {}
 
     Class ownerClass() const { return Class(m_instance->ownerClass); }
-    void setOwnerClass(Class ownerClass) { m_instance->ownerClass = ownerClass.slot(); }
+    void setOwnerClass(ThreadContext* context, Class ownerClass) {
+        m_instance->ownerClass = ownerClass.slot();
+        writeBarrier(context);
+    }
 
     Symbol name(ThreadContext* context) const { return Symbol(context, m_instance->name); }
     void setName(Symbol name) { m_instance->name = name.slot(); }
@@ -192,16 +254,28 @@ public:
     ~Frame() {}
 
     Method method() const { return Method(m_instance->method); }
-    void setMethod(Method method) { m_instance->method = method.slot(); }
+    void setMethod(ThreadContext* context, Method method) {
+        m_instance->method = method.slot();
+        writeBarrier(context);
+    }
 
     Object caller() const { return Object(m_instance->caller); }
-    void setCaller(Object caller) { m_instance->caller = caller.slot(); }
+    void setCaller(ThreadContext* context, Object caller) {
+        m_instance->caller = caller.slot();
+        writeBarrier(context);
+    }
 
     Frame context() const { return Frame(m_instance->context); }
-    void setContext(Frame context) { m_instance->context = context.slot(); }
+    void setContext(ThreadContext* context, Frame frame) {
+        m_instance->context = frame.slot();
+        writeBarrier(context);
+    }
 
     Frame homeContext() const { return Frame(m_instance->homeContext); }
-    void setHomeContext(Frame homeContext) { m_instance->homeContext = homeContext.slot(); }
+    void setHomeContext(ThreadContext* context, Frame homeContext) {
+        m_instance->homeContext = homeContext.slot();
+        writeBarrier(context);
+    }
 
     int8_t* ip() const { return m_instance->ip.getRawPointer(); }
     void setIp(int8_t* ip) { m_instance->ip = Slot::makeRawPointer(ip); }
@@ -0,0 +1,48 @@
+#ifndef SRC_HADRON_LIBRARY_KERNEL_FIXTURES_UNITTESTS_HPP_
+#define SRC_HADRON_LIBRARY_KERNEL_FIXTURES_UNITTESTS_HPP_
+
+#include "hadron/library/Array.hpp"
+#include "hadron/library/Kernel.hpp"
+#include "hadron/library/Symbol.hpp"
+#include "hadron/ThreadContext.hpp"
+
+#include <string_view>
+
+// Helpers for unit tests that build small class hierarchies by hand, in place of compiling a class library.
+namespace hadron {
+namespace fixtures {
+
+// Returns a new Class named |name|, a subclass of |superclass| unless that is nil, but not yet known to |superclass|.
+inline library::Class makeClass(ThreadContext* context, std::string_view name, library::Class superclass) {
+    auto classDef = library::Class::alloc(context);
+    classDef.initToNil();
+    classDef.setName(library::Symbol::fromView(context, name));
+    if (!superclass.isNil()) { classDef.setSuperclass(superclass.name(context)); }
+    return classDef;
+}
+
+// As makeClass(), but also adds the new Class to the subclasses of |superclass| and to |classArray|.
+inline library::Class addClass(ThreadContext* context, library::ClassArray& classArray, std::string_view name,
+        library::Class superclass) {
+    auto classDef = makeClass(context, name, superclass);
+    if (!superclass.isNil()) {
+        superclass.setSubclasses(context, superclass.subclasses().typedAdd(context, classDef));
+    }
+    classArray = classArray.typedAdd(context, classDef);
+    return classDef;
+}
+
+// Adds a new Method named |name| to |classDef|, and returns it.
+inline library::Method addMethod(ThreadContext* context, library::Class classDef, std::string_view name) {
+    auto method = library::Method::alloc(context);
+    method.initToNil();
+    method.setName(library::Symbol::fromView(context, name));
+    method.setOwnerClass(context, classDef);
+    classDef.setMethods(context, classDef.methods().typedAdd(context, method));
+    return method;
+}
+
+} // namespace fixtures
+} // namespace hadron
+
+#endif // SRC_HADRON_LIBRARY_KERNEL_FIXTURES_UNITTESTS_HPP_
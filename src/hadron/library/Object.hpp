@@ -4,6 +4,7 @@
 #include "hadron/Hash.hpp"
 #include "hadron/Heap.hpp"
 #include "hadron/Keywords.hpp"
+#include "hadron/LayoutTable.hpp"
 #include "hadron/Slot.hpp"
 #include "hadron/ThreadContext.hpp"
 
@@ -29,14 +30,14 @@ public:
     // without type checking, use wrapUnsafe().
     explicit Object(S* instance): m_instance(instance) {
         if (m_instance) {
-            assert(m_instance->schema._className == S::kNameHash);
+            assert(m_instance->schema.classIndex() == S::kClassIndex);
         }
     }
     explicit Object(Slot instance) {
         if (instance.isNil()) { m_instance = nullptr; }
         else {
             m_instance = reinterpret_cast<S*>(instance.getPointer());
-            assert(m_instance->schema._className == S::kNameHash);
+            assert(m_instance->schema.classIndex() == S::kClassIndex);
         }
     }
 
@@ -52,11 +53,14 @@ public:
         }
     }
 
-    static inline T alloc(ThreadContext* context, int32_t extraSlots = 0) {
+    // Allocates a new, uninitialized object. See Heap::AllocationSpace for the choice of |space|.
+    static inline T alloc(ThreadContext* context, int32_t extraSlots = 0,
+            Heap::AllocationSpace space = Heap::kAllocateDefault) {
         size_t sizeInBytes = sizeof(S) + (extraSlots * kSlotSize);
-        S* instance = reinterpret_cast<S*>(context->heap->allocateNew(sizeInBytes));
-        instance->schema._className = S::kNameHash;
-        instance->schema._sizeInBytes = sizeInBytes;
+        assert(sizeInBytes <= Schema::kMaximumSizeInBytes);
+        S* instance = reinterpret_cast<S*>(context->heap->allocate(sizeInBytes, S::kClassIndex, space));
+        instance->schema._classIndex = S::kClassIndex;
+        instance->schema._sizeInBytes = static_cast<uint32_t>(sizeInBytes);
         return T(instance);
     }
 
@@ -76,12 +80,18 @@ public:
     inline bool isNil() const { return m_instance == nullptr; }
     inline Hash className() const {
         if (isNil()) { return kNilHash; }
-        return m_instance->schema._className;
+        return LayoutTable::instance().className(m_instance->schema.classIndex());
     }
     static inline Hash nameHash() { return S::kNameHash; }
+    static inline uint32_t classIndex() { return S::kClassIndex; }
     static inline int32_t schemaSize() { return (sizeof(S) - sizeof(Schema)) / kSlotSize; }
 
 protected:
+    // Setters that store object pointers must call this after the store, see Heap::writeBarrier().
+    void writeBarrier(ThreadContext* context) {
+        context->heap->writeBarrier(reinterpret_cast<Schema*>(m_instance));
+    }
+
     S* m_instance;
 };
 
@@ -22,14 +22,50 @@ struct Schema {
     ~Schema() = delete;
 
     // Underscores as prefixes for these members so they don't collide with instance variables derived from scanning the
-    // SuperCollider class files. This is always a symbol.
-    Hash _className;
+    // SuperCollider class files. The dense index of the class of this object, assigned by schemac for the classes it
+    // processed and by the ClassLibrary for the rest. See LayoutTable for the mapping back to the class name, and
+    // ClassLibrary for the mapping to the Class object. Indices only use the low kClassIndexBits, and the bits above are
+    // reserved for the collector to keep per-object state like color or age in the header. They are always zero outside
+    // of collection.
+    uint32_t _classIndex;
     // This is absolute size, including this header.
-    uint64_t _sizeInBytes;
+    uint32_t _sizeInBytes;
+
+    static constexpr uint32_t kClassIndexBits = 24;
+    static constexpr uint32_t kClassIndexMask = (1u << kClassIndexBits) - 1;
+
+    // Returns the class index without any collector bits, use this rather than reading _classIndex.
+    uint32_t classIndex() const { return _classIndex & kClassIndexMask; }
+    // Limits object sizes so that a header can never be mistaken for the tagged forwarding pointer a collector leaves
+    // in place of the header of a moved object.
+    static constexpr uint64_t kMaximumSizeInBytes = 0x7fffffff;
 };
 
 // Important we not have a vtable in these objects, so no virtual functions.
 static_assert(std::is_standard_layout<Schema>::value);
+static_assert(sizeof(Schema) == 8);
+
+// schemac generates one of these for each non-primitive class, describing where in its instances the garbage collector
+// should look for pointers. The Slots follow the Schema header, first the instance variables of every class in the
+// lineage, then any indexed elements.
+struct SchemaLayout {
+    enum Indexed : uint8_t {
+        // Instances are only the instance variables.
+        kNotIndexed,
+        // The instance variables are followed by a variable number of Slots, as in Array.
+        kIndexedSlots,
+        // The instance variables are followed by raw bytes, as in Int8Array, String, or SymbolArray.
+        kIndexedBytes,
+        // The instance variables are followed by a variable number of CompressedSlots, as in CompressedArray.
+        kIndexedCompressed
+    };
+
+    Hash className;
+    uint32_t fixedSlots;
+    Indexed indexed;
+    // Bit i is set if instance variable i can hold a pointer. Instance variables past the first 64 are always scanned.
+    uint64_t pointerMap;
+};
 
 } // namespace library
 } // namespace hadron
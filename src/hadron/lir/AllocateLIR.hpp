@@ -0,0 +1,74 @@
+#ifndef SRC_HADRON_LIR_ALLOCATE_LIR_HPP_
+#define SRC_HADRON_LIR_ALLOCATE_LIR_HPP_
+
+#include "hadron/library/Schema.hpp"
+#include "hadron/lir/LIR.hpp"
+#include "hadron/ThreadContext.hpp"
+
+namespace hadron {
+namespace lir {
+
+// Allocates a new object of |sizeInBytes| inline from the ThreadContext allocation buffer for that size, and initializes
+// the Schema header. Only when the buffer is empty does it exit machine code with the kAllocateMemory interrupt. Like
+// InterruptLIR that exit is one way, as there is not yet a protocol for saving a resume address and the registers, so
+// machine code can't continue after the Runtime refills the buffer.
+struct AllocateLIR : public LIR {
+    AllocateLIR() = delete;
+    // |scratch| is clobbered, so must not be read by any later LIR.
+    AllocateLIR(VReg s, size_t size, uint32_t index):
+        LIR(kAllocate, TypeFlags::kObjectFlag),
+        scratch(s),
+        sizeInBytes(size),
+        classIndex(index) {
+        assert(sizeInBytes >= sizeof(library::Schema));
+        assert(sizeInBytes <= ThreadContext::kMaximumBufferedSize);
+        read(scratch);
+    }
+    virtual ~AllocateLIR() = default;
+
+    VReg scratch;
+    size_t sizeInBytes;
+    uint32_t classIndex;
+
+    bool producesValue() const override { return true; }
+
+    void emit(JIT* jit, std::vector<std::pair<JIT::Label, LabelID>>& /* patchNeeded */) const override {
+        emitBase(jit);
+        auto object = locate(value);
+        auto temp = locate(scratch);
+        int bufferOffset = offsetof(ThreadContext, allocationBuffers) +
+                (ThreadContext::allocationBufferIndex(sizeInBytes) * sizeof(ThreadContext::AllocationBuffer));
+        int topOffset = bufferOffset + offsetof(ThreadContext::AllocationBuffer, top);
+        int remainingOffset = bufferOffset + offsetof(ThreadContext::AllocationBuffer, remaining);
+        int objectSizeOffset = bufferOffset + offsetof(ThreadContext::AllocationBuffer, objectSize);
+
+        jit->ldxi_w(temp, JIT::kContextPointerReg, remainingOffset);
+        jit->addi(temp, temp, -1);
+        auto hasRoom = jit->bgei(temp, 0);
+
+        // Buffer is empty, save the requested size and exit machine code to ask the Runtime to refill it.
+        jit->movi(temp, static_cast<Word>(sizeInBytes));
+        jit->stxi_w(offsetof(ThreadContext, allocationSize), JIT::kContextPointerReg, temp);
+        jit->movi(temp, ThreadContext::InterruptCode::kAllocateMemory);
+        jit->stxi_i(offsetof(ThreadContext, interruptCode), JIT::kContextPointerReg, temp);
+        jit->ldxi_w(temp, JIT::kContextPointerReg, offsetof(ThreadContext, exitMachineCode));
+        jit->jmpr(temp);
+
+        // Bump allocate the object and write the header.
+        jit->patchHere(hasRoom);
+        jit->stxi_w(remainingOffset, JIT::kContextPointerReg, temp);
+        jit->ldxi_w(object, JIT::kContextPointerReg, topOffset);
+        jit->ldxi_w(temp, JIT::kContextPointerReg, objectSizeOffset);
+        jit->addr(temp, object, temp);
+        jit->stxi_w(topOffset, JIT::kContextPointerReg, temp);
+        jit->movi(temp, static_cast<Word>(classIndex));
+        jit->stxi_i(offsetof(library::Schema, _classIndex), object, temp);
+        jit->movi(temp, static_cast<Word>(sizeInBytes));
+        jit->stxi_i(offsetof(library::Schema, _sizeInBytes), object, temp);
+    }
+};
+
+} // namespace lir
+} // namespace hadron
+
+#endif // SRC_HADRON_LIR_ALLOCATE_LIR_HPP_
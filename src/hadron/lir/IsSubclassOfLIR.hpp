@@ -0,0 +1,78 @@
+#ifndef SRC_HADRON_LIR_IS_SUBCLASS_OF_LIR_HPP_
+#define SRC_HADRON_LIR_IS_SUBCLASS_OF_LIR_HPP_
+
+#include "hadron/library/Kernel.hpp"
+#include "hadron/lir/LIR.hpp"
+
+#include <cstddef>
+
+namespace hadron {
+namespace lir {
+
+// Produces true if the Class |classDef| is |superclass| or inherits from it, as Class::isSubclassOf() does, otherwise
+// false. Classes are numbered in preorder, so this is two comparisons of the preorder index of |classDef| against the
+// interval numbered by |superclass|. The interval is loaded from |superclass| rather than being compiled in, as adding a
+// class renumbers the hierarchy. Both classes must be numbered.
+struct IsSubclassOfLIR : public LIR {
+    IsSubclassOfLIR() = delete;
+    // |scratch| is clobbered, so must not be read by any later LIR.
+    IsSubclassOfLIR(VReg c, VReg super, VReg s):
+        LIR(kIsSubclassOf, TypeFlags::kBooleanFlag),
+        classDef(c),
+        superclass(super),
+        scratch(s) {
+        read(classDef);
+        read(superclass);
+        read(scratch);
+    }
+    virtual ~IsSubclassOfLIR() = default;
+
+    VReg classDef;
+    VReg superclass;
+    VReg scratch;
+
+    bool producesValue() const override { return true; }
+
+    void emit(JIT* jit, std::vector<std::pair<JIT::Label, LabelID>>& /* patchNeeded */) const override {
+        emitBase(jit);
+        auto result = locate(value);
+        auto temp = locate(scratch);
+        int preorderOffset = offsetof(schema::ClassSchema, classIndex);
+        int maxSubclassOffset = offsetof(schema::ClassSchema, maxSubclassIndex);
+
+        // The JIT can only compare against immediate values, so compare by the sign of differences instead. The
+        // numbers are tagged Int32 Slots, and the tags cancel out in the differences. There's no subtraction either,
+        // but a - b - 1 is a + ~b, so load the complement of the index of |classDef|.
+        jit->andi(result, locate(classDef), ~Slot::kTagMask);
+        jit->ldxi_w(result, result, preorderOffset);
+        jit->movi(temp, -1);
+        jit->xorr(result, result, temp);
+
+        // max - index - 1 is less than -1 past the end of the interval.
+        jit->andi(temp, locate(superclass), ~Slot::kTagMask);
+        jit->ldxi_w(temp, temp, maxSubclassOffset);
+        jit->addr(temp, temp, result);
+        auto notPast = jit->bgei(temp, -1);
+        jit->movi_u(result, Slot::makeBool(false).asBits());
+        auto past = jit->jmp();
+
+        // preorder - index - 1 is at least 0 before the start of the interval.
+        jit->patchHere(notPast);
+        jit->andi(temp, locate(superclass), ~Slot::kTagMask);
+        jit->ldxi_w(temp, temp, preorderOffset);
+        jit->addr(temp, temp, result);
+        auto before = jit->bgei(temp, 0);
+        jit->movi_u(result, Slot::makeBool(true).asBits());
+        auto within = jit->jmp();
+        jit->patchHere(before);
+        jit->movi_u(result, Slot::makeBool(false).asBits());
+
+        jit->patchHere(past);
+        jit->patchHere(within);
+    }
+};
+
+} // namespace lir
+} // namespace hadron
+
+#endif // SRC_HADRON_LIR_IS_SUBCLASS_OF_LIR_HPP_
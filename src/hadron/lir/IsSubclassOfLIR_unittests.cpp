@@ -0,0 +1,153 @@
+#include "hadron/lir/IsSubclassOfLIR.hpp"
+
+#include "hadron/ClassLibrary.hpp"
+#include "hadron/ErrorReporter.hpp"
+#include "hadron/library/Array.hpp"
+#include "hadron/library/Kernel.hpp"
+#include "hadron/library/KernelFixtures_unittests.hpp"
+#include "hadron/OpcodeIterator.hpp"
+#include "hadron/Runtime.hpp"
+#include "hadron/ThreadContext.hpp"
+#include "hadron/VirtualJIT.hpp"
+
+#include "doctest/doctest.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace hadron {
+
+using fixtures::addClass;
+
+namespace {
+
+// Emits an IsSubclassOfLIR with VirtualJIT and interprets the bytecode, returning the bits of the Slot it produces.
+// Only the opcodes the LIR emits are interpreted.
+uint64_t isSubclassOf(library::Class classDef, library::Class superclass) {
+    lir::IsSubclassOfLIR lir(0, 1, 2);
+    lir.value = 3;
+    for (lir::VReg vReg = 0; vReg < 4; ++vReg) { lir.locations.emplace(vReg, vReg); }
+
+    std::array<int8_t, 256> buffer;
+    VirtualJIT jit;
+    jit.begin(buffer.data(), buffer.size());
+    std::vector<std::pair<JIT::Label, lir::LabelID>> patchNeeded;
+    lir.emit(&jit, patchNeeded);
+    size_t size = 0;
+    jit.end(&size);
+    REQUIRE_LE(size, buffer.size());
+    CHECK(patchNeeded.empty());
+
+    std::unordered_map<JIT::Reg, Word> registers;
+    registers[0] = static_cast<Word>(classDef.slot().asBits());
+    registers[1] = static_cast<Word>(superclass.slot().asBits());
+    // Garbage in the scratch and result registers must not matter.
+    registers[2] = 0x5ca7c4;
+    registers[3] = -1;
+
+    const int8_t* end = buffer.data() + size;
+    OpcodeReadIterator iterator(buffer.data(), size);
+    JIT::Reg target, a, b;
+    Word word;
+    UWord uword;
+    int offset;
+    const int8_t* address;
+    while (iterator.getCurrent() < end) {
+        switch (iterator.peek()) {
+        case kAddr:
+            REQUIRE(iterator.addr(target, a, b));
+            registers[target] = registers[a] + registers[b];
+            break;
+        case kAndi:
+            REQUIRE(iterator.andi(target, a, uword));
+            registers[target] = static_cast<Word>(static_cast<UWord>(registers[a]) & uword);
+            break;
+        case kXorr:
+            REQUIRE(iterator.xorr(target, a, b));
+            registers[target] = registers[a] ^ registers[b];
+            break;
+        case kMovi:
+            REQUIRE(iterator.movi(target, word));
+            registers[target] = word;
+            break;
+        case kMoviU:
+            REQUIRE(iterator.movi_u(target, uword));
+            registers[target] = static_cast<Word>(uword);
+            break;
+        case kLdxiW:
+            REQUIRE(iterator.ldxi_w(target, a, offset));
+            registers[target] = *reinterpret_cast<const Word*>(registers[a] + offset);
+            break;
+        case kBgei:
+            REQUIRE(iterator.bgei(a, word, address));
+            if (registers[a] >= word) { iterator.setBuffer(address, end - address); }
+            break;
+        case kJmp:
+            REQUIRE(iterator.jmp(address));
+            iterator.setBuffer(address, end - address);
+            break;
+        default:
+            // Unexpected opcode.
+            REQUIRE(false);
+            return 0;
+        }
+    }
+
+    return static_cast<uint64_t>(registers[3]);
+}
+
+} // namespace
+
+TEST_CASE("IsSubclassOfLIR") {
+    Runtime runtime(std::make_shared<ErrorReporter>());
+    auto context = runtime.context();
+
+    // Numbered in preorder Object 0, Collection 1, Array 2, Set 3, String 4, so Collection's interval is [1, 3].
+    auto classArray = library::ClassArray::typedArrayAlloc(context, 1);
+    auto object = addClass(context, classArray, "Object", library::Class());
+    auto collection = addClass(context, classArray, "Collection", object);
+    auto array = addClass(context, classArray, "Array", collection);
+    auto set = addClass(context, classArray, "Set", collection);
+    auto string = addClass(context, classArray, "String", object);
+    REQUIRE(context->classLibrary->restoreLibrary(context, classArray, library::Method(), library::Array()));
+    REQUIRE_EQ(collection.preorderIndex(), 1);
+    REQUIRE_EQ(collection.maxSubclassIndex(), 3);
+
+    auto yes = Slot::makeBool(true).asBits();
+    auto no = Slot::makeBool(false).asBits();
+
+    SUBCASE("before, within and after an interval") {
+        CHECK_EQ(isSubclassOf(object, collection), no);
+        CHECK_EQ(isSubclassOf(collection, collection), yes);
+        CHECK_EQ(isSubclassOf(array, collection), yes);
+        CHECK_EQ(isSubclassOf(set, collection), yes);
+        CHECK_EQ(isSubclassOf(string, collection), no);
+    }
+
+    SUBCASE("single class interval") {
+        CHECK_EQ(isSubclassOf(collection, array), no);
+        CHECK_EQ(isSubclassOf(array, array), yes);
+        CHECK_EQ(isSubclassOf(set, array), no);
+    }
+
+    SUBCASE("root interval") {
+        for (auto classDef : { object, collection, array, set, string }) {
+            CHECK_EQ(isSubclassOf(classDef, object), yes);
+        }
+    }
+
+    SUBCASE("agrees with Class") {
+        for (auto classDef : { object, collection, array, set, string }) {
+            for (auto superclass : { object, collection, array, set, string }) {
+                auto expected = Slot::makeBool(classDef.isSubclassOf(superclass)).asBits();
+                CHECK_EQ(isSubclassOf(classDef, superclass), expected);
+            }
+        }
+    }
+}
+
+} // namespace hadron
@@ -25,16 +25,20 @@ using LIRList = std::list<std::unique_ptr<lir::LIR>>;
 namespace lir {
 
 enum Opcode {
+    kAllocate,
     kAssign,
     kBranch,
     kBranchIfTrue,
     kBranchToRegister,
     kInterrupt,
+    kIsSubclassOf,
     kLabel,
     kLoadConstant,
     kLoadFromPointer,
+    kLoadLiteral,
     kPhi,
-    kStoreToPointer
+    kStoreToPointer,
+    kWriteBarrier
 };
 
 struct LIR {
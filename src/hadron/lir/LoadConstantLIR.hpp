@@ -7,11 +7,12 @@
 namespace hadron {
 namespace lir {
 
+// Loads an immediate value. Pointers to heap objects must go through LoadLiteralLIR, as the collector can move them.
 struct LoadConstantLIR : public LIR {
     LoadConstantLIR() = delete;
     explicit LoadConstantLIR(Slot c):
         LIR(kLoadConstant, c.getType()),
-        constant(c) {}
+        constant(c) { assert(!constant.isPointer()); }
     virtual ~LoadConstantLIR() = default;
 
     Slot constant;
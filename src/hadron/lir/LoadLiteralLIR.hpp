@@ -0,0 +1,43 @@
+#ifndef SRC_HADRON_LIR_LOAD_LITERAL_LIR_HPP_
+#define SRC_HADRON_LIR_LOAD_LITERAL_LIR_HPP_
+
+#include "hadron/library/Kernel.hpp"
+#include "hadron/library/Schema.hpp"
+#include "hadron/lir/LIR.hpp"
+
+#include <cstddef>
+
+namespace hadron {
+namespace lir {
+
+// Loads element |index| of the constants Array of the running FunctionDef or Method. Heap objects can move, so code
+// never holds their addresses directly. It instead reaches them through the constants Array, which the collector scans
+// and updates like any other object. The dispatcher stores the FunctionDef or Method whose code is running in the
+// method slot of the Frame.
+struct LoadLiteralLIR : public LIR {
+    LoadLiteralLIR() = delete;
+    LoadLiteralLIR(int32_t i, TypeFlags t):
+        LIR(kLoadLiteral, t),
+        index(i) {}
+    virtual ~LoadLiteralLIR() = default;
+
+    int32_t index;
+
+    bool producesValue() const override { return true; }
+
+    void emit(JIT* jit, std::vector<std::pair<JIT::Label, LabelID>>& /* patchNeeded */) const override {
+        static_assert(offsetof(schema::FunctionDefSchema, constants) == offsetof(schema::MethodSchema, constants));
+        emitBase(jit);
+        // The value register serves as scratch for the pointer chase, removing the tag from each pointer in turn.
+        jit->ldxi_w(locate(value), JIT::kFramePointerReg, offsetof(schema::FramePrivateSchema, method));
+        jit->andi(locate(value), locate(value), ~Slot::kTagMask);
+        jit->ldxi_w(locate(value), locate(value), offsetof(schema::FunctionDefSchema, constants));
+        jit->andi(locate(value), locate(value), ~Slot::kTagMask);
+        jit->ldxi_w(locate(value), locate(value), sizeof(library::Schema) + (index * kSlotSize));
+    }
+};
+
+} // namespace lir
+} // namespace hadron
+
+#endif // SRC_HADRON_LIR_LOAD_LITERAL_LIR_HPP_
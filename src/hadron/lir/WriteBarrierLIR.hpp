@@ -0,0 +1,51 @@
+#ifndef SRC_HADRON_LIR_WRITE_BARRIER_LIR_HPP_
+#define SRC_HADRON_LIR_WRITE_BARRIER_LIR_HPP_
+
+#include "hadron/Heap.hpp"
+#include "hadron/lir/LIR.hpp"
+#include "hadron/ThreadContext.hpp"
+
+namespace hadron {
+namespace lir {
+
+// Generational write barrier, appends |object| to the ThreadContext store buffer so the Heap can find stores of young
+// pointers into mature objects, and during incremental marking stores into objects already marked black. Should follow
+// any store into a heap-allocated object.
+struct WriteBarrierLIR : public LIR {
+    WriteBarrierLIR() = delete;
+    explicit WriteBarrierLIR(VReg obj):
+        LIR(kWriteBarrier, TypeFlags::kNoFlags),
+        object(obj) {
+        read(object);
+    }
+    virtual ~WriteBarrierLIR() = default;
+
+    VReg object;
+
+    // The value is never read, it reserves a scratch register for the store buffer pointer.
+    bool producesValue() const override { return true; }
+
+    void emit(JIT* jit, std::vector<std::pair<JIT::Label, LabelID>>& /* patchNeeded */) const override {
+        emitBase(jit);
+        auto top = locate(value);
+        jit->ldxi_w(top, JIT::kContextPointerReg, offsetof(ThreadContext, storeBufferTop));
+        jit->stxi_w(0, top, locate(object));
+        jit->addi(top, top, sizeof(library::Schema*));
+        jit->stxi_w(offsetof(ThreadContext, storeBufferTop), JIT::kContextPointerReg, top);
+
+        // The store buffer is aligned to its size, so the masked top pointer is zero only when the buffer is full.
+        jit->andi(top, top, Heap::kStoreBufferSize - 1);
+        auto full = jit->beqi(top, 0);
+        auto done = jit->jmp();
+        jit->patchHere(full);
+        jit->ldxi_w(top, JIT::kContextPointerReg, offsetof(ThreadContext, storeBuffer));
+        jit->stxi_w(offsetof(ThreadContext, storeBufferTop), JIT::kContextPointerReg, top);
+        jit->stxi_w(offsetof(ThreadContext, storeBufferOverflow), JIT::kContextPointerReg, top);
+        jit->patchHere(done);
+    }
+};
+
+} // namespace lir
+} // namespace hadron
+
+#endif // SRC_HADRON_LIR_WRITE_BARRIER_LIR_HPP_
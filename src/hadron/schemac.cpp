@@ -10,6 +10,7 @@
 #include "fmt/format.h"
 #include "gflags/gflags.h"
 
+#include <algorithm>
 #include <array>
 #include <fstream>
 #include <iostream>
@@ -22,6 +23,7 @@
 DEFINE_string(classFiles, "", "Semicolon-delineated list of input class files to process.");
 DEFINE_string(libraryPath, "", "Base path of the SC class library.");
 DEFINE_string(schemaPath, "", "Base path of output schema files.");
+DEFINE_string(layoutFile, "", "Path of the output C++ file defining the table of class layouts for the collector.");
 
 namespace {
 // While we generate a Schema struct for these objects they are not represented by Hadron with pointers, rather their
@@ -36,6 +38,12 @@ std::unordered_set<std::string> PrimitiveTypeNames {
     "Symbol"
 };
 
+// Classes that also get a compressed variant of their storage, with the indexed Slots stored as 32 bit CompressedSlots.
+// Each variant has its own class index, after those of every class, and a layout of kIndexedCompressed.
+std::unordered_set<std::string> CompressedClassNames {
+    "Array"
+};
+
 // Some argument names in sclang are C++ keywords, causing the generated file to have invalid code. We keep a list
 // here of suitable replacements and use them if a match is encountered.
 std::unordered_map<std::string, std::string> keywordSubs {
@@ -46,8 +54,17 @@ struct ClassInfo {
     std::string className;
     std::string superClassName;
     bool isPrimitiveType;
+    // The optional name in brackets after the class name, like "slot" or "int8", for classes with indexed instances.
+    std::string indexedType;
     std::vector<std::string> variables;
 };
+
+struct LayoutInfo {
+    std::string className;
+    size_t fixedSlots;
+    std::string indexed;
+    uint64_t pointerMap;
+};
 } // namespace
 
 int main(int argc, char* argv[]) {
@@ -142,6 +159,10 @@ int main(int argc, char* argv[]) {
 
             classInfo.isPrimitiveType = PrimitiveTypeNames.count(classInfo.className) != 0;
 
+            if (classNode->optionalNameIndex) {
+                classInfo.indexedType = std::string(lexer.tokens()[classNode->optionalNameIndex.value()].range);
+            }
+
             // Add instance variables to classInfo struct.
             const hadron::parse::VarListNode* varList = classNode->variables.get();
             while (varList) {
@@ -170,8 +191,27 @@ int main(int argc, char* argv[]) {
         pathEnd = FLAGS_classFiles.find_first_of(';', pathBegin);
     } while (true);
 
+    // Number the non-primitive classes densely, in name order so the numbering doesn't depend on hash map iteration
+    // order. Object headers store these indices in place of class names.
+    std::vector<std::string> indexedClassNames;
+    for (const auto& pair : classes) {
+        if (!pair.second.isPrimitiveType) { indexedClassNames.emplace_back(pair.first); }
+    }
+    std::sort(indexedClassNames.begin(), indexedClassNames.end());
+    std::unordered_map<std::string, size_t> classIndices;
+    for (size_t i = 0; i < indexedClassNames.size(); ++i) {
+        classIndices.emplace(indexedClassNames[i], i);
+    }
+    std::unordered_map<std::string, size_t> compressedClassIndices;
+    for (const auto& className : indexedClassNames) {
+        if (CompressedClassNames.count(className)) {
+            compressedClassIndices.emplace(className, classIndices.size() + compressedClassIndices.size());
+        }
+    }
+
     // Now that we've parsed all the input files, we should have the complete class heirarchy defined for each input
     // class, and can generate the output files.
+    std::vector<LayoutInfo> layouts(indexedClassNames.size() + compressedClassIndices.size());
     for (const auto& pair : classFiles) {
         std::ofstream outFile(pair.first);
         if (!outFile) {
@@ -220,8 +260,17 @@ int main(int argc, char* argv[]) {
                 lineage.emplace(lineageIter);
             }
 
+            auto classIndex = classIndices.at(className);
+            outFile << fmt::format("    static constexpr uint32_t kClassIndex = {};\n", classIndex);
+            auto compressedIter = compressedClassIndices.find(className);
+            if (compressedIter != compressedClassIndices.end()) {
+                outFile << fmt::format("    static constexpr uint32_t kCompressedClassIndex = {};\n",
+                        compressedIter->second);
+            }
             outFile << std::endl << "    library::Schema schema;" << std::endl << std::endl;
 
+            LayoutInfo layout{className, 0, "kNotIndexed", 0};
+
             // Lineage in order from top to bottom.
             while (lineage.size()) {
                 lineageIter = lineage.top();
@@ -230,7 +279,27 @@ int main(int argc, char* argv[]) {
                 for (const auto& varName : lineageIter->second.variables) {
                     outFile << "    Slot " << varName << ";" << std::endl;
                 }
+                layout.fixedSlots += lineageIter->second.variables.size();
+
+                // Subclasses inherit the indexed type of the nearest ancestor that declares one. Every indexed type
+                // other than slot, including symbol, is stored as raw bytes.
+                if (lineageIter->second.indexedType != "") {
+                    layout.indexed = lineageIter->second.indexedType == "slot" ? "kIndexedSlots" : "kIndexedBytes";
+                }
+            }
+
+            // Instance variables are untyped, so any of them could hold a pointer.
+            layout.pointerMap = layout.fixedSlots >= 64 ? ~0ull : (1ull << layout.fixedSlots) - 1;
+            if (compressedIter != compressedClassIndices.end()) {
+                if (layout.indexed != "kIndexedSlots") {
+                    std::cerr << "Compressed storage requested for class without indexed slots: " << className
+                            << std::endl;
+                    return -1;
+                }
+                layouts[compressedIter->second] = LayoutInfo{className, layout.fixedSlots, "kIndexedCompressed",
+                        layout.pointerMap};
             }
+            layouts[classIndex] = std::move(layout);
 
             outFile << "};" << std::endl << std::endl;
             outFile << "static_assert(std::is_standard_layout<" << className << "Schema>::value);"
@@ -243,5 +312,31 @@ int main(int argc, char* argv[]) {
         outFile << "#endif // " << includeGuard << std::endl;
     }
 
+    if (FLAGS_layoutFile != "") {
+        std::ofstream layoutFile(FLAGS_layoutFile);
+        if (!layoutFile) {
+            std::cerr << "Layout file create error on output file: " << FLAGS_layoutFile << std::endl;
+            return -1;
+        }
+
+        layoutFile << "// NOTE: schemac automatically generated this file from sclang input files." << std::endl;
+        layoutFile << "// Edits will likely be clobbered." << std::endl << std::endl;
+        layoutFile << "#include \"hadron/LayoutTable.hpp\"" << std::endl << std::endl;
+        layoutFile << "namespace hadron {" << std::endl;
+        layoutFile << "namespace schema {" << std::endl << std::endl;
+        // Indexed by class index.
+        layoutFile << "const library::SchemaLayout kSchemaLayouts[] = {" << std::endl;
+        for (size_t i = 0; i < layouts.size(); ++i) {
+            const auto& layout = layouts[i];
+            layoutFile << fmt::format("    {{ 0x{:012x}, {}, library::SchemaLayout::{}, 0x{:016x} }}, // {} {}\n",
+                    hadron::hash(layout.className), layout.fixedSlots, layout.indexed, layout.pointerMap, i,
+                    layout.className);
+        }
+        layoutFile << "};" << std::endl << std::endl;
+        layoutFile << "const size_t kNumberOfSchemaLayouts = " << layouts.size() << ";" << std::endl << std::endl;
+        layoutFile << "} // namespace schema" << std::endl;
+        layoutFile << "} // namespace hadron" << std::endl;
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,114 @@
+// hbench, times C++ traversals of large heap collections with and without compressed pointers
+#include "hadron/ErrorReporter.hpp"
+#include "hadron/Heap.hpp"
+#include "hadron/library/Array.hpp"
+#include "hadron/PagePool.hpp"
+#include "hadron/Runtime.hpp"
+#include "hadron/ThreadContext.hpp"
+
+#include "fmt/format.h"
+#include "gflags/gflags.h"
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+DEFINE_int32(elements, 1 << 22, "Number of objects in each array traversed.");
+DEFINE_int32(iterations, 10, "Number of timed traversals of each array, of which the fastest is reported.");
+
+namespace {
+
+// Sums the Integer each element of |array| holds, fetching every element object as C++ code traversing a collection
+// would.
+template<typename A>
+int64_t sumElements(A array) {
+    int64_t sum = 0;
+    for (int32_t i = 0; i < array.size(); ++i) {
+        sum += array.typedAt(i).at(0).getInt32();
+    }
+    return sum;
+}
+
+// Returns the fastest of |iterations| traversals of |array|, storing the sum of the last in |sum|.
+template<typename A>
+std::chrono::nanoseconds timeTraversal(A array, int32_t iterations, int64_t& sum) {
+    auto fastest = std::chrono::nanoseconds::max();
+    for (int32_t i = 0; i < iterations; ++i) {
+        auto startTime = std::chrono::steady_clock::now();
+        sum = sumElements(array);
+        fastest = std::min(fastest, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - startTime));
+    }
+    return fastest;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, false);
+
+    if (FLAGS_elements <= 0 || FLAGS_iterations <= 0) {
+        SPDLOG_ERROR("--elements and --iterations must be positive.");
+        return -1;
+    }
+
+    // Compressed pointers must be enabled before creating the Heap.
+    if (!hadron::PagePool::instance().reserve(hadron::Heap::kMaximumCompressedReservation, hadron::PagePool::kNone)) {
+        SPDLOG_ERROR("Failed to reserve {} bytes for the heap.", hadron::Heap::kMaximumCompressedReservation);
+        return -1;
+    }
+    if (!hadron::Heap::enableCompressedPointers()) {
+        SPDLOG_ERROR("Failed to enable compressed pointers.");
+        return -1;
+    }
+
+    auto errorReporter = std::make_shared<hadron::ErrorReporter>();
+    hadron::Runtime runtime(errorReporter);
+    auto context = runtime.context();
+    // Nothing here is in the root set, so nothing may be collected.
+    context->heap->deferCollection();
+
+    // Both arrays refer to the same element objects, in a shuffled order, so that the traversals jump around the heap
+    // as traversals of long lived collections do. The arrays differ only in the size of their elements.
+    std::vector<hadron::library::Array> elements;
+    elements.reserve(FLAGS_elements);
+    for (int32_t i = 0; i < FLAGS_elements; ++i) {
+        elements.emplace_back(hadron::library::Array::newClear(context, 1));
+        elements.back().put(0, hadron::Slot::makeInt32(i));
+    }
+    std::vector<int32_t> order(FLAGS_elements);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937(0));
+
+    auto array = hadron::library::TypedArray<hadron::library::Array>(
+            hadron::library::Array::newClear(context, FLAGS_elements).instance());
+    auto compressedArray = hadron::library::CompressedArray<hadron::library::Array>::newClear(context,
+            FLAGS_elements);
+    for (int32_t i = 0; i < FLAGS_elements; ++i) {
+        array.put(i, elements[order[i]].slot());
+        compressedArray.typedPut(i, elements[order[i]]);
+    }
+
+    int64_t arraySum = 0;
+    auto arrayTime = timeTraversal(array, FLAGS_iterations, arraySum);
+    int64_t compressedSum = 0;
+    auto compressedTime = timeTraversal(compressedArray, FLAGS_iterations, compressedSum);
+    if (arraySum != compressedSum) {
+        SPDLOG_ERROR("Traversal sums differ, Array {} and CompressedArray {}.", arraySum, compressedSum);
+        return -1;
+    }
+
+    std::cout << fmt::format("Traversed {} elements, fastest of {} iterations.\n", FLAGS_elements, FLAGS_iterations);
+    std::cout << fmt::format("  Array:           {} us, {:.2f} ns per element\n", arrayTime.count() / 1000,
+            static_cast<double>(arrayTime.count()) / FLAGS_elements);
+    std::cout << fmt::format("  CompressedArray: {} us, {:.2f} ns per element\n", compressedTime.count() / 1000,
+            static_cast<double>(compressedTime.count()) / FLAGS_elements);
+
+    context->heap->allowCollection();
+    return 0;
+}
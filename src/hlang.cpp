@@ -1,25 +1,148 @@
 // hlang, command line SuperCollider language script interpreter
 #include "hadron/ErrorReporter.hpp"
+#include "hadron/Heap.hpp"
+#include "hadron/library/Symbol.hpp"
+#include "hadron/PagePool.hpp"
 #include "hadron/Runtime.hpp"
+#include "hadron/SymbolTable.hpp"
+#include "hadron/ThreadContext.hpp"
 
+#include "fmt/format.h"
 #include "gflags/gflags.h"
 #include "spdlog/spdlog.h"
 
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
 
 DEFINE_string(sourceFile, "", "Path to the source code file to execute.");
+DEFINE_int32(gcHelperThreads, -1, "Number of helper threads for parallel garbage collection, or -1 for one fewer than "
+        "the number of hardware threads.");
+DEFINE_string(heapImage, "", "Path of a heap image of the compiled class library, loaded on startup if up to date and "
+        "written after compiling the class library otherwise.");
+DEFINE_double(compactionThreshold, 0.0, "Compact the mature space after full collections that leave at least this "
+        "fraction of it unused, or 0 to never compact.");
+DEFINE_bool(dumpHeapStats, false, "Print heap statistics to stdout on exit.");
+DEFINE_uint64(allocationSampleInterval, hadron::AllocationProfiler::kDefaultSampleInterval, "Average number of bytes "
+        "allocated between allocation profiler samples, or 0 to disable allocation sampling.");
+DEFINE_string(allocationProfile, "", "Path to write sampled allocations to on exit, in the folded stack format used by "
+        "flame graph tools.");
+DEFINE_uint64(heapReservation, 0, "Bytes of address space to reserve up front for heap pages, or 0 to map pages as "
+        "needed.");
+DEFINE_string(hugePages, "none", "Backing for the heap reservation, one of 'none', 'transparent', or 'explicit'.");
+DEFINE_bool(compressedPointers, false, "Confine the heap to its reservation so that compressed arrays can store 32 bit "
+        "object references. Reserves the largest supported reservation if --heapReservation is 0.");
+
+namespace {
+
+void dumpHeapStats(hadron::ThreadContext* context) {
+    auto stats = context->heap->stats();
+    std::cout << fmt::format("Heap statistics, peak resident set size {} bytes.\n", stats.peakResidentBytes);
+
+    std::cout << fmt::format("{} young and {} full collections, {} compactions, paused {} us in total and {} us at "
+            "most.\n", stats.youngCollections, stats.fullCollections, stats.compactions, stats.totalPauseTime.count(),
+            stats.maximumPauseTime.count());
+    std::cout << "Pause time histogram:\n";
+    for (size_t i = 0; i < stats.pauseHistogram.size(); ++i) {
+        if (stats.pauseHistogram[i] == 0) { continue; }
+        if (i == 0) {
+            std::cout << fmt::format("  under 1 us: {}\n", stats.pauseHistogram[i]);
+        } else if (i == stats.pauseHistogram.size() - 1) {
+            std::cout << fmt::format("  {} us and over: {}\n", 1ull << (i - 1), stats.pauseHistogram[i]);
+        } else {
+            std::cout << fmt::format("  {} to {} us: {}\n", 1ull << (i - 1), 1ull << i, stats.pauseHistogram[i]);
+        }
+    }
+
+    std::cout << "Pages by space:\n";
+    for (const auto& [name, space] : { std::make_pair("young", stats.youngSpace),
+            std::make_pair("mature", stats.matureSpace), std::make_pair("permanent", stats.permanentSpace),
+            std::make_pair("executable", stats.executableSpace), std::make_pair("large object", stats.largeObjectSpace),
+            std::make_pair("stack", stats.stackSpace) }) {
+        std::cout << fmt::format("  {}: {} pages, {} bytes, {} bytes allocated\n", name, space.pages, space.bytesMapped,
+                space.bytesAllocated);
+    }
+
+    std::cout << "Size classes in use (object size: objects, bytes allocated, bytes used, total allocations):\n";
+    for (const auto& usage : stats.sizeClasses) {
+        if (usage.objects == 0 && usage.totalAllocations == 0) { continue; }
+        std::cout << fmt::format("  {}: {}, {}, {}, {}\n", usage.objectSize, usage.objects, usage.bytesAllocated,
+                usage.bytesUsed, usage.totalAllocations);
+    }
+
+    // List classes by bytes allocated, most first.
+    std::vector<std::pair<hadron::Hash, hadron::HeapStats::ClassUsage>> classes(stats.classes.begin(),
+            stats.classes.end());
+    std::sort(classes.begin(), classes.end(), [](const auto& a, const auto& b) {
+        return a.second.bytes > b.second.bytes;
+    });
+    std::cout << "Classes (name: objects, bytes):\n";
+    for (const auto& [hash, usage] : classes) {
+        std::string name = context->symbolTable->isDefined(hash) ?
+                std::string(hadron::library::Symbol(context, hadron::Slot::makeHash(hash)).view(context)) :
+                fmt::format("{:#x}", hash);
+        std::cout << fmt::format("  {}: {}, {}\n", name, usage.objects, usage.bytes);
+    }
+}
+
+} // namespace
 
 int main(int argc, char* argv[]) {
     gflags::ParseCommandLineFlags(&argc, &argv, false);
 
     spdlog::default_logger()->set_level(spdlog::level::trace);
 
+    uint64_t heapReservation = FLAGS_heapReservation;
+    if (FLAGS_compressedPointers && heapReservation == 0) {
+        heapReservation = hadron::Heap::kMaximumCompressedReservation;
+    }
+    if (heapReservation > 0) {
+        auto hugePages = hadron::PagePool::kNone;
+        if (FLAGS_hugePages == "transparent") {
+            hugePages = hadron::PagePool::kTransparent;
+        } else if (FLAGS_hugePages == "explicit") {
+            hugePages = hadron::PagePool::kExplicit;
+        } else if (FLAGS_hugePages != "none") {
+            SPDLOG_ERROR("Unknown --hugePages value '{}'.", FLAGS_hugePages);
+            return -1;
+        }
+        if (!hadron::PagePool::instance().reserve(heapReservation, hugePages)) {
+            SPDLOG_WARN("Failed to reserve {} bytes for the heap, mapping pages as needed.", heapReservation);
+        }
+    }
+    if (FLAGS_compressedPointers && !hadron::Heap::enableCompressedPointers()) {
+        SPDLOG_ERROR("Failed to enable compressed pointers.");
+        return -1;
+    }
+
     auto errorReporter = std::make_shared<hadron::ErrorReporter>();
     hadron::Runtime runtime(errorReporter);
-    if (!runtime.initInterpreter()) {
-        return -1;
+    int32_t helperThreads = FLAGS_gcHelperThreads;
+    if (helperThreads < 0) {
+        helperThreads = static_cast<int32_t>(std::max(std::thread::hardware_concurrency(), 1u)) - 1;
+    }
+    runtime.context()->heap->setHelperThreads(static_cast<size_t>(helperThreads));
+    runtime.context()->heap->setCompactionThreshold(FLAGS_compactionThreshold);
+    runtime.context()->heap->allocationProfiler().setSampleInterval(FLAGS_allocationSampleInterval);
+    runtime.setHeapImagePath(FLAGS_heapImage);
+    bool initialized = runtime.initInterpreter();
+
+    if (FLAGS_dumpHeapStats) {
+        dumpHeapStats(runtime.context());
+    }
+
+    if (!FLAGS_allocationProfile.empty()) {
+        std::ofstream profile(FLAGS_allocationProfile);
+        if (!profile) {
+            SPDLOG_ERROR("Failed to open allocation profile file {}.", FLAGS_allocationProfile);
+            return -1;
+        }
+        runtime.context()->heap->allocationProfiler().writeFoldedStacks(runtime.context(), profile);
     }
 
-    return 0;
+    return initialized ? 0 : -1;
 }
\ No newline at end of file
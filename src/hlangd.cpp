@@ -14,6 +14,8 @@
 DEFINE_string(logFile, "hlangdLog.txt", "Path and file name of log file.");
 DEFINE_bool(debugLogs, false, "Set log output level to debug (verbose).");
 DEFINE_bool(traceLogs, true, "Set log output level to trace (very verbose).");
+DEFINE_string(heapImage, "", "Path of a heap image of the compiled class library, loaded on startup if up to date and "
+        "written after compiling the class library otherwise.");
 
 int main(int argc, char* argv[]) {
     gflags::ParseCommandLineFlags(&argc, &argv, false);
@@ -32,7 +34,7 @@ int main(int argc, char* argv[]) {
         hadron::kHadronBranch, hadron::kHadronCommitHash, hadron::kHadronCompilerName, hadron::kHadronCompilerVersion);
 
     auto transport = std::make_unique<server::JSONTransport>(stdin, stdout);
-    server::HadronServer server(std::move(transport));
+    server::HadronServer server(std::move(transport), FLAGS_heapImage);
 
     int returnCode = server.runLoop();
 
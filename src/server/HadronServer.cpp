@@ -7,9 +7,11 @@
 #include "hadron/BlockBuilder.hpp"
 #include "hadron/BlockSerializer.hpp"
 #include "hadron/ClassLibrary.hpp"
+#include "hadron/DispatchTable.hpp"
 #include "hadron/Emitter.hpp"
 #include "hadron/ErrorReporter.hpp"
 #include "hadron/Frame.hpp"
+#include "hadron/Heap.hpp"
 #include "hadron/Lexer.hpp"
 #include "hadron/LifetimeAnalyzer.hpp"
 #include "hadron/LighteningJIT.hpp"
@@ -28,12 +30,13 @@
 
 namespace server {
 
-HadronServer::HadronServer(std::unique_ptr<JSONTransport> jsonTransport):
+HadronServer::HadronServer(std::unique_ptr<JSONTransport> jsonTransport, const std::string& heapImagePath):
         m_jsonTransport(std::move(jsonTransport)),
         m_state(kUninitialized),
         m_errorReporter(std::make_shared<hadron::ErrorReporter>()),
         m_runtime(std::make_unique<hadron::Runtime>(m_errorReporter)) {
     m_jsonTransport->setServer(this);
+    m_runtime->setHeapImagePath(heapImagePath);
 }
 
 int HadronServer::runLoop() {
@@ -71,10 +74,15 @@ void HadronServer::semanticTokensFull(const std::string& filePath) {
 
 void HadronServer::hadronCompilationDiagnostics(lsp::ID id, const std::string& filePath,
         DiagnosticsStoppingPoint stopAfter) {
+    // Compilation holds references to heap objects the Heap can't see, including in the CompilationUnits until they
+    // are serialized, so defer any collection until done.
+    m_runtime->context()->heap->deferCollection();
+
     hadron::SourceFile sourceFile(filePath);
     if (!sourceFile.read(m_errorReporter)) {
         m_jsonTransport->sendErrorResponse(std::nullopt, JSONTransport::ErrorCode::kFileReadError,
                 fmt::format("Failed to read file {} for parsing.", filePath));
+        m_runtime->context()->heap->allowCollection();
         return;
     }
 
@@ -82,6 +90,7 @@ void HadronServer::hadronCompilationDiagnostics(lsp::ID id, const std::string& f
     auto lexer = std::make_shared<hadron::Lexer>(code, m_errorReporter);
     if (!lexer->lex() || !m_errorReporter->ok()) {
         // TODO: errorReporter starts reporting problems itself
+        m_runtime->context()->heap->allowCollection();
         return;
     }
 
@@ -99,6 +108,7 @@ void HadronServer::hadronCompilationDiagnostics(lsp::ID id, const std::string& f
     if (isClassFile) {
         if (!parser->parseClass() || !m_errorReporter->ok()) {
             // TODO: error handling
+            m_runtime->context()->heap->allowCollection();
             return;
         }
         const hadron::parse::Node* node = parser->root();
@@ -129,14 +139,8 @@ void HadronServer::hadronCompilationDiagnostics(lsp::ID id, const std::string& f
 
                     auto methodClass = methodNode->isClassMethod ? metaClassDef : classDef;
 
-                    hadron::library::Method methodDef;
-                    for (int32_t i = 0; i < methodClass.methods().size(); ++i) {
-                        auto method = methodClass.methods().typedAt(i);
-                        if (method.name(m_runtime->context()) == methodName) {
-                            methodDef = method;
-                            break;
-                        }
-                    }
+                    auto methodDef = m_runtime->context()->classLibrary->dispatchTable()->lookup(
+                            m_runtime->context(), methodClass, methodName);
 
                     if (methodDef.isNil()) {
                         SPDLOG_CRITICAL("Failed to find {}:{} methodDef.", className.view(m_runtime->context()),
@@ -155,6 +159,7 @@ void HadronServer::hadronCompilationDiagnostics(lsp::ID id, const std::string& f
     } else {
         if (!parser->parse() || !m_errorReporter->ok()) {
             // TODO: errors
+            m_runtime->context()->heap->allowCollection();
             return;
         }
         assert(parser->root()->nodeType == hadron::parse::NodeType::kBlock);
@@ -163,6 +168,12 @@ void HadronServer::hadronCompilationDiagnostics(lsp::ID id, const std::string& f
                 reinterpret_cast<const hadron::parse::BlockNode*>(parser->root()), units, stopAfter);
     }
     m_jsonTransport->sendCompilationDiagnostics(m_runtime->context(), id, units);
+    m_runtime->context()->heap->allowCollection();
+}
+
+void HadronServer::hadronHeapStats(lsp::ID id) {
+    auto heapStats = m_runtime->context()->heap->stats();
+    m_jsonTransport->sendHeapStats(m_runtime->context(), id, heapStats);
 }
 
 void HadronServer::addCompilationUnit(hadron::library::Method methodDef, std::shared_ptr<hadron::Lexer> lexer,
@@ -27,7 +27,8 @@ class JSONTransport;
 class HadronServer {
 public:
     HadronServer() = delete;
-    HadronServer(std::unique_ptr<JSONTransport> jsonTransport);
+    // If |heapImagePath| is not empty the class library is loaded from, or saved to, the HeapImage at that path.
+    HadronServer(std::unique_ptr<JSONTransport> jsonTransport, const std::string& heapImagePath = "");
 
     int runLoop();
 
@@ -48,6 +49,8 @@ public:
         kMachineCodeEmission = 9
     };
     void hadronCompilationDiagnostics(lsp::ID id, const std::string& filePath, DiagnosticsStoppingPoint stopAfter);
+    // Responds with the HeapStats of the runtime Heap.
+    void hadronHeapStats(lsp::ID id);
 
     enum ServerState {
         kUninitialized,
@@ -4,11 +4,13 @@
 #include "hadron/Block.hpp"
 #include "hadron/BlockBuilder.hpp"
 #include "hadron/Frame.hpp"
+#include "hadron/Heap.hpp"
 
 #include "hadron/hir/BlockLiteralHIR.hpp"
 #include "hadron/hir/BranchHIR.hpp"
 #include "hadron/hir/BranchIfTrueHIR.hpp"
 #include "hadron/hir/ConstantHIR.hpp"
+#include "hadron/hir/DirectCallHIR.hpp"
 #include "hadron/hir/HIR.hpp"
 #include "hadron/hir/LoadOuterFrameHIR.hpp"
 #include "hadron/hir/MessageHIR.hpp"
@@ -29,21 +31,26 @@
 #include "hadron/LifetimeInterval.hpp"
 #include "hadron/LinearFrame.hpp"
 
+#include "hadron/lir/AllocateLIR.hpp"
 #include "hadron/lir/AssignLIR.hpp"
 #include "hadron/lir/BranchIfTrueLIR.hpp"
 #include "hadron/lir/BranchLIR.hpp"
 #include "hadron/lir/BranchToRegisterLIR.hpp"
 #include "hadron/lir/InterruptLIR.hpp"
+#include "hadron/lir/IsSubclassOfLIR.hpp"
 #include "hadron/lir/LabelLIR.hpp"
 #include "hadron/lir/LIR.hpp"
 #include "hadron/lir/LoadConstantLIR.hpp"
 #include "hadron/lir/LoadFromPointerLIR.hpp"
+#include "hadron/lir/LoadLiteralLIR.hpp"
 #include "hadron/lir/PhiLIR.hpp"
 #include "hadron/lir/StoreToPointerLIR.hpp"
+#include "hadron/lir/WriteBarrierLIR.hpp"
 
 #include "hadron/OpcodeIterator.hpp"
 #include "hadron/Parser.hpp"
 #include "hadron/Scope.hpp"
+#include "hadron/SymbolTable.hpp"
 #include "hadron/ThreadContext.hpp"
 #include "server/HadronServer.hpp"
 #include "server/LSPMethods.hpp"
@@ -78,6 +85,7 @@ public:
     void sendSemanticTokens(const std::vector<hadron::Token>& tokens);
     void sendCompilationDiagnostics(hadron::ThreadContext* context, lsp::ID id,
             const std::vector<CompilationUnit>& compilationUnits);
+    void sendHeapStats(hadron::ThreadContext* context, lsp::ID id, const hadron::HeapStats& heapStats);
 
 private:
     size_t readHeaders();
@@ -351,6 +359,101 @@ void JSONTransport::JSONTransportImpl::sendSemanticTokens(const std::vector<hadr
     sendMessage(document);
 }
 
+void JSONTransport::JSONTransportImpl::sendHeapStats(hadron::ThreadContext* context, lsp::ID id,
+        const hadron::HeapStats& heapStats) {
+    rapidjson::Document document;
+    document.SetObject();
+    document.AddMember("jsonrpc", rapidjson::Value("2.0"), document.GetAllocator());
+    encodeId(id, document);
+
+    rapidjson::Value result;
+    result.SetObject();
+
+    rapidjson::Value sizeClasses;
+    sizeClasses.SetArray();
+    for (const auto& usage : heapStats.sizeClasses) {
+        rapidjson::Value jsonUsage;
+        jsonUsage.SetObject();
+        jsonUsage.AddMember("objectSize", rapidjson::Value(static_cast<uint64_t>(usage.objectSize)),
+                document.GetAllocator());
+        jsonUsage.AddMember("pages", rapidjson::Value(static_cast<uint64_t>(usage.pages)), document.GetAllocator());
+        jsonUsage.AddMember("objects", rapidjson::Value(static_cast<uint64_t>(usage.objects)), document.GetAllocator());
+        jsonUsage.AddMember("bytesAllocated", rapidjson::Value(static_cast<uint64_t>(usage.bytesAllocated)),
+                document.GetAllocator());
+        jsonUsage.AddMember("bytesUsed", rapidjson::Value(static_cast<uint64_t>(usage.bytesUsed)),
+                document.GetAllocator());
+        jsonUsage.AddMember("totalAllocations", rapidjson::Value(static_cast<uint64_t>(usage.totalAllocations)),
+                document.GetAllocator());
+        jsonUsage.AddMember("totalBytesRequested", rapidjson::Value(static_cast<uint64_t>(usage.totalBytesRequested)),
+                document.GetAllocator());
+        sizeClasses.PushBack(jsonUsage, document.GetAllocator());
+    }
+    result.AddMember("sizeClasses", sizeClasses, document.GetAllocator());
+
+    rapidjson::Value classes;
+    classes.SetArray();
+    for (const auto& [hash, usage] : heapStats.classes) {
+        rapidjson::Value jsonUsage;
+        jsonUsage.SetObject();
+        // Objects allocated before their class name was added to the symbol table only have the hash.
+        if (context->symbolTable->isDefined(hash)) {
+            rapidjson::Value className;
+            serializeSymbol(context, hadron::library::Symbol(context, hadron::Slot::makeHash(hash)), className,
+                    document);
+            jsonUsage.AddMember("className", className, document.GetAllocator());
+        } else {
+            rapidjson::Value className;
+            className.SetObject();
+            className.AddMember("hash", rapidjson::Value(hash), document.GetAllocator());
+            jsonUsage.AddMember("className", className, document.GetAllocator());
+        }
+        jsonUsage.AddMember("objects", rapidjson::Value(static_cast<uint64_t>(usage.objects)), document.GetAllocator());
+        jsonUsage.AddMember("bytes", rapidjson::Value(static_cast<uint64_t>(usage.bytes)), document.GetAllocator());
+        classes.PushBack(jsonUsage, document.GetAllocator());
+    }
+    result.AddMember("classes", classes, document.GetAllocator());
+
+    rapidjson::Value spaces;
+    spaces.SetObject();
+    for (const auto& [name, space] : { std::make_pair("young", heapStats.youngSpace),
+            std::make_pair("mature", heapStats.matureSpace), std::make_pair("permanent", heapStats.permanentSpace),
+            std::make_pair("executable", heapStats.executableSpace),
+            std::make_pair("largeObject", heapStats.largeObjectSpace),
+            std::make_pair("stack", heapStats.stackSpace) }) {
+        rapidjson::Value jsonSpace;
+        jsonSpace.SetObject();
+        jsonSpace.AddMember("pages", rapidjson::Value(static_cast<uint64_t>(space.pages)), document.GetAllocator());
+        jsonSpace.AddMember("bytesMapped", rapidjson::Value(static_cast<uint64_t>(space.bytesMapped)),
+                document.GetAllocator());
+        jsonSpace.AddMember("bytesAllocated", rapidjson::Value(static_cast<uint64_t>(space.bytesAllocated)),
+                document.GetAllocator());
+        spaces.AddMember(rapidjson::StringRef(name), jsonSpace, document.GetAllocator());
+    }
+    result.AddMember("spaces", spaces, document.GetAllocator());
+
+    result.AddMember("youngCollections", rapidjson::Value(static_cast<uint64_t>(heapStats.youngCollections)),
+            document.GetAllocator());
+    result.AddMember("fullCollections", rapidjson::Value(static_cast<uint64_t>(heapStats.fullCollections)),
+            document.GetAllocator());
+    result.AddMember("compactions", rapidjson::Value(static_cast<uint64_t>(heapStats.compactions)),
+            document.GetAllocator());
+    rapidjson::Value pauseHistogram;
+    pauseHistogram.SetArray();
+    for (auto count : heapStats.pauseHistogram) {
+        pauseHistogram.PushBack(rapidjson::Value(static_cast<uint64_t>(count)), document.GetAllocator());
+    }
+    result.AddMember("pauseHistogram", pauseHistogram, document.GetAllocator());
+    result.AddMember("totalPauseTimeMicroseconds", rapidjson::Value(static_cast<int64_t>(
+            heapStats.totalPauseTime.count())), document.GetAllocator());
+    result.AddMember("maximumPauseTimeMicroseconds", rapidjson::Value(static_cast<int64_t>(
+            heapStats.maximumPauseTime.count())), document.GetAllocator());
+    result.AddMember("peakResidentBytes", rapidjson::Value(static_cast<uint64_t>(heapStats.peakResidentBytes)),
+            document.GetAllocator());
+
+    document.AddMember("result", result, document.GetAllocator());
+    sendMessage(document);
+}
+
 void JSONTransport::JSONTransportImpl::sendCompilationDiagnostics(hadron::ThreadContext* context, lsp::ID id,
         const std::vector<CompilationUnit>& compilationUnits) {
     rapidjson::Document document;
@@ -537,6 +640,10 @@ bool JSONTransport::JSONTransportImpl::handleMethod(const std::string& methodNam
         m_server->hadronCompilationDiagnostics(*id, (*params)["textDocument"]["uri"].GetString(),
             static_cast<HadronServer::DiagnosticsStoppingPoint>((*params)["stopAfter"].GetInt()));
     } break;
+    case server::lsp::Method::kHadronHeapStats:
+        SPDLOG_TRACE("heapStats");
+        m_server->hadronHeapStats(*id);
+        break;
     }
     return true;
 }
@@ -1525,6 +1632,37 @@ void JSONTransport::JSONTransportImpl::serializeHIR(hadron::ThreadContext* conte
         jsonHIR.AddMember("constant", value, document.GetAllocator());
     } break;
 
+    case hadron::hir::Opcode::kDirectCall: {
+        const auto directCall = reinterpret_cast<const hadron::hir::DirectCallHIR*>(hir);
+        jsonHIR.AddMember("opcode", "DirectCall", document.GetAllocator());
+
+        rapidjson::Value selector;
+        serializeSymbol(context, directCall->selector, selector, document);
+        jsonHIR.AddMember("selector", selector, document.GetAllocator());
+
+        rapidjson::Value ownerClass;
+        serializeSymbol(context, directCall->method.ownerClass().name(context), ownerClass, document);
+        jsonHIR.AddMember("ownerClass", ownerClass, document.GetAllocator());
+
+        rapidjson::Value arguments;
+        arguments.SetArray();
+        for (auto argId : directCall->arguments) {
+            rapidjson::Value arg;
+            serializeValue(context, argId, frame, arg, document);
+            arguments.PushBack(arg, document.GetAllocator());
+        }
+        jsonHIR.AddMember("arguments", arguments, document.GetAllocator());
+
+        rapidjson::Value keywordArguments;
+        keywordArguments.SetArray();
+        for (auto argId : directCall->keywordArguments) {
+            rapidjson::Value arg;
+            serializeValue(context, argId, frame, arg, document);
+            keywordArguments.PushBack(arg, document.GetAllocator());
+        }
+        jsonHIR.AddMember("keywordArguments", keywordArguments, document.GetAllocator());
+    } break;
+
     case hadron::hir::Opcode::kLoadOuterFrame: {
         const auto loadOuter = reinterpret_cast<const hadron::hir::LoadOuterFrameHIR*>(hir);
         jsonHIR.AddMember("opcode", "LoadOuterFrame", document.GetAllocator());
@@ -1835,6 +1973,15 @@ void JSONTransport::JSONTransportImpl::serializeLIR(hadron::ThreadContext* conte
     jsonLIR.AddMember("locations", valueLocations, document.GetAllocator());
 
     switch(lir->opcode) {
+    case hadron::lir::Opcode::kAllocate: {
+        const auto allocate = reinterpret_cast<const hadron::lir::AllocateLIR*>(lir);
+        jsonLIR.AddMember("opcode", "Allocate", document.GetAllocator());
+        jsonLIR.AddMember("scratch", rapidjson::Value(allocate->scratch), document.GetAllocator());
+        jsonLIR.AddMember("sizeInBytes", rapidjson::Value(static_cast<uint64_t>(allocate->sizeInBytes)),
+                document.GetAllocator());
+        jsonLIR.AddMember("classIndex", rapidjson::Value(allocate->classIndex), document.GetAllocator());
+    } break;
+
     case hadron::lir::Opcode::kAssign: {
         const auto assign = reinterpret_cast<const hadron::lir::AssignLIR*>(lir);
         jsonLIR.AddMember("opcode", "Assign", document.GetAllocator());
@@ -1866,6 +2013,14 @@ void JSONTransport::JSONTransportImpl::serializeLIR(hadron::ThreadContext* conte
         jsonLIR.AddMember("interruptCode", rapidjson::Value(interrupt->interruptCode), document.GetAllocator());
     } break;
 
+    case hadron::lir::Opcode::kIsSubclassOf: {
+        const auto isSubclassOf = reinterpret_cast<const hadron::lir::IsSubclassOfLIR*>(lir);
+        jsonLIR.AddMember("opcode", "IsSubclassOf", document.GetAllocator());
+        jsonLIR.AddMember("classDef", rapidjson::Value(isSubclassOf->classDef), document.GetAllocator());
+        jsonLIR.AddMember("superclass", rapidjson::Value(isSubclassOf->superclass), document.GetAllocator());
+        jsonLIR.AddMember("scratch", rapidjson::Value(isSubclassOf->scratch), document.GetAllocator());
+    } break;
+
     case hadron::lir::Opcode::kLabel: {
         const auto label = reinterpret_cast<const hadron::lir::LabelLIR*>(lir);
         jsonLIR.AddMember("opcode", "Label", document.GetAllocator());
@@ -1911,6 +2066,12 @@ void JSONTransport::JSONTransportImpl::serializeLIR(hadron::ThreadContext* conte
         jsonLIR.AddMember("offset", rapidjson::Value(loadPointer->offset), document.GetAllocator());
     } break;
 
+    case hadron::lir::kLoadLiteral: {
+        const auto loadLiteral = reinterpret_cast<const hadron::lir::LoadLiteralLIR*>(lir);
+        jsonLIR.AddMember("opcode", "LoadLiteral", document.GetAllocator());
+        jsonLIR.AddMember("index", rapidjson::Value(loadLiteral->index), document.GetAllocator());
+    } break;
+
     case hadron::lir::kPhi: {
         const auto phi = reinterpret_cast<const hadron::lir::PhiLIR*>(lir);
         jsonLIR.AddMember("opcode", "Phi", document.GetAllocator());
@@ -1930,6 +2091,12 @@ void JSONTransport::JSONTransportImpl::serializeLIR(hadron::ThreadContext* conte
         jsonLIR.AddMember("toStore", rapidjson::Value(storePointer->toStore), document.GetAllocator());
         jsonLIR.AddMember("offset", rapidjson::Value(storePointer->offset), document.GetAllocator());
     } break;
+
+    case hadron::lir::kWriteBarrier: {
+        const auto writeBarrier = reinterpret_cast<const hadron::lir::WriteBarrierLIR*>(lir);
+        jsonLIR.AddMember("opcode", "WriteBarrier", document.GetAllocator());
+        jsonLIR.AddMember("object", rapidjson::Value(writeBarrier->object), document.GetAllocator());
+    } break;
     }
 
 }
@@ -1967,4 +2134,8 @@ void JSONTransport::sendCompilationDiagnostics(hadron::ThreadContext* context, l
     m_impl->sendCompilationDiagnostics(context, id, compilationUnits);
 }
 
+void JSONTransport::sendHeapStats(hadron::ThreadContext* context, lsp::ID id, const hadron::HeapStats& heapStats) {
+    m_impl->sendHeapStats(context, id, heapStats);
+}
+
 } // namespace server
\ No newline at end of file
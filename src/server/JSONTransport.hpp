@@ -12,6 +12,7 @@
 #include <vector>
 
 namespace hadron {
+struct HeapStats;
 struct ThreadContext;
 } // namespace hadron
 
@@ -58,6 +59,7 @@ public:
 
     void sendCompilationDiagnostics(hadron::ThreadContext* context, lsp::ID id,
             const std::vector<CompilationUnit>& compilationUnits);
+    void sendHeapStats(hadron::ThreadContext* context, lsp::ID id, const hadron::HeapStats& heapStats);
 
 private:
     // pIMPL pattern to keep JSON headers from leaking into rest of server namespace.
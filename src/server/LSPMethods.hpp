@@ -17,7 +17,8 @@ enum Method {
     kSemanticTokensFull,
 
     // Hadron-specific extensions in the 'hadron/' method namespace
-    kHadronCompilationDiagnostics
+    kHadronCompilationDiagnostics,
+    kHadronHeapStats
 };
 
 Method getMethodNamed(const char* name, size_t length);
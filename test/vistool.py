@@ -97,7 +97,10 @@ def vRegToString(lir):
     return '({}) VR{}'.format(flags, lir['value'])
 
 def lirToString(lir):
-    if lir['opcode'] == 'Assign':
+    if lir['opcode'] == 'Allocate':
+        return '{} &#8592; allocate {} bytes of class index {}'.format(vRegToString(lir), lir['sizeInBytes'],
+                lir['classIndex'])
+    elif lir['opcode'] == 'Assign':
         return 'VR{} &#8592; VR{}'.format(lir['origin'])
     elif lir['opcode'] == 'Branch':
         return 'Branch to Label {}'.format(lir['labelId'])
@@ -105,6 +108,8 @@ def lirToString(lir):
         return 'BranchIfTrue {} to Label {}'.format(lir['condition'], lir['labelId'])
     elif lir['opcode'] == 'BranchToRegister':
         return 'BranchToRegister VR{}'.format(lir['address'])
+    elif lir['opcode'] == 'IsSubclassOf':
+        return '{} &#8592; VR{} isSubclassOf VR{}'.format(vRegToString(lir), lir['classDef'], lir['superclass'])
     elif lir['opcode'] == 'Label':
         # Labels get their own column for readability.
         return ''
@@ -113,6 +118,8 @@ def lirToString(lir):
     elif lir['opcode'] == 'LoadFromPointer':
         return '{} &#8592; *(VR{} + {})'.format(vRegToString(lir), lir['pointer'],
                 lir['offset'])
+    elif lir['opcode'] == 'LoadLiteral':
+        return '{} &#8592; constants[{}]'.format(vRegToString(lir), lir['index'])
     elif lir['opcode'] == 'LoadFromStack':
         if lir['useFramePointer']:
             return '{} &#8592; *(FP + {})'.format(vRegToString(lir), lir['offset'])